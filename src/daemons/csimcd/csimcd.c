@@ -48,12 +48,14 @@
 #include "running.h"
 #include "strops.h"
 #include "telenv.h"
+#include "trace.h"
 
 #define SPEED B38400 /* cflag for tty speed */
 #define MAXV 5       /* max verbose */
 #define SOPWAIT 50   /* socket open wait time, secs */
 
 #define TOKWT 5000 /* ms to wait for token back */
+#define PARTIAL (-2) /* readBootFrame(): the rest has yet to arrive */
 
 typedef struct
 {
@@ -62,6 +64,8 @@ typedef struct
     int cfd;        /* client fd, if cfdset */
     int toaddr;     /* node address */
     OpenWhy why;    /* goal of connect */
+    Byte frame[PMXDAT + 1]; /* FOR_WBOOT: boot packet so far, after its length */
+    int nframe;     /* bytes of it, including the length */
 } CInfo;
 
 static void usage(char *me);
@@ -98,6 +102,7 @@ static void clientMsg(int fd);
 static int buildShellXPkt(int fd);
 static int buildSerialXPkt(int fd);
 static int buildBootXPkt(int fd);
+static int readBootFrame(int cfd, char *dp);
 static void closecfd(int cfd);
 static void breakAllConnections(void);
 static void breakConnections(int to);
@@ -106,6 +111,7 @@ static int pktSize(Byte pkt[]);
 static void logAddr(int fr);
 static char *p2tstr(Pkt *pktp);
 static void onVerboseSig(int dummy);
+static void onTraceSig(int signo);
 static void onExit(void);
 static void onBye(int signo);
 static int sendBaud(int cfd, int baud);
@@ -116,6 +122,7 @@ static CInfo *CFD2CIP(int fd);
 static char tty_def[30] = "/dev/ttyS0";             /* default tty onto network */
 static char *tty = tty_def;                         /* tty we actually use */
 static int port = CSIMCPORT;                        /* default IP port */
+static int portarg;                                 /* set if -i, which beats cfg */
 static char cfg_def[] = "archive/config/csimc.cfg"; /* default config file */
 static char *cfg = cfg_def;                         /* config file we actually use */
 
@@ -150,6 +157,7 @@ static CInfo cinfo[NHOSTS];                /* connection info */
 int main(int ac, char *av[])
 {
     char *me = basenm(av[0]);
+    double stall = 0;
 
     /* check args */
     while ((--ac > 0) && ((*++av)[0] == '-'))
@@ -168,6 +176,7 @@ int main(int ac, char *av[])
                 if (ac < 2)
                     usage(me);
                 port = atoi(*++av);
+                portarg++;
                 ac--;
                 break;
             case 'm':
@@ -179,6 +188,12 @@ int main(int ac, char *av[])
                 tty = *++av;
                 ac--;
                 break;
+            case 'T':
+                if (ac < 2)
+                    usage(me);
+                stall = atof(*++av);
+                ac--;
+                break;
             case 'v':
                 verbose++;
                 break;
@@ -198,16 +213,27 @@ int main(int ac, char *av[])
         exit(0);
     }
 
-    /* set log now to proper place */
+    /* set log now to proper place, and log without waiting on the disk */
     telOELog(me);
+    if (logRingInit(0) < 0)
+        daemonLog("Can not start log ring, logging synchronously");
 
     /* a few signal issues */
     signal(SIGPIPE, SIG_IGN);
     signal(SIGHUP, onVerboseSig);
+    signal(SIGUSR1, onTraceSig);
+    signal(SIGUSR2, onTraceSig);
     signal(SIGTERM, onBye);
     signal(SIGINT, onBye);
     signal(SIGQUIT, onBye);
 
+    /* trace spans from the start if asked */
+    if (stall > 0)
+    {
+        traceStall(stall);
+        traceEnable(1);
+    }
+
     /* init defaults */
     initCfg();
 
@@ -216,11 +242,15 @@ int main(int ac, char *av[])
     announce();
     initCInfo();
     initPty();
+    ready_running();
 
     /* infinite service loop */
     atexit(onExit);
     while (1)
+    {
         mainLoop();
+        traceCheck(me);
+    }
 
     return (0);
 }
@@ -235,6 +265,7 @@ static void usage(char *me)
     fprintf(stderr, " -i p    listen on port <p>; default is %d\n", CSIMCPORT);
     fprintf(stderr, " -m      allow multiple instances for multiple LANs\n");
     fprintf(stderr, " -t tty  alternate <tty>. default is %s\n", tty_def);
+    fprintf(stderr, " -T ms   trace spans from the start; dump if one takes longer than ms\n");
     fprintf(stderr, " -v      verbose; up to %d; SIGHUP also bumps\n", MAXV);
     fprintf(stderr, "           0: always show errors..\n");
     fprintf(stderr, "           1: plus basic actions..\n");
@@ -242,6 +273,7 @@ static void usage(char *me)
     fprintf(stderr, "           3: plus raw tty input.. \n");
     fprintf(stderr, "           4: plus tokens.. \n");
     fprintf(stderr, "           5: plus host traffic. \n");
+    fprintf(stderr, "SIGUSR1 starts or stops tracing; SIGUSR2 dumps it to archive/logs\n");
 
     exit(1);
 }
@@ -260,11 +292,15 @@ ptt(int on)
 }
 #endif
 
-/* read config file, if any */
+/* read config file, if any, for whatever was not given on the command line.
+ * this is the same file csimc and telescoped use to find us, so a bare csimcd,
+ * as started from rund.cfg, listens where they will look.
+ */
 static void initCfg(void)
 {
     read1CfgEntry(1, cfg, "TTY", CFG_STR, tty_def, sizeof(tty_def));
-    read1CfgEntry(1, cfg, "PORT", CFG_INT, &port, 0);
+    if (!portarg)
+        read1CfgEntry(1, cfg, "PORT", CFG_INT, &port, 0);
 }
 
 /* read the config file and set up any serial entries.
@@ -549,12 +585,16 @@ static void mainLoop()
     {
         if (verbose > 3)
             daemonLog("Token is ours\n");
+        TRACE_BEGIN("checkClients");
         checkClients();
+        TRACE_END("checkClients");
     }
     else
     {
         sendCurToken();
+        TRACE_BEGIN("wait4TokenBack");
         wait4TokenBack();
+        TRACE_END("wait4TokenBack");
     }
 }
 
@@ -702,6 +742,7 @@ static void newClient()
     cip->cfd = newcfd;
     cip->toaddr = to;
     cip->why = why;
+    cip->nframe = 0;
 
     switch (why)
     {
@@ -711,7 +752,8 @@ static void newClient()
     case FOR_REBOOT:
         newReboot(cip);
         break;
-    case FOR_BOOT:
+    case FOR_BOOT: /* FALLTHRU */
+    case FOR_WBOOT:
         newBoot(cip);
         break;
     case FOR_SERIAL:
@@ -1141,8 +1183,9 @@ static void clientMsg(int cfd)
 {
     switch (CFD2CIP(cfd)->why)
     {
-    case FOR_BOOT:
-        if (buildBootXPkt(cfd) < 0)
+    case FOR_BOOT: /* FALLTHRU */
+    case FOR_WBOOT:
+        if (buildBootXPkt(cfd) != 0)
             return;
         break;
     case FOR_SHELL:
@@ -1220,26 +1263,28 @@ static int buildShellXPkt(int cfd)
 }
 
 /* read client cfd with raw boot code and create xpkt.
- * return 0 if ok to send xpkt, else -1 when finished.
+ * return 0 if ok to send xpkt, 1 if not all here yet, else -1 when finished.
  */
 static int buildBootXPkt(int cfd)
 {
     int haddr = CFD2HA(cfd);
     int toaddr = CFD2CIP(cfd)->toaddr;
-    int newseq = XSEQ(toaddr);
     char *dp = (char *)&xpkt[PB_DATA];
     int n;
 
-    /* this much of a boot xpkt is always the same */
-    xpkt[PB_SYNC] = PSYNC;
-    xpkt[PB_TO] = toaddr;
-    xpkt[PB_FR] = haddr;
-    xpkt[PB_INFO] = PT_BOOTREC | newseq;
-
     /* read one boot packet.
-     * client won't send another until we tell ok.
+     * a FOR_BOOT client won't send another until we tell ok, so it is
+     * whatever is there. a FOR_WBOOT client may have sent several, each
+     * after its length, and we take only what is here so as never to wait
+     * on one client with the others and the token held up.
      */
-    if ((n = readI(cfd, dp, PMXDAT)) <= 0)
+    if (CFD2CIP(cfd)->why == FOR_WBOOT)
+        n = readBootFrame(cfd, dp);
+    else
+        n = readI(cfd, dp, PMXDAT);
+    if (n == PARTIAL)
+        return (1);
+    if (n <= 0)
     {
         if (n < 0)
             daemonLog("Host %d booting %d: socket read error: %s\n", haddr, toaddr, strerror(errno));
@@ -1267,12 +1312,49 @@ static int buildBootXPkt(int cfd)
     }
 
     /* routine boot records */
+    xpkt[PB_SYNC] = PSYNC;
+    xpkt[PB_TO] = toaddr;
+    xpkt[PB_FR] = haddr;
+    xpkt[PB_INFO] = PT_BOOTREC | XSEQ(toaddr);
     xpkt[PB_COUNT] = n;
     xpkt[PB_DCHK] = chkSum(dp, n);
     xpkt[PB_HCHK] = chkSum(xpkt, PB_NHCHK);
     return (0);
 }
 
+/* read what has arrived of a length-framed boot packet from FOR_WBOOT
+ * client cfd, without waiting for the rest, and copy it to dp once whole.
+ * return its length, PARTIAL if more is to come, 0 on EOF or -1 on error.
+ */
+static int readBootFrame(int cfd, char *dp)
+{
+    CInfo *cip = CFD2CIP(cfd);
+    int want, n, s;
+
+    /* the length first, then no more than it says so the next stays queued */
+    want = cip->nframe == 0 ? 1 : 1 + cip->frame[0];
+    s = readI(cfd, cip->frame + cip->nframe, want - cip->nframe);
+    if (s <= 0)
+    {
+        cip->nframe = 0;
+        return (s < 0 ? -1 : 0);
+    }
+    cip->nframe += s;
+
+    n = cip->frame[0];
+    if (n > PMXDAT)
+    {
+        cip->nframe = 0;
+        return (n); /* caller complains */
+    }
+    if (cip->nframe < 1 + n)
+        return (PARTIAL);
+
+    memcpy(dp, cip->frame + 1, n);
+    cip->nframe = 0;
+    return (n);
+}
+
 /* read client cfd with serial data and create xpkt.
  * return 0 if ok, else -1.
  * TODO: escape??
@@ -1403,7 +1485,8 @@ static int ack4xpkt(void)
         /* if ack for BOOTREC from boot client, inform size as progress.
          * N.B. first ack of FOR_BOOT is just the Ping confirm.
          */
-        if (HA2CIP(haddr)->why == FOR_BOOT && (xpkt[PB_INFO] & PT_MASK) == PT_BOOTREC)
+        if ((HA2CIP(haddr)->why == FOR_BOOT || HA2CIP(haddr)->why == FOR_WBOOT) &&
+            (xpkt[PB_INFO] & PT_MASK) == PT_BOOTREC)
         {
             int cfd = HA2CFD(haddr);
             if (verbose)
@@ -1685,6 +1768,8 @@ static char *why2str(OpenWhy why)
         return ("FOR_REBOOT");
     case FOR_SERIAL:
         return ("FOR_SERIAL");
+    case FOR_WBOOT:
+        return ("FOR_WBOOT");
     default:
         return ("FOR_???");
     }
@@ -1698,6 +1783,16 @@ static void onVerboseSig(int dummy)
     daemonLog("Verbose set to %d\n", verbose);
 }
 
+/* SIGUSR1 toggles tracing, SIGUSR2 asks for a dump */
+static void onTraceSig(int signo)
+{
+    signal(signo, onTraceSig);
+    if (signo == SIGUSR1)
+        traceEnable(!traceOn);
+    else
+        traceRequestDump();
+}
+
 static void onExit(void)
 {
     onBye(-1);
@@ -2,6 +2,15 @@
  * keep re-execing it unless it dies from SIGTERM or exits with 0.
  * arrange for all its output to go to $TELHOME/archive/logs/<command>.log.
  * exit 0 if program exists and we have exec perm, else 1.
+ *
+ * with -f, do the same for each command listed in a file, one per line,
+ * starting each only once all those before it have said they are ready.
+ * with -w, do not exit until the command(s) have said they are ready.
+ *
+ * a command says it is ready by calling ready_running(), which writes to a
+ * pipe we hand it by way of READYFDENV. one that never does is still run
+ * and restarted, it just never counts as ready, so nothing listed after it
+ * is started.
  */
 
 #include <errno.h>
@@ -12,6 +21,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <sys/select.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
@@ -21,35 +32,81 @@
 #include "strops.h"
 #include "telenv.h"
 
-#define MINFORKDT 15 /* fork no faster than this, seconds */
+#define MINBACKOFF 1  /* first wait to restart a command that failed young, secs */
+#define MAXBACKOFF 64 /* longest wait to restart, secs */
+#define STABLEDT 60   /* secs ready after which a death is not held against it */
+#define MAXD 16       /* most commands in a -f list */
+#define MAXARGS 32    /* most words in one command */
+
+/* one command we shepherd */
+typedef struct
+{
+    char *av[MAXARGS + 1]; /* command and args, NULL-terminated */
+    char *name;            /* basenm(av[0]) */
+    int pid;               /* running process, else 0 */
+    int readyfd;           /* its ready pipe until it says or closes, else -1 */
+    int ready;             /* set while running once it has said so */
+    int everready;         /* set once it has ever said so */
+    int done;              /* set once finished for good, or not ours */
+    int backoff;           /* secs to wait to restart after next young death */
+    struct timeval tstart; /* when last started */
+    time_t tready;         /* when last said ready */
+    time_t due;            /* when next to start, if !pid */
+} Daemon;
 
 static void usage(void);
-static void recordStartup(char *title, int ac, char *av[]);
-static void setupFD(char *log);
-static void forever(int ac, char *av[]);
+static void recordStartup(char *title, char *av[]);
+static void setupFD(char *log, int keep);
+static int readList(char *fn);
+static void forever(int notifyfd);
+static void startD(Daemon *dp);
+static void reapD(void);
+static void readyD(Daemon *dp);
 static int chkPATH(char *prog);
+static void setCloexec(int fd);
 static void onSig(int signo);
+static void onChld(int signo);
 
-static char *runprog;
+static Daemon dmn[MAXD]; /* what we shepherd */
+static int ndmn;
+static char *listfn;     /* -f file, if any */
+static int wsecs;        /* -w secs, if any */
+static int sigpipe[2];   /* SIGCHLD wakes our select by way of this */
 static char *me;
-static int pid;
 
 int main(int ac, char *av[])
 {
     char *telhome = getenv("TELHOME");
-
-    /* must be given a command to run */
-    me = basenm(av[0]);
-    if (ac == 1 || av[1][0] == '-')
-        usage();
+    int wp[2];
+    int i, n;
 
     /* messages go to our own log until we get serious */
     me = basenm(av[0]);
-    setupFD(me);
-    recordStartup("Starting", ac - 1, av + 1);
+    setupFD(me, -1);
 
-    /* base name of command we shepherd */
-    runprog = basenm(av[1]);
+    /* crack options, then the command unless -f */
+    while (--ac > 0 && (*++av)[0] == '-')
+    {
+        switch ((*av)[1])
+        {
+        case 'f':
+            if (ac < 2)
+                usage();
+            listfn = *++av;
+            ac--;
+            break;
+        case 'w':
+            if (ac < 2)
+                usage();
+            wsecs = atoi(*++av);
+            ac--;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (!!listfn == (ac > 0))
+        usage();
 
     /* cd TELHOME for any cores */
     if (!telhome || chdir(telhome) < 0)
@@ -58,46 +115,98 @@ int main(int ac, char *av[])
         exit(1);
     }
 
-    /* only one target */
-    if (testlock_running(runprog) == 0)
+    if (listfn)
     {
-        daemonLog("%s: already running\n", runprog);
-        exit(0);
+        char *lav[2];
+
+        lav[0] = listfn;
+        lav[1] = NULL;
+        recordStartup("Starting list", lav);
+        if (readList(listfn) < 0)
+            exit(1);
+    }
+    else
+    {
+        recordStartup("Starting", av);
+        for (i = 0; i < ac && i < MAXARGS; i++)
+            dmn[0].av[i] = av[i];
+        dmn[0].name = basenm(av[0]);
+        ndmn = 1;
     }
 
-    /* see whether the command even exists and is executable */
-    if (access(av[1], X_OK) == 0 || chkPATH(runprog) < 0)
+    /* leave alone those already running, and be sure of the rest */
+    for (n = i = 0; i < ndmn; i++)
     {
-        daemonLog("Not found in %s\n", getenv("PATH"));
-        exit(1);
+        Daemon *dp = &dmn[i];
+
+        dp->readyfd = -1;
+        dp->backoff = MINBACKOFF;
+        if (testlock_running(dp->name) == 0)
+        {
+            daemonLog("%s: already running\n", dp->name);
+            dp->done = dp->everready = 1;
+            continue;
+        }
+        if (access(dp->av[0], X_OK) < 0 && chkPATH(dp->name) < 0)
+        {
+            daemonLog("%s: not found in %s\n", dp->name, getenv("PATH"));
+            exit(1);
+        }
+        n++;
     }
+    if (!n)
+        exit(0);
 
-    /* we exit, leaving a shephard behind */
+    /* we exit, leaving a shepherd behind, once it says all are ready if -w */
+    if (pipe(wp) < 0)
+    {
+        daemonLog("pipe(): %s\n", strerror(errno));
+        exit(3);
+    }
     switch (fork())
     {
     case 0:
         (void)setsid(); /* no controlling tty */
-        forever(ac - 1, &av[1]);
+        (void)close(wp[0]);
+        forever(wp[1]);
         return (1);
-        break;
     case -1:
         daemonLog("fork(): %s\n", strerror(errno));
         return (3);
-        break;
     default:
+        (void)close(wp[1]);
+        if (wsecs > 0)
+        {
+            struct timeval tv;
+            fd_set rfs;
+            char c;
+
+            FD_ZERO(&rfs);
+            FD_SET(wp[0], &rfs);
+            tv.tv_sec = wsecs;
+            tv.tv_usec = 0;
+            if (select(wp[0] + 1, &rfs, NULL, NULL, &tv) <= 0 || read(wp[0], &c, 1) != 1)
+            {
+                daemonLog("not ready after %d secs\n", wsecs);
+                return (1);
+            }
+        }
         return (0);
-        break;
     }
-
-    /* huh ? */
-    return (2);
 }
 
 static void usage()
 {
-    fprintf(stderr, "Usage: %s command [args ...]\n", me);
+    fprintf(stderr, "Usage: %s [-w secs] command [args ...]\n", me);
+    fprintf(stderr, "       %s [-w secs] -f file\n", me);
     fprintf(stderr, "Purpose: run command with the given args; restart if fails\n");
-    fprintf(stderr, "  unless it exits with 0 or via SIGTERM.\n");
+    fprintf(stderr, "  unless it exits with 0 or via SIGTERM. a command that fails\n");
+    fprintf(stderr, "  soon after starting waits %d secs to restart, doubling each\n", MINBACKOFF);
+    fprintf(stderr, "  time to at most %d; one that was ready %d secs restarts at once.\n", MAXBACKOFF, STABLEDT);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, " -f file: run each command in file, one per line, each once those\n");
+    fprintf(stderr, "          before it are ready. # or ! begins a comment.\n");
+    fprintf(stderr, " -w secs: exit only once all are ready, 0 if so, 1 if not in secs.\n");
     fprintf(stderr, "Our output goes to $TELHOME/archive/logs/%s.log.\n", me);
     fprintf(stderr, "Command's output goes to $TELHOME/archive/logs/command.log\n");
     fprintf(stderr, "Once set up, we exit.\n");
@@ -105,102 +214,322 @@ static void usage()
     exit(1);
 }
 
-static void recordStartup(char *title, int ac, char *av[])
+static void recordStartup(char *title, char *av[])
 {
     char cmd[2048];
     int l = 0;
 
-    while (ac--)
+    while (*av)
         l += sprintf(cmd + l, "%s ", *av++);
     daemonLog("%s: %s\n", title, cmd);
 }
 
-static void forever(int ac, char *av[])
+/* read the commands in fn into dmn[].
+ * return 0 if ok, else -1.
+ */
+static int readList(char *fn)
 {
-    char lockname[128];
-    time_t lastfork = 0;
-    int status;
+    char buf[1024];
+    FILE *fp;
 
-    /* only one sheparding effort */
-    sprintf(lockname, "%s.%s", me, runprog);
-    if (lock_running(lockname) < 0)
+    fp = telfopen(fn, "r");
+    if (!fp)
     {
-        daemonLog("%s: another rund is already trying\n", runprog);
-        exit(0);
+        daemonLog("%s: %s\n", fn, strerror(errno));
+        return (-1);
+    }
+
+    while (fgets(buf, sizeof(buf), fp))
+    {
+        Daemon *dp = &dmn[ndmn];
+        char *line, *w;
+        int n;
+
+        if ((w = strpbrk(buf, "#!")) != NULL)
+            *w = '\0';
+        line = strcpy(malloc(strlen(buf) + 1), buf);
+        for (n = 0, w = strtok(line, " \t\r\n"); w && n < MAXARGS; w = strtok(NULL, " \t\r\n"))
+            dp->av[n++] = w;
+        if (!n)
+        {
+            free(line);
+            continue;
+        }
+        if (ndmn == MAXD)
+        {
+            daemonLog("%s: more than %d commands\n", fn, MAXD);
+            fclose(fp);
+            return (-1);
+        }
+        dp->name = basenm(dp->av[0]);
+        ndmn++;
     }
 
-    /* now logs belong to the command */
-    setupFD(runprog);
+    fclose(fp);
+    return (0);
+}
 
-    /* survive SIGTERM to pass on in kind */
-    signal(SIGTERM, onSig);
+/* shepherd dmn[] until all are finished.
+ * once all have said they are ready, tell notifyfd.
+ */
+static void forever(int notifyfd)
+{
+    char lockname[128];
+    int i;
 
-    /* keep reexecing unless dies from SIGTERM or exits 0 */
-    while (1)
+    /* only one shepherding effort each */
+    for (i = 0; i < ndmn; i++)
     {
-        if (time(NULL) - lastfork < MINFORKDT)
+        if (dmn[i].done)
+            continue;
+        sprintf(lockname, "%s.%s", me, dmn[i].name);
+        if (lock_running(lockname) < 0)
         {
-            daemonLog("forking too fast... waiting %d seconds\n", MINFORKDT);
-            sleep(MINFORKDT);
+            daemonLog("%s: another rund is already trying\n", dmn[i].name);
+            dmn[i].done = dmn[i].everready = 1;
         }
-        lastfork = time(NULL);
+    }
 
-        switch (pid = fork())
+    /* now logs belong to the command, if just one */
+    if (!listfn)
+        setupFD(dmn[0].name, notifyfd);
+
+    /* survive SIGTERM to pass on in kind, hear of deaths on sigpipe */
+    if (pipe(sigpipe) < 0)
+    {
+        daemonLog("pipe(): %s\n", strerror(errno));
+        return;
+    }
+    setCloexec(sigpipe[0]);
+    setCloexec(sigpipe[1]);
+    fcntl(sigpipe[1], F_SETFL, O_NONBLOCK);
+    setCloexec(notifyfd);
+    signal(SIGTERM, onSig);
+    signal(SIGCHLD, onChld);
+
+    while (1)
+    {
+        time_t now = time(NULL);
+        struct timeval tv, *tvp = NULL;
+        int allready = 1, alive = 0;
+        fd_set rfs;
+        int maxfd;
+
+        /* start each that is due once all before it have been ready */
+        for (i = 0; i < ndmn; i++)
         {
-        case 0:
-            recordStartup("Started by rund", ac, av);
-            execvp(av[0], av);
-            daemonLog("execvp(%s): %s\n", av[0], strerror(errno));
-            kill(getpid(), SIGTERM); /* parent will not restart */
-            exit(1);                 /* superfluous */
-            break;                   /* very superfluous */
-        case -1:
-            daemonLog("fork(): %s\n", strerror(errno));
-            sleep(30); /* retry fork later */
-            break;
-        default:
-            if (waitpid(pid, &status, WUNTRACED) < 0)
-            {
-                daemonLog("waitpid(): %s\n", strerror(errno));
-                return; /* all we can do */
-            }
+            Daemon *dp = &dmn[i];
 
-            if (WIFSIGNALED(status))
+            if (!dp->done && !dp->pid)
             {
-                int s = WTERMSIG(status);
-                if (s == SIGTERM)
+                if (dp->due <= now)
+                    startD(dp);
+                else if (!tvp || dp->due - now < tv.tv_sec)
                 {
-                    daemonLog("final kill with SIGTERM\n");
-                    return; /* finished */
+                    tv.tv_sec = dp->due - now;
+                    tv.tv_usec = 0;
+                    tvp = &tv;
                 }
-                daemonLog("died from signal %d\n", s);
             }
-            else if (WIFEXITED(status))
+            if (!dp->done || dp->pid)
+                alive++;
+            if (!dp->everready && !dp->done)
             {
-                int s = WEXITSTATUS(status);
-                if (s == 0)
-                {
-                    daemonLog("final exit 0\n");
-                    return; /* finished */
-                }
-                daemonLog("exited with %d\n", s);
+                allready = 0;
+                break;
+            }
+        }
+        for (; i < ndmn; i++)
+            if (dmn[i].pid || !dmn[i].done)
+                alive++;
+
+        if (allready && notifyfd >= 0)
+        {
+            (void)write(notifyfd, "R", 1);
+            (void)close(notifyfd);
+            notifyfd = -1;
+        }
+        if (!alive)
+            return; /* all finished */
+
+        FD_ZERO(&rfs);
+        FD_SET(sigpipe[0], &rfs);
+        maxfd = sigpipe[0];
+        for (i = 0; i < ndmn; i++)
+        {
+            if (dmn[i].readyfd >= 0)
+            {
+                FD_SET(dmn[i].readyfd, &rfs);
+                if (dmn[i].readyfd > maxfd)
+                    maxfd = dmn[i].readyfd;
             }
-            else if (WIFSTOPPED(status))
+        }
+        if (select(maxfd + 1, &rfs, NULL, NULL, tvp) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            daemonLog("select(): %s\n", strerror(errno));
+            return; /* all we can do */
+        }
+
+        /* deaths first, so a pipe closed by dying is not taken for more */
+        if (FD_ISSET(sigpipe[0], &rfs))
+        {
+            char buf[32];
+            while (read(sigpipe[0], buf, sizeof(buf)) == sizeof(buf))
+                continue;
+            reapD();
+        }
+        for (i = 0; i < ndmn; i++)
+            if (dmn[i].readyfd >= 0 && FD_ISSET(dmn[i].readyfd, &rfs))
+                readyD(&dmn[i]);
+    }
+}
+
+/* fork and exec dp, with the write end of a new ready pipe for it */
+static void startD(Daemon *dp)
+{
+    char env[32];
+    int rp[2];
+
+    if (pipe(rp) < 0)
+    {
+        daemonLog("%s: pipe(): %s\n", dp->name, strerror(errno));
+        dp->due = time(NULL) + MAXBACKOFF; /* retry later */
+        return;
+    }
+    setCloexec(rp[0]);
+
+    gettimeofday(&dp->tstart, NULL);
+    switch (dp->pid = fork())
+    {
+    case 0:
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        if (listfn)
+            telOELog(dp->name);
+        sprintf(env, "%d", rp[1]);
+        setenv(READYFDENV, env, 1);
+        recordStartup("Started by rund", dp->av);
+        execvp(dp->av[0], dp->av);
+        daemonLog("execvp(%s): %s\n", dp->av[0], strerror(errno));
+        kill(getpid(), SIGTERM); /* parent will not restart */
+        exit(1);                 /* superfluous */
+        break;                   /* very superfluous */
+    case -1:
+        daemonLog("%s: fork(): %s\n", dp->name, strerror(errno));
+        dp->pid = 0;
+        dp->due = time(NULL) + MAXBACKOFF; /* retry fork later */
+        (void)close(rp[0]);
+        (void)close(rp[1]);
+        break;
+    default:
+        (void)close(rp[1]);
+        dp->readyfd = rp[0];
+        dp->ready = 0;
+        break;
+    }
+}
+
+/* dp's ready pipe has something to say */
+static void readyD(Daemon *dp)
+{
+    struct timeval tv;
+    char c;
+
+    if (read(dp->readyfd, &c, 1) == 1)
+    {
+        gettimeofday(&tv, NULL);
+        daemonLog("%s: ready after %.2f secs\n", dp->name,
+                  (tv.tv_sec - dp->tstart.tv_sec) + (tv.tv_usec - dp->tstart.tv_usec) / 1e6);
+        dp->ready = dp->everready = 1;
+        dp->tready = tv.tv_sec;
+    }
+
+    /* either way, that is all it will say */
+    (void)close(dp->readyfd);
+    dp->readyfd = -1;
+}
+
+/* collect each child that has died and decide when to run it again */
+static void reapD()
+{
+    int status;
+    int pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0)
+    {
+        time_t now = time(NULL);
+        Daemon *dp;
+
+        for (dp = dmn; dp < &dmn[ndmn]; dp++)
+            if (dp->pid == pid)
+                break;
+        if (dp == &dmn[ndmn])
+            continue;
+
+        if (WIFSTOPPED(status))
+        {
+            daemonLog("%s: stopped with signal %d\n", dp->name, WSTOPSIG(status));
+            continue;
+        }
+
+        if (WIFSIGNALED(status))
+        {
+            int s = WTERMSIG(status);
+            if (s == SIGTERM)
             {
-                int s = WSTOPSIG(status);
-                daemonLog("stopped with signal %d\n", s);
+                daemonLog("%s: final kill with SIGTERM\n", dp->name);
+                dp->done = 1;
             }
             else
+                daemonLog("%s: died from signal %d\n", dp->name, s);
+        }
+        else if (WIFEXITED(status))
+        {
+            int s = WEXITSTATUS(status);
+            if (s == 0)
             {
-                daemonLog("sending SIGKILL due to unknown wait status:%d\n", status);
-                kill(pid, SIGKILL); /* out of control -- abort big time */
+                daemonLog("%s: final exit 0\n", dp->name);
+                dp->done = 1;
             }
-            break;
+            else
+                daemonLog("%s: exited with %d\n", dp->name, s);
+        }
+        else
+        {
+            daemonLog("%s: sending SIGKILL due to unknown wait status:%d\n", dp->name, status);
+            kill(pid, SIGKILL); /* out of control -- abort big time */
+            continue;
+        }
+
+        dp->pid = 0;
+        if (dp->readyfd >= 0)
+        {
+            (void)close(dp->readyfd);
+            dp->readyfd = -1;
         }
+        if (dp->done)
+            continue;
+
+        /* long ready is a fresh start, else wait longer each time */
+        if (dp->ready && now - dp->tready >= STABLEDT)
+        {
+            dp->backoff = MINBACKOFF;
+            dp->due = now;
+        }
+        else
+        {
+            dp->due = now + dp->backoff;
+            daemonLog("%s: restarting in %d secs\n", dp->name, dp->backoff);
+            dp->backoff = dp->backoff * 2 > MAXBACKOFF ? MAXBACKOFF : dp->backoff * 2;
+        }
+        dp->ready = 0;
     }
 }
 
-static void setupFD(char *log)
+/* stdin from /dev/null, stdout and err to log, close all else but keep */
+static void setupFD(char *log, int keep)
 {
     long openmax = sysconf(_SC_OPEN_MAX);
     int i;
@@ -208,7 +537,8 @@ static void setupFD(char *log)
     dup2(open("/dev/null", O_RDONLY), 0);
     telOELog(log);
     for (i = 3; i < openmax; i++)
-        (void)close(i);
+        if (i != keep)
+            (void)close(i);
 }
 
 /* search PATH for prog.
@@ -251,13 +581,29 @@ static int chkPATH(char *prog)
     return (ret);
 }
 
+/* keep fd from the commands we exec */
+static void setCloexec(int fd)
+{
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
 /* pass along then exit */
 static void onSig(int signo)
 {
-    if (pid > 0)
-    {
-        daemonLog("rund received SIGTERM.. passing on in kind\n");
-        kill(pid, SIGTERM);
-    }
+    int i;
+
+    daemonLog("rund received SIGTERM.. passing on in kind\n");
+    for (i = 0; i < ndmn; i++)
+        if (dmn[i].pid > 0)
+            kill(dmn[i].pid, SIGTERM);
     exit(0);
 }
+
+/* wake forever() to reap */
+static void onChld(int signo)
+{
+    int e = errno;
+
+    (void)write(sigpipe[1], "C", 1);
+    errno = e;
+}
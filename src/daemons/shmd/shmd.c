@@ -137,6 +137,7 @@ static void masterMode()
 
     shmConnect();
     acceptfd = setupAsMaster();
+    ready_running();
     FD_ZERO(&clients);
     FD_SET(acceptfd, &clients);
     maxfdp1 = acceptfd + 1;
@@ -349,6 +350,7 @@ static void slaveMode()
 
     shmConnect();
     fd = setupAsSlave();
+    ready_running();
 
     while (1)
     {
@@ -46,7 +46,7 @@ int axis_home(MotorInfo *mip, FifoId fid, int first)
     }
     else
     {
-        static double mjdto[TEL_NM];
+        static THREADLOCAL double mjdto[TEL_NM];
         int i = mip - &telstatshmp->minfo[0];
         int axis = (int)mip->axis;
         int cfd = MIPCFD(mip);
@@ -205,8 +205,8 @@ int axisMotionCheck(MotorInfo *mip, char msgbuf[])
 {
 #if 0
 	/* TODO */
-	static double last_cpos[TEL_NM];	/* last mip->cpos */
-	static double last_changed[TEL_NM];	/* last mjd it changed */
+	static THREADLOCAL double last_cpos[TEL_NM];	/* last mip->cpos */
+	static THREADLOCAL double last_changed[TEL_NM];	/* last mjd it changed */
 	int i = mip - telstatshmp->minfo;
 	double now = telstatshmp->now.n_mjd;
 	double v;
@@ -268,11 +268,11 @@ int axis_limits(MotorInfo *mip, FifoId fid, int first)
     }
     else
     {
-        static double mjdto[TEL_NM]; /* timeout */
-        static char seeking[TEL_NM]; /* canonical dir we seek, '+'/'-' */
-        static char found[TEL_NM];   /* last can dir we found, '+'/'-' */
-        static int motbeg[TEL_NM];   /* motor at beginning of sweep */
-        static int encbeg[TEL_NM];   /* encoder at beginning of sweep */
+        static THREADLOCAL double mjdto[TEL_NM]; /* timeout */
+        static THREADLOCAL char seeking[TEL_NM]; /* canonical dir we seek, '+'/'-' */
+        static THREADLOCAL char found[TEL_NM];   /* last can dir we found, '+'/'-' */
+        static THREADLOCAL int motbeg[TEL_NM];   /* motor at beginning of sweep */
+        static THREADLOCAL int encbeg[TEL_NM];   /* encoder at beginning of sweep */
         int i = mip - telstatshmp->minfo;
         int axis = (int)mip->axis;
         int cfd = MIPCFD(mip);
@@ -0,0 +1,263 @@
+/* keep enough state in comm/telescoped.ckpt that telescoped may be restarted,
+ * such as by rund after a crash, and carry on without homing again.
+ *
+ * at startup, after the usual Reset, the checkpoint is trusted only if it is
+ * recent, was made with the same axis configuration and calibration, the
+ * nodes still report themselves homed (h, see isHomed() in find.cmc) and
+ * each encoder is no further from where it was than the axis could have
+ * moved meanwhile. if so, tracking resumes at once. else we start cold, as
+ * before, with the homed state as the nodes report it.
+ *
+ * virtual nodes do not outlive telescoped so their positions and homed
+ * state are taken from the checkpoint as a real node would have kept them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "csimc.h"
+#include "misc.h"
+#include "telenv.h"
+#include "telstatshm.h"
+#include "virmc.h"
+
+#include "teled.h"
+
+#define CKPTMAGIC "TALONCKP" /* first 8 bytes of a checkpoint */
+#define CKPTVERSION 1         /* bump when Ckpt changes */
+#define CKPTSECS 1            /* most secs between checkpoints */
+#define CKPTMAXAGE 600        /* oldest checkpoint to trust, secs */
+#define CKPTPOSTOL degrad(30.0 / 3600) /* encoder slack when not moving, rads */
+
+static char ckptfn[] = "comm/telescoped.ckpt";
+
+/* one axis as it was */
+typedef struct
+{
+    int have;    /* as MotorInfo */
+    int ishomed;
+    int step, sign, estep, esign;
+    int raw;
+    double cpos;
+} CkptAxis;
+
+/* the whole checkpoint */
+typedef struct
+{
+    char magic[8];         /* CKPTMAGIC */
+    int version;           /* CKPTVERSION */
+    time_t when;           /* wall time written */
+    int telstate;          /* TelState then */
+    TelAxes tax;           /* calibration in effect */
+    CkptAxis ax[TEL_NM];   /* TEL_HM .. TEL_RM, others unused */
+    TelTrack track;        /* what was being tracked, if anything */
+} Ckpt;
+
+static int ckptCheck(Ckpt *cp, int age, char why[]);
+static int sameAxes(TelAxes *a, TelAxes *b);
+
+/* write a new checkpoint if CKPTSECS have passed or the state has changed
+ * since the last, or if force.
+ */
+void ckpt_save(int force)
+{
+    static THREADLOCAL time_t last;
+    static THREADLOCAL int lastidx = -1;
+    static THREADLOCAL int reported;
+    char fn[1024], tmp[1024];
+    time_t now = time(NULL);
+    Ckpt ck;
+    int i, fd, ok;
+
+    if (!force && now - last < CKPTSECS && telstatshmp->telstateidx == lastidx)
+        return;
+    last = now;
+    lastidx = telstatshmp->telstateidx;
+
+    memset((void *)&ck, 0, sizeof(ck));
+    memcpy(ck.magic, CKPTMAGIC, sizeof(ck.magic));
+    ck.version = CKPTVERSION;
+    ck.when = now;
+    ck.telstate = telstatshmp->telstate;
+    ck.tax = telstatshmp->tax;
+    for (i = TEL_HM; i <= TEL_RM; i++)
+    {
+        MotorInfo *mip = &telstatshmp->minfo[i];
+        CkptAxis *ap = &ck.ax[i];
+
+        ap->have = mip->have;
+        ap->ishomed = mip->ishomed;
+        ap->step = mip->step;
+        ap->sign = mip->sign;
+        ap->estep = mip->estep;
+        ap->esign = mip->esign;
+        ap->raw = mip->raw;
+        ap->cpos = mip->cpos;
+    }
+    tel_getTrack(&ck.track);
+
+    /* write aside then rename so a reader never sees half of one */
+    telfixpath(fn, ckptfn);
+    if (snprintf(tmp, sizeof(tmp), "%s.new", fn) >= (int)sizeof(tmp))
+    {
+        if (!reported)
+            tdlog("%s: name too long to checkpoint", fn);
+        reported = 1;
+        return;
+    }
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    ok = fd >= 0 && write(fd, &ck, sizeof(ck)) == sizeof(ck);
+    if (fd >= 0 && close(fd) < 0)
+        ok = 0;
+    if (ok && rename(tmp, fn) < 0)
+        ok = 0;
+
+    /* just say so once, then keep trying */
+    if (!ok && !reported)
+        tdlog("%s: %s", tmp, strerror(errno));
+    reported = !ok;
+}
+
+/* call once after the first Reset. if there is a checkpoint we can trust,
+ * restore from it and return 1, else return 0 to start cold.
+ */
+int ckpt_resume()
+{
+    char fn[1024], why[128];
+    Ckpt ck;
+    int fd, n, age, i;
+
+    telfixpath(fn, ckptfn);
+    fd = open(fn, O_RDONLY);
+    if (fd < 0)
+    {
+        tdlog("Cold start: no checkpoint");
+        return (0);
+    }
+    n = read(fd, &ck, sizeof(ck));
+    close(fd);
+    if (n != sizeof(ck) || memcmp(ck.magic, CKPTMAGIC, sizeof(ck.magic)) || ck.version != CKPTVERSION)
+    {
+        tdlog("Cold start: %s is not a checkpoint we know", fn);
+        return (0);
+    }
+    age = (int)(time(NULL) - ck.when);
+
+    /* virtual nodes start afresh, so put them back as they were */
+    if (virtual_mode)
+    {
+        for (i = TEL_HM; i <= TEL_RM; i++)
+        {
+            MotorInfo *mip = &telstatshmp->minfo[i];
+
+            if (mip->have && ck.ax[i].have && ck.ax[i].ishomed)
+            {
+                vmcSetPosition(mip->axis, ck.ax[i].raw);
+                mip->ishomed = 1;
+            }
+        }
+    }
+
+    /* read the axes as they are now, the clock not having run yet */
+    telstatshmp->now.n_mjd = vclockMJD();
+    tel_msg(NULL);
+
+    if (ckptCheck(&ck, age, why) < 0)
+    {
+        tdlog("Cold start: checkpoint from %d secs ago: %s", age, why);
+        if (virtual_mode)
+        {
+            for (i = TEL_HM; i <= TEL_RM; i++)
+            {
+                MotorInfo *mip = &telstatshmp->minfo[i];
+
+                if (mip->have)
+                {
+                    vmcSetPosition(mip->axis, 0);
+                    mip->ishomed = 0;
+                }
+            }
+            tel_msg(NULL);
+        }
+        return (0);
+    }
+
+    if (ck.track.tracking)
+    {
+        tdlog("Warm start: checkpoint from %d secs ago, resuming %s at RA %.6f Dec %.6f, segment of %.0f secs at "
+              "MJD %.6f",
+              age, ck.track.o.o_name, ck.track.o.f_RA, ck.track.o.f_dec, ck.track.trackdur, ck.track.strack);
+        tel_resumeTrack(&ck.track);
+    }
+    else
+        tdlog("Warm start: checkpoint from %d secs ago, homed and not tracking", age);
+
+    return (1);
+}
+
+/* check the checkpoint at cp, made age secs ago, against the nodes now.
+ * return 0 if it may be trusted, else -1 with the reason in why[].
+ */
+static int ckptCheck(Ckpt *cp, int age, char why[])
+{
+    int moving = cp->telstate != TS_STOPPED && cp->telstate != TS_ABSENT;
+    int i;
+
+    if (age < 0 || age > CKPTMAXAGE)
+    {
+        sprintf(why, "older than %d secs", CKPTMAXAGE);
+        return (-1);
+    }
+    if (!sameAxes(&cp->tax, &telstatshmp->tax))
+    {
+        sprintf(why, "axis calibration has changed");
+        return (-1);
+    }
+
+    for (i = TEL_HM; i <= TEL_RM; i++)
+    {
+        MotorInfo *mip = &telstatshmp->minfo[i];
+        CkptAxis *ap = &cp->ax[i];
+        double maxd;
+
+        if (ap->have != mip->have || ap->step != mip->step || ap->sign != mip->sign || ap->estep != mip->estep ||
+            ap->esign != mip->esign)
+        {
+            sprintf(why, "axis %d configuration has changed", mip->axis);
+            return (-1);
+        }
+        if (!mip->have)
+            continue;
+        if (!ap->ishomed || !mip->ishomed)
+        {
+            sprintf(why, "axis %d is not homed", mip->axis);
+            return (-1);
+        }
+
+        /* an encoder that has gone further than possible was reset */
+        maxd = CKPTPOSTOL + (moving ? mip->maxvel * (age + CKPTSECS) : 0);
+        if (fabs(mip->cpos - ap->cpos) > maxd)
+        {
+            sprintf(why, "axis %d moved %.1f arcsecs, at most %.1f possible", mip->axis,
+                    raddeg(fabs(mip->cpos - ap->cpos)) * 3600, raddeg(maxd) * 3600);
+            return (-1);
+        }
+    }
+
+    return (0);
+}
+
+/* return whether a and b hold the same calibration */
+static int sameAxes(TelAxes *a, TelAxes *b)
+{
+    return (a->GERMEQ == b->GERMEQ && a->ZENFLIP == b->ZENFLIP && a->HT == b->HT && a->DT == b->DT &&
+            a->XP == b->XP && a->YC == b->YC && a->NP == b->NP && a->R0 == b->R0);
+}
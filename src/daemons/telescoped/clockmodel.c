@@ -0,0 +1,164 @@
+/* a model of each node's ms clock against a host clock that never steps, so
+ * track profiles may be laid out in node time, and drift is judged against
+ * the model rather than against the host.
+ *
+ * N.B. the model would let a track refresh start from the running clock, so
+ * segments need not end to zero it, but only with CLOCKKEEP in
+ * telescoped.cfg. that needs node firmware which takes an e/mtrack starting
+ * other than at 0, which is not in this tree and so is unconfirmed. until it
+ * is, CLOCKKEEP is 0 and every refresh still zeroes the node clocks as before.
+ *
+ * each model is a second order phase-locked loop: every reading of a node
+ * clock nudges its offset and, more gently, its rate towards what was read.
+ * the offset takes up the unknown latency of the clock=0 that started it; the
+ * rate takes up the node crystal, easily 100 ppm or 0.36 secs an hour, which
+ * would otherwise walk a long track off the sky. readings far from the model,
+ * such as one delayed by a busy host, are reported but do not move it; how
+ * far is far grows with the time since the last one, so a node read only at
+ * each long track refresh is not shut out by its own honest drift.
+ *
+ * the host clock is CLOCK_MONOTONIC unless vclock is simulating, when it is
+ * vclock, as are the virtual nodes.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "csimc.h"
+#include "misc.h"
+#include "telenv.h"
+#include "telstatshm.h"
+#include "virmc.h"
+
+#include "teled.h"
+
+#define CLKTAU 60.0      /* loop time constant, secs */
+#define CLKXMAX 0.25     /* largest step of a reading as a fraction of CLKTAU */
+#define CLKOUTLIER 50.0  /* ms from the model, plus CLKMAXPPM drift, not used */
+#define CLKMAXPPM 1000.0 /* largest rate error we believe, ppm */
+#define CLKNLOG 100      /* readings before a rate is worth reporting */
+
+/* one node clock */
+typedef struct
+{
+    int valid;    /* set once zeroed */
+    int nsamp;    /* readings used since zeroed */
+    double h0;    /* host secs of reference */
+    double c0;    /* node ms at h0 */
+    double rate;  /* node ms per host sec, 0 until first used */
+    double hlast; /* host secs of last reading used */
+} ClkModel;
+
+static THREADLOCAL ClkModel clkm[TEL_NM];
+
+static ClkModel *clkModel(MotorInfo *mip);
+
+/* return secs on the host clock the models are made against */
+double clk_now()
+{
+    struct timespec ts;
+
+    if (!vclockIsWall() || clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+        return (vclockMJD() * SPD);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* the clock of mip's node has just been set to 0.
+ * the rate is a property of the node so it is kept.
+ */
+void clk_zero(MotorInfo *mip)
+{
+    ClkModel *cp = clkModel(mip);
+
+    if (cp->nsamp >= CLKNLOG)
+        tdlog("Node %d clock runs %+.1f ppm from host", mip->axis, (cp->rate / 1000.0 - 1) * 1e6);
+
+    cp->h0 = cp->hlast = clk_now();
+    cp->c0 = 0;
+    cp->nsamp = 0;
+    cp->valid = 1;
+}
+
+/* read the clock of mip's node and use it to refine its model.
+ * return the node ms, with how far that is from the model in *errp, ms.
+ */
+int clk_read(MotorInfo *mip, double *errp)
+{
+    ClkModel *cp = clkModel(mip);
+    double h0, h, dt, x, e, rmax;
+    int c;
+
+    /* the node read its clock somewhere between asking and hearing */
+    h0 = clk_now();
+    if (virtual_mode)
+        c = (int)vmcGetClock(mip->axis);
+    else
+        c = csi_rix(MIPSFD(mip), "=clock;");
+    h = (h0 + clk_now()) / 2;
+
+    if (!cp->valid)
+    {
+        *errp = 0;
+        return (c);
+    }
+
+    e = c - clk_node(mip, h);
+    *errp = e;
+    dt = h - cp->hlast;
+
+    if (cp->nsamp == 0)
+    {
+        /* first since zeroed: just take up the latency, whatever it is */
+        cp->c0 = c;
+    }
+    else
+    {
+        if (dt <= 0 || fabs(e) > CLKOUTLIER + CLKMAXPPM * 1e-3 * dt)
+            return (c);
+
+        x = dt / CLKTAU;
+        if (x > CLKXMAX)
+            x = CLKXMAX;
+        cp->c0 = c - e + 2 * x * e;
+        cp->rate += x * x * e / dt;
+        rmax = 1000.0 * CLKMAXPPM / 1e6;
+        if (cp->rate > 1000.0 + rmax)
+            cp->rate = 1000.0 + rmax;
+        if (cp->rate < 1000.0 - rmax)
+            cp->rate = 1000.0 - rmax;
+    }
+    cp->h0 = cp->hlast = h;
+    cp->nsamp++;
+
+    return (c);
+}
+
+/* return ms mip's node clock will read at host secs h */
+double clk_node(MotorInfo *mip, double h)
+{
+    ClkModel *cp = clkModel(mip);
+
+    return (cp->c0 + cp->rate * (h - cp->h0));
+}
+
+/* return host secs when mip's node clock reads ms */
+double clk_host(MotorInfo *mip, double ms)
+{
+    ClkModel *cp = clkModel(mip);
+
+    return (cp->h0 + (ms - cp->c0) / cp->rate);
+}
+
+/* return the model for mip, first use at rate 1 */
+static ClkModel *clkModel(MotorInfo *mip)
+{
+    ClkModel *cp = &clkm[mip - telstatshmp->minfo];
+
+    if (cp->rate == 0)
+        cp->rate = 1000.0;
+    return (cp);
+}
@@ -0,0 +1,78 @@
+/* state and configuration common to every telescope core, whether run by
+ * telescoped as a daemon or by telsim as one of many simulated mounts.
+ * N.B. everything here is per-thread; see THREADLOCAL.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "configfile.h"
+#include "csimc.h"
+#include "misc.h"
+#include "telstatshm.h"
+
+#include "teled.h"
+
+THREADLOCAL TelStatShm *telstatshmp; /* shared telescope info */
+THREADLOCAL int virtual_mode;        /* non-zero for virtual mode enabled */
+
+char tscfn[] = "archive/config/telsched.cfg";
+char tdcfn[] = "archive/config/telescoped.cfg";
+char hcfn[] = "archive/config/home.cfg";
+char ocfn[] = "archive/config/focus.cfg";
+
+// Global values read from config
+THREADLOCAL int DOSTOW;
+THREADLOCAL double STOWALT, STOWAZ, STOWTO;
+
+/* tell everybody to stop */
+void allstop()
+{
+    tel_msg("Stop");
+    focus_msg("Stop");
+}
+
+/* read the config files for variables we use here */
+void init_cfg()
+{
+#define NTSCFG (sizeof(tscfg) / sizeof(tscfg[0]))
+    static THREADLOCAL double LONGITUDE, LATITUDE, TEMPERATURE, PRESSURE, ELEVATION;
+    CfgEntry tscfg[] = {
+        {"DOSTOW", CFG_INT, &DOSTOW},
+        {"STOWTO", CFG_DBL, &STOWTO},
+        {"STOWALT", CFG_DBL, &STOWALT},
+        {"STOWAZ", CFG_DBL, &STOWAZ},
+        {"LONGITUDE", CFG_DBL, &LONGITUDE},
+        {"LATITUDE", CFG_DBL, &LATITUDE},
+        {"TEMPERATURE", CFG_DBL, &TEMPERATURE},
+        {"PRESSURE", CFG_DBL, &PRESSURE},
+        {"ELEVATION", CFG_DBL, &ELEVATION},
+    };
+
+    Now *np = &telstatshmp->now;
+    int n;
+
+    n = readCfgFile(1, tscfn, tscfg, NTSCFG);
+    if (n != NTSCFG)
+    {
+        cfgFileError(tscfn, n, (CfgPrFp)tdlog, tscfg, NTSCFG);
+        // Don't die...	    die();
+    }
+
+    /* convert seconds to days */
+    STOWTO /= SPD;
+
+    /* basic defaults if no GPS or weather station */
+    lng = -LONGITUDE;        /* we want rads +E */
+    lat = LATITUDE;          /* we want rads +N */
+    temp = TEMPERATURE;      /* we want degrees C */
+    pressure = PRESSURE;     /* we want mB */
+    elev = ELEVATION / ERAD; /* we want earth radii*/
+
+#undef NTSCFG
+}
@@ -26,10 +26,10 @@
 /* info about each CSIMC connected.
  * index with MotorInfo->axis.
  */
-CSIMCInfo csii[NNODES];
+THREADLOCAL CSIMCInfo csii[NNODES];
 
 static char ipme[] = "127.0.0.1";
-static char *host;
+static THREADLOCAL char *host;
 static int port = CSIMCPORT;
 static char *cfg = "csimc.cfg";
 
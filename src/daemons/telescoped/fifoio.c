@@ -22,9 +22,11 @@
 #include "cliserv.h"
 #include "configfile.h"
 #include "csimc.h"
+#include "latshm.h"
 #include "misc.h"
 #include "running.h"
 #include "telstatshm.h"
+#include "trace.h"
 
 #include "teled.h"
 
@@ -53,6 +55,7 @@ static void open_1fifo(FifoInfo *fip);
 static void close_1fifo(FifoInfo *fip);
 static void reopen_1fifo(FifoInfo *fip);
 static void set_shmtime(void);
+static void bump_shmgen(void);
 
 /* write a code and new message to given fifo.
  * also log with tdlog() if code is < 0.
@@ -108,9 +111,12 @@ void init_fifos()
  */
 void chk_fifos()
 {
+    static double lastpoll; /* when the previous poll began */
     FifoInfo *fip;
     struct timeval tv;
     fd_set rfdset;
+    double t0;
+    long us;
     int maxfdp1;
     int i, s;
 
@@ -125,9 +131,12 @@ void chk_fifos()
     }
     maxfdp1++;
 
-    /* set up the max polling delay */
-    tv.tv_sec = 0;
-    tv.tv_usec = 2 * 1000000 / HZ; /* every other tick or so */
+    /* set up the max polling delay, every other tick or so.
+     * N.B. a slow virtual clock can make this more than a second.
+     */
+    us = vclockWait(2 * 1000000 / HZ);
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
 
     /* call select, waiting for commands or timeout */
     while ((s = select(maxfdp1, &rfdset, NULL, NULL, &tv)) < 0 && errno == EINTR)
@@ -138,6 +147,13 @@ void chk_fifos()
         return; /* main will repeat -- we don't wanna die */
     }
 
+    /* the work, not counting the wait */
+    TRACE_BEGIN("chk_fifos");
+    t0 = latNow();
+    if (lastpoll > 0)
+        latRecord(LAT_POLLPERIOD, t0 - lastpoll);
+    lastpoll = t0;
+
     /* dispatch any fifo messages */
     for (fip = fifo; s > 0 && fip < &fifo[N_F]; fip++)
     {
@@ -158,7 +174,8 @@ void chk_fifos()
             /* keep time current */
             set_shmtime();
 
-            /* dispatch */
+            /* dispatch, and record what for replay */
+            rec_cmd(fip->name, msg);
             (*fip->fp)(msg);
 
             /* handled this one */
@@ -172,6 +189,12 @@ void chk_fifos()
         set_shmtime();    /* keep time current */
         (*fip->fp)(NULL); /* general update poll */
     }
+
+    /* let clients know if anything they show has changed */
+    bump_shmgen();
+
+    latRecord(LAT_POLLDUR, latNow() - t0);
+    TRACE_END("chk_fifos");
 }
 
 /* create and attach all the fifos */
@@ -212,8 +235,39 @@ static void reopen_1fifo(FifoInfo *fip)
     open_1fifo(fip);
 }
 
-/* set current time in telstatshmp */
+/* set current time in telstatshmp.
+ * N.B. this is simulated time if virtual mode is running with -t.
+ */
 static void set_shmtime()
 {
-    telstatshmp->now.n_mjd = mjd_now();
+    telstatshmp->now.n_mjd = vclockMJD();
+}
+
+/* bump telstatshmp->gen if anything has changed since the last poll.
+ * the time, and the sidereal time, RA, J2000 Dec and PA that drift with it
+ * while stopped, do not count, so an idle scope leaves gen alone.
+ */
+static void bump_shmgen()
+{
+    static TelStatShm last;
+    TelStatShm now;
+
+    memcpy(&now, telstatshmp, sizeof(now));
+    now.now = last.now;
+    now.Clst = last.Clst;
+    now.CARA = last.CARA;
+    now.CJ2kRA = last.CJ2kRA;
+    now.CJ2kDec = last.CJ2kDec;
+    now.CPA = last.CPA;
+    now.DARA = last.DARA;
+    now.DJ2kRA = last.DJ2kRA;
+    now.DJ2kDec = last.DJ2kDec;
+    now.DPA = last.DPA;
+    now.gen = last.gen;
+
+    if (memcmp(&now, &last, sizeof(now)) != 0)
+    {
+        telstatshmp->gen++;
+        memcpy(&last, &now, sizeof(last));
+    }
 }
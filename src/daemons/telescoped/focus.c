@@ -14,6 +14,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "autofocus.h"
 #include "circum.h"
 #include "cliserv.h"
 #include "configfile.h"
@@ -28,7 +29,7 @@
 #include "teled.h"
 
 /* the current activity, if any */
-static void (*active_func)(int first, ...);
+static THREADLOCAL void (*active_func)(int first, ...);
 
 /* one of these... */
 static void focus_poll(void);
@@ -44,8 +45,39 @@ static void focus_jog(int first, ...);
 static void initCfg(void);
 static void stopFocus(int fast);
 static void readFocus(void);
-
-static double OJOGF;
+static void readFocTab(void);
+static double focCorrection(double alt, double t);
+static void autoSample(double fwhm);
+static void autoNext(void);
+static void autoMove(double microns, int state);
+static void autoArrived(void);
+static double focusMicrons(void);
+
+static THREADLOCAL double OJOGF;
+
+/* autofocus, see focus_auto() */
+#define AFSTEP 50.0 /* default initial sample spacing, microns */
+#define AFTOL 5.0   /* default accuracy wanted, microns */
+#define AFMAXSAMP 20 /* give up after this many samples */
+enum
+{
+    AFS_IDLE,    /* not autofocusing */
+    AFS_MOVE,    /* moving to the next sample */
+    AFS_MEASURE, /* waiting for the fwhm there */
+    AFS_BEST     /* moving to best focus */
+};
+static THREADLOCAL int afstate;
+static THREADLOCAL AutoFocus af;
+
+/* focus corrections by altitude and temperature, see readFocTab() */
+#define FTCOMMENT '#' /* ignore lines beginning with this */
+#define MAXFTT 16     /* most temperature columns */
+static char ftabfn[] = "archive/config/focus.tab"; /* name of table file */
+static THREADLOCAL double fttemp[MAXFTT];          /* temperatures, C, ascending */
+static THREADLOCAL int nfttemp;
+static THREADLOCAL double *ftalt; /* malloced altitudes, rads, ascending */
+static THREADLOCAL double *ftcor; /* malloced corrections, microns, nftalt rows of nfttemp */
+static THREADLOCAL int nftalt;
 
 /* called when we receive a message from the Focus fifo.
  * if !msg just update things.
@@ -55,6 +87,13 @@ void focus_msg(msg) char *msg;
 {
     char jog[10];
 
+    /* any command but a fwhm ends an autofocus */
+    if (msg && afstate != AFS_IDLE && strncasecmp(msg, "fwhm", 4) != 0)
+    {
+        tdlog("Autofocus abandoned for %s", msg);
+        afstate = AFS_IDLE;
+    }
+
     /* do reset before checking for `have' to allow for new config file */
     if (msg && strncasecmp(msg, "reset", 5) == 0)
     {
@@ -87,12 +126,51 @@ void focus_msg(msg) char *msg;
         focus_stop(1);
     else if (strncasecmp(msg, "limits", 6) == 0)
         focus_limits(1);
+    else if (strncasecmp(msg, "auto", 4) == 0)
+        focus_auto(1, msg + 4);
+    else if (strncasecmp(msg, "fwhm", 4) == 0)
+        autoSample(atof(msg + 4));
     else if (sscanf(msg, "j%1[0+-]", jog) == 1)
         focus_jog(1, jog[0]);
     else
         focus_offset(1, atof(msg));
 }
 
+/* start moving to the given position, microns from home, plus any correction
+ * from ftabfn at the given altitude and the current temperature.
+ * this is how a Tel target brings a focus move along with it, so the two
+ * run at once. progress is reported on the Focus channel as for an offset.
+ * return 0 if the move is under way, else -1.
+ */
+int focus_goto(double microns, double alt)
+{
+    MotorInfo *mip = OMOT;
+    double t = telstatshmp->now.n_temp;
+    double cor, unow;
+
+    if (!mip->have || (!virtual_mode && !MIPCFD(mip)))
+        return (-1);
+    if (afstate != AFS_IDLE)
+    {
+        tdlog("Autofocus abandoned for a Tel target");
+        afstate = AFS_IDLE;
+    }
+
+    unow = focusMicrons();
+    cor = focCorrection(alt, t);
+    if (cor != 0)
+        tdlog("Focus %.1f microns %+.1f for Alt %.1f Temp %.1f", microns, cor, raddeg(alt), t);
+
+    focus_offset(1, microns + cor - unow);
+    return (focus_busy() ? 0 : -1);
+}
+
+/* return 1 while a focus move is under way, else 0 */
+int focus_busy()
+{
+    return (active_func == focus_offset);
+}
+
 /* no new messages.
  * goose the current objective, if any.
  */
@@ -115,6 +193,7 @@ static void focus_reset(int first)
     int had = mip->have;
 
     initCfg();
+    readFocTab();
 
     /* TODO: for some reason focus behaves badly if you just close/reopen.
      * N.B. "had" relies on telstatshmp being zeroed when telescoped starts.
@@ -262,7 +341,7 @@ static void focus_stop(int first, ...)
 /* handle a relative focus move, in microns */
 static void focus_offset(int first, ...)
 {
-    static int rawgoal;
+    static THREADLOCAL int rawgoal;
     MotorInfo *mip = OMOT;
     int cfd = MIPCFD(mip);
 
@@ -279,6 +358,7 @@ static void focus_offset(int first, ...)
         if (axisHomedCheck(mip, buf))
         {
             active_func = NULL;
+            afstate = AFS_IDLE;
             stopFocus(0);
             fifoWrite(Focus_Id, -1, "Focus error: %s", buf);
             return;
@@ -295,12 +375,14 @@ static void focus_offset(int first, ...)
         {
             fifoWrite(Focus_Id, -1, "Move is beyond positive limit");
             active_func = NULL;
+            afstate = AFS_IDLE;
             return;
         }
         if (goal < mip->neglim)
         {
             fifoWrite(Focus_Id, -2, "Move is beyond negative limit");
             active_func = NULL;
+            afstate = AFS_IDLE;
             return;
         }
 
@@ -324,10 +406,55 @@ static void focus_offset(int first, ...)
     {
         active_func = NULL;
         stopFocus(0);
-        fifoWrite(Focus_Id, 0, "Focus offset complete");
+        if (afstate != AFS_IDLE)
+            autoArrived();
+        else
+            fifoWrite(Focus_Id, 0, "Focus offset complete");
     }
 }
 
+/* find best focus from star sizes measured by whoever sent "auto [step [tol]]".
+ * we move to each position the autofocus engine asks for in turn and say
+ * "send FWHM" with code 3, then wait for "fwhm <size>" in any unit. when the
+ * engine is sure of best focus to within tol microns we move there and are
+ * done. step is the initial spacing of samples, microns. any other command
+ * abandons the search where it is.
+ */
+static void focus_auto(int first, ...)
+{
+    MotorInfo *mip = OMOT;
+
+    if (first)
+    {
+        double step = AFSTEP, tol = AFTOL;
+        double unow, lim0, lim1;
+        va_list ap;
+        char *args;
+
+        va_start(ap, first);
+        args = va_arg(ap, char *);
+        va_end(ap);
+        sscanf(args, "%lf %lf", &step, &tol);
+        if (step <= 0 || tol <= 0)
+        {
+            fifoWrite(Focus_Id, -1, "Autofocus step and tolerance must be positive");
+            return;
+        }
+
+        /* search within the limits, in microns */
+        unow = focusMicrons();
+        lim0 = mip->neglim * mip->step / (2 * PI * mip->focscale);
+        lim1 = mip->poslim * mip->step / (2 * PI * mip->focscale);
+        afInit(&af, unow, step, tol, lim0 < lim1 ? lim0 : lim1, lim0 < lim1 ? lim1 : lim0, AFMAXSAMP);
+        tdlog("Autofocus from %.1f microns, step %.1f, tolerance %.1f", unow, step, tol);
+
+        autoNext();
+        return;
+    }
+
+    /* nothing to do but wait for a fwhm */
+}
+
 /* handle a joystick jog command */
 static void focus_jog(int first, ...)
 {
@@ -416,11 +543,11 @@ static void initCfg()
 #define NOCFG (sizeof(ocfg) / sizeof(ocfg[0]))
 #define NHCFG (sizeof(hcfg) / sizeof(hcfg[0]))
 
-    static int OHAVE, OHASLIM, OAXIS;
-    static int OSTEP, OSIGN, OPOSSIDE, OHOMELOW;
-    static double OMAXVEL, OMAXACC, OSLIMACC, OSCALE;
+    static THREADLOCAL int OHAVE, OHASLIM, OAXIS;
+    static THREADLOCAL int OSTEP, OSIGN, OPOSSIDE, OHOMELOW;
+    static THREADLOCAL double OMAXVEL, OMAXACC, OSLIMACC, OSCALE;
 
-    static CfgEntry ocfg[] = {
+    CfgEntry ocfg[] = {
         {"OAXIS", CFG_INT, &OAXIS},
         {"OHAVE", CFG_INT, &OHAVE},
         {"OHASLIM", CFG_INT, &OHASLIM},
@@ -435,9 +562,9 @@ static void initCfg()
         {"OJOGF", CFG_DBL, &OJOGF},
     };
 
-    static double OPOSLIM, ONEGLIM;
+    static THREADLOCAL double OPOSLIM, ONEGLIM;
 
-    static CfgEntry hcfg[] = {
+    CfgEntry hcfg[] = {
         {"OPOSLIM", CFG_DBL, &OPOSLIM},
         {"ONEGLIM", CFG_DBL, &ONEGLIM},
     };
@@ -511,6 +638,213 @@ static void stopFocus(int fast)
     OMOT->dpos = OMOT->cpos;
 }
 
+/* read ftabfn, if any, into fttemp[], ftalt[] and ftcor[].
+ * the first line lists the temperatures, degrees C; each after is an altitude,
+ * degrees, followed by the correction at each temperature, microns. both
+ * must ascend. with no table, or a bad one, there is no correction.
+ */
+static void readFocTab()
+{
+    char buf[1024];
+    int n = 0, m = 0;
+    int lineno = 0;
+    double prev = 0;
+    FILE *fp;
+
+    if (ftalt)
+        free((void *)ftalt);
+    if (ftcor)
+        free((void *)ftcor);
+    ftalt = ftcor = NULL;
+    nftalt = nfttemp = 0;
+
+    fp = telfopen(ftabfn, "r");
+    if (!fp)
+        return;
+
+    while (fgets(buf, sizeof(buf), fp))
+    {
+        char *w, *end;
+        int i;
+
+        lineno++;
+        if (buf[0] == FTCOMMENT || strspn(buf, " \t\r\n") == strlen(buf))
+            continue;
+
+        if (!nfttemp)
+        {
+            for (w = buf; nfttemp < MAXFTT; w = end)
+            {
+                fttemp[nfttemp] = strtod(w, &end);
+                if (end == w)
+                    break;
+                if (nfttemp > 0 && fttemp[nfttemp] <= fttemp[nfttemp - 1])
+                    break;
+                nfttemp++;
+            }
+            if (!nfttemp || strspn(w, " \t\r\n") != strlen(w))
+            {
+                tdlog("%s: line %d: need up to %d ascending temperatures", ftabfn, lineno, MAXFTT);
+                goto bad;
+            }
+            continue;
+        }
+
+        if (n == m)
+        {
+            double *newalt, *newcor;
+
+            /* on failure keep what we have, so it is still freed next time */
+            newalt = (double *)realloc((void *)ftalt, (m + 16) * sizeof(double));
+            if (newalt)
+                ftalt = newalt;
+            newcor = (double *)realloc((void *)ftcor, (m + 16) * nfttemp * sizeof(double));
+            if (newcor)
+                ftcor = newcor;
+            if (!newalt || !newcor)
+            {
+                tdlog("%s: line %d: no memory for more altitudes", ftabfn, lineno);
+                goto bad;
+            }
+            m += 16;
+        }
+        ftalt[n] = degrad(strtod(buf, &end));
+        for (i = 0, w = end; i < nfttemp; i++, w = end)
+        {
+            ftcor[n * nfttemp + i] = strtod(w, &end);
+            if (end == w)
+                break;
+        }
+        if (end == buf || i < nfttemp || (n > 0 && ftalt[n] <= prev))
+        {
+            tdlog("%s: line %d: need an ascending altitude and %d corrections", ftabfn, lineno, nfttemp);
+            goto bad;
+        }
+        prev = ftalt[n++];
+    }
+    fclose(fp);
+
+    if (!n)
+    {
+        tdlog("%s: no altitudes", ftabfn);
+        nfttemp = 0;
+        return;
+    }
+    nftalt = n;
+    tdlog("%s: read %d altitudes at %d temperatures", ftabfn, nftalt, nfttemp);
+    return;
+
+bad:
+    fclose(fp);
+    nftalt = nfttemp = 0;
+}
+
+/* return the focus correction at alt, rads, and t, degrees C, in microns.
+ * interpolate between the nearest table entries, holding the edge values
+ * beyond them.
+ */
+static double focCorrection(double alt, double t)
+{
+    double fa, ft, c0, c1;
+    int a, j;
+
+    if (!nftalt)
+        return (0.0);
+
+    for (a = 0; a < nftalt - 2 && alt > ftalt[a + 1]; a++)
+        continue;
+    for (j = 0; j < nfttemp - 2 && t > fttemp[j + 1]; j++)
+        continue;
+
+    fa = nftalt < 2 ? 0 : (alt - ftalt[a]) / (ftalt[a + 1] - ftalt[a]);
+    ft = nfttemp < 2 ? 0 : (t - fttemp[j]) / (fttemp[j + 1] - fttemp[j]);
+    fa = fa < 0 ? 0 : fa > 1 ? 1 : fa;
+    ft = ft < 0 ? 0 : ft > 1 ? 1 : ft;
+
+#define FTC(ai, ti) ftcor[(ai) * nfttemp + (ti)]
+    c0 = FTC(a, j);
+    c1 = nftalt < 2 ? c0 : FTC(a + 1, j);
+    if (nfttemp > 1)
+    {
+        c0 += ft * (FTC(a, j + 1) - c0);
+        c1 += ft * ((nftalt < 2 ? FTC(a, j + 1) : FTC(a + 1, j + 1)) - c1);
+    }
+#undef FTC
+
+    return (c0 + fa * (c1 - c0));
+}
+
+/* add a fwhm measured at the current position to the autofocus search */
+static void autoSample(double fwhm)
+{
+    if (afstate != AFS_MEASURE)
+    {
+        fifoWrite(Focus_Id, -1, "Not waiting for an autofocus FWHM");
+        return;
+    }
+    if (afAddSample(&af, focusMicrons(), fwhm) < 0)
+    {
+        fifoWrite(Focus_Id, -1, "Autofocus FWHM must be positive");
+        return;
+    }
+
+    autoNext();
+}
+
+/* ask the autofocus engine what to do next, and start doing it */
+static void autoNext()
+{
+    double x;
+
+    switch (afNext(&af, &x))
+    {
+    case AF_MORE:
+        autoMove(x, AFS_MOVE);
+        break;
+    case AF_DONE:
+        tdlog("Autofocus best %.1f +-%.1f microns, FWHM %.2f, after %d samples, %d rejected", x, af.err, af.fmin,
+              af.nsamp, af.nrej);
+        autoMove(x, AFS_BEST);
+        break;
+    default:
+        afstate = AFS_IDLE;
+        active_func = NULL;
+        fifoWrite(Focus_Id, -8, "Autofocus failed: %s", af.whynot);
+        break;
+    }
+}
+
+/* start moving to microns from home, then to be in state */
+static void autoMove(double microns, int state)
+{
+    afstate = state;
+    focus_offset(1, microns - focusMicrons());
+}
+
+/* an autofocus move has arrived */
+static void autoArrived()
+{
+    if (afstate == AFS_BEST)
+    {
+        afstate = AFS_IDLE;
+        fifoWrite(Focus_Id, 0, "Autofocus complete at %.1f microns", focusMicrons());
+        return;
+    }
+
+    afstate = AFS_MEASURE;
+    active_func = focus_auto;
+    fifoWrite(Focus_Id, 3, "Autofocus sample %d at %.1f microns: send FWHM", af.nsamp + 1, focusMicrons());
+}
+
+/* return the current position, microns from home */
+static double focusMicrons()
+{
+    MotorInfo *mip = OMOT;
+
+    readFocus();
+    return (mip->cpos * mip->step / (2 * PI * mip->focscale));
+}
+
 /* read the raw value */
 static void readFocus()
 {
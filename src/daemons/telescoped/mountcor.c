@@ -29,16 +29,14 @@ typedef struct
     double dha, ddec; /* error (target - wcs), dha is polar angle */
 } MeshPoint;
 
-static MeshPoint *mpoints; /* malloced list of mesh points, from file */
-static int nmpoints;
+static THREADLOCAL MeshPoint *mpoints; /* malloced list of mesh points, from file */
+static THREADLOCAL int nmpoints;
 
-static double ptgrad; /* pointing interpolation radius, rads */
+static THREADLOCAL double ptgrad; /* pointing interpolation radius, rads */
 
 static void interp(double ha, double dec, double *ehap, double *edecp);
-static void readMeshFile(void);
-static MeshPoint *newMeshPoint(void);
+static int readMeshFile(MeshPoint **mpp, int *np);
 static int cmpMP(const void *p1, const void *p2);
-static void sortMPoints(void);
 
 /* do whatever when we want to reinitialize for mount corrections.
  * this amounts to (re)reading the pointing mesh list and sorting it by dec.
@@ -53,9 +51,43 @@ void init_mount_cor()
         die();
     }
 
-    readMeshFile();
     if (mpoints)
-        sortMPoints();
+        free((void *)mpoints);
+    if (readMeshFile(&mpoints, &nmpoints) < 0)
+    {
+        mpoints = NULL;
+        nmpoints = 0;
+    }
+}
+
+/* as init_mount_cor() but while the telescope may be tracking: the new mesh
+ * and PTGRAD replace the old only once both are read, so the corrections
+ * in use never go missing. if trouble, say why in why[] and keep the old.
+ * return 0 if ok, else -1.
+ */
+int reload_mount_cor(char why[])
+{
+    MeshPoint *newmp;
+    double newptgrad;
+    int newn;
+
+    if (read1CfgEntry(1, tscfn, "PTGRAD", CFG_DBL, &newptgrad, 0) < 0)
+    {
+        sprintf(why, "%s: PTGRAD not found", basenm(tscfn));
+        return (-1);
+    }
+    if (readMeshFile(&newmp, &newn) < 0)
+    {
+        sprintf(why, "%s: %s", basenm(meshfn), strerror(errno));
+        return (-1);
+    }
+
+    if (mpoints)
+        free((void *)mpoints);
+    mpoints = newmp;
+    nmpoints = newn;
+    ptgrad = newptgrad;
+    return (0);
 }
 
 /* given an ha and dec, find the amounts by which the ideal should be
@@ -76,10 +108,13 @@ double *ddecp;
 }
 
 /* given a target location and the mesh points, interpolate to find the error.
- * use a weighted average based on distance if find two or more mesh points
- *   within ptgrad. the weight is the inverse of the distance away from the
- *   target, scaled 1 to 0 out to ptgrad. If don't find at least two then just
- *   use the closest directly.
+ * use a weighted average of the mesh points within ptgrad. the weight varies
+ *   linearly from 1 on a mesh point to 0 at ptgrad. where those weights add to
+ *   less than 1, towards and beyond the edge of the mesh, make up the
+ *   difference with an average of all points weighted by the inverse square
+ *   of their distance. every weight goes smoothly to 0 so the error does too,
+ *   with no step where a point comes into or out of range, or where one
+ *   point stops being the closest, that a track would have to jump.
  * N.B. we assume mpoints is sorted by increasing tdec.
  */
 static void interp(double ha, double dec, double *ehap, double *edecp)
@@ -87,7 +122,7 @@ static void interp(double ha, double dec, double *ehap, double *edecp)
     double cdec = cos(dec), sdec = sin(dec);
     double cptgrad = cos(ptgrad);
     double swh, swd, sw;
-    int nfound;
+    double fill;
     int l, u, m;
     int i;
 
@@ -110,13 +145,10 @@ static void interp(double ha, double dec, double *ehap, double *edecp)
         continue;
 
     swh = swd = sw = 0.0;
-    nfound = 0;
     for (i = l + 1; i < u; i++)
     {
         MeshPoint *rp = &mpoints[i];
         double cosr, w; /* cos dist, weight */
-        double edec;    /* dec error */
-        double eha;     /* ha error */
 
         /* distance to this mesh point -- reject immediately if > ptgrad */
         cosr = sdec * sin(rp->dec) + cdec * cos(rp->dec) * cos(ha - rp->ha);
@@ -126,103 +158,85 @@ static void interp(double ha, double dec, double *ehap, double *edecp)
         /* weight varies linearly from 1 if right on a mesh point to 0
          * at ptgrad.
          */
-        w = (ptgrad - acos(cosr)) / ptgrad;
-
-        eha = rp->dha;
-        edec = rp->ddec;
+        w = (ptgrad - acos(cosr > 1 ? 1 : cosr)) / ptgrad;
 
-        swh += w * eha;
-        swd += w * edec;
+        swh += w * rp->dha;
+        swd += w * rp->ddec;
         sw += w;
-
-        nfound++;
     }
 
-    /* if found at least two, use average.
-     * else find closest and use it.
-     */
-    if (nfound >= 2)
+    /* thin or no cover: fill in from all points, nearest the most */
+    fill = sw < 1 ? 1 - sw : 0;
+    if (fill > 0)
     {
-        *ehap = swh / sw;
-        *edecp = swd / sw;
-    }
-    else
-    {
-        MeshPoint *closestrp = NULL;
-        double closestcosr = -1;
+        double fh, fd, fw;
 
+        fh = fd = fw = 0.0;
         for (i = 0; i < nmpoints; i++)
         {
             MeshPoint *rp = &mpoints[i];
-            double cosr;
+            double cosr, w;
 
             cosr = sdec * sin(rp->dec) + cdec * cos(rp->dec) * cos(ha - rp->ha);
-            if (cosr > closestcosr)
+            if (cosr >= 1)
             {
-                closestrp = rp;
-                closestcosr = cosr;
+                /* right on it */
+                fh = rp->dha;
+                fd = rp->ddec;
+                fw = 1;
+                break;
             }
+            w = 1 / (1 - cosr); /* ~ 2/dist^2 */
+            fh += w * rp->dha;
+            fd += w * rp->ddec;
+            fw += w;
         }
-        if (closestrp)
+        if (fw > 0)
         {
-            *ehap = closestrp->dha;
-            *edecp = closestrp->ddec;
-        }
-        else
-        {
-            *ehap = 0.0;
-            *edecp = 0.0;
+            swh += fill * fh / fw;
+            swd += fill * fd / fw;
+            sw += fill;
         }
     }
-}
 
-/* add room for one more in mpoints[] and return pointer to the new one.
- * return NULL if no more room.
- */
-static MeshPoint *newMeshPoint()
-{
-    char *new;
-
-    new = mpoints ? realloc((void *)mpoints, (nmpoints + 1) * sizeof(MeshPoint)) : malloc(sizeof(MeshPoint));
-    if (!new)
-        return (NULL);
-
-    mpoints = (MeshPoint *)new;
-    return (&mpoints[nmpoints++]);
+    if (sw > 0)
+    {
+        *ehap = swh / sw;
+        *edecp = swd / sw;
+    }
+    else
+    {
+        *ehap = 0.0;
+        *edecp = 0.0;
+    }
 }
 
-/* read the mesh file into mpoints.
- * the mesh file is expected to have errors in arc mins, dHA a polar angle.
- * if trouble, return with mpoints == NULL.
+/* read the mesh file into a new malloced array sorted by dec at *mpp, with
+ * *np entries. it is expected to have errors in arc mins, dHA a polar angle.
+ * return 0 if ok, else -1 with errno set and nothing malloced.
  */
-static void readMeshFile()
+static int readMeshFile(MeshPoint **mpp, int *np)
 {
+    MeshPoint *mp = NULL;
+    int n = 0, m = 0;
     char line[1024];
     FILE *fp;
     double ha, dec, dha, ddec;
     int lineno = 0;
 
-    /* reset mpoints array */
-    if (mpoints)
-    {
-        free((void *)mpoints);
-        nmpoints = 0;
-        mpoints = NULL;
-    }
-
     /* open mesh file */
     fp = telfopen(meshfn, "r");
     if (!fp)
     {
-        tdlog("%s: %s", meshfn, strerror(errno));
-        return;
+        int e = errno;
+        tdlog("%s: %s", meshfn, strerror(e));
+        errno = e;
+        return (-1);
     }
 
-    /* read each line, building mpoints[] */
+    /* read each line, building mp[] */
     while (fgets(line, sizeof(line), fp))
     {
-        MeshPoint *mp;
-
         lineno++;
         if (line[0] == COMMENT)
             continue;
@@ -231,27 +245,38 @@ static void readMeshFile()
             tdlog("%s: skipping bad entry, line %d", meshfn, lineno);
             continue;
         }
-        mp = newMeshPoint();
-        if (!mp)
+        if (n == m)
         {
-            tdlog("No memory for mesh log -- corrections will be 0");
-            if (mpoints)
+            MeshPoint *new;
+
+            m = m ? 2 * m : 64;
+            new = (MeshPoint *)realloc((void *)mp, m * sizeof(MeshPoint));
+            if (!new)
             {
-                free((void *)mpoints);
-                mpoints = NULL;
+                tdlog("No memory for mesh log");
+                free((void *)mp);
+                fclose(fp);
+                errno = ENOMEM;
+                return (-1);
             }
-            nmpoints = 0;
-            break;
+            mp = new;
         }
-        mp->ha = hrrad(ha);
-        mp->dec = degrad(dec);
-        mp->dha = degrad(dha / 60.0);
-        mp->ddec = degrad(ddec / 60.0);
+        mp[n].ha = hrrad(ha);
+        mp[n].dec = degrad(dec);
+        mp[n].dha = degrad(dha / 60.0);
+        mp[n].ddec = degrad(ddec / 60.0);
+        n++;
     }
 
     fclose(fp);
 
-    tdlog("%s: read %d mesh points", meshfn, nmpoints);
+    if (mp)
+        qsort((void *)mp, n, sizeof(MeshPoint), cmpMP);
+    *mpp = mp;
+    *np = n;
+
+    tdlog("%s: read %d mesh points", meshfn, n);
+    return (0);
 }
 
 /* qsort-style function to compare 2 MeshPoints by increasing tdec */
@@ -267,9 +292,3 @@ static int cmpMP(const void *p1, const void *p2)
         return (1);
     return (0);
 }
-
-/* sort mpoints array by uncreasing dec */
-static void sortMPoints()
-{
-    qsort((void *)mpoints, nmpoints, sizeof(MeshPoint), cmpMP);
-}
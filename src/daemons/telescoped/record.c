@@ -0,0 +1,108 @@
+/* record telescoped state at every poll, and each command, to
+ * archive/logs/telescoped-<time>.rec for later study with telrec.
+ * see telrec.h for the format.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "csimc.h"
+#include "telenv.h"
+#include "telrec.h"
+#include "telstatshm.h"
+
+#include "teled.h"
+
+static char *recprog;     /* prefix of file names, or NULL if not recording */
+static double rechours;   /* start a new file this often, 0 never */
+static time_t rectime;    /* when current file was started */
+
+static void rec_start(void);
+static void rec_stop(char *why);
+
+/* start recording, to a new file every hours if > 0 */
+void rec_init(char *progname, double hours)
+{
+    recprog = progname;
+    rechours = hours;
+    rec_start();
+}
+
+/* record the state now */
+void rec_poll()
+{
+    TelStatShm *tp = telstatshmp;
+    double v[TR_NCOL];
+    int i;
+
+    if (!recprog)
+        return;
+    if (rechours > 0 && time(NULL) - rectime >= rechours * 3600)
+        rec_start();
+
+    v[TR_MJD] = tp->now.n_mjd;
+    v[TR_STATE] = tp->telstate;
+    for (i = TEL_HM; i <= TEL_RM; i++)
+    {
+        MotorInfo *mip = &tp->minfo[i];
+        double *vp = &v[TR_HRAW + 4 * i];
+
+        vp[0] = mip->raw;
+        vp[1] = mip->cpos;
+        vp[2] = mip->dpos;
+        vp[3] = mip->cvel;
+    }
+    v[TR_MDHA] = tp->mdha;
+    v[TR_MDDEC] = tp->mddec;
+    v[TR_JDHA] = tp->jdha;
+    v[TR_JDDEC] = tp->jddec;
+    v[TR_CAHA] = tp->CAHA;
+    v[TR_CADEC] = tp->CADec;
+    v[TR_DAHA] = tp->DAHA;
+    v[TR_DADEC] = tp->DADec;
+
+    if (trPut(v) < 0)
+        rec_stop(strerror(errno));
+}
+
+/* record msg just received on fifo */
+void rec_cmd(char *fifo, char *msg)
+{
+    if (recprog && trCmd(telstatshmp->now.n_mjd, fifo, msg) < 0)
+        rec_stop(strerror(errno));
+}
+
+/* finish the current file */
+void rec_close()
+{
+    trClose();
+}
+
+/* start a new file */
+static void rec_start()
+{
+    char fn[1024], path[1024];
+
+    rectime = time(NULL);
+    sprintf(fn, "archive/logs/%s-%s.rec", recprog, timestamp(rectime));
+    telfixpath(path, fn);
+    if (trOpen(path) < 0)
+    {
+        rec_stop(strerror(errno));
+        return;
+    }
+    tdlog("Recording to %s", path);
+}
+
+/* give up recording after trouble */
+static void rec_stop(char *why)
+{
+    tdlog("Recording stopped: %s", why);
+    trClose();
+    recprog = NULL;
+}
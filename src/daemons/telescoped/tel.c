@@ -20,11 +20,13 @@
 #include "cliserv.h"
 #include "configfile.h"
 #include "csimc.h"
+#include "latshm.h"
 #include "misc.h"
 #include "running.h"
 #include "strops.h"
 #include "telenv.h"
 #include "telstatshm.h"
+#include "trace.h"
 #include "virmc.h"
 
 #include "teled.h"
@@ -34,11 +36,12 @@
 #define NMOT (TEL_RM - TEL_HM + 1)
 
 /* the current activity, if any */
-static void (*active_func)(int first, ...);
+static THREADLOCAL void (*active_func)(int first, ...);
 
 /* one of these... */
 static void tel_poll(void);
 static void tel_reset(int first);
+static void tel_reload(void);
 static void tel_home(int first, ...);
 static void tel_limits(int first, ...);
 void tel_stow(int first, ...);
@@ -49,7 +52,13 @@ static void tel_altaz(int first, ...);
 static void tel_hadec(int first, ...);
 static void tel_stop(int first, ...);
 static void tel_jog(int first, char jog_dir[]);
+static void tel_slewtime(char *msg);
+static void tel_cantrack(char *msg);
 static void offsetTracking(int first, double harcsecs, double darcsecs, int report);
+static int focusSuffix(char *msg, double *micronsp);
+static int isTarget(char *msg);
+static void focusAlong(int have, double microns);
+static int focusDone(void);
 
 /* helped along by these... */
 static int dbformat(char *msg, Obj *op, double *drap, double *ddecp);
@@ -63,29 +72,93 @@ static void stopTel(int fast);
 static int onTarget(MotorInfo **mipp);
 static int atTarget(void);
 static int trackObj(Obj *op, int first);
+static int trackObj1(Obj *op, int first);
+static int readClock(MotorInfo *mip, int *clockp);
+static void nodeTrack(MotorInfo *mip, double v[], int start, int ivalms, double out[]);
+static double trackSag(double *xyr[]);
 static void findAxes(Now *np, Obj *op, double *xp, double *yp, double *rp);
+static void findAxesOffset(Now *np, Obj *op, double roff, double doff, double *xp, double *yp, double *rp);
+static double timeToLimit(Now *np, Obj *op, double roff, double doff, double start[], double horizon, int *axisp);
+static void limBegin(Now *np, Obj *op, double roff, double doff, double start[], double horizon);
+static int limStep(int n);
+static void limClear(void);
+static int beyondLimit(Now *np, Obj *op, double roff, double doff, double t, double prev[], double v[]);
 static int chkLimits(int wrapok, double *xp, double *yp, double *rp);
+static int wrapLimits(MotorInfo *mip, int wrapok, double *vp, char why[]);
+static int slewPredict(Now *np, char *tgt, long *slewusp, long *settleusp, char why[]);
 static void jogTrack(int first, char dircode);
 static void jogSlew(int first, char dircode);
 static int checkAxes(void);
 static char *sayWhere(double alt, double az);
+static double cpuSecs(void);
 
 /* config entries */
-static double TRACKACC;    /* tracking accuracy, rads. 0 means 1 enc step*/
-static double ACQUIREACC;  /* acquire accuracy, rads. 0 means 1 enc step*/
-static double ACQUIREDELT; /* how far moved in 1sec before settled */
-static double FGUIDEVEL;   /* fine jogging motion rate, rads/sec */
-static double CGUIDEVEL;   /* coarse jogging motion rate, rads/sec */
-static int TRACKINT;       /* tracking interval for each e/mtrack, secs */
+static THREADLOCAL double TRACKACC;    /* tracking accuracy, rads. 0 means 1 enc step*/
+static THREADLOCAL double ACQUIREACC;  /* acquire accuracy, rads. 0 means 1 enc step*/
+static THREADLOCAL double ACQUIREDELT; /* how far moved in 1sec before settled */
+static THREADLOCAL double FGUIDEVEL;   /* fine jogging motion rate, rads/sec */
+static THREADLOCAL double CGUIDEVEL;   /* coarse jogging motion rate, rads/sec */
+static THREADLOCAL int TRACKINT;       /* tracking interval for each e/mtrack, secs */
+static THREADLOCAL int CLOCKKEEP;      /* refreshes start from the running clock */
+static THREADLOCAL int ACQSCURVE;      /* acquire along a jerk-limited S-curve */
 
 #define PPTRACK 60 /* number of positions to e/mtrack */
+#define TRACKSAG (PI / 180 / 3600) /* most rads a track may stray between points */
+#define MINIVALMS 100              /* shortest ms between track points */
 
-/* offsets to apply to target object location, if any */
-static double r_offset; /* delta ra to be added */
-static double d_offset; /* delta dec to be added */
+/* acquisition profile, see buildTrack() */
+static THREADLOCAL double maxjerk[NMOT]; /* S-curve jerk limit per axis, rads/sec^3 */
+#define JERKRAMP 0.25        /* default secs to ramp to maxacc */
+#define ACQDERATE 0.9        /* fraction of maxvel/maxacc for the S-curve */
+#define ACQTAIL 10.0         /* secs of plain track after the S-curve */
+static THREADLOCAL double trackdur;      /* secs until current e/mtrack needs refreshed */
+static THREADLOCAL double sacquire;      /* when current acquisition started */
 
+/* offsets to apply to target object location, if any */
+static THREADLOCAL double r_offset; /* delta ra to be added */
+static THREADLOCAL double d_offset; /* delta dec to be added */
+
+/* target being tracked, and any offset from it, see tel_getTrack() */
+static THREADLOCAL Obj *trackop;          /* target of trackObj(), or NULL */
+static THREADLOCAL double h_toffset;      /* last Offset command, arcsecs */
+static THREADLOCAL double d_toffset;
+static THREADLOCAL int resumeoffset;      /* apply them once acquired */
+
+/* set while a target waits for the focus move it brought, see focusAlong() */
+static THREADLOCAL int focuswait;
+
+/* look-ahead for the current target reaching a limit, see timeToLimit() */
+#define LIMHORIZON (12 * 3600.0) /* secs to look ahead */
+#define LIMSTEP 120.0            /* secs between trajectory samples */
+#define LIMRES 1.0               /* secs to which limit time is refined */
+#define LIMPERPOLL 4             /* trajectory samples per poll while tracking */
+
+/* a look-ahead in progress, advanced LIMPERPOLL samples each poll so the
+ * whole horizon costs no one poll much, see limStep().
+ */
+typedef struct
+{
+    Now now;            /* time it looks ahead from */
+    Obj o;              /* target, modified as positions are computed */
+    double roff, doff;  /* offsets it was begun with */
+    double horizon;     /* secs to look no further than */
+    double prev[NMOT];  /* last positions known to be within limits */
+    double v[NMOT];     /* scratch positions */
+    double tlo, thi;    /* secs known to be clear, and the next to try */
+    int axis;           /* axis found to reach a limit first, else -1 */
+    int bisect;         /* set once a crossing is found and being refined */
+    int done;           /* set when tlo and axis are final */
+} LimWalk;
+static THREADLOCAL LimWalk limwalk;
+
+#define SETTLETIME 1.0 /* secs all axes must stay within ACQUIREACC */
 #define MAXJITTER 10.0 /* max clock vs host difference */
-static double strack;  /* when current e/mtrack started */
+static THREADLOCAL double strack;  /* when current e/mtrack started */
+static THREADLOCAL double hstrack; /* clk_now() at strack */
+
+/* cost of building track profiles, see tel_trackstats() */
+static THREADLOCAL int nbuilds;      /* profiles built */
+static THREADLOCAL double buildsecs; /* thread cpu secs spent building them */
 
 int tel_ishomed(void);
 
@@ -95,33 +168,62 @@ int tel_ishomed(void);
 /* ARGSUSED */
 void tel_msg(msg) char *msg;
 {
-    double a, b, c;
-    int i;
+    double a, b, c, f;
+    int i, hasf;
     char jog_dir[8];
     Obj o;
 
+    /* any target may also say where to focus, nothing else may */
+    hasf = msg && focusSuffix(msg, &f);
+    if (hasf && !isTarget(msg))
+    {
+        fifoWrite(Tel_Id, -1, "Focus: only goes with a target: %s", msg);
+        return;
+    }
+
     /* dispatch -- stop by default */
 
     if (!msg)
         tel_poll();
     else if (strncasecmp(msg, "reset", 5) == 0)
         tel_reset(1);
+    else if (strncasecmp(msg, "reload", 6) == 0)
+        tel_reload(); /* current activity continues */
     else if (strncasecmp(msg, "home", 4) == 0)
         tel_home(1, msg);
     else if (strncasecmp(msg, "limits", 6) == 0)
         tel_limits(1, msg);
     else if (strncasecmp(msg, "stow", 4) == 0)
         tel_stow(1, msg);
+    else if (strncasecmp(msg, "slewtime", 8) == 0)
+        tel_slewtime(msg + 8); /* just a query, current activity continues */
+    else if (strncasecmp(msg, "cantrack", 8) == 0)
+        tel_cantrack(msg + 8); /* just a query, current activity continues */
     else if (sscanf(msg, "RA:%lf Dec:%lf Epoch:%lf", &a, &b, &c) == 3)
+    {
         tel_radecep(1, a, b, c);
+        focusAlong(hasf, f);
+    }
     else if (sscanf(msg, "RA:%lf Dec:%lf", &a, &b) == 2)
+    {
         tel_radeceod(1, a, b);
+        focusAlong(hasf, f);
+    }
     else if (dbformat(msg, &o, &a, &b) == 0)
+    {
         tel_op(1, &o, a, b);
+        focusAlong(hasf, f);
+    }
     else if (sscanf(msg, "Alt:%lf Az:%lf", &a, &b) == 2)
+    {
         tel_altaz(1, a, b);
+        focusAlong(hasf, f);
+    }
     else if (sscanf(msg, "HA:%lf Dec:%lf", &a, &b) == 2)
+    {
         tel_hadec(1, a, b);
+        focusAlong(hasf, f);
+    }
     else if (sscanf(msg, "j%7[NSEWnsew0]", jog_dir) == 1)
         tel_jog(1, jog_dir);
     else if (sscanf(msg, "Offset %lf,%lf", &a, &b) == 2)
@@ -138,6 +240,8 @@ void tel_msg(msg) char *msg;
  */
 static void tel_poll()
 {
+    TRACE_BEGIN("tel_poll");
+
     if (virtual_mode)
     {
         MotorInfo *mip;
@@ -156,6 +260,8 @@ static void tel_poll()
         mkCook();
         dummyTarg();
     }
+
+    TRACE_END("tel_poll");
 }
 
 /* stop and reread config files */
@@ -203,11 +309,61 @@ static void tel_reset(int first)
     fifoWrite(Tel_Id, 0, "Reset complete");
 }
 
+/* reread those config entries that need nothing of the nodes, as a Reset
+ * would, but leave the nodes and whatever we are doing alone. all are read
+ * and checked before any is used, and as we are between polls each takes
+ * effect from the next: accuracies and guide rates at once, TRACKINT from
+ * the next tracking segment, the mesh as the next segment is built.
+ */
+static void tel_reload()
+{
+    double trackacc, acquireacc, acquiredelt, fguidevel, cguidevel;
+    int trackint;
+    CfgEntry rcfg[] = {
+        {"TRACKINT", CFG_INT, &trackint},
+        {"TRACKACC", CFG_DBL, &trackacc},
+        {"ACQUIREACC", CFG_DBL, &acquireacc},
+        {"ACQUIREDELT", CFG_DBL, &acquiredelt},
+        {"FGUIDEVEL", CFG_DBL, &fguidevel},
+        {"CGUIDEVEL", CFG_DBL, &cguidevel},
+    };
+    int nrcfg = sizeof(rcfg) / sizeof(rcfg[0]);
+    char why[256];
+    int n;
+
+    n = readCfgFile(1, tdcfn, rcfg, nrcfg);
+    if (n != nrcfg)
+    {
+        cfgFileError(tdcfn, n, (CfgPrFp)tdlog, rcfg, nrcfg);
+        fifoWrite(Tel_Id, -1, "Reload: %s is incomplete, nothing changed", basenm(tdcfn));
+        return;
+    }
+    if (trackint <= 0 || trackacc < 0 || acquireacc < 0 || fguidevel < 0 || cguidevel < 0)
+    {
+        fifoWrite(Tel_Id, -1, "Reload: %s has bad values, nothing changed", basenm(tdcfn));
+        return;
+    }
+    if (reload_mount_cor(why) < 0)
+    {
+        fifoWrite(Tel_Id, -1, "Reload: %s, nothing changed", why);
+        return;
+    }
+
+    TRACKINT = trackint;
+    TRACKACC = trackacc;
+    ACQUIREACC = acquireacc;
+    ACQUIREDELT = acquiredelt;
+    FGUIDEVEL = fguidevel;
+    CGUIDEVEL = cguidevel;
+
+    fifoWrite(Tel_Id, 0, "Reload complete");
+}
+
 /* seek telescope axis home positions.. all or as per HDR */
 static void tel_home(int first, ...)
 {
-    static int want[NMOT];
-    static int nwant;
+    static THREADLOCAL int want[NMOT];
+    static THREADLOCAL int nwant;
     MotorInfo *mip;
     int i;
 
@@ -276,6 +432,7 @@ static void tel_home(int first, ...)
         /* if get here, set new state */
         active_func = tel_home;
         telstatshmp->telstate = TS_HOMING;
+        limClear();
         telstatshmp->telstateidx++;
     }
 
@@ -307,6 +464,7 @@ static void tel_home(int first, ...)
     if (!nwant)
     {
         telstatshmp->telstate = TS_STOPPED;
+        limClear();
         telstatshmp->telstateidx++;
         active_func = NULL;
         fifoWrite(Tel_Id, 0, "Scope homing complete");
@@ -318,9 +476,9 @@ static void tel_home(int first, ...)
  */
 static void tel_limits(int first, ...)
 {
-    static int ishomed[NMOT];
-    static int want[NMOT];
-    static int nwant;
+    static THREADLOCAL int ishomed[NMOT];
+    static THREADLOCAL int want[NMOT];
+    static THREADLOCAL int nwant;
     MotorInfo *mip;
     int i;
 
@@ -396,6 +554,7 @@ static void tel_limits(int first, ...)
         /* new state */
         active_func = tel_limits;
         telstatshmp->telstate = TS_LIMITING;
+        limClear();
         telstatshmp->telstateidx++;
     }
 
@@ -459,7 +618,7 @@ void tel_stow(int first, ...)
 /* handle tracking an astrometric position */
 static void tel_radecep(int first, ...)
 {
-    static Obj o;
+    static THREADLOCAL Obj o;
 
     if (first)
     {
@@ -502,7 +661,7 @@ static void tel_radecep(int first, ...)
 /* handle tracking an apparent position */
 static void tel_radeceod(int first, ...)
 {
-    static Obj o;
+    static THREADLOCAL Obj o;
 
     if (first)
     {
@@ -544,7 +703,7 @@ static void tel_radeceod(int first, ...)
 /* handle tracking an object */
 static void tel_op(int first, ...)
 {
-    static Obj o;
+    static THREADLOCAL Obj o;
 
     if (first)
     {
@@ -605,6 +764,7 @@ static void tel_altaz(int first, ...)
 
         /* set new state */
         telstatshmp->telstate = TS_SLEWING;
+        limClear();
         telstatshmp->telstateidx++;
         active_func = tel_altaz;
 
@@ -673,7 +833,7 @@ static void tel_altaz(int first, ...)
         active_func = NULL;
     }
 
-    if (atTarget() == 0)
+    if (atTarget() == 0 && focusDone())
     {
         stopTel(0);
         fifoWrite(Tel_Id, 0, "Slew complete");
@@ -711,6 +871,7 @@ static void tel_hadec(int first, ...)
 
         /* set new state */
         telstatshmp->telstate = TS_SLEWING;
+        limClear();
         telstatshmp->telstateidx++;
         active_func = tel_hadec;
 
@@ -780,7 +941,7 @@ static void tel_hadec(int first, ...)
         active_func = NULL;
     }
 
-    if (atTarget() == 0)
+    if (atTarget() == 0 && focusDone())
     {
         stopTel(0);
         fifoWrite(Tel_Id, 0, "Slew complete");
@@ -820,6 +981,7 @@ static void tel_stop(int first, ...)
 
     /* if get here, everything has stopped */
     telstatshmp->telstate = TS_STOPPED;
+    limClear();
     telstatshmp->telstateidx++;
     active_func = NULL;
     fifoWrite(Tel_Id, 0, "Stop complete");
@@ -836,8 +998,223 @@ static void tel_jog(int first, char jog_dir[])
         jogSlew(first, jog_dir[0]);
 }
 
+/* answer a SlewTime query: predict how long it would take to slew from the
+ * current position to each of a list of targets separated by ';'. each target
+ * may be given as "RA:r Dec:d" (apparent, rads), "HA:h Dec:d" or "Alt:a Az:z".
+ * each result is reported as microseconds of slew and of settling; a list
+ * reports each with code 1 then the total with code 0.
+ * N.B. this does not disturb active_func.
+ */
+static void tel_slewtime(char *msg)
+{
+    Now *np = &telstatshmp->now;
+    char buf[1024], why[128];
+    char *tgt, *next;
+    long slewus, settleus, totus;
+    int ntgt, nbad;
+
+    /* work with a copy so we can split it up */
+    strncpy(buf, msg, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    /* need to know where we are now */
+    if (!active_func)
+    {
+        readRaw();
+        mkCook();
+    }
+
+    totus = 0;
+    ntgt = nbad = 0;
+    for (tgt = buf; tgt; tgt = next)
+    {
+        next = strchr(tgt, ';');
+        if (next)
+            *next++ = '\0';
+        while (*tgt == ' ')
+            tgt++;
+        if (!*tgt)
+            continue;
+
+        if (slewPredict(np, tgt, &slewus, &settleus, why) < 0)
+        {
+            if (!next && !ntgt)
+            {
+                fifoWrite(Tel_Id, -1, "SlewTime: %s", why);
+                return;
+            }
+            fifoWrite(Tel_Id, 1, "SlewTime %d: %s", ntgt, why);
+            nbad++;
+        }
+        else
+        {
+            if (!next && !ntgt)
+            {
+                fifoWrite(Tel_Id, 0, "SlewTime: %ld us slew %ld us settle", slewus, settleus);
+                return;
+            }
+            fifoWrite(Tel_Id, 1, "SlewTime %d: %ld us slew %ld us settle", ntgt, slewus, settleus);
+            totus += slewus + settleus;
+        }
+        ntgt++;
+    }
+
+    if (!ntgt)
+        fifoWrite(Tel_Id, -1, "SlewTime: no targets given");
+    else
+        fifoWrite(Tel_Id, 0, "SlewTime: %d targets %d unreachable %ld us total", ntgt, nbad, totus);
+}
+
+/* answer whether the given target could be tracked from now for the given
+ * number of minutes without reaching an axis limit, as "mins target" where
+ * target is "RA:r Dec:d [Epoch:e]" or a db line with optional offsets, as the
+ * tracking commands accept. the axes start as a slew
+ * there now would leave them.
+ */
+static void tel_cantrack(char *msg)
+{
+    Now *np = &telstatshmp->now;
+    double mins, a, b, c, tlim;
+    double roff = 0, doff = 0;
+    double start[NMOT];
+    char why[128];
+    MotorInfo *mip;
+    Obj o;
+    int n, axis;
+
+    if (sscanf(msg, "%lf %n", &mins, &n) < 1 || mins < 0)
+    {
+        fifoWrite(Tel_Id, -1, "CanTrack: need minutes then target");
+        return;
+    }
+    msg += n;
+
+    /* build the object as the tracking commands would */
+    memset((void *)&o, 0, sizeof(o));
+    o.o_type = FIXED;
+    strcpy(o.o_name, "<Anon>");
+    if (sscanf(msg, "RA:%lf Dec:%lf Epoch:%lf", &a, &b, &c) == 3)
+    {
+        double Mjd;
+
+        o.f_RA = a;
+        o.f_dec = b;
+        year_mjd(c, &Mjd);
+        o.f_epoch = Mjd;
+    }
+    else if (sscanf(msg, "RA:%lf Dec:%lf", &a, &b) == 2)
+    {
+        ap_as(np, J2000, &a, &b);
+        o.f_RA = a;
+        o.f_dec = b;
+        o.f_epoch = J2000;
+    }
+    else if (dbformat(msg, &o, &roff, &doff) < 0)
+    {
+        fifoWrite(Tel_Id, -1, "CanTrack: unrecognized target: %.64s", msg);
+        return;
+    }
+
+    /* where a slew would go */
+    findAxesOffset(np, &o, roff, doff, &start[TEL_HM], &start[TEL_DM], &start[TEL_RM]);
+    FEM(mip)
+    {
+        if (mip->have && wrapLimits(mip, 1, &start[mip - telstatshmp->minfo], why) < 0)
+        {
+            fifoWrite(Tel_Id, 0, "CanTrack: no, %s", why);
+            return;
+        }
+    }
+
+    /* no need to look further than asked */
+    tlim = timeToLimit(np, &o, roff, doff, start, mins * 60, &axis);
+    if (axis < 0)
+        fifoWrite(Tel_Id, 0, "CanTrack: yes, no limit within %g mins", mins);
+    else
+        fifoWrite(Tel_Id, 0, "CanTrack: no, axis %d reaches limit after %.1f mins",
+                  telstatshmp->minfo[axis].axis, tlim / 60);
+}
+
 /* aux support functions */
 
+/* predict the slew and settle times, in microseconds, to move from the
+ * current axis positions to the target described in tgt at np.
+ * targets that move are found where they will be when the slew ends.
+ * return 0 if ok, else -1 with a reason in why[].
+ */
+static int slewPredict(Now *np, char *tgt, long *slewusp, long *settleusp, char why[])
+{
+    MotorInfo *mips[NMOT];
+    double from[NMOT], to[NMOT];
+    double a, b, ha, dec, lst;
+    double *top[NMOT];
+    MotorInfo *mip;
+    Now now = *np;
+    int isra = 0;
+    int i, n;
+
+    if (sscanf(tgt, "RA:%lf Dec:%lf", &a, &b) == 2)
+    {
+        isra = 1;
+        dec = b;
+    }
+    else if (sscanf(tgt, "HA:%lf Dec:%lf", &a, &b) == 2)
+    {
+        ha = a;
+        dec = b;
+    }
+    else if (sscanf(tgt, "Alt:%lf Az:%lf", &a, &b) == 2)
+        aa_hadec(lat, a, b, &ha, &dec);
+    else
+    {
+        sprintf(why, "Unrecognized target: %.64s", tgt);
+        return (-1);
+    }
+
+    top[TEL_HM] = &to[TEL_HM];
+    top[TEL_DM] = &to[TEL_DM];
+    top[TEL_RM] = &to[TEL_RM];
+
+    /* an RA target moves in HA during the slew so find it where it will be
+     * once we get there. one refinement is plenty at sidereal rates.
+     */
+    *slewusp = 0;
+    for (n = 0; n < (isra ? 2 : 1); n++)
+    {
+        if (isra)
+        {
+            now.n_mjd = np->n_mjd + *slewusp / (SPD * 1e6);
+            now_lst(&now, &lst);
+            ha = hrrad(lst) - a;
+            haRange(&ha);
+        }
+
+        /* same axis positions and wrap choice as a real slew would use */
+        hd2xyr(ha, dec, top[TEL_HM], top[TEL_DM], top[TEL_RM]);
+        i = 0;
+        FEM(mip)
+        {
+            int id = mip - telstatshmp->minfo;
+
+            if (!mip->have)
+                continue;
+            if (wrapLimits(mip, 1, top[id], why) < 0)
+                return (-1);
+            mips[i] = mip;
+            from[i] = mip->cpos;
+            to[i] = *top[id];
+            i++;
+        }
+
+        *slewusp = slewTimeUs(mips, from, to, i);
+    }
+
+    /* atTarget() insists on SETTLETIME on target, found at our poll rate */
+    *settleusp = (long)(SETTLETIME * 1e6) + telstatshmp->dt * 1000L;
+
+    return (0);
+}
+
 /* dig out a message with a db line in it.
  * may optionally be preceded by "dRA:x dDec:y #".
  * return 0 if ok, else -1.
@@ -855,54 +1232,162 @@ static int dbformat(char *msg, Obj *op, double *drap, double *ddecp)
 
 /* build and load an e/mtrack sequence for op.
  * time starts at np. it is ok to modify np->n_mjd.
- * N.B. we assume clocks have been set to 0
+ * if acquire, which trackObj1() asks only if ACQSCURVE, the sequence begins
+ *   with a jerk-limited S-curve from where each axis is now which merges into
+ *   the track, instead of leaving the node to jump at the first point and hunt.
+ *   the points are then closer together and the sequence only lasts long
+ *   enough to settle; the next refresh is a plain track. either way, set
+ *   trackdur to when the refresh is due.
+ * return 0 if loaded, else -1 if the S-curve would cross a limit, having
+ *   said why to Tel_Id and loaded nothing.
+ * N.B. we assume np is at hstrack; each node gets the profile in its own
+ *   time, see nodeTrack().
  */
-static void buildTrack(Now *np, Obj *op)
+static int buildTrack(Now *np, Obj *op, int acquire)
 {
-    double *x, *y, *r;
+    double *x, *y, *r, *p;
     double *xyr[NMOT];
-    double mjd0;
+    double off[NMOT];
+    double mjd0, tacq;
+    double cpu0 = cpuSecs();
+    double t0 = latNow();
     MotorInfo *mip;
+    char why[128];
+    int ivalms;
     int i;
 
+    TRACE_BEGIN("buildTrack");
+
     /* malloc each then store so we can effectively access them via a mip */
     x = (double *)malloc(PPTRACK * sizeof(double));
     y = (double *)malloc(PPTRACK * sizeof(double));
     r = (double *)malloc(PPTRACK * sizeof(double));
+    p = (double *)malloc(PPTRACK * sizeof(double));
     xyr[TEL_HM] = x;
     xyr[TEL_DM] = y;
     xyr[TEL_RM] = r;
 
-    /* build list of PPTRACK values beginning at mjd */
+    /* find how far each axis is from the start of the track and the time
+     * the slowest needs to get there.
+     */
     mjd0 = mjd;
+    tacq = 0;
+    if (acquire)
+    {
+        findAxes(np, op, &x[0], &y[0], &r[0]);
+        (void)chkLimits(1, &x[0], &y[0], &r[0]);
+        FEM(mip)
+        {
+            int m = mip - telstatshmp->minfo;
+            double t;
+
+            off[m] = mip->have ? mip->cpos - xyr[m][0] : 0.0;
+            t = scurveMoveTime(off[m], ACQDERATE * mip->maxvel, ACQDERATE * mip->maxacc, maxjerk[m]);
+            if (t > tacq)
+                tacq = t;
+        }
+    }
+
+    /* spread the points to cover the S-curve with room to settle, keeping
+     * two spare intervals beyond the refresh.
+     */
+    if (acquire)
+    {
+        trackdur = tacq + ACQTAIL;
+        ivalms = (int)ceil(1000.0 * trackdur / (PPTRACK - 3));
+        tdlog("Acquiring: S-curve %.1f secs, %d ms steps", tacq, ivalms);
+    }
+    else
+    {
+        trackdur = TRACKINT;
+        ivalms = (int)(1000.0 * TRACKINT / PPTRACK + 0.5);
+    }
+
+    /* build list of PPTRACK values beginning at mjd. the nodes go straight
+     * between points, which strays from a path that curves quickly such as
+     * a satellite's, so a plain track is shortened until the worst stray is
+     * within TRACKSAG, and is refreshed that much sooner, again with two
+     * spare intervals. sidereal paths are well within it as they are.
+     */
+    while (1)
+    {
+        double sag;
+
+        for (i = 0; i < PPTRACK; i++)
+        {
+            mjd = mjd0 + i * ivalms / 1000.0 / SPD;
+            findAxes(np, op, &x[i], &y[i], &r[i]);
+        }
+        if (acquire || ivalms <= MINIVALMS || (sag = trackSag(xyr)) <= TRACKSAG)
+            break;
+        ivalms = (int)(ivalms * 0.9 * sqrt(TRACKSAG / sag));
+        if (ivalms < MINIVALMS)
+            ivalms = MINIVALMS;
+        trackdur = ivalms * (PPTRACK - 3) / 1000.0;
+    }
+
+    /* only the points to be sent are held to the limits */
     for (i = 0; i < PPTRACK; i++)
     {
-        mjd = mjd0 + i * TRACKINT / (PPTRACK * SPD);
-        findAxes(np, op, &x[i], &y[i], &r[i]);
+        double t = i * ivalms / 1000.0;
+
         (void)chkLimits(1, &x[i], &y[i], &r[i]); /* let limit protect */
+
+        /* add what remains of each axis' S-curve, which must stay within
+         * limits just as a slew must. no wrapping: that would be a jump.
+         */
+        if (acquire)
+        {
+            FEM(mip)
+            {
+                int m = mip - telstatshmp->minfo;
+                int code;
+
+                if (!mip->have)
+                    continue;
+                xyr[m][i] += off[m] + scurveMovePos(-off[m], ACQDERATE * mip->maxvel, ACQDERATE * mip->maxacc,
+                                                    maxjerk[m], t);
+                code = wrapLimits(mip, 0, &xyr[m][i], why);
+                if (code < 0)
+                {
+                    fifoWrite(Tel_Id, code, "Acquiring: %s", why);
+                    free((void *)x);
+                    free((void *)y);
+                    free((void *)r);
+                    free((void *)p);
+                    TRACE_END("buildTrack");
+                    return (-1);
+                }
+            }
+        }
     }
 
     /* send to each controller */
     FEM(mip)
     {
         double scale;
-        double *xyrp;
+        int start;
         int cfd;
 
         if (!mip->have)
             continue;
 
+        /* start now by this node's clock */
+        start = (int)floor(clk_node(mip, hstrack) + 0.5);
+        nodeTrack(mip, xyr[mip - telstatshmp->minfo], start, ivalms, p);
+
         if (virtual_mode)
         {
 
-            xyrp = xyr[mip - telstatshmp->minfo];
+            /* virmc positions are raw, as for vmcSetTargetPosition() */
+            for (i = 0; i < PPTRACK; i++)
+                p[i] *= mip->sign;
             //	    tdlog ("Creating track profile:");
-            vmcSetTrackPath(mip->axis, PPTRACK, 0, 1000.0 * TRACKINT / PPTRACK + 0.5, xyrp);
+            vmcSetTrackPath(mip->axis, PPTRACK, start, ivalms, p);
         }
         else
         {
 
-            xyrp = xyr[mip - telstatshmp->minfo];
             cfd = MIPCFD(mip);
             //	    tdlog ("Creating track profile:");
             if (mip->haveenc)
@@ -917,14 +1402,14 @@ static void buildTrack(Now *np, Obj *op)
                 csi_w(cfd, "mtrack");
                 //		printf ("mtrack");
             }
-            csi_w(cfd, "(0,%.0f", 1000. * TRACKINT / PPTRACK + .5);
-            //	    printf ("(0,%.0f", 1000.*TRACKINT/PPTRACK+.5);
+            csi_w(cfd, "(%d,%d", start, ivalms);
+            //	    printf ("(%d,%d", start, ivalms);
 
             /* TODO: pack into longer commands */
             for (i = 0; i < PPTRACK; i++)
             {
-                csi_w(cfd, ",%.0f", scale * xyrp[i] + .5);
-                //		printf (",%.0f", scale*xyrp[i]+.5);
+                csi_w(cfd, ",%.0f", scale * p[i] + .5);
+                //		printf (",%.0f", scale*p[i]+.5);
             }
             csi_w(cfd, ");");
             //	    printf (");\n");
@@ -937,30 +1422,77 @@ static void buildTrack(Now *np, Obj *op)
     free((void *)x);
     free((void *)y);
     free((void *)r);
+    free((void *)p);
+
+    nbuilds++;
+    buildsecs += cpuSecs() - cpu0;
+    latRecord(LAT_BUILD, latNow() - t0);
+
+    TRACE_END("buildTrack");
+    return (0);
+}
+
+/* report how many track profiles this core has built and the cpu secs spent
+ * building them.
+ */
+void tel_trackstats(int *nbuildsp, double *secsp)
+{
+    *nbuildsp = nbuilds;
+    *secsp = buildsecs;
+}
+
+/* return cpu secs used so far by the calling thread */
+static double cpuSecs()
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        return (0.0);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
 }
 
-/* if first or TRACKINT has expired and needs refreshed compute and load a new
- *   tracking profile.
+/* if first or trackdur has expired and needs refreshed compute and load a new
+ *   tracking profile. if first it begins by acquiring op, see buildTrack().
  * also always handle jogginf, limit checks, telstat info, whether on track.
  * return -1 when tracking is just not possible, 0 when ok to keep trying.
  */
 static int trackObj(Obj *op, int first)
+{
+    int r;
+
+    TRACE_BEGIN("trackObj");
+    r = trackObj1(op, first);
+    TRACE_END("trackObj");
+
+    return (r);
+}
+
+/* the work of trackObj() */
+static int trackObj1(Obj *op, int first)
 {
     Now *np = &telstatshmp->now; /* pointer to live one */
     Now now = telstatshmp->now;  /* stable and changeable copy */
     double ra, dec, lst, ha;
     double x, y, r;
     int clocknow;
+    int newtrack;
     MotorInfo *mip;
 
     /* download tracking profile if new or expired */
-    if (first || mjd > strack + TRACKINT / SPD)
-    {
-        /* sync all clocks to 0 */
-        /* N.B. use MIPSFD to insure precedes main loop clock reads */
+    newtrack = first || mjd > strack + trackdur / SPD;
+    if (newtrack)
+    {
+        /* a new target syncs all clocks to 0. so does each refresh unless
+         * CLOCKKEEP, when their models carry them instead, see clockmodel.c;
+         * that needs firmware which takes an e/mtrack starting other than
+         * at 0, not yet confirmed on the nodes.
+         * N.B. use MIPSFD to insure precedes main loop clock reads
+         */
         FEM(mip)
         {
-            if (mip->have)
+            if (!mip->have)
+                continue;
+            if (first || !CLOCKKEEP)
             {
                 if (virtual_mode)
                 {
@@ -970,31 +1502,23 @@ static int trackObj(Obj *op, int first)
                 {
                     csi_w(MIPSFD(mip), "clock=0;");
                 }
+                clk_zero(mip);
             }
+            else if (readClock(mip, &clocknow) < 0)
+                return (-1);
         }
 
-        /* record when this TRACKINT began */
+        /* record when this track began */
         strack = now.n_mjd;
-
-        /* set all timeouts to TRACKINT */
-        FEM(mip)
-        {
-            if (mip->have)
-            {
-                if (virtual_mode)
-                {
-                    vmcSetTimeout(mip->axis, TRACKINT * 1000);
-                }
-                else
-                {
-                    csi_w(MIPSFD(mip), "timeout=%d;", TRACKINT * 1000);
-                }
-            }
-        }
+        hstrack = clk_now();
 
         /* if just starting, reset any lingering track offset */
         if (first)
         {
+            sacquire = now.n_mjd;
+            trackop = op;
+            h_toffset = d_toffset = 0;
+            resumeoffset = 0;
             FEM(mip)
             {
                 if (mip->have)
@@ -1021,21 +1545,36 @@ static int trackObj(Obj *op, int first)
         }
 
         /* now build and install tracking profiles */
-        buildTrack(&now, op);
+        if (buildTrack(&now, op, first && ACQSCURVE) < 0)
+        {
+            active_func = NULL;
+            stopTel(0);
+            return (-1);
+        }
+
+        /* set all timeouts to when it needs refreshed */
+        FEM(mip)
+        {
+            if (mip->have)
+            {
+                if (virtual_mode)
+                {
+                    vmcSetTimeout(mip->axis, (int)(trackdur * 1000));
+                }
+                else
+                {
+                    csi_w(MIPSFD(mip), "timeout=%d;", (int)(trackdur * 1000));
+                }
+            }
+        }
     }
 
     /* quick, get current value of typical clock.
      * use this to compute desired to avoid host computer time jitter
      */
     mip = HMOT->have ? HMOT : DMOT; /* surely we have one ! */
-    if (virtual_mode)
-    {
-        clocknow = vmcGetClock(mip->axis);
-    }
-    else
-    {
-        clocknow = csi_rix(MIPSFD(mip), "=clock;");
-    }
+    if (readClock(mip, &clocknow) < 0)
+        return (-1);
 
     /* update actual position info */
     readRaw();
@@ -1049,21 +1588,34 @@ static int trackObj(Obj *op, int first)
     }
 
     /* find desired topocentric apparent place and axes @ clocknow */
-    now.n_mjd = strack + clocknow / (SPD * 1000.);
-    x = fabs(mjd - now.n_mjd) * SPD;
-    if (x > MAXJITTER)
-    {
-        fifoWrite(Tel_Id, -5, "Motion controller clock drift exceeds %g sec: %g", MAXJITTER, x);
-        fifoWrite(Tel_Id, -5, "clocknow=%d. strack=%g", clocknow, strack);
-        stopTel(0);
-        return (-1);
-    }
+    now.n_mjd = strack + (clk_host(mip, clocknow) - hstrack) / SPD;
     findAxes(&now, op, &x, &y, &r);
     if (chkLimits(1, &x, &y, &r) < 0)
     {
         stopTel(0);
         return (-1);
     }
+
+    /* look ahead along the track for the next limit for each new target,
+     * or when its offsets change. the walk runs a few samples each poll
+     * between refreshes; until it is done tlimit is only how far it has got.
+     */
+    if (newtrack && (first || r_offset != limwalk.roff || d_offset != limwalk.doff))
+    {
+        double start[NMOT];
+
+        start[TEL_HM] = x;
+        start[TEL_DM] = y;
+        start[TEL_RM] = r;
+        limBegin(&now, op, r_offset, d_offset, start, LIMHORIZON);
+    }
+    else if (!newtrack)
+        (void)limStep(LIMPERPOLL);
+    telstatshmp->tlimit = limwalk.tlo - (now.n_mjd - limwalk.now.n_mjd) * SPD;
+    if (telstatshmp->tlimit < 0)
+        telstatshmp->tlimit = 0;
+    telstatshmp->limaxis = limwalk.done ? limwalk.axis : -1;
+
     telstatshmp->Dalt = op->s_alt;
     telstatshmp->Daz = op->s_az;
     telstatshmp->DARA = ra = op->s_ra;
@@ -1083,12 +1635,21 @@ static int trackObj(Obj *op, int first)
     switch (telstatshmp->telstate)
     {
     case TS_HUNTING:
-        if (atTarget() == 0)
+        if (atTarget() == 0 && focusDone())
         {
+            tdlog("Acquired in %.1f secs", (mjd - sacquire) * SPD);
+            latRecord(LAT_ACQUIRE, (mjd - sacquire) * SPD);
             fifoWrite(Tel_Id, 3, "All axes have tracking lock");
             fifoWrite(Tel_Id, 0, "Now tracking");
             telstatshmp->telstate = TS_TRACKING;
             telstatshmp->telstateidx++;
+
+            /* put back an offset from before a restart */
+            if (resumeoffset)
+            {
+                offsetTracking(0, h_toffset, d_toffset, 0);
+                resumeoffset = 0;
+            }
         }
         break;
     case TS_TRACKING:
@@ -1108,16 +1669,132 @@ static int trackObj(Obj *op, int first)
     return (0);
 }
 
+/* if msg ends with " Focus:<microns>", remove it and return 1 with the
+ * microns in *micronsp, else return 0.
+ */
+static int focusSuffix(char *msg, double *micronsp)
+{
+    char *fp = strstr(msg, " Focus:");
+
+    if (!fp)
+        return (0);
+    *micronsp = atof(fp + 7);
+    *fp = '\0';
+    return (1);
+}
+
+/* return 1 if msg, less any focus, is a target tel_msg() would slew to */
+static int isTarget(char *msg)
+{
+    double a, b, c;
+    Obj o;
+
+    return (sscanf(msg, "RA:%lf Dec:%lf Epoch:%lf", &a, &b, &c) == 3 || sscanf(msg, "RA:%lf Dec:%lf", &a, &b) == 2 ||
+            dbformat(msg, &o, &a, &b) == 0 || sscanf(msg, "Alt:%lf Az:%lf", &a, &b) == 2 ||
+            sscanf(msg, "HA:%lf Dec:%lf", &a, &b) == 2);
+}
+
+/* called just after starting a new target. if it came with a focus position,
+ * have focus.c start there now too, corrected for where the target is, and
+ * hold off saying we have arrived until it is done as well.
+ */
+static void focusAlong(int have, double microns)
+{
+    focuswait = have && active_func && focus_goto(microns, telstatshmp->Dalt) == 0;
+}
+
+/* return 1 unless still waiting for a focus move brought by the target */
+static int focusDone()
+{
+    if (focuswait && focus_busy())
+        return (0);
+    focuswait = 0;
+    return (1);
+}
+
+/* read mip's node clock into *clockp, refining its model.
+ * if it has strayed from the model by more than MAXJITTER, such as after the
+ *   node was reset behind our back, stop and return -1, else return 0.
+ */
+static int readClock(MotorInfo *mip, int *clockp)
+{
+    double e;
+
+    *clockp = clk_read(mip, &e);
+    if (fabs(e) > MAXJITTER * 1000)
+    {
+        fifoWrite(Tel_Id, -5, "Motion controller clock drift exceeds %g sec: %g", MAXJITTER, e / 1000);
+        fifoWrite(Tel_Id, -5, "Node %d clock=%d. strack=%g", mip->axis, *clockp, strack);
+        stopTel(0);
+        return (-1);
+    }
+    return (0);
+}
+
+/* v[] holds PPTRACK positions every ivalms of host time from hstrack.
+ * fill out[] with where to be as mip's node clock reads start, start+ivalms,
+ *   etc, by interpolating v[] at those times according to the clock model.
+ */
+static void nodeTrack(MotorInfo *mip, double v[], int start, int ivalms, double out[])
+{
+    int i;
+
+    for (i = 0; i < PPTRACK; i++)
+    {
+        double u = (clk_host(mip, start + (double)i * ivalms) - hstrack) * 1000.0 / ivalms;
+        int j = (int)floor(u);
+
+        if (j < 0)
+            j = 0;
+        if (j > PPTRACK - 2)
+            j = PPTRACK - 2;
+        out[i] = v[j] + (v[j + 1] - v[j]) * (u - j);
+    }
+}
+
+/* return the most any axis in xyr[] strays, in rads, from its path as it
+ * goes straight between points, estimated from the second differences.
+ */
+static double trackSag(double *xyr[])
+{
+    MotorInfo *mip;
+    double sag = 0;
+    int i;
+
+    FEM(mip)
+    {
+        double *v = xyr[mip - telstatshmp->minfo];
+
+        if (!mip->have)
+            continue;
+        for (i = 1; i < PPTRACK - 1; i++)
+        {
+            double d = delra(v[i - 1] - 2 * v[i] + v[i + 1]) / 8;
+
+            if (d > sag)
+                sag = d;
+        }
+    }
+
+    return (sag);
+}
+
 /* compute axes for op at np, including fixed schedule offsets if any.
  * return 0 if ok, -1 if exceeds limits
  * N.B. o_type of *op may be different upon return.
  */
 static void findAxes(Now *np, Obj *op, double *xp, double *yp, double *rp)
+{
+    findAxesOffset(np, op, r_offset, d_offset, xp, yp, rp);
+}
+
+/* as findAxes() but with the given ra and dec offsets, rads */
+static void findAxesOffset(Now *np, Obj *op, double roff, double doff, double *xp, double *yp, double *rp)
 {
     double ha, dec;
     Obj fobj;
 
-    if (r_offset || d_offset)
+    if (roff || doff)
     {
         /* find offsets to op as a fixed object */
         double ra, dec;
@@ -1128,8 +1805,8 @@ static void findAxes(Now *np, Obj *op, double *xp, double *yp, double *rp)
         dec = op->s_dec;
 
         /* apply offsets */
-        ra += r_offset;
-        dec += d_offset;
+        ra += roff;
+        dec += doff;
 
         op = &fobj;
         op->o_type = FIXED;
@@ -1144,6 +1821,145 @@ static void findAxes(Now *np, Obj *op, double *xp, double *yp, double *rp)
     hd2xyr(ha, dec, xp, yp, rp);
 }
 
+/* find how many secs after np op may be tracked continuously from the axis
+ * positions start[] before any axis reaches a limit, looking no further than
+ * horizon. the trajectory is sampled every LIMSTEP, unwrapped as the axes
+ * really move, then the first crossing is bisected down to LIMRES.
+ * set *axisp to the index of the offending axis, or -1 if none by horizon.
+ * N.B. this is the whole walk at once, and uses limwalk to do it.
+ */
+static double timeToLimit(Now *np, Obj *op, double roff, double doff, double start[], double horizon, int *axisp)
+{
+    LimWalk save = limwalk;
+    double t;
+
+    limBegin(np, op, roff, doff, start, horizon);
+    while (!limStep(1000))
+        continue;
+    *axisp = limwalk.axis;
+    t = limwalk.tlo;
+
+    limwalk = save;
+    return (t);
+}
+
+/* begin a look-ahead in limwalk for op from np, see timeToLimit().
+ * N.B. op itself is not modified.
+ */
+static void limBegin(Now *np, Obj *op, double roff, double doff, double start[], double horizon)
+{
+    LimWalk *lp = &limwalk;
+
+    lp->now = *np;
+    lp->o = *op;
+    lp->roff = roff;
+    lp->doff = doff;
+    lp->horizon = horizon;
+    memcpy(lp->prev, start, sizeof(lp->prev));
+    lp->tlo = lp->thi = 0;
+    lp->bisect = 0;
+
+    /* maybe no room even now */
+    lp->axis = beyondLimit(&lp->now, &lp->o, roff, doff, -1.0, lp->prev, lp->v);
+    lp->done = lp->axis >= 0;
+}
+
+/* take up to n more samples of the look-ahead in limwalk.
+ * return 1 if it is done, else 0.
+ */
+static int limStep(int n)
+{
+    LimWalk *lp = &limwalk;
+
+    while (!lp->done && n-- > 0)
+    {
+        double t;
+        int a;
+
+        if (!lp->bisect)
+        {
+            /* step along until something is beyond */
+            t = lp->tlo + LIMSTEP;
+            lp->thi = t > lp->horizon ? lp->horizon : t;
+            a = beyondLimit(&lp->now, &lp->o, lp->roff, lp->doff, lp->thi, lp->prev, lp->v);
+            if (a >= 0)
+            {
+                lp->axis = a;
+                lp->bisect = 1;
+            }
+            else
+            {
+                memcpy(lp->prev, lp->v, sizeof(lp->prev));
+                lp->tlo = lp->thi;
+                lp->done = lp->tlo >= lp->horizon;
+            }
+        }
+        else
+        {
+            /* bisect, unwrapping from the last good positions */
+            t = (lp->tlo + lp->thi) / 2;
+            a = beyondLimit(&lp->now, &lp->o, lp->roff, lp->doff, t, lp->prev, lp->v);
+            if (a >= 0)
+            {
+                lp->thi = t;
+                lp->axis = a;
+            }
+            else
+            {
+                lp->tlo = t;
+                memcpy(lp->prev, lp->v, sizeof(lp->prev));
+            }
+        }
+
+        if (lp->bisect && lp->thi - lp->tlo <= LIMRES)
+            lp->done = 1;
+    }
+
+    return (lp->done);
+}
+
+/* forget any look-ahead, as when tracking ends */
+static void limClear()
+{
+    memset(&limwalk, 0, sizeof(limwalk));
+    limwalk.axis = -1;
+    limwalk.done = 1;
+    telstatshmp->tlimit = 0;
+    telstatshmp->limaxis = -1;
+}
+
+/* find the axis positions v[] for op t secs after np, each unwrapped to be
+ * nearest prev[]. if t < 0 just check prev[].
+ * return the index of the first axis beyond its limits, else -1.
+ */
+static int beyondLimit(Now *np, Obj *op, double roff, double doff, double t, double prev[], double v[])
+{
+    MotorInfo *mip;
+
+    if (t < 0)
+        memcpy(v, prev, NMOT * sizeof(double));
+    else
+    {
+        Now now = *np;
+
+        now.n_mjd += t / SPD;
+        findAxesOffset(&now, op, roff, doff, &v[TEL_HM], &v[TEL_DM], &v[TEL_RM]);
+    }
+
+    FEM(mip)
+    {
+        int m = mip - telstatshmp->minfo;
+
+        if (!mip->have)
+            continue;
+        v[m] -= 2 * PI * floor((v[m] - prev[m]) / (2 * PI) + 0.5);
+        if (v[m] <= mip->neglim || v[m] >= mip->poslim)
+            return (m);
+    }
+
+    return (-1);
+}
+
 /* convert an ha/dec to scope x/y/r, allowing for mesh corrections.
  * in many ways, this is the reverse of mkCook().
  */
@@ -1207,6 +2023,8 @@ static void mkCook()
     double mdha, mddec;
     double x, y, r;
 
+    TRACE_BEGIN("mkCook");
+
     /* handy axis values */
     x = HMOT->cpos;
     y = DMOT->cpos;
@@ -1251,6 +2069,8 @@ static void mkCook()
     /* find position angle */
     tel_hadec2PA(ha, dec, tap, lat, &r);
     telstatshmp->CPA = r;
+
+    TRACE_END("mkCook");
 }
 
 /* read the raw values */
@@ -1258,6 +2078,8 @@ static void readRaw()
 {
     MotorInfo *mip;
 
+    TRACE_BEGIN("readRaw");
+
     FEM(mip)
     {
         if (!mip->have)
@@ -1288,6 +2110,8 @@ static void readRaw()
             }
         }
     }
+
+    TRACE_END("readRaw");
 }
 
 /* issue a stop to all telescope axes */
@@ -1317,6 +2141,8 @@ static void stopTel(int fast)
 
     telstatshmp->jogging_ison = 0;
     telstatshmp->telstate = TS_STOPPED; /* well, soon anyway */
+    limClear();
+    focuswait = 0; /* any target's focus move no longer holds anything up */
     telstatshmp->telstateidx++;
 }
 
@@ -1354,11 +2180,11 @@ static int onTarget(MotorInfo **mipp)
  */
 static int atTarget()
 {
-    static double mjd0;
+    static THREADLOCAL double mjd0;
     Now *np = &telstatshmp->now;
     MotorInfo *mip;
 
-    static double last_delmax = 0;
+    static THREADLOCAL double last_delmax = 0;
     double delpos, delmax = 0;
 
     FEM(mip)
@@ -1386,7 +2212,7 @@ static int atTarget()
     }
 
     /* if get here, all axes are within ACQUIREACC this time
-     * but still doesn't count until/unless it stays on for a second.
+     * but still doesn't count until/unless it stays on for SETTLETIME.
      */
     if (!mjd0)
     {
@@ -1394,7 +2220,7 @@ static int atTarget()
         last_delmax = delmax;
         return (-1);
     }
-    if (mjd >= mjd0 + 1. / SPD)
+    if (mjd >= mjd0 + SETTLETIME / SPD)
     {
         tdlog("Hunt %f %f", fabs(last_delmax - delmax) * 3600 * 180 / PI, ACQUIREDELT * 3600 * 180 / PI);
         if (fabs(last_delmax - delmax) > ACQUIREDELT)
@@ -1418,8 +2244,8 @@ static int chkLimits(int wrapok, double *xp, double *yp, double *rp)
 {
     double *valp[NMOT];
     MotorInfo *mip;
-    char str[64];
-    double poslim, neglim, alt, az;
+    char why[128];
+    int code;
 
     /* store so we can effectively access them via a mip */
     valp[TEL_HM] = xp;
@@ -1428,50 +2254,67 @@ static int chkLimits(int wrapok, double *xp, double *yp, double *rp)
 
     FEM(mip)
     {
-        double *vp = valp[mip - telstatshmp->minfo];
-        double v = *vp;
-
         if (!mip->have)
             continue;
 
-        poslim = mip->poslim;
-        neglim = mip->neglim;
-
-        while (v <= neglim)
+        code = wrapLimits(mip, wrapok, valp[mip - telstatshmp->minfo], why);
+        if (code < 0)
         {
-            if (!wrapok)
-            {
-                fs_sexa(str, raddeg(v), 4, 3600);
-                fifoWrite(Tel_Id, -2, "Axis %d: %s hits negative limit", mip->axis, str);
-                return (-1);
-            }
-            v += 2 * PI;
+            fifoWrite(Tel_Id, code, "%s", why);
+            return (-1);
         }
+    }
+
+    /* if get here, all ok */
+    return (0);
+}
+
+/* check one canonical axis value for being beyond the hardware limit of mip,
+ * wrapping whole revolutions if wrapok.
+ * return 0 if ok with *vp possibly updated, else the Tel_Id error code for
+ * the problem with a description in why[].
+ */
+static int wrapLimits(MotorInfo *mip, int wrapok, double *vp, char why[])
+{
+    double v = *vp;
+    double poslim, neglim;
+    char str[64];
+
+    poslim = mip->poslim;
+    neglim = mip->neglim;
 
-        while (v >= poslim)
+    while (v <= neglim)
+    {
+        if (!wrapok)
         {
-            if (!wrapok)
-            {
-                fs_sexa(str, raddeg(v), 4, 3600);
-                fifoWrite(Tel_Id, -3, "Axis %d: %s hits positive limit", mip->axis, str);
-                return (-1);
-            }
-            v -= 2 * PI;
+            fs_sexa(str, raddeg(v), 4, 3600);
+            sprintf(why, "Axis %d: %s hits negative limit", mip->axis, str);
+            return (-2);
         }
+        v += 2 * PI;
+    }
 
-        /* double-check */
-        if (v <= neglim || v >= poslim)
+    while (v >= poslim)
+    {
+        if (!wrapok)
         {
             fs_sexa(str, raddeg(v), 4, 3600);
-            fifoWrite(Tel_Id, -4, "Axis %d: %s trapped within limits gap", mip->axis, str);
-            return (-1);
+            sprintf(why, "Axis %d: %s hits positive limit", mip->axis, str);
+            return (-3);
         }
+        v -= 2 * PI;
+    }
 
-        /* pass back possibly updated */
-        *vp = v;
+    /* double-check */
+    if (v <= neglim || v >= poslim)
+    {
+        fs_sexa(str, raddeg(v), 4, 3600);
+        sprintf(why, "Axis %d: %s trapped within limits gap", mip->axis, str);
+        return (-4);
     }
 
-    /* if get here, all ok */
+    /* pass back possibly updated */
+    *vp = v;
     return (0);
 }
 
@@ -1665,10 +2508,13 @@ static void jogSlew(int first, char dircode)
     else
     {
         csi_w(MIPCFD(mip), "clock=0;");
+        clk_zero(mip);
         csi_w(MIPCFD(mip), "timeout=300000;");
         csi_w(MIPCFD(mip), "mtvel=%d;", CVELStp(mip));
     }
     telstatshmp->telstate = TS_SLEWING;
+    limClear();
+    focuswait = 0;
     telstatshmp->telstateidx++;
     fifoWrite(Tel_Id, 5, "Paddle command %s", msg);
     telstatshmp->jogging_ison = 1;
@@ -1708,6 +2554,8 @@ static void offsetTracking(int first, double harcsecs, double darcsecs, int repo
 
     // Turn on jogging ... this produces the offset and also serves as a flag that we have done this
     telstatshmp->jogging_ison = 1;
+    h_toffset = harcsecs;
+    d_toffset = darcsecs;
 
     if (report)
         fifoWrite(Tel_Id, 0, "Tracking offset by %3.3f x %3.3f arcseconds (%ld x %ld steps)", harcsecs, darcsecs,
@@ -1720,19 +2568,19 @@ static void initCfg()
 #define NTDCFG (sizeof(tdcfg) / sizeof(tdcfg[0]))
 #define NHCFG (sizeof(hcfg) / sizeof(hcfg[0]))
 
-    static double HMAXVEL, HMAXACC, HSLIMACC, HDAMP, HTRENCWT;
-    static int HHAVE, HAXIS, HENCHOME, HPOSSIDE, HHOMELOW, HESTEP, HESIGN;
+    static THREADLOCAL double HMAXVEL, HMAXACC, HSLIMACC, HDAMP, HTRENCWT;
+    static THREADLOCAL int HHAVE, HAXIS, HENCHOME, HPOSSIDE, HHOMELOW, HESTEP, HESIGN;
 
-    static double DMAXVEL, DMAXACC, DSLIMACC, DDAMP, DTRENCWT;
-    static int DHAVE, DAXIS, DENCHOME, DPOSSIDE, DHOMELOW, DESTEP, DESIGN;
+    static THREADLOCAL double DMAXVEL, DMAXACC, DSLIMACC, DDAMP, DTRENCWT;
+    static THREADLOCAL int DHAVE, DAXIS, DENCHOME, DPOSSIDE, DHOMELOW, DESTEP, DESIGN;
 
-    static double RMAXVEL, RMAXACC, RSLIMACC, RDAMP;
-    static int RHAVE, RAXIS, RHASLIM, RPOSSIDE, RHOMELOW, RSTEP, RSIGN;
+    static THREADLOCAL double RMAXVEL, RMAXACC, RSLIMACC, RDAMP;
+    static THREADLOCAL int RHAVE, RAXIS, RHASLIM, RPOSSIDE, RHOMELOW, RSTEP, RSIGN;
 
-    static int GERMEQ;
-    static int ZENFLIP;
+    static THREADLOCAL int GERMEQ;
+    static THREADLOCAL int ZENFLIP;
 
-    static CfgEntry tdcfg[] = {
+    CfgEntry tdcfg[] = {
         {"HHAVE", CFG_INT, &HHAVE},
         {"HAXIS", CFG_INT, &HAXIS},
         {"HHOMELOW", CFG_INT, &HHOMELOW},
@@ -1774,11 +2622,11 @@ static void initCfg()
         {"CGUIDEVEL", CFG_DBL, &CGUIDEVEL},
     };
 
-    static double HT, DT, XP, YC, NP, R0;
-    static double HPOSLIM, HNEGLIM, DPOSLIM, DNEGLIM, RNEGLIM, RPOSLIM;
-    static int HSTEP, HSIGN, DSTEP, DSIGN;
+    static THREADLOCAL double HT, DT, XP, YC, NP, R0;
+    static THREADLOCAL double HPOSLIM, HNEGLIM, DPOSLIM, DNEGLIM, RNEGLIM, RPOSLIM;
+    static THREADLOCAL int HSTEP, HSIGN, DSTEP, DSIGN;
 
-    static CfgEntry hcfg[] = {
+    CfgEntry hcfg[] = {
         {"HT", CFG_DBL, &HT},
         {"DT", CFG_DBL, &DT},
         {"XP", CFG_DBL, &XP},
@@ -1799,11 +2647,29 @@ static void initCfg()
         {"DSIGN", CFG_INT, &DSIGN},
     };
 
-    static int LARGEXP;
-    static CfgEntry hcfg2[] = {
+    static THREADLOCAL int LARGEXP;
+    CfgEntry hcfg2[] = {
         {"LARGEXP", CFG_INT, &LARGEXP},
     };
 
+    /* optional; 0 means take JERKRAMP secs to reach MAXACC */
+    static THREADLOCAL double HMAXJERK, DMAXJERK, RMAXJERK;
+    CfgEntry jcfg[] = {
+        {"HMAXJERK", CFG_DBL, &HMAXJERK},
+        {"DMAXJERK", CFG_DBL, &DMAXJERK},
+        {"RMAXJERK", CFG_DBL, &RMAXJERK},
+    };
+
+    /* optional; 0 zeroes node clocks at every track refresh, as always */
+    CfgEntry kcfg[] = {
+        {"CLOCKKEEP", CFG_INT, &CLOCKKEEP},
+    };
+
+    /* optional; 0 acquires with a plain track, 1 with the S-curve */
+    CfgEntry acfg[] = {
+        {"ACQSCURVE", CFG_INT, &ACQSCURVE},
+    };
+
     MotorInfo *mip;
     TelAxes *tap;
     int n;
@@ -1831,6 +2697,18 @@ static void initCfg()
         XP += (PI / 2);
     }
 
+    HMAXJERK = DMAXJERK = RMAXJERK = 0;
+    (void)readCfgFile(1, tdcfn, jcfg, sizeof(jcfg) / sizeof(jcfg[0]));
+    maxjerk[TEL_HM] = HMAXJERK > 0 ? HMAXJERK : HMAXACC / JERKRAMP;
+    maxjerk[TEL_DM] = DMAXJERK > 0 ? DMAXJERK : DMAXACC / JERKRAMP;
+    maxjerk[TEL_RM] = RMAXJERK > 0 ? RMAXJERK : RMAXACC / JERKRAMP;
+
+    CLOCKKEEP = 0;
+    (void)readCfgFile(1, tdcfn, kcfg, 1);
+
+    ACQSCURVE = 0;
+    (void)readCfgFile(1, tdcfn, acfg, 1);
+
     /* misc checks */
     if (TRACKINT <= 0)
     {
@@ -2030,6 +2908,47 @@ static int checkAxes()
     return (nbad > 0 ? -1 : 0);
 }
 
+/* fill *tp with what tel_resumeTrack() needs to carry on tracking the
+ * current target after a restart.
+ */
+void tel_getTrack(TelTrack *tp)
+{
+    int ts = telstatshmp->telstate;
+
+    memset((void *)tp, 0, sizeof(*tp));
+    tp->tracking = trackop && (active_func == tel_radecep || active_func == tel_radeceod || active_func == tel_op) &&
+                   (ts == TS_HUNTING || ts == TS_TRACKING);
+    if (!tp->tracking)
+        return;
+
+    tp->o = *trackop;
+    tp->r_offset = r_offset;
+    tp->d_offset = d_offset;
+    tp->h_toffset = h_toffset;
+    tp->d_toffset = d_toffset;
+    tp->strack = strack;
+    tp->trackdur = trackdur;
+}
+
+/* start tracking again as recorded by tel_getTrack(), acquiring from
+ * wherever the axes are now. any Offset is put back once acquired.
+ */
+void tel_resumeTrack(TelTrack *tp)
+{
+    Obj o = tp->o;
+
+    if (!tp->tracking)
+        return;
+
+    tel_op(1, &o, tp->r_offset, tp->d_offset);
+    if (active_func == tel_op && (tp->h_toffset || tp->d_toffset))
+    {
+        h_toffset = tp->h_toffset;
+        d_toffset = tp->d_toffset;
+        resumeoffset = 1;
+    }
+}
+
 int tel_ishomed(void)
 {
     MotorInfo *mip;
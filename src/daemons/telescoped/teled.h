@@ -7,6 +7,17 @@ typedef enum
     Focus_Id
 } FifoId;
 
+/* tracking kept across a restart, see tel_getTrack() */
+typedef struct
+{
+    int tracking;                 /* set if the rest is valid */
+    Obj o;                        /* target being tracked */
+    double r_offset, d_offset;    /* offsets applied to it, rads */
+    double h_toffset, d_toffset;  /* last Offset command, arcsecs */
+    double strack;                /* mjd current track segment began */
+    double trackdur;              /* secs it was built to run */
+} TelTrack;
+
 /* CSIMC info */
 typedef struct
 {
@@ -24,8 +35,12 @@ extern int axisLimitCheck(MotorInfo *mip, char msgbuf[]);
 extern int axisMotionCheck(MotorInfo *mip, char msgbuf[]);
 extern int axisHomedCheck(MotorInfo *mip, char msgbuf[]);
 
+/* checkpoint.c */
+extern int ckpt_resume(void);
+extern void ckpt_save(int force);
+
 /* csimc.c */
-extern CSIMCInfo csii[NNODES];
+extern THREADLOCAL CSIMCInfo csii[NNODES];
 extern void csiInit(void);
 extern void csiDrain(int fd);
 extern void csiSetup(MotorInfo *mip);
@@ -36,7 +51,7 @@ extern int csiOpen(int addr);
 extern int csiClose(int addr);
 extern int csiIsReady(int fd);
 
-/* fifoio.c */
+/* fifoio.c, or telsim */
 extern void fifoWrite(FifoId f, int code, char *fmt, ...);
 extern void init_fifos(void);
 extern void chk_fifos(void);
@@ -44,19 +59,38 @@ extern void close_fifos(void);
 
 /* focus.c */
 extern void focus_msg(char *msg);
+extern int focus_goto(double microns, double alt);
+extern int focus_busy(void);
 
 /* mountcor.c */
 extern void init_mount_cor(void);
+extern int reload_mount_cor(char why[]);
 extern void tel_mount_cor(double ha, double dec, double *dhap, double *ddecp);
 
+/* record.c */
+extern void rec_init(char *progname, double hours);
+extern void rec_poll(void);
+extern void rec_cmd(char *fifo, char *msg);
+extern void rec_close(void);
+
 /* tel.c */
 extern void tel_msg(char *msg);
+extern void tel_trackstats(int *nbuildsp, double *secsp);
+extern void tel_getTrack(TelTrack *tp);
+extern void tel_resumeTrack(TelTrack *tp);
+
+/* clockmodel.c */
+extern double clk_now(void);
+extern void clk_zero(MotorInfo *mip);
+extern int clk_read(MotorInfo *mip, double *errp);
+extern double clk_node(MotorInfo *mip, double h);
+extern double clk_host(MotorInfo *mip, double ms);
 
-/* telescoped.c */
-extern int DOSTOW;
-extern double STOWALT, STOWAZ, STOWTO;
-extern TelStatShm *telstatshmp;
-extern int virtual_mode;
+/* core.c */
+extern THREADLOCAL int DOSTOW;
+extern THREADLOCAL double STOWALT, STOWAZ, STOWTO;
+extern THREADLOCAL TelStatShm *telstatshmp;
+extern THREADLOCAL int virtual_mode;
 extern char tscfn[];
 extern char tdcfn[];
 extern char hcfn[];
@@ -64,5 +98,7 @@ extern char ocfn[];
 extern char dcfn[];
 extern void init_cfg(void);
 extern void allstop(void);
+
+/* telescoped.c, or telsim */
 extern void tdlog(char *fmt, ...);
 extern void die(void);
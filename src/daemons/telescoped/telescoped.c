@@ -38,40 +38,35 @@
 #include "circum.h"
 #include "configfile.h"
 #include "csimc.h"
+#include "latshm.h"
 #include "misc.h"
 #include "running.h"
 #include "strops.h"
 #include "telenv.h"
 #include "telstatshm.h"
+#include "trace.h"
 
 #include "teled.h"
 
-TelStatShm *telstatshmp; /* shared telescope info */
-int virtual_mode;        /* non-zero for virtual mode enabled */
-
-char tscfn[] = "archive/config/telsched.cfg";
-char tdcfn[] = "archive/config/telescoped.cfg";
-char hcfn[] = "archive/config/home.cfg";
-char ocfn[] = "archive/config/focus.cfg";
-
 static void usage(void);
 static void init_all(void);
 static void allreset(void);
 static void init_shm(void);
 static void init_tz(void);
 static void on_sig(int fake);
+static void on_tracesig(int signo);
 static void main_loop(void);
 
 static char logdir[] = "archive/logs";
 static char *progname;
-
-// Global values read from config
-int DOSTOW;
-double STOWALT, STOWAZ, STOWTO;
+static int coldstart; /* set to ignore any checkpoint */
 
 int main(ac, av) int ac;
 char *av[];
 {
+    double rate = 1, mjd0 = 0;
+    double stall = 0;
+    double rechours = -1;
     char *str;
 
     progname = basenm(av[0]);
@@ -87,6 +82,33 @@ char *av[];
             case 'v': /* same thing, but mnemonic to new name */
                 virtual_mode = 1;
                 break;
+            case 'c': /* ignore any checkpoint */
+                coldstart = 1;
+                break;
+            case 't': /* simulated clock rate */
+                if (ac < 2)
+                    usage();
+                rate = atof(*++av);
+                ac--;
+                break;
+            case 'j': /* simulated clock start */
+                if (ac < 2)
+                    usage();
+                mjd0 = atof(*++av);
+                ac--;
+                break;
+            case 'T': /* trace from the start, dump on stalls */
+                if (ac < 2)
+                    usage();
+                stall = atof(*++av);
+                ac--;
+                break;
+            case 'R': /* record every poll */
+                if (ac < 2)
+                    usage();
+                rechours = atof(*++av);
+                ac--;
+                break;
             default:
                 usage();
                 break;
@@ -97,6 +119,16 @@ char *av[];
     if (ac > 0)
         usage();
 
+    /* only simulated motors can keep up with simulated time */
+    if ((rate != 1 || mjd0 != 0) && !virtual_mode)
+    {
+        fprintf(stderr, "%s: -t and -j require -v\n", progname);
+        exit(1);
+    }
+    if (rate < 0)
+        usage();
+    vclockInit(rate, mjd0);
+
     /* only ever one */
     if (lock_running(progname) < 0)
     {
@@ -104,9 +136,24 @@ char *av[];
         exit(0);
     }
 
+    /* log from here on without waiting on the disk */
+    if (logRingInit(0) < 0)
+        tdlog("Can not start log ring, logging synchronously");
+
+    /* trace spans from the start if asked */
+    if (stall > 0)
+    {
+        traceStall(stall);
+        traceEnable(1);
+    }
+
     /* init all subsystems once */
     init_all();
 
+    /* record from the first poll if asked */
+    if (rechours >= 0)
+        rec_init(progname, rechours);
+
     /* go */
     main_loop();
 
@@ -116,6 +163,8 @@ char *av[];
 
 /* write a log message to stdout with a time stamp.
  * N.B. if fmt doesn't end with \n we add it.
+ * unless the clock is simulated the message goes by way of the log ring so
+ * the tracking path does not wait on formatting or the disk.
  */
 void tdlog(char *fmt, ...)
 {
@@ -123,8 +172,17 @@ void tdlog(char *fmt, ...)
     va_list ap;
     int l;
 
+    if (vclockIsWall())
+    {
+        va_start(ap, fmt);
+        l = logRingV(fmt, ap);
+        va_end(ap);
+        if (l == 0)
+            return;
+    }
+
     /* start with time stamp */
-    l = sprintf(buf, "%s: ", timestamp(time(NULL)));
+    l = sprintf(buf, "%s: ", timestamp((time_t)floor((vclockMJD() - 25567.5) * SPD)));
 
     /* format the message */
     va_start(ap, fmt);
@@ -148,62 +206,22 @@ void die()
 {
     tdlog("die()!");
     allstop();
+    ckpt_save(1);
+    rec_close();
     close_fifos();
     unlock_running(progname, 0);
     exit(0);
 }
 
-/* tell everybody to stop */
-void allstop()
-{
-    tel_msg("Stop");
-    focus_msg("Stop");
-}
-
-/* read the config files for variables we use here */
-void init_cfg()
-{
-#define NTSCFG (sizeof(tscfg) / sizeof(tscfg[0]))
-    static double LONGITUDE, LATITUDE, TEMPERATURE, PRESSURE, ELEVATION;
-    static CfgEntry tscfg[] = {
-        {"DOSTOW", CFG_INT, &DOSTOW},
-        {"STOWTO", CFG_DBL, &STOWTO},
-        {"STOWALT", CFG_DBL, &STOWALT},
-        {"STOWAZ", CFG_DBL, &STOWAZ},
-        {"LONGITUDE", CFG_DBL, &LONGITUDE},
-        {"LATITUDE", CFG_DBL, &LATITUDE},
-        {"TEMPERATURE", CFG_DBL, &TEMPERATURE},
-        {"PRESSURE", CFG_DBL, &PRESSURE},
-        {"ELEVATION", CFG_DBL, &ELEVATION},
-    };
-
-    Now *np = &telstatshmp->now;
-    int n;
-
-    n = readCfgFile(1, tscfn, tscfg, NTSCFG);
-    if (n != NTSCFG)
-    {
-        cfgFileError(tscfn, n, (CfgPrFp)tdlog, tscfg, NTSCFG);
-        // Don't die...	    die();
-    }
-
-    /* convert seconds to days */
-    STOWTO /= SPD;
-
-    /* basic defaults if no GPS or weather station */
-    lng = -LONGITUDE;        /* we want rads +E */
-    lat = LATITUDE;          /* we want rads +N */
-    temp = TEMPERATURE;      /* we want degrees C */
-    pressure = PRESSURE;     /* we want mB */
-    elev = ELEVATION / ERAD; /* we want earth radii*/
-
-#undef NTSCFG
-}
-
 static void main_loop()
 {
     while (1)
+    {
         chk_fifos();
+        rec_poll();
+        ckpt_save(0);
+        traceCheck(progname);
+    }
 }
 
 /* tell everybody to reset */
@@ -219,6 +237,12 @@ static void usage()
 {
     fprintf(stderr, "%s: [options]\n", progname);
     fprintf(stderr, " -v: (or -h) run in virtual mode w/o actual hardware attached.\n");
+    fprintf(stderr, " -c: cold start, ignoring any checkpoint left by a previous run.\n");
+    fprintf(stderr, " -t rate: with -v, run the clock rate times real time, 0 as fast as possible.\n");
+    fprintf(stderr, " -j mjd: with -v, start the clock at the given MJD, as in telstatshm.\n");
+    fprintf(stderr, " -T ms: trace spans from the start; dump the trace if a poll takes longer than ms.\n");
+    fprintf(stderr, " -R hours: record state at every poll in %s, starting a new file every hours, 0 never.\n", logdir);
+    fprintf(stderr, "SIGUSR1 starts or stops tracing; SIGUSR2 dumps it to %s.\n", logdir);
     exit(1);
 }
 
@@ -246,6 +270,8 @@ static void init_all()
     signal(SIGINT, on_sig);
     signal(SIGTERM, on_sig);
     signal(SIGHUP, on_sig);
+    signal(SIGUSR1, on_tracesig);
+    signal(SIGUSR2, on_tracesig);
 
     /* don't get signal if write to fifo fails */
     signal(SIGPIPE, SIG_IGN);
@@ -255,6 +281,13 @@ static void init_all()
 
     /* initialize config files and hardware subsystem  */
     allreset();
+
+    /* carry on from before a restart if we can */
+    if (!coldstart)
+        (void)ckpt_resume();
+
+    /* tell rund, and so whoever is waiting on it */
+    ready_running();
 }
 
 /* create the telstatshmp shared memory segment */
@@ -293,12 +326,16 @@ static void init_shm()
 
     /* store the PID of this process */
     telstatshmp->telescoped_pid = getpid();
+
+    /* latency histograms alongside, but we can do without them */
+    if (latInit() < 0)
+        tdlog("Can not create latency shm: %s", strerror(errno));
 }
 
 static void init_tz()
 {
     Now *np = &telstatshmp->now;
-    time_t t = time(NULL);
+    time_t t = (time_t)floor((vclockMJD() - 25567.5) * SPD);
     struct tm *gtmp, *ltmp;
     double gmkt, lmkt;
 
@@ -318,3 +355,12 @@ static void on_sig(int signo)
     tdlog("Received signal %d", signo);
     die();
 }
+
+/* SIGUSR1 toggles tracing, SIGUSR2 asks main_loop() for a dump */
+static void on_tracesig(int signo)
+{
+    if (signo == SIGUSR1)
+        traceEnable(!traceOn);
+    else
+        traceRequestDump();
+}
@@ -9,17 +9,35 @@
     Simulated node is a motor, no encoder, any number of motor steps
     positive sign
 
+    Motion is evaluated in closed form as a function of node time, so
+    where a node is does not depend on how often it is serviced:
+    moves follow a trapezoidal velocity profile, jogs ramp to speed,
+    and tracking follows the path exactly once any initial error has
+    been made up with a trapezoidal move. Stops are immediate.
+
+    N.B. this model is unvalidated against real axes: no recordings of
+    real motion exist to compare it with. it has no inertia, servo lag,
+    overshoot or backlash, so it can not stand in for the mount when
+    judging settling or tracking error. dynamics run on the real mount,
+    with -l to log every sample, gives the recordings to check it against.
+
     S. Ohmert June 21, 2001
 
 \********************************************/
 
-#include "virmc.h"
-#include <ctype.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "misc.h"
+
+#include "virmc.h"
+
 #define TRACE_ON 0
 #if TRACE_ON
 #define TRACE fprintf(stderr,
@@ -35,24 +53,22 @@ void TRACE_EAT(char *fmt, ...)
 
 // local functions
 static long oGetTime(VCNodePtr pvc);
-static int oTrackProgram(VCNodePtr pvc);
-static void oMoveToTarget(VCNodePtr pvc);
+static int oTrapezoid(VCNodePtr pvc, double dist, double t, double *posp, double *velp);
+static void oJogRamp(VCNodePtr pvc, double t, double *posp, double *velp);
+static int oTrackPath(VCNodePtr pvc, long ms, double *posp, double *velp);
+static void oTrackError(VCNodePtr pvc);
 static void oMotorGo(VCNodePtr pvc);
 static void oResetEdgeLatch(VCNodePtr pvc, char edgeBits);
-static char *oReadcmd(char *str);
-static long oGetParm(char *str, int num);
-static int oIsCmd(char *str, char *cmd);
 
 // local variables
-static int everBeenInit = 0; // a sanity "been init at least once" flag
-static VCNode vmcNode[NVNODES];
+static THREADLOCAL int everBeenInit = 0; // a sanity "been init at least once" flag
+static THREADLOCAL VCNode vmcNode[NVNODES];
 typedef void (*ActFunc)(int);
-static ActFunc active_func[NVNODES];
+static THREADLOCAL ActFunc active_func[NVNODES];
 
 // Main service loop.  This is called at each iteration of tel_poll
-// If we are tracking, vmcTrackProgram is executed to keep target current
-// vmcMoveToTarget handles acceleration
-// vmcGo moves us there
+// oMotorGo brings the position up to date with the node clock and
+// latches any switches passed since last time
 void vmcService(int node)
 {
     VCNodePtr pvc;
@@ -66,15 +82,6 @@ void vmcService(int node)
 
     //		TRACE "vmcService %d. Tracking = %d\n",node,pvc->tracking);
 
-    if (pvc->tracking)
-    {
-        oTrackProgram(pvc);
-    }
-    if (pvc->targetSet)
-    {
-        oMoveToTarget(pvc);
-    }
-
     oMotorGo(pvc);
 
     // run our background (script) process if we've set one up.
@@ -132,7 +139,7 @@ int vmcSetup(int node, double maxvelr, double maxaccr, long steps, int sign)
     }
 
     pvc->maxVel = maxvelr * scale;
-    //	pvc->maxAcc = maxaccr*scale;
+    pvc->maxAcc = maxaccr > 0 ? maxaccr * steps / (2 * PI) : 0;
     pvc->countsPerRev = steps;
     pvc->sign = sign;
 
@@ -151,7 +158,7 @@ void vmcSetTargetPosition(int node, long position)
     if (node == 2)
     TRACE "vmcSetTargetPosition %d\n",node);
 
-    while (abs(position) > pvc->countsPerRev)
+    while (labs(position) > pvc->countsPerRev)
     {
         if (position < 0)
         {
@@ -163,9 +170,18 @@ void vmcSetTargetPosition(int node, long position)
         }
     }
 
-    pvc->targetPos = position;
+    // take the shorter way around
+    pvc->segDist = position - pvc->currentPos;
+    if (fabs(pvc->segDist) > pvc->countsPerRev / 2)
+    {
+        if (pvc->segDist > 0)
+            pvc->segDist -= pvc->countsPerRev;
+        else
+            pvc->segDist += pvc->countsPerRev;
+    }
+
+    pvc->targetPos = pvc->currentPos + (long)pvc->segDist;
     pvc->targetSet = 1;
-    pvc->velocity = 0;
 }
 
 // Get the current speed
@@ -175,7 +191,13 @@ int vmcGetVelocity(int node)
 
     TRACE "vmcGetVelocity %d\n",node);
 
-    return pvc->velocity;
+    oMotorGo(pvc);
+
+    // still moving, however slowly, until the motion is complete
+    if (pvc->velocity > -1 && pvc->velocity < 1 && (pvc->targetSet || pvc->jogging))
+        return pvc->velocity < 0 ? -1 : 1;
+
+    return (int)pvc->velocity;
 }
 
 // Get the current position
@@ -197,7 +219,19 @@ void vmcResetClock(int node)
 
     TRACE "vmcResetClock %d\n",node);
 
-    ftime(&pvc->timeRef);
+    // keep any motion in progress going, relative to the new clock
+    if (pvc->timeRef)
+    {
+        long was;
+
+        oMotorGo(pvc);
+        was = oGetTime(pvc);
+        pvc->segTime -= was;
+        pvc->lastTime -= was;
+        pvc->trackStart -= was; // so the old path stays put until a new one comes
+    }
+
+    pvc->timeRef = vclockMJD();
 }
 
 // return milliseconds elapsed since last reset for this node
@@ -210,18 +244,10 @@ long vmcGetClock(int node)
     return oGetTime(pvc);
 }
 
+// milliseconds since last reset, by the same clock as telescoped
 static long oGetTime(VCNodePtr pvc)
 {
-    struct timeb now;
-    int dsec;
-    int dms;
-
-    ftime(&now);
-
-    dsec = now.time - pvc->timeRef.time;
-    dms = now.millitm - pvc->timeRef.millitm;
-
-    return dsec * 1000 + dms;
+    return (long)floor((vclockMJD() - pvc->timeRef) * SPD * 1000 + 0.5);
 }
 
 // Set the timeout value
@@ -241,9 +267,14 @@ void vmcSetTrackingOffset(int node, int offset)
 
     TRACE "vmcSetTrackingOffset %d %d\n",node, offset);
 
-    pvc->toffset = offset;
     if (pvc->tracking)
-        oTrackProgram(pvc);
+    {
+        oMotorGo(pvc);
+        pvc->toffset = offset;
+        oTrackError(pvc);
+    }
+    else
+        pvc->toffset = offset;
 }
 
 // Jog the motor a set amount
@@ -253,7 +284,16 @@ void vmcJog(int node, int amt)
 
     TRACE "vmcJog %d %d\n", node, amt);
 
-    pvc->velocity = amt;
+    oMotorGo(pvc);
+
+    // ramp from the current speed
+    pvc->segTime = pvc->lastTime;
+    pvc->segPos = pvc->currentPos;
+    pvc->segVel = pvc->velocity;
+    pvc->jogVel = (double)amt * pvc->sign;
+    absclamp(pvc->jogVel, pvc->maxVel);
+    pvc->clamped = pvc->jogVel != (double)amt * pvc->sign;
+    pvc->jogging = 1;
 
     pvc->tracking = 0; // definitely not tracking now
     pvc->targetSet = 0;
@@ -266,10 +306,18 @@ void vmcStop(int node)
 
     //	TRACE "vmcStop %d\n",node);
 
+    if (everBeenInit)
+        oMotorGo(pvc);
+
     pvc->velocity = 0;
     pvc->targetPos = pvc->currentPos;
     pvc->tracking = 0;
     pvc->targetSet = 0;
+    pvc->jogging = 0;
+    pvc->segTime = pvc->lastTime;
+    pvc->segPos = pvc->currentPos;
+    pvc->segVel = 0;
+    pvc->segDist = 0;
 }
 
 // Accept a list of idealized encoder positions for tracking
@@ -284,9 +332,7 @@ int vmcSetTrackPath(int node, int num, int startMs, int ivalMs, double *path)
 
     TRACE "vmcSetTrackPath %d, %d items at %d, %d apart\n",node,num,startMs,ivalMs);
 
-    pvc->lastPos = pvc->targetPos = pvc->currentPos;
-    pvc->velocity = 0;
-    pvc->lastTime = oGetTime(pvc);
+    oMotorGo(pvc);
 
     if (pvc->trackPath)
         free(pvc->trackPath); // free previous
@@ -307,8 +353,8 @@ int vmcSetTrackPath(int node, int num, int startMs, int ivalMs, double *path)
 
     pvc->tracking = 1;
     pvc->targetSet = 1;
-
-    pvc->targetPos = pvc->trackPath[0];
+    pvc->jogging = 0;
+    oTrackError(pvc);
 
     return 0;
 }
@@ -321,6 +367,18 @@ void vmcSetHome(int node)
     VCNodePtr pvc = &vmcNode[node];
     vmcStop(node);
     pvc->currentPos = pvc->lastPos = pvc->targetPos = pvc->homePos;
+    pvc->segPos = pvc->homePos;
+}
+
+//
+// Set the position counter, as a real node keeps it across a restart of telescoped
+//
+void vmcSetPosition(int node, long position)
+{
+    VCNodePtr pvc = &vmcNode[node];
+    vmcStop(node);
+    pvc->currentPos = pvc->lastPos = pvc->targetPos = position;
+    pvc->segPos = position;
 }
 
 ////////////////////////////////
@@ -329,93 +387,182 @@ void vmcSetHome(int node)
 //
 ////////////////////////////////
 
-// Track according to path set
-// return 0 for success
-static int oTrackProgram(VCNodePtr pvc)
+// Find where a rest-to-rest move of dist steps is t secs after it began,
+// accelerating at maxAcc up to maxVel then decelerating to a stop.
+// return 1 if the move is complete, else 0
+static int oTrapezoid(VCNodePtr pvc, double dist, double t, double *posp, double *velp)
 {
-    long now, span;
-    double p1, p2, rat;
-    int i;
+    double a = pvc->maxAcc;
+    double d = fabs(dist);
+    double s = dist < 0 ? -1 : 1;
+    double ta, tc, vpk, tt, r;
 
-    //	TRACE "oTrackProgram\n");
+    if (d == 0 || pvc->maxVel <= 0)
+    {
+        *posp = d == 0 ? dist : 0; // can not move at all without speed
+        *velp = 0;
+        return 1;
+    }
 
-    // Find where we're at in the list
-    now = oGetTime(pvc);
-    now += 100; // add some time for interpolation
+    // time to reach speed, time coasting, and that speed
+    if (a <= 0)
+    {
+        ta = 0;
+        vpk = pvc->maxVel;
+        tc = d / vpk;
+    }
+    else
+    {
+        ta = pvc->maxVel / a;
+        if (d < pvc->maxVel * ta)
+        {
+            ta = sqrt(d / a); // never reaches maxVel
+            tc = 0;
+        }
+        else
+            tc = d / pvc->maxVel - ta;
+        vpk = a * ta;
+        if (vpk > pvc->maxVel)
+            vpk = pvc->maxVel;
+    }
+    tt = 2 * ta + tc;
 
-    span = now - pvc->trackStart;
-    i = span / pvc->trackIval;
-    if (i >= pvc->numTrackPts - 1)
+    if (t >= tt)
     {
-        // we should have been refreshed by now...
-        // we're pretty much screwed.  Drop out of tracking.
-        TRACE "Out of track points... aborting tracking\n");
-        pvc->tracking = 0;
-        pvc->targetSet = 0;
-        pvc->velocity = 0;
-        return -1;
+        *posp = dist;
+        *velp = 0;
+        return 1;
     }
+    if (t < 0)
+        t = 0;
 
-    // we need two points to interpolate from
-    p1 = pvc->trackPath[i];
-    p2 = pvc->trackPath[i + 1];
+    if (t < ta)
+    {
+        *posp = s * 0.5 * a * t * t;
+        *velp = s * a * t;
+    }
+    else if (t < ta + tc)
+    {
+        *posp = s * (0.5 * a * ta * ta + vpk * (t - ta));
+        *velp = s * vpk;
+    }
+    else
+    {
+        r = tt - t;
+        *posp = s * (d - 0.5 * a * r * r);
+        *velp = s * a * r;
+    }
 
-    // how far past the ideal time for p1 are we?
+    return 0;
+}
 
-    span = now - pvc->trackIval * i;
+// Find how far a jog has gone t secs after it began, ramping from segVel
+// to jogVel at maxAcc then holding that speed.
+static void oJogRamp(VCNodePtr pvc, double t, double *posp, double *velp)
+{
+    double v0 = pvc->segVel;
+    double v1 = pvc->jogVel;
+    double a = v1 < v0 ? -pvc->maxAcc : pvc->maxAcc;
+    double tr = pvc->maxAcc > 0 ? (v1 - v0) / a : 0;
 
-    // and what ratio is that of our interval?
-    rat = (double)span / (double)pvc->trackIval;
+    if (t < tr)
+    {
+        *posp = v0 * t + 0.5 * a * t * t;
+        *velp = v0 + a * t;
+    }
+    else
+    {
+        *posp = v0 * tr + 0.5 * a * tr * tr + v1 * (t - tr);
+        *velp = v1;
+    }
+}
 
-    // so what is the relative ratio of the difference in position?
-    // add this to p1 to get where we should be now
-    p1 += (p2 - p1) * rat;
+// Find where the track path, plus any jog offset, is at node time ms.
+// return 0 if still within the path, else -1 and where it ends
+static int oTrackPath(VCNodePtr pvc, long ms, double *posp, double *velp)
+{
+    double span = (double)(ms - pvc->trackStart) / pvc->trackIval;
+    int i = (int)floor(span);
+    double p1, p2;
 
-    // okay -- let's move there.
-    pvc->targetPos = (long)(p1 + 0.5);
-    pvc->targetPos += pvc->toffset; // apply a jog offset if one in effect
-    pvc->targetSet = 1;
+    if (i >= pvc->numTrackPts - 1)
+    {
+        *posp = pvc->trackPath[pvc->numTrackPts - 1] + pvc->toffset;
+        *velp = 0;
+        return -1;
+    }
+    if (i < 0)
+        span = i = 0;
 
-    //	TRACE "Track point %d, pos = %ld\n",i,pvc->targetPos);
+    // interpolate between the two points either side
+    p1 = pvc->trackPath[i];
+    p2 = pvc->trackPath[i + 1];
+    *posp = p1 + (p2 - p1) * (span - i) + pvc->toffset;
+    *velp = (p2 - p1) * 1000.0 / pvc->trackIval;
 
     return 0;
 }
 
-// Move according to velocity
+// Start making up the difference between where we are and the track path.
+// N.B. call with the position up to date
+static void oTrackError(VCNodePtr pvc)
+{
+    double pos, vel;
+
+    oTrackPath(pvc, pvc->lastTime, &pos, &vel);
+    pvc->segTime = pvc->lastTime;
+    pvc->segPos = pvc->currentPos;
+    pvc->segVel = pvc->velocity;
+    pvc->segDist = pvc->currentPos - pos;
+}
+
+// Bring the position up to date with the node clock.
 // Check limit and home switches
 static void oMotorGo(VCNodePtr pvc)
 {
-    // Move according to current velocity and the increment of real time
-    int wantVel;
     long now = oGetTime(pvc);
-    long ival = now - pvc->lastTime;
-    long amt;
-
-    wantVel = pvc->velocity;
-    absclamp(pvc->velocity, pvc->maxVel);
-    if (pvc->velocity != wantVel)
-        pvc->clamped = 1;
-    else
-        pvc->clamped = 0;
-
-    amt = (ival * pvc->velocity) / 1000;
+    double t = (now - pvc->segTime) / 1000.0;
+    double pos, vel, epos, evel;
 
-    if (!amt && wantVel)
-        return; // not enough time has elapsed to do anything
-
-    pvc->currentPos += amt * pvc->sign;
-
-    // check the motion past switches and latch the bits
-    if (pvc->targetSet)
+    if (pvc->tracking && pvc->trackPath)
     {
-        // if we've gone past target, latch to target and stop
-        if ((pvc->lastPos <= pvc->targetPos && pvc->currentPos >= pvc->targetPos) ||
-            (pvc->lastPos >= pvc->targetPos && pvc->currentPos <= pvc->targetPos))
+        if (oTrackPath(pvc, now, &pos, &vel) < 0)
         {
-            pvc->currentPos = pvc->targetPos;
+            // we should have been refreshed by now...
+            // we're pretty much screwed.  Drop out of tracking.
+            TRACE "Out of track points... aborting tracking\n");
+            pvc->tracking = 0;
             pvc->targetSet = 0;
+            pvc->segPos = pos;
         }
+        else
+        {
+            // the error still to make up shrinks as a move toward the path
+            oTrapezoid(pvc, pvc->segDist, t, &epos, &evel);
+            pos += pvc->segDist - epos;
+            vel -= evel;
+        }
+        pvc->targetPos = (long)floor(pos + 0.5);
+    }
+    else if (pvc->targetSet)
+    {
+        if (oTrapezoid(pvc, pvc->segDist, t, &pos, &vel))
+            pvc->targetSet = 0;
+        pos += pvc->segPos;
     }
+    else if (pvc->jogging)
+    {
+        oJogRamp(pvc, t, &pos, &vel);
+        pos += pvc->segPos;
+    }
+    else
+    {
+        pos = pvc->currentPos;
+        vel = 0;
+    }
+
+    pvc->currentPos = (long)floor(pos + 0.5);
+    pvc->velocity = vel;
 
     if ((pvc->lastPos < pvc->homePos && pvc->currentPos >= pvc->homePos) ||
         (pvc->lastPos > pvc->homePos && pvc->currentPos <= pvc->homePos))
@@ -443,83 +590,17 @@ static void oResetEdgeLatch(VCNodePtr pvc, char edgeBits)
     pvc->iedge &= ~edgeBits;
 }
 
-// Move toward current target
-static void oMoveToTarget(VCNodePtr pvc)
-{
-    double amt = pvc->sign * (pvc->targetPos - pvc->currentPos);
-
-    if (abs(amt) > pvc->countsPerRev / 2)
-    {
-        if (amt > 0)
-            amt = -(pvc->countsPerRev - amt);
-        else
-            amt = pvc->countsPerRev + amt;
-    }
-
-    absclamp(amt, pvc->maxVel);
-    pvc->velocity = amt;
-
-    if (pvc == &vmcNode[2])
-    TRACE "oMoveToTarget: %ld ==> %ld  speed = %.2f\n",pvc->currentPos,pvc->targetPos,pvc->velocity);
-}
-
 // ---------------------------------------------------------------------------------
 //
 // Code that mimics the CSIMC interfaces... sort of
 //
 // ---------------------------------------------------------------------------------
 
-char vmcResponse[NVNODES][256];
-
-static char *oReadcmd(char *str)
-{
-    static char rtbuf[40];
-    char *p = rtbuf;
-
-    while (*str == '_' || isalnum(*str))
-    {
-        *p++ = *str++;
-    }
-    *p = 0;
-
-    //	TRACE "oReadCmd %s\n",rtbuf);
-    return rtbuf;
-}
-
-static long oGetParm(char *str, int num)
-{
-    int c;
-    long val;
-
-    while (*str && *str != '(')
-    {
-        str++;
-    }
-    str++;
-    for (c = 0; c < num; c++)
-    {
-        while (*str && *str != ',')
-        {
-            str++;
-        }
-        str++;
-    }
-    val = atol(str);
-    //	TRACE "oGetParm %d = (%ld) %s\n",num,val,str);
-    return val;
-}
-
-static int oIsCmd(char *str, char *cmd)
-{
-    return (0 == strcmp(cmd, oReadcmd(str)));
-}
+static THREADLOCAL char vmcResponse[NVNODES][256];
 
 // Write a command to the virtual controller
 void vmc_w(int node, char *string)
 {
-    VCNodePtr pvc = &vmcNode[node];
-    long val;
-
     TRACE "vmc_w (%d) : %s\n",node,string);
     sprintf(vmcResponse[node], "-1: Untrapped vmc command '%s' on node %d\n", string, node);
     active_func[node] = NULL;
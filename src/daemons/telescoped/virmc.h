@@ -3,8 +3,6 @@
 #ifndef VIRMC_H
 #define VIRMC_H
 
-#include <sys/timeb.h> // ftime
-
 #define mAbs(v) ((v) < 0 ? -(v) : (v))
 #define absclamp(v, m) (v = (mAbs(v) < (m) ? (v) : (v) < 0 ? -(m) : (m)))
 
@@ -34,13 +32,14 @@ typedef struct
     long lastTime;   // last time stamp
     double velocity; // current speed, steps per second, signed
 
-    int maxVel; // maximum speed, steps per second, unsigned
+    int maxVel;    // maximum speed, steps per second, unsigned
+    double maxAcc; // maximum acceleration, steps per second per second, 0 for instant
 
     int timeout; // timeout value... not used. Virtual motors never stall...
 
     char iedge; // triggered bits, like iedge of csimc
 
-    struct timeb timeRef; // a time reference used for millisecond clock
+    double timeRef;       // mjd reference used for millisecond clock
     double *trackPath;    // allocation for path points if tracking
     int numTrackPts;      // number of tracking points in path
     int trackStart;       // ms time this path starts at
@@ -49,8 +48,15 @@ typedef struct
 
     int targetSet; // 1 if we are actively pursuing a target
     int tracking;  // 1 if we are tracking, else 0
+    int jogging;   // 1 if we are jogging, else 0
     int clamped;   // 1 if we were clamped during last motion, else 0
 
+    long segTime;   // ms time the current motion began
+    double segPos;  // position when the current motion began
+    double segVel;  // speed when the current motion began
+    double segDist; // distance to move, or track error to make up
+    double jogVel;  // speed a jog is heading for
+
     long miscVal[4]; // misc values for passing
 
 } VCNode, *VCNodePtr;
@@ -69,6 +75,7 @@ extern void vmcJog(int node, int amt);
 extern void vmcStop(int node);
 extern int vmcSetTrackPath(int node, int num, int startMs, int ivalMs, double *path);
 extern void vmcSetHome(int node);
+extern void vmcSetPosition(int node, long position);
 
 extern int vmc_r(int node, char *buf, int length);
 extern void vmc_w(int node, char *buf);
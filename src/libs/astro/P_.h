@@ -8,3 +8,10 @@
 #define P_(s) ()
 #endif
 #endif /* P_ */
+
+/* storage class for caches and other state that must not be shared by
+ * threads, such as several telescopes simulated in one process.
+ */
+#ifndef THREADLOCAL
+#define THREADLOCAL __thread
+#endif
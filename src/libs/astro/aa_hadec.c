@@ -52,7 +52,7 @@ static void aaha_aux(lat, x, y, p, q) double lat;
 double x, y;
 double *p, *q;
 {
-    static double last_lat = -3434, slat, clat;
+    static THREADLOCAL double last_lat = -3434, slat, clat;
     double cap, B;
 
     if (lat != last_lat)
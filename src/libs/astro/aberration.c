@@ -47,10 +47,10 @@ void ab_eq(mjd, lsn, ra, dec) double mjd, lsn, *ra, *dec;
 static void ab_aux(mjd, x, y, lsn, mode) double mjd, *x, *y, lsn;
 int mode;
 {
-    static double lastmjd = -10000;
-    static double eexc;    /* earth orbit excentricity */
-    static double leperi;  /* ... and longitude of perihelion */
-    static char dirty = 1; /* flag for cached trig terms */
+    static THREADLOCAL double lastmjd = -10000;
+    static THREADLOCAL double eexc;    /* earth orbit excentricity */
+    static THREADLOCAL double leperi;  /* ... and longitude of perihelion */
+    static THREADLOCAL char dirty = 1; /* flag for cached trig terms */
 
     if (mjd != lastmjd)
     {
@@ -83,7 +83,7 @@ int mode;
     {
         double *ra = x, *dec = y;
         double sr, cr, sd, cd, sls, cls; /* trig values coords */
-        static double cp, sp, ce, se;    /* .. and perihel/eclipic */
+        static THREADLOCAL double cp, sp, ce, se;    /* .. and perihel/eclipic */
         double dra, ddec;                /* changes in ra and dec */
 
         if (dirty)
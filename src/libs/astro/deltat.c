@@ -167,8 +167,8 @@ double deltat(mjd) double mjd;
     int d[6];
     int i, iy, k;
     double floor();
-    static double ans;
-    static double lastmjd = -10000;
+    static THREADLOCAL double ans;
+    static THREADLOCAL double lastmjd = -10000;
 
     if (mjd == lastmjd)
     {
@@ -96,26 +96,26 @@ static void GetPrecession P_((double SemiMajorAxis, double Eccentricity, double
 #define SunSemiMajorAxis 149598845.0 /* Kilometers 		   */
 
 /*  Keplerian Elements and misc. data for the satellite              */
-static double EpochDay;         /* time of epoch                 */
-static double EpochMeanAnomaly; /* Mean Anomaly at epoch         */
-static long EpochOrbitNum;      /* Integer orbit # of epoch      */
-static double EpochRAAN;        /* RAAN at epoch                 */
-static double epochMeanMotion;  /* Revolutions/day               */
-static double OrbitalDecay;     /* Revolutions/day^2             */
-static double EpochArgPerigee;  /* argument of perigee at epoch  */
-static double Eccentricity;
-static double Inclination;
+static THREADLOCAL double EpochDay;         /* time of epoch                 */
+static THREADLOCAL double EpochMeanAnomaly; /* Mean Anomaly at epoch         */
+static THREADLOCAL long EpochOrbitNum;      /* Integer orbit # of epoch      */
+static THREADLOCAL double EpochRAAN;        /* RAAN at epoch                 */
+static THREADLOCAL double epochMeanMotion;  /* Revolutions/day               */
+static THREADLOCAL double OrbitalDecay;     /* Revolutions/day^2             */
+static THREADLOCAL double EpochArgPerigee;  /* argument of perigee at epoch  */
+static THREADLOCAL double Eccentricity;
+static THREADLOCAL double Inclination;
 
 /* Site Parameters */
-static double SiteLat, SiteLong, SiteAltitude;
+static THREADLOCAL double SiteLat, SiteLong, SiteAltitude;
 
-static double SidDay, SidReference; /* Date and sidereal time	*/
+static THREADLOCAL double SidDay, SidReference; /* Date and sidereal time	*/
 
 /* Keplerian elements for the sun */
-static double SunEpochTime, SunInclination, SunRAAN, SunEccentricity, SunArgPerigee, SunMeanAnomaly, SunMeanMotion;
+static THREADLOCAL double SunEpochTime, SunInclination, SunRAAN, SunEccentricity, SunArgPerigee, SunMeanAnomaly, SunMeanMotion;
 
 /* values for shadow geometry */
-static double SinPenumbra, CosPenumbra;
+static THREADLOCAL double SinPenumbra, CosPenumbra;
 
 /* given a Now and an Obj with info about an earth satellite in the es_* fields
  * fill in the s_* sky fields describing the satellite.
@@ -576,10 +576,10 @@ double *SiteX, *SiteY, *SiteZ, *SiteVX, *SiteVY;
 MAT3x3 SiteMatrix;
 
 {
-    static double G1, G2; /* Used to correct for flattening of the Earth */
-    static double CosLat, SinLat;
-    static double OldSiteLat = -100000; /* Used to avoid unneccesary recomputation */
-    static double OldSiteElevation = -100000;
+    static THREADLOCAL double G1, G2; /* Used to correct for flattening of the Earth */
+    static THREADLOCAL double CosLat, SinLat;
+    static THREADLOCAL double OldSiteLat = -100000; /* Used to avoid unneccesary recomputation */
+    static THREADLOCAL double OldSiteElevation = -100000;
     double Lat;
     double SiteRA; /* Right Ascension of site			*/
     double CosRA, SinRA;
@@ -40,8 +40,8 @@ double mjd;
 double x, y;   /* sw==1: x==ra, y==dec.  sw==-1: x==lng, y==lat. */
 double *p, *q; /* sw==1: p==lng, q==lat. sw==-1: p==ra, q==dec. */
 {
-    static double lastmjd = -10000; /* last mjd calculated */
-    static double seps, ceps;       /* sin and cos of mean obliquity */
+    static THREADLOCAL double lastmjd = -10000; /* last mjd calculated */
+    static THREADLOCAL double seps, ceps;       /* sin and cos of mean obliquity */
     double sx, cx, sy, cy, ty;
 
     if (mjd != lastmjd)
@@ -16,9 +16,9 @@ static void galeq_init P_((void));
 static double an = degrad(32.93192);   /* G lng of asc node on equator */
 static double gpr = degrad(192.85948); /* RA of North Gal Pole, 2000 */
 static double gpd = degrad(27.12825);  /* Dec of  " */
-static double cgpd, sgpd;              /* cos() and sin() of gpd */
-static double mjd2000;                 /* mjd of 2000 */
-static int before;                     /* whether these have been set yet */
+static THREADLOCAL double cgpd, sgpd;              /* cos() and sin() of gpd */
+static THREADLOCAL double mjd2000;                 /* mjd of 2000 */
+static THREADLOCAL int before;                     /* whether these have been set yet */
 
 /* given ra and dec, each in radians, for the given epoch, find the
  * corresponding galactic latitude, *lat, and longititude, *lng, also each in
@@ -61,8 +61,8 @@ static double JD2000 = 2451545.0;
 /* Conversion factors between degrees and radians */
 static double STR = 4.8481368110953599359e-6; /* radians per arc second */
 
-static double ss[14][24];
-static double cc[14][24];
+static THREADLOCAL double ss[14][24];
+static THREADLOCAL double cc[14][24];
 
 /* Reduce arc seconds modulo 360 degrees,
    answer in arc seconds.  */
@@ -110,8 +110,8 @@ int n;
 /* Mean elements.
    Copied from cmoon.c, DE404 version.  */
 
-static double Jlast = -1.0e38;
-static double T;
+static THREADLOCAL double Jlast = -1.0e38;
+static THREADLOCAL double T;
 
 static int dargs(J, plan) double J;
 struct plantbl *plan;
@@ -125,7 +125,7 @@ char *obj_description(op) Obj *op;
 void now_lst(np, lstp) Now *np;
 double *lstp;
 {
-    static double last_mjd = -23243, last_lng = 121212, last_lst;
+    static THREADLOCAL double last_mjd = -23243, last_lng = 121212, last_lst;
     double eps, lst, deps, dpsi;
 
     if (last_mjd == mjd && last_lng == lng)
@@ -356,7 +356,9 @@ double *cap, *Bp;
     else
     {
         /* compute cB and sB and remove common factor of sa from quotient.
-         * be careful where B causes atan to blow.
+         * atan2 copes with x near 0, and must be left to: when c is small y
+         * is too, so a band where x is merely small is a real span of A, in
+         * which B would stick. only where both vanish is B undefined.
          */
         double sA = sin(A);
         double x, y;
@@ -364,8 +366,8 @@ double *cap, *Bp;
         y = sA * sb * sc;
         x = cb - ca * cc;
 
-        if (fabs(x) < 1e-5)
-            B = y < 0 ? 3 * PI / 2 : PI / 2;
+        if (x == 0 && y == 0)
+            B = PI / 2;
         else
             B = atan2(y, x);
     }
@@ -14,8 +14,8 @@ void cal_mjd(mn, dy, yr, mjd) int mn, yr;
 double dy;
 double *mjd;
 {
-    static double last_mjd, last_dy;
-    static int last_mn, last_yr;
+    static THREADLOCAL double last_mjd, last_dy;
+    static THREADLOCAL int last_mn, last_yr;
     int b, d, m, y;
     long c;
 
@@ -64,8 +64,8 @@ void mjd_cal(mjd, mn, dy, yr) double mjd;
 int *mn, *yr;
 double *dy;
 {
-    static double last_mjd, last_dy;
-    static int last_mn, last_yr;
+    static THREADLOCAL double last_mjd, last_dy;
+    static THREADLOCAL int last_mn, last_yr;
     double d, f;
     double i, a, b, ce, g;
 
@@ -185,7 +185,7 @@ double *dy;
 void mjd_year(mjd, yr) double mjd;
 double *yr;
 {
-    static double last_mjd, last_yr;
+    static THREADLOCAL double last_mjd, last_yr;
     int m, y;
     double d;
     double e0, e1; /* mjd of start of this year, start of next year */
@@ -99,18 +99,18 @@ static int gecmoon P_((double J, struct plantbl *lrtab, struct plantbl *lattab,
 #define MOSHIER_BEGIN (1221000.5 - MJD0) /* directly from above */
 #define MOSHIER_END (2798525.5 - MJD0)   /* 2950.0; from libration table */
 
-static double Args[NARGS];
-static double LP_equinox;
-static double NF_arcsec;
-static double Ea_arcsec;
-static double pA_precession;
+static THREADLOCAL double Args[NARGS];
+static THREADLOCAL double LP_equinox;
+static THREADLOCAL double NF_arcsec;
+static THREADLOCAL double Ea_arcsec;
+static THREADLOCAL double pA_precession;
 
 /* This storage ought to be allocated dynamically.  */
 double ss[NARGS][30];
 double cc[NARGS][30];
 
 /* Time, in units of 10,000 Julian years from JED 2451545.0.  */
-static double T;
+static THREADLOCAL double T;
 
 /* Conversion factors between degrees and radians */
 #define DTR 1.7453292519943295769e-2
@@ -90,11 +90,11 @@ void nutation(mjd, deps, dpsi) double mjd;
 double *deps; /* on input:  precision parameter in arc seconds */
 double *dpsi;
 {
-    static double lastmjd = -10000, lastdeps, lastdpsi;
+    static THREADLOCAL double lastmjd = -10000, lastdeps, lastdpsi;
     double T, T2, T3, T10; /* jul cent since J2000 */
     double prec;           /* series precis in arc sec */
     int i, isecul;         /* index in term table */
-    static double delcache[5][2 * NUT_MAXMUL + 1];
+    static THREADLOCAL double delcache[5][2 * NUT_MAXMUL + 1];
     /* cache for multiples of delaunay args
      * [M',M,F,D,Om][-min*x, .. , 0, .., max*x]
      * make static to have unfilled fields cleared on init
@@ -187,8 +187,8 @@ double *dpsi;
  */
 void nut_eq(mjd, ra, dec) double mjd, *ra, *dec;
 {
-    static double lastmjd = -10000;
-    static double a[3][3]; /* rotation matrix */
+    static THREADLOCAL double lastmjd = -10000;
+    static THREADLOCAL double a[3][3]; /* rotation matrix */
     double xold, yold, zold, x, y, z;
 
     if (mjd != lastmjd)
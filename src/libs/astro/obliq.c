@@ -11,7 +11,7 @@
 void obliquity(mjd, eps) double mjd;
 double *eps;
 {
-    static double lastmjd = -16347, lasteps;
+    static THREADLOCAL double lastmjd = -16347, lasteps;
 
     if (mjd != lastmjd)
     {
@@ -14,7 +14,7 @@
 void ta_par(tha, tdec, phi, ht, rho, aha, adec) double tha, tdec, phi, ht, *rho;
 double *aha, *adec;
 {
-    static double last_phi = 1000.0, last_ht = -1000.0, xobs, zobs;
+    static THREADLOCAL double last_phi = 1000.0, last_ht = -1000.0, xobs, zobs;
     double x, y, z; /* obj cartesian coord, in Earth radii */
 
     /* avoid calcs involving the same phi and ht */
@@ -179,9 +179,9 @@ void plans(mjd, p, lpd0, psi0, rp0, rho0, lam, bet, dia, mag) double mjd;
 int p;
 double *lpd0, *psi0, *rp0, *rho0, *lam, *bet, *dia, *mag;
 {
-    static double lastmjd = -10000;
-    static double lsn, bsn, rsn; /* geometric geocentric coords of sun */
-    static double xsn, ysn, zsn;
+    static THREADLOCAL double lastmjd = -10000;
+    static THREADLOCAL double lsn, bsn, rsn; /* geometric geocentric coords of sun */
+    static THREADLOCAL double xsn, ysn, zsn;
     double lp, bp, rp;      /* heliocentric coords of planet */
     double xp, yp, zp, rho; /* rect. coords and geocentric dist. */
     double dt;              /* light time */
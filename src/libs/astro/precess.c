@@ -39,8 +39,8 @@ double *ra, *dec;                                    /* ra/dec for mjd1 in, for
 static void precess_hiprec(mjd1, mjd2, ra, dec) double mjd1, mjd2; /* initial and final epoch modified JDs */
 double *ra, *dec;                                                  /* ra/dec for mjd1 in, for mjd2 out */
 {
-    static double last_mjd1 = -213.432, last_from;
-    static double last_mjd2 = -213.432, last_to;
+    static THREADLOCAL double last_mjd1 = -213.432, last_from;
+    static THREADLOCAL double last_mjd2 = -213.432, last_to;
     double zeta_A, z_A, theta_A;
     double T;
     double A, B, C;
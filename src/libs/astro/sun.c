@@ -18,7 +18,7 @@
 void sunpos(mjd, lsn, rsn, bsn) double mjd;
 double *lsn, *rsn, *bsn;
 {
-    static double last_mjd = -3691, last_lsn, last_rsn, last_bsn;
+    static THREADLOCAL double last_mjd = -3691, last_lsn, last_rsn, last_bsn;
     double ret[6];
 
     if (mjd == last_mjd)
@@ -11,8 +11,8 @@ void utc_gst(mjd, utc, gst) double mjd;
 double utc;
 double *gst;
 {
-    static double lastmjd = -18981;
-    static double t0;
+    static THREADLOCAL double lastmjd = -18981;
+    static THREADLOCAL double t0;
 
     if (mjd != lastmjd)
     {
@@ -31,8 +31,8 @@ void gst_utc(mjd, gst, utc) double mjd;
 double gst;
 double *utc;
 {
-    static double lastmjd = -10000;
-    static double t0;
+    static THREADLOCAL double lastmjd = -10000;
+    static THREADLOCAL double t0;
 
     if (mjd != lastmjd)
     {
@@ -0,0 +1,480 @@
+/* find best focus from (position, fwhm) samples, proposing each next sample
+ * so as to get there in few moves.
+ *
+ * the V curve of a star's fwhm against focus position is close to the
+ * hyperbola fwhm^2 = fmin^2 + (slope (x - best))^2, which is a parabola in
+ * fwhm^2, so it is fit by weighted linear least squares. fwhm errors are
+ * taken to be a like fraction of the fwhm. with enough samples the fit is
+ * repeated with Tukey biweights from the residuals so a frame spoilt by a
+ * cloud or a guiding glitch does not drag it off.
+ *
+ * until the fit has a minimum with samples on either side of it the search
+ * walks downhill, by the fit if it has a minimum or a step if not. once it
+ * is bracketed it steps out until both arms rise clear of the bottom, then
+ * each sample goes where it best pins down the centre: at the knee of the
+ * hyperbola, fmin/slope from best, on whichever arm has fewer. the search is
+ * done when the uncertainty of best from the fit is below tol.
+ *
+ * the samples may come from anywhere; this knows nothing of the focuser. see
+ * focus_auto() in telescoped for one that drives it.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "autofocus.h"
+
+#define AFMINROBUST 5  /* fewest samples to bother reweighting */
+#define AFNROBUST 5    /* reweighting passes */
+#define AFTUKEY 4.685  /* Tukey biweight cutoff, in robust sigmas */
+#define AFMINSCALE .01 /* least fractional fwhm error we believe */
+#define AFMINDONE 6    /* fewest samples before deciding best */
+#define AFMINARM 2     /* fewest samples on each arm before deciding best */
+#define AFRISE 1.3     /* each arm must reach this times the least fwhm */
+#define AFREACH 3.0    /* furthest to go beyond the samples, steps */
+#define AFHUGE 1e30    /* err when unknown */
+
+static int fitOnce(AutoFocus *afp, double xc, double p[3], double cov[3][3], double *sp);
+static double model(double p[3], double u);
+static int solve3(double a[3][3], double b[3]);
+static double median(double v[], int n);
+static int cmpDouble(const void *a, const void *b);
+static int sampledNear(AutoFocus *afp, double x);
+
+/* start a new search from start, sampling step apart at first, to find best
+ * focus to within tol without going outside [min, max] or taking more than
+ * maxsamp samples.
+ */
+void afInit(AutoFocus *afp, double start, double step, double tol, double min, double max, int maxsamp)
+{
+    memset(afp, 0, sizeof(*afp));
+    afp->start = start;
+    afp->step = fabs(step);
+    afp->tol = fabs(tol);
+    afp->min = min;
+    afp->max = max;
+    afp->maxsamp = maxsamp < 3 || maxsamp > AF_MAXSAMP ? AF_MAXSAMP : maxsamp;
+}
+
+/* add the fwhm measured at x.
+ * return 0 if ok, -1 if full or fwhm is not positive.
+ */
+int afAddSample(AutoFocus *afp, double x, double fwhm)
+{
+    AFSample *sp;
+
+    if (afp->nsamp >= AF_MAXSAMP || !(fwhm > 0))
+        return (-1);
+
+    sp = &afp->samp[afp->nsamp++];
+    sp->x = x;
+    sp->fwhm = fwhm;
+    sp->w = 1;
+    return (0);
+}
+
+/* fit the V curve to the samples so far, setting best, fmin, slope, err and
+ * nrej. return 0 and set fitok if it has a minimum, else -1.
+ */
+int afFit(AutoFocus *afp)
+{
+    double r[AF_MAXSAMP], ar[AF_MAXSAMP];
+    double p[3], cov[3][3], g[3];
+    double xc, s, v;
+    int n = afp->nsamp;
+    int pass, i, j;
+
+    afp->fitok = 0;
+    afp->nrej = 0;
+    afp->err = AFHUGE;
+    if (n < 3)
+        return (-1);
+
+    /* fit about the mean position, in steps, to keep it well conditioned */
+    for (i = 0, xc = 0; i < n; i++)
+    {
+        afp->samp[i].w = 1;
+        xc += afp->samp[i].x;
+    }
+    xc /= n;
+
+    /* start from the fit to all or, with enough to spare, the most self
+     * consistent fit that leaves one out. otherwise a wild sample far out on
+     * an arm can pull the fit so near itself it looks no worse than the rest.
+     */
+    if (n >= AFMINROBUST)
+    {
+        double pk[3], ck[3][3], sk, sbest = 0;
+        int k, found = 0;
+
+        for (k = 0; k < n; k++)
+        {
+            afp->samp[k].w = 0;
+            if (fitOnce(afp, xc, pk, ck, &sk) == 0 && (!found || sk < sbest))
+            {
+                memcpy(p, pk, sizeof(pk));
+                sbest = sk;
+                found = 1;
+            }
+            afp->samp[k].w = 1;
+        }
+        if (!found)
+            return (-1);
+    }
+    else if (fitOnce(afp, xc, p, cov, &s) < 0)
+        return (-1);
+
+    /* reweight by how far each is from the fit */
+    for (pass = 0; n >= AFMINROBUST && pass < AFNROBUST; pass++)
+    {
+        for (i = 0; i < n; i++)
+        {
+            double m = model(p, (afp->samp[i].x - xc) / afp->step);
+
+            r[i] = afp->samp[i].fwhm / m - 1;
+            ar[i] = fabs(r[i]);
+        }
+        s = 1.4826 * median(ar, n);
+        if (s < AFMINSCALE)
+            s = AFMINSCALE;
+
+        for (i = 0, afp->nrej = 0; i < n; i++)
+        {
+            double t = r[i] / (AFTUKEY * s);
+
+            if (fabs(t) < 1)
+                afp->samp[i].w = (1 - t * t) * (1 - t * t);
+            else
+            {
+                afp->samp[i].w = 0;
+                afp->nrej++;
+            }
+        }
+        if (fitOnce(afp, xc, p, cov, &s) < 0)
+            return (-1);
+    }
+
+    afp->best = xc - afp->step * p[1] / (2 * p[2]);
+    v = p[0] - p[1] * p[1] / (4 * p[2]);
+    afp->fmin = v > 0 ? sqrt(v) : 0;
+    afp->slope = sqrt(p[2]) / afp->step;
+
+    /* propagate the fit covariance to best, if there is any to go on */
+    if (s > 0)
+    {
+        g[0] = 0;
+        g[1] = -1 / (2 * p[2]);
+        g[2] = p[1] / (2 * p[2] * p[2]);
+        for (i = 0, v = 0; i < 3; i++)
+            for (j = 0; j < 3; j++)
+                v += g[i] * cov[i][j] * g[j];
+        afp->err = afp->step * sqrt(v);
+    }
+
+    afp->fitok = 1;
+    return (0);
+}
+
+/* decide what to do next.
+ * return AF_MORE with the next position to sample in *xp, AF_DONE with best
+ * focus in *xp, or AF_FAIL with the reason in whynot.
+ */
+int afNext(AutoFocus *afp, double *xp)
+{
+    double lo, hi, x, knee = 0;
+    int n = afp->nsamp;
+    int nlo = 0, nhi = 0, rlo = 0, rhi = 0;
+    int bracketed;
+    int i;
+
+    /* first two are start and a step from it, uphill or down */
+    if (n == 0)
+    {
+        *xp = afp->start < afp->min ? afp->min : afp->start > afp->max ? afp->max : afp->start;
+        return (AF_MORE);
+    }
+    if (n == 1)
+    {
+        x = afp->samp[0].x + afp->step;
+        *xp = x <= afp->max ? x : afp->samp[0].x - afp->step;
+        return (AF_MORE);
+    }
+
+    /* the span so far */
+    for (i = 1, lo = hi = afp->samp[0].x; i < n; i++)
+    {
+        if (afp->samp[i].x < lo)
+            lo = afp->samp[i].x;
+        if (afp->samp[i].x > hi)
+            hi = afp->samp[i].x;
+    }
+
+    /* fit, and see how well each arm is sampled */
+    afFit(afp);
+    bracketed = afp->fitok && afp->best > lo && afp->best < hi;
+    if (bracketed)
+    {
+        double fleast = 0, flo = 0, fhi = 0;
+
+        knee = afp->slope > 0 ? afp->fmin / afp->slope : afp->step;
+        if (knee < afp->step / 2)
+            knee = afp->step / 2;
+        for (i = 0; i < n; i++)
+        {
+            AFSample *sp = &afp->samp[i];
+
+            if (sp->w <= 0)
+                continue;
+            if (fleast == 0 || sp->fwhm < fleast)
+                fleast = sp->fwhm;
+            if (sp->x <= afp->best - knee / 2)
+            {
+                nlo++;
+                if (sp->fwhm > flo)
+                    flo = sp->fwhm;
+            }
+            if (sp->x >= afp->best + knee / 2)
+            {
+                nhi++;
+                if (sp->fwhm > fhi)
+                    fhi = sp->fwhm;
+            }
+        }
+        rlo = flo >= AFRISE * fleast;
+        rhi = fhi >= AFRISE * fleast;
+    }
+
+    if (bracketed && n >= AFMINDONE && nlo >= AFMINARM && nhi >= AFMINARM && rlo && rhi && afp->err <= afp->tol)
+    {
+        *xp = afp->best;
+        return (AF_DONE);
+    }
+    if (n >= afp->maxsamp)
+    {
+        if (bracketed)
+        {
+            *xp = afp->best;
+            return (AF_DONE);
+        }
+        sprintf(afp->whynot, "no minimum after %d samples", n);
+        return (AF_FAIL);
+    }
+
+    if (bracketed)
+    {
+        /* step out until both arms rise clear of the bottom, then sample at
+         * the knee on the arm with fewer samples.
+         */
+        if (!rlo && (rhi || nlo <= nhi))
+            x = lo - afp->step;
+        else if (!rhi)
+            x = hi + afp->step;
+        else
+            x = nlo <= nhi ? afp->best - knee : afp->best + knee;
+        if (x < lo - AFREACH * afp->step)
+            x = lo - AFREACH * afp->step;
+        if (x > hi + AFREACH * afp->step)
+            x = hi + AFREACH * afp->step;
+    }
+    else if (afp->fitok)
+    {
+        /* head for the fitted minimum, but not too far past what we know */
+        x = afp->best;
+        if (x < lo - AFREACH * afp->step)
+            x = lo - AFREACH * afp->step;
+        if (x > hi + AFREACH * afp->step)
+            x = hi + AFREACH * afp->step;
+    }
+    else
+    {
+        /* no minimum yet: step out past whichever end is lower */
+        double flo = 0, fhi = 0;
+
+        for (i = 0; i < n; i++)
+        {
+            if (afp->samp[i].x == lo)
+                flo = afp->samp[i].fwhm;
+            if (afp->samp[i].x == hi)
+                fhi = afp->samp[i].fwhm;
+        }
+        x = fhi <= flo ? hi + afp->step : lo - afp->step;
+    }
+
+    if (x < afp->min)
+        x = afp->min;
+    if (x > afp->max)
+        x = afp->max;
+    if (!bracketed && sampledNear(afp, x) && (x == afp->min || x == afp->max))
+    {
+        sprintf(afp->whynot, "best focus is beyond the %s limit", x == afp->min ? "lower" : "upper");
+        return (AF_FAIL);
+    }
+
+    *xp = x;
+    return (AF_MORE);
+}
+
+/* one weighted fit of fwhm^2 = p0 + p1 u + p2 u^2, u = (x - xc)/step.
+ * each fwhm^2 is weighted by its robust weight over its variance, which goes
+ * as fwhm^4. return the parameters in p[], their covariance in cov[][] and
+ * the fractional fwhm error they imply in *sp, 0 if too few to tell.
+ * return 0 if it has a minimum, else -1.
+ */
+static int fitOnce(AutoFocus *afp, double xc, double p[3], double cov[3][3], double *sp)
+{
+    double a[3][3], t[3][3], b[3];
+    double chisqr, s2;
+    int nused = 0;
+    int i, j, k;
+
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    for (i = 0; i < afp->nsamp; i++)
+    {
+        AFSample *smp = &afp->samp[i];
+        double u = (smp->x - xc) / afp->step;
+        double f2 = smp->fwhm * smp->fwhm;
+        double w = smp->w / (f2 * f2);
+        double up[3];
+
+        if (smp->w <= 0)
+            continue;
+        nused++;
+        up[0] = 1;
+        up[1] = u;
+        up[2] = u * u;
+        for (j = 0; j < 3; j++)
+        {
+            b[j] += w * up[j] * f2;
+            for (k = 0; k < 3; k++)
+                a[j][k] += w * up[j] * up[k];
+        }
+    }
+
+    memcpy(t, a, sizeof(t));
+    memcpy(p, b, 3 * sizeof(double));
+    if (solve3(t, p) < 0 || !(p[2] > 0))
+        return (-1);
+
+    /* covariance is the inverse of a, scaled by the residual variance */
+    for (k = 0; k < 3; k++)
+    {
+        double e[3] = {0, 0, 0};
+
+        e[k] = 1;
+        memcpy(t, a, sizeof(t));
+        if (solve3(t, e) < 0)
+            return (-1);
+        for (j = 0; j < 3; j++)
+            cov[j][k] = e[j];
+    }
+
+    *sp = 0;
+    if (nused > 3)
+    {
+        for (i = 0, chisqr = 0; i < afp->nsamp; i++)
+        {
+            AFSample *smp = &afp->samp[i];
+            double f2 = smp->fwhm * smp->fwhm;
+            double m = model(p, (smp->x - xc) / afp->step);
+            double r = (f2 - m * m) / f2;
+
+            chisqr += smp->w * r * r;
+        }
+        s2 = chisqr / (nused - 3);
+        if (s2 < 4 * AFMINSCALE * AFMINSCALE)
+            s2 = 4 * AFMINSCALE * AFMINSCALE;
+        for (j = 0; j < 3; j++)
+            for (k = 0; k < 3; k++)
+                cov[j][k] *= s2;
+        *sp = sqrt(s2) / 2;
+    }
+
+    return (0);
+}
+
+/* return the fwhm of the fit p[] at u, never less than a tiny bit */
+static double model(double p[3], double u)
+{
+    double m = p[0] + u * (p[1] + u * p[2]);
+
+    return (m > 1e-12 ? sqrt(m) : 1e-6);
+}
+
+/* solve a x = b for x, left in b, by gaussian elimination with pivoting.
+ * return 0 if ok, -1 if singular.
+ */
+static int solve3(double a[3][3], double b[3])
+{
+    int i, j, k;
+
+    for (i = 0; i < 3; i++)
+    {
+        int p = i;
+
+        for (j = i + 1; j < 3; j++)
+            if (fabs(a[j][i]) > fabs(a[p][i]))
+                p = j;
+        if (a[p][i] == 0)
+            return (-1);
+        if (p != i)
+        {
+            double t;
+
+            for (k = 0; k < 3; k++)
+            {
+                t = a[i][k];
+                a[i][k] = a[p][k];
+                a[p][k] = t;
+            }
+            t = b[i];
+            b[i] = b[p];
+            b[p] = t;
+        }
+        for (j = i + 1; j < 3; j++)
+        {
+            double f = a[j][i] / a[i][i];
+
+            for (k = i; k < 3; k++)
+                a[j][k] -= f * a[i][k];
+            b[j] -= f * b[i];
+        }
+    }
+
+    for (i = 2; i >= 0; --i)
+    {
+        for (k = i + 1; k < 3; k++)
+            b[i] -= a[i][k] * b[k];
+        b[i] /= a[i][i];
+    }
+
+    return (0);
+}
+
+/* return the median of v[], which is sorted */
+static double median(double v[], int n)
+{
+    qsort(v, n, sizeof(double), cmpDouble);
+    return (n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2);
+}
+
+/* qsort compare for doubles */
+static int cmpDouble(const void *a, const void *b)
+{
+    double d = *(double *)a - *(double *)b;
+
+    return (d < 0 ? -1 : d > 0 ? 1 : 0);
+}
+
+/* return 1 if there is already a sample within tol/2 of x, else 0 */
+static int sampledNear(AutoFocus *afp, double x)
+{
+    int i;
+
+    for (i = 0; i < afp->nsamp; i++)
+        if (fabs(afp->samp[i].x - x) <= afp->tol / 2)
+            return (1);
+    return (0);
+}
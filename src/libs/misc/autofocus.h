@@ -0,0 +1,53 @@
+/* include file for the autofocus curve fitting and best focus search engine */
+
+#ifndef AUTOFOCUS_H
+#define AUTOFOCUS_H
+
+#define AF_MAXSAMP 64 /* most samples in one run */
+
+/* afNext() outcomes */
+#define AF_MORE 0  /* take a sample at the position given */
+#define AF_DONE 1  /* best focus is at the position given */
+#define AF_FAIL -1 /* no best focus can be found, see whynot */
+
+/* one measurement */
+typedef struct
+{
+    double x;    /* focus position, any linear unit, say microns */
+    double fwhm; /* star size there, any unit, say pixels */
+    double w;    /* robust weight in the last fit, 0 if rejected */
+} AFSample;
+
+/* one autofocus run.
+ * the V curve is the hyperbola fwhm^2 = fmin^2 + (slope (x - best))^2.
+ */
+typedef struct
+{
+    /* set by afInit() */
+    double start;   /* first position */
+    double step;    /* initial spacing of samples */
+    double tol;     /* wanted accuracy of best */
+    double min, max; /* positions allowed */
+    int maxsamp;    /* give up after this many samples */
+
+    /* the samples so far */
+    AFSample samp[AF_MAXSAMP];
+    int nsamp;
+
+    /* the last fit, if fitok */
+    int fitok;
+    double best;  /* position of least fwhm */
+    double fmin;  /* fwhm there */
+    double slope; /* fwhm per unit x far from best */
+    double err;   /* 1 sigma uncertainty of best, huge if unknown */
+    int nrej;     /* samples given no weight */
+
+    char whynot[128]; /* reason for AF_FAIL */
+} AutoFocus;
+
+extern void afInit(AutoFocus *afp, double start, double step, double tol, double min, double max, int maxsamp);
+extern int afAddSample(AutoFocus *afp, double x, double fwhm);
+extern int afFit(AutoFocus *afp);
+extern int afNext(AutoFocus *afp, double *xp);
+
+#endif // AUTOFOCUS_H
@@ -5,15 +5,53 @@
 #include <ctype.h>
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 
 #include "configfile.h"
 #include "strops.h"
 #include "telenv.h"
 
+/* each config file is parsed once into a table of its pairs, hashed on name
+ * without regard to case, and kept for all later lookups in this process.
+ * a file is parsed again only when stat(2) shows it has since changed.
+ */
+#define CFGNHASH 64   /* hash buckets per file, a power of 2 */
+#define CFGMAXNAME 256  /* longest name */
+#define CFGMAXVALUE 1024 /* longest value */
+
+typedef struct
+{
+    char *name, *value; /* last value given to name */
+    int next;           /* next pair in same bucket, or -1 */
+} CfgPair;
+
+typedef struct _CfgFile
+{
+    char *path;              /* as opened */
+    dev_t dev;               /* identity and state when parsed */
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    CfgPair *pairs;          /* malloced, one per distinct name */
+    int npairs, mpairs;      /* used and malloced */
+    int hash[CFGNHASH];      /* first pair in each bucket, or -1 */
+    struct _CfgFile *next;   /* next file */
+} CfgFile;
+
+static CfgFile *cfgfiles;    /* all files parsed so far */
+static pthread_mutex_t cfglock = PTHREAD_MUTEX_INITIALIZER;
+
+static CfgFile *cfgLoad(char *cfn);
+static int cfgParse(CfgFile *cf, FILE *fp, char *cfn);
+static void cfgEmpty(CfgFile *cf);
+static CfgPair *cfgLookup(CfgFile *cf, char *name);
+static unsigned cfgHash(char *name);
+
 /* read the given list of params from the given config file.
  * return number of entries found, or -1 if can not even open file.
  * if trace each entry found is traced to stderr as "filename: name = value".
@@ -23,57 +61,47 @@ int readCfgFile(int trace, char *cfn, CfgEntry cea[], int ncea)
 {
     char *bn = basenm(cfn);
     CfgEntry *cep, *lcea = cea + ncea;
-    char name[256];
-    char valu[1024];
+    char valu[CFGMAXVALUE + 64];
+    CfgFile *cf;
     int nfound;
-    FILE *fp;
 
-    /* open file */
-    fp = telfopen(cfn, "r");
-    if (!fp)
+    pthread_mutex_lock(&cfglock);
+    cf = cfgLoad(cfn);
+    if (!cf)
+    {
+        pthread_mutex_unlock(&cfglock);
         return (-1);
+    }
 
-    /* reset found flags */
+    /* fill each in cea list from the file's pairs */
+    nfound = 0;
     for (cep = cea; cep < lcea; cep++)
+    {
+        CfgPair *pp = cfgLookup(cf, cep->name);
+
         cep->found = 0;
+        if (!pp)
+            continue;
 
-    /* for each pair in file
-     *   fill if in cea list
-     */
-    nfound = 0;
-    while (!nextPair(fp, cfn, name, sizeof(name), valu, sizeof(valu)))
-    {
-        for (cep = cea; cep < lcea; cep++)
+        switch (cep->type)
         {
-            if (!strcasecmp(cep->name, name))
-            {
-                switch (cep->type)
-                {
-                case CFG_INT:
-                    *((int *)cep->valp) = atoi(valu);
-                    break;
-                case CFG_DBL:
-                    *((double *)cep->valp) = atof(valu);
-                    break;
-                case CFG_STR:
-                    (void)strncpy((char *)(cep->valp), valu, cep->slen);
-                    break;
-                default:
-                    fprintf(stderr, "%s: bad type: %d\n", bn, cep->type);
-                    exit(1);
-                }
-                if (!cep->found)
-                {
-                    cep->found = 1;
-                    nfound++; /* just count once */
-                }
-                break;
-            }
+        case CFG_INT:
+            *((int *)cep->valp) = atoi(pp->value);
+            break;
+        case CFG_DBL:
+            *((double *)cep->valp) = atof(pp->value);
+            break;
+        case CFG_STR:
+            (void)strncpy((char *)(cep->valp), pp->value, cep->slen);
+            break;
+        default:
+            fprintf(stderr, "%s: bad type: %d\n", bn, cep->type);
+            exit(1);
         }
+        cep->found = 1;
+        nfound++;
     }
-
-    /* done with file */
-    fclose(fp);
+    pthread_mutex_unlock(&cfglock);
 
     /* print the final list if desired */
     if (trace)
@@ -122,6 +150,176 @@ int read1CfgEntry(int trace, char *fn, char *name, CfgType t, void *vp, int slen
     return (readCfgFile(trace, fn, &e, 1) == 1 ? 0 : -1);
 }
 
+/* return the parsed cfn, parsing it first if it is new or has changed.
+ * return NULL with errno set if it can not be read.
+ * N.B. call with cfglock held.
+ */
+static CfgFile *cfgLoad(char *cfn)
+{
+    char path[1024];
+    struct stat st;
+    CfgFile *cf, **cfpp;
+    FILE *fp;
+    int ok;
+
+    /* find it as telfopen() would */
+    if (snprintf(path, sizeof(path), "%s", cfn) >= (int)sizeof(path))
+    {
+        errno = ENAMETOOLONG;
+        return (NULL);
+    }
+    ok = stat(path, &st) == 0;
+    if (!ok && cfn[0] != '/')
+    {
+        telfixpath(path, cfn);
+        ok = stat(path, &st) == 0;
+    }
+
+    for (cfpp = &cfgfiles; (cf = *cfpp) != NULL; cfpp = &cf->next)
+        if (!strcmp(cf->path, path))
+            break;
+
+    /* gone: forget it too */
+    if (!ok)
+    {
+        if (cf)
+        {
+            *cfpp = cf->next;
+            cfgEmpty(cf);
+            free(cf->path);
+            free(cf);
+        }
+        return (NULL);
+    }
+
+    /* just as it was */
+    if (cf && cf->dev == st.st_dev && cf->ino == st.st_ino && cf->size == st.st_size &&
+        cf->mtime.tv_sec == st.st_mtim.tv_sec && cf->mtime.tv_nsec == st.st_mtim.tv_nsec)
+        return (cf);
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return (NULL);
+    if (!cf)
+    {
+        cf = (CfgFile *)calloc(1, sizeof(CfgFile));
+        if (!cf || !(cf->path = strdup(path)))
+        {
+            free(cf);
+            fclose(fp);
+            errno = ENOMEM;
+            return (NULL);
+        }
+        cf->next = cfgfiles;
+        cfgfiles = cf;
+    }
+
+    /* stat again once open, in case it changed meanwhile */
+    (void)fstat(fileno(fp), &st);
+    cf->dev = st.st_dev;
+    cf->ino = st.st_ino;
+    cf->size = st.st_size;
+    cf->mtime = st.st_mtim;
+    if (cfgParse(cf, fp, cfn) < 0)
+    {
+        cf->mtime.tv_sec = 0; /* try again next time */
+        fclose(fp);
+        errno = ENOMEM;
+        return (NULL);
+    }
+    fclose(fp);
+
+    return (cf);
+}
+
+/* replace cf's pairs with those in fp, named cfn.
+ * as ever, parsing stops at the first syntax error.
+ * return 0 if ok, -1 if out of memory.
+ */
+static int cfgParse(CfgFile *cf, FILE *fp, char *cfn)
+{
+    char name[CFGMAXNAME];
+    char valu[CFGMAXVALUE];
+
+    /* a lone '/' comes back without touching valu, so empty it each time */
+    cfgEmpty(cf);
+    for (valu[0] = '\0'; !nextPair(fp, cfn, name, sizeof(name), valu, sizeof(valu)); valu[0] = '\0')
+    {
+        CfgPair *pp = cfgLookup(cf, name);
+        char *v;
+
+        if (!(v = strdup(valu)))
+            return (-1);
+        if (pp)
+        {
+            free(pp->value);
+            pp->value = v;
+            continue;
+        }
+
+        if (cf->npairs == cf->mpairs)
+        {
+            int m = cf->mpairs ? 2 * cf->mpairs : 32;
+            CfgPair *newp = (CfgPair *)realloc(cf->pairs, m * sizeof(CfgPair));
+
+            if (!newp)
+            {
+                free(v);
+                return (-1);
+            }
+            cf->pairs = newp;
+            cf->mpairs = m;
+        }
+        pp = &cf->pairs[cf->npairs];
+        if (!(pp->name = strdup(name)))
+        {
+            free(v);
+            return (-1);
+        }
+        pp->value = v;
+        pp->next = cf->hash[cfgHash(name)];
+        cf->hash[cfgHash(name)] = cf->npairs++;
+    }
+
+    return (0);
+}
+
+/* free cf's pairs and leave it with none */
+static void cfgEmpty(CfgFile *cf)
+{
+    int i;
+
+    for (i = 0; i < cf->npairs; i++)
+    {
+        free(cf->pairs[i].name);
+        free(cf->pairs[i].value);
+    }
+    cf->npairs = 0;
+    for (i = 0; i < CFGNHASH; i++)
+        cf->hash[i] = -1;
+}
+
+/* return the pair in cf for name, regardless of case, else NULL */
+static CfgPair *cfgLookup(CfgFile *cf, char *name)
+{
+    int i;
+
+    for (i = cf->hash[cfgHash(name)]; i >= 0; i = cf->pairs[i].next)
+        if (!strcasecmp(cf->pairs[i].name, name))
+            return (&cf->pairs[i]);
+    return (NULL);
+}
+
+/* hash name, regardless of case, into [0..CFGNHASH) */
+static unsigned cfgHash(char *name)
+{
+    unsigned h = 0;
+
+    while (*name)
+        h = h * 31 + tolower((unsigned char)*name++);
+    return (h & (CFGNHASH - 1));
+}
+
 /* handy utility to print an error message describing what went wrong with
  * a call to readCfgFile().
  * fn is the offending file name.
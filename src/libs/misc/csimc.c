@@ -17,6 +17,8 @@
 #include <unistd.h>
 
 #include "csimc.h"
+#include "latshm.h"
+#include "trace.h"
 
 /*** low-level server connections, not for applications ***********************/
 
@@ -183,7 +185,10 @@ static int common_close(int fd)
     return (-1);
 }
 
-static int common_open(char *host, int port, int addr, OpenWhy why, int client)
+/* contact csimcd and ask for a connection to addr, without waiting for it to
+ * confirm. return fd or -1.
+ */
+static int common_start(char *host, int port, int addr, OpenWhy why, int client)
 {
     Byte preamble[3];
     int fd;
@@ -203,18 +208,37 @@ static int common_open(char *host, int port, int addr, OpenWhy why, int client)
         return (-1);
     }
 
+    return (fd);
+}
+
+/* wait for csimcd to confirm a connection begun with common_start().
+ * return fd or -1, having closed it.
+ */
+static int common_finish(int fd, int addr, OpenWhy why)
+{
+    Byte haddr;
+
     /* read back assigned host addr byte and to confirm connection */
-    if (read(fd, preamble, 1) <= 0)
+    if (read(fd, &haddr, 1) <= 0)
     {
         (void)close(fd);
         return (-1);
     }
 
     /* new */
-    fdiAdd(fd, preamble[0], addr, why);
+    fdiAdd(fd, haddr, addr, why);
     return (fd);
 }
 
+static int common_open(char *host, int port, int addr, OpenWhy why, int client)
+{
+    int fd = common_start(host, port, addr, why, client);
+
+    if (fd < 0)
+        return (-1);
+    return (common_finish(fd, addr, why));
+}
+
 /* build a shell connection to csimcd for the given TCP/IP host and port.
  * return fd or -1.
  */
@@ -223,6 +247,24 @@ int csi_open(char *host, int port, int addr)
     return (common_open(host, port, addr, FOR_SHELL, 0));
 }
 
+/* as csi_open() but return as soon as the request is sent, so connections to
+ * many nodes may be made at once. csimcd answers each in turn; once fd is
+ * readable, csi_openDone() must be called before any other use.
+ * return fd or -1.
+ */
+int csi_openStart(char *host, int port, int addr)
+{
+    return (common_start(host, port, addr, FOR_SHELL, 0));
+}
+
+/* complete a connection to addr begun with csi_openStart().
+ * return fd or -1, having closed it.
+ */
+int csi_openDone(int fd, int addr)
+{
+    return (common_finish(fd, addr, FOR_SHELL));
+}
+
 /* build a serial connection to csimcd for the given TCP/IP host and port.
  * return fd or -1.
  */
@@ -239,6 +281,27 @@ int csi_bopen(char *host, int port, int addr)
     return (common_open(host, port, addr, FOR_BOOT, 0));
 }
 
+/* as csi_bopen() but return as soon as the request is sent, as with
+ * csi_openStart(). the connection is framed: each boot packet written must be
+ * preceded by a byte holding its length, so csimcd may find the boundaries
+ * even when several are written before the first is ACKed.
+ * return fd or -1.
+ */
+int csi_bopenStart(char *host, int port, int addr)
+{
+    return (common_start(host, port, addr, FOR_WBOOT, 0));
+}
+
+/* complete a connection to addr begun with csi_bopenStart().
+ * N.B. a csimcd from before framed boot connections just closes, so failure
+ *   here may be worth trying again with csi_bopen().
+ * return fd or -1, having closed it.
+ */
+int csi_bopenDone(int fd, int addr)
+{
+    return (common_finish(fd, addr, FOR_WBOOT));
+}
+
 /* convert a file descriptor from csi_[b]open() to its assigned host addr */
 int csi_f2h(int fd)
 {
@@ -358,20 +421,25 @@ int csi_rix(int fd, char *fmt, ...)
 {
     va_list ap;
     char buf[1024];
+    double t0;
     int l;
 
+    TRACE_BEGIN("csi_rix");
+
     va_start(ap, fmt);
     l = vsprintf(buf, fmt, ap);
     va_end(ap);
 
+    t0 = latNow();
     if (write(fd, buf, l) < 0)
     {
         fprintf(stderr, "csi_rix(%d, %s): %s\n", fd, buf, strerror(errno));
         exit(1);
     }
 
-    if (csi_r(fd, buf, sizeof(buf)) < 0)
-        return (-1);
+    l = csi_r(fd, buf, sizeof(buf)) < 0 ? -1 : (int)strtol(buf, NULL, 0);
+    latRecord(LAT_CSIRTT, latNow() - t0);
 
-    return (strtol(buf, NULL, 0));
+    TRACE_END("csi_rix");
+    return (l);
 }
@@ -90,7 +90,8 @@ typedef enum
     FOR_SHELL,
     FOR_BOOT,
     FOR_REBOOT,
-    FOR_SERIAL
+    FOR_SERIAL,
+    FOR_WBOOT /* as FOR_BOOT but each packet is preceded by its length */
 } OpenWhy;
 
 /* header for a boot image record */
@@ -115,7 +116,11 @@ extern int csimcd_clconn(char *host, int port);
 
 /* host client API */
 extern int csi_open(char *host, int port, int addr);
+extern int csi_openStart(char *host, int port, int addr);
+extern int csi_openDone(int fd, int addr);
 extern int csi_bopen(char *host, int port, int addr);
+extern int csi_bopenStart(char *host, int port, int addr);
+extern int csi_bopenDone(int fd, int addr);
 extern int csi_sopen(char *host, int port, int addr, int baud);
 extern int csi_close(int fd);
 extern int csi_intr(int fd);
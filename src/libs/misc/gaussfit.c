@@ -1,6 +1,6 @@
 /* given an array of pixels find the best-fit gaussian.
  * this is not really for external use -- just by starStats().
- * N.B. this is NOT reentrant.
+ * N.B. this is NOT reentrant. see starfit.c for a reentrant 2D fit.
  */
 
 #include <malloc.h>
@@ -0,0 +1,249 @@
+/* control loop latency histograms kept in shared memory.
+ *
+ * telescoped calls latInit() once to create and clear the segment, then
+ * latRecord() wherever it measures something. latRecord() does nothing until
+ * latInit() has been called, so the same code may be used by tools that do
+ * not want the segment. anyone may latOpen() it to look, as getshm does.
+ *
+ * there is one writer so no locking; a reader may see a value counted in
+ * count a moment before its bucket, which is harmless for a report.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "latshm.h"
+
+static LatShm *latshmp; /* set once latInit() has made it */
+
+static char *latnames[LAT_N] = {
+    "pollperiod", "polldur", "csirtt", "build", "acquire",
+};
+
+static LatShm *attach(int flags);
+
+/* create the segment if need be, attach, clear and start recording.
+ * return 0 if ok, else -1 with errno set.
+ */
+int latInit()
+{
+    LatShm *lp;
+    int i;
+
+    lp = attach(IPC_CREAT);
+    if (!lp)
+        return (-1);
+
+    memset(lp, 0, sizeof(LatShm));
+    for (i = 0; i < LAT_N; i++)
+        strcpy(lp->h[i].name, latnames[i]);
+    lp->pid = getpid();
+    lp->start = (long)time(NULL);
+    lp->version = LATVERSION;
+
+    latshmp = lp;
+    return (0);
+}
+
+/* attach to an existing segment read-only.
+ * return it, else NULL with errno set.
+ */
+LatShm *latOpen()
+{
+    LatShm *lp = attach(SHM_RDONLY);
+
+    if (lp && lp->version != LATVERSION)
+    {
+        shmdt(lp);
+        errno = EPROTO;
+        return (NULL);
+    }
+    return (lp);
+}
+
+/* count secs in histogram id, if we are recording */
+void latRecord(LatId id, double secs)
+{
+    unsigned long long us;
+    LatHist *hp;
+
+    if (!latshmp || (unsigned)id >= LAT_N)
+        return;
+    hp = &latshmp->h[id];
+
+    us = secs > 0 ? (unsigned long long)(secs * 1e6 + 0.5) : 0;
+    if (hp->count == 0 || us < hp->min)
+        hp->min = us;
+    if (us > hp->max)
+        hp->max = us;
+    hp->sum += us;
+    hp->bucket[latBucket(us)]++;
+    hp->count++;
+}
+
+/* return CLOCK_MONOTONIC in secs, handy for measuring what to latRecord() */
+double latNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+/* return the bucket in which to count us.
+ * values past 2^(LATMAXBIT+1) all go in the last one.
+ */
+int latBucket(unsigned long long us)
+{
+    int e;
+
+    if (us < LATNSUB)
+        return ((int)us);
+    e = 63 - __builtin_clzll(us);
+    if (e > LATMAXBIT)
+        return (LATNBKT - 1);
+    return (LATNSUB + (e - LATSUBBITS) * LATNSUB + (int)((us >> (e - LATSUBBITS)) - LATNSUB));
+}
+
+/* return the smallest value counted in bucket b, us */
+double latBucketLow(int b)
+{
+    int k;
+
+    if (b < LATNSUB)
+        return (b);
+    k = (b - LATNSUB) / LATNSUB;
+    return (ldexp(LATNSUB + (b - LATNSUB) % LATNSUB, k));
+}
+
+/* return the value just beyond those counted in bucket b, us */
+double latBucketHigh(int b)
+{
+    if (b < LATNSUB)
+        return (b + 1);
+    return (latBucketLow(b) + ldexp(1, (b - LATNSUB) / LATNSUB));
+}
+
+/* return the value below which pct percent of those in hp lie, us.
+ * this is the middle of the bucket it falls in, kept within min and max.
+ */
+double latPercentile(LatHist *hp, double pct)
+{
+    unsigned long long want, n = 0;
+    double v;
+    int b;
+
+    if (hp->count == 0)
+        return (0);
+    want = (unsigned long long)ceil(hp->count * pct / 100.0);
+    if (want < 1)
+        want = 1;
+
+    for (b = 0; b < LATNBKT - 1; b++)
+        if ((n += hp->bucket[b]) >= want)
+            break;
+
+    v = (latBucketLow(b) + latBucketHigh(b) - 1) / 2;
+    if (v < hp->min)
+        v = hp->min;
+    if (v > hp->max)
+        v = hp->max;
+    return (v);
+}
+
+/* print a table of all histograms to fp, ms */
+void latPrint(FILE *fp, LatShm *lp)
+{
+    char buf[64];
+    time_t t = lp->start;
+    int i;
+
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S UTC", gmtime(&t));
+    fprintf(fp, "telescoped pid %d, latencies since %s, ms\n", lp->pid, buf);
+    fprintf(fp, "%-10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "what", "count", "min", "mean", "p50", "p90", "p99",
+            "p99.9", "max");
+
+    for (i = 0; i < LAT_N; i++)
+    {
+        LatHist *hp = &lp->h[i];
+
+        fprintf(fp, "%-10s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", hp->name, hp->count,
+                hp->min / 1e3, hp->count ? hp->sum / 1e3 / hp->count : 0.0, latPercentile(hp, 50) / 1e3,
+                latPercentile(hp, 90) / 1e3, latPercentile(hp, 99) / 1e3, latPercentile(hp, 99.9) / 1e3,
+                hp->max / 1e3);
+    }
+}
+
+/* write all histograms to fn in the Prometheus text format, as a cumulative
+ * histogram of secs for each, so a node_exporter textfile collector may
+ * pick them up. only buckets that have something in them are listed.
+ * written to a temp file then renamed so readers never see it half done.
+ * return 0 if ok, else -1 with errno set.
+ */
+int latExport(char *fn, LatShm *lp)
+{
+    char tmp[1024];
+    FILE *fp;
+    int i, b;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", fn);
+    fp = fopen(tmp, "w");
+    if (!fp)
+        return (-1);
+
+    fprintf(fp, "# HELP talon_latency_seconds telescoped control loop latencies\n");
+    fprintf(fp, "# TYPE talon_latency_seconds histogram\n");
+    for (i = 0; i < LAT_N; i++)
+    {
+        LatHist *hp = &lp->h[i];
+        unsigned long long n = 0;
+
+        for (b = 0; b < LATNBKT; b++)
+        {
+            if (!hp->bucket[b])
+                continue;
+            n += hp->bucket[b];
+            fprintf(fp, "talon_latency_seconds_bucket{what=\"%s\",le=\"%g\"} %llu\n", hp->name,
+                    latBucketHigh(b) / 1e6, n);
+        }
+        fprintf(fp, "talon_latency_seconds_bucket{what=\"%s\",le=\"+Inf\"} %llu\n", hp->name, hp->count);
+        fprintf(fp, "talon_latency_seconds_sum{what=\"%s\"} %g\n", hp->name, hp->sum / 1e6);
+        fprintf(fp, "talon_latency_seconds_count{what=\"%s\"} %llu\n", hp->name, hp->count);
+    }
+    fprintf(fp, "talon_latency_start_seconds %ld\n", lp->start);
+
+    if (fclose(fp) == EOF || rename(tmp, fn) < 0)
+    {
+        int e = errno;
+        unlink(tmp);
+        errno = e;
+        return (-1);
+    }
+    return (0);
+}
+
+/* attach to the segment, creating it if flags has IPC_CREAT.
+ * return it, else NULL with errno set.
+ */
+static LatShm *attach(int flags)
+{
+    int shmid;
+    void *addr;
+
+    shmid = shmget(LATSHMKEY, sizeof(LatShm), (flags & IPC_CREAT) | 0664);
+    if (shmid < 0)
+        return (NULL);
+
+    addr = shmat(shmid, NULL, flags & SHM_RDONLY);
+    if (addr == (void *)-1)
+        return (NULL);
+    return ((LatShm *)addr);
+}
@@ -0,0 +1,66 @@
+/* include file to access the control loop latency histograms.
+ *
+ * telescoped keeps these in their own small shared memory segment beside
+ * TelStatShm so anyone may look without disturbing it. each histogram counts
+ * values in microseconds in log-linear buckets, HDR style: exact below
+ * LATNSUB, then LATNSUB buckets per power of 2, so any value is within
+ * 1/LATNSUB of its bucket from 1 us up to over an hour.
+ */
+
+#ifndef LATSHM_H
+#define LATSHM_H
+
+#include <stdio.h>
+
+/* shared memory key, just beyond TELSTATSHMKEY */
+#define LATSHMKEY 0x4e56361b
+
+#define LATVERSION 1                                          /* bump when layout changes */
+#define LATSUBBITS 4                                          /* log2 of buckets per power of 2 */
+#define LATNSUB (1 << LATSUBBITS)                             /* buckets per power of 2 */
+#define LATMAXBIT 32                                          /* largest power of 2 kept, us */
+#define LATNBKT (LATNSUB + (LATMAXBIT - LATSUBBITS + 1) * LATNSUB) /* total buckets */
+
+/* what is measured */
+typedef enum
+{
+    LAT_POLLPERIOD, /* start of one main loop poll to the next */
+    LAT_POLLDUR,    /* time spent in one poll, not counting the wait */
+    LAT_CSIRTT,     /* csi_rix() query to its reply */
+    LAT_BUILD,      /* building one tracking profile */
+    LAT_ACQUIRE,    /* track command to "Now tracking", simulated secs */
+    LAT_N
+} LatId;
+
+/* one histogram */
+typedef struct
+{
+    char name[16];                  /* short name, for reports */
+    unsigned long long count;       /* values recorded */
+    unsigned long long sum;         /* their total, us */
+    unsigned long long min, max;    /* smallest and largest, us */
+    unsigned int bucket[LATNBKT];   /* counts, see latBucket() */
+} LatHist;
+
+/* the whole segment */
+typedef struct
+{
+    int version;      /* LATVERSION */
+    int pid;          /* telescoped */
+    long start;       /* unix time when last cleared */
+    LatHist h[LAT_N]; /* indexed by LatId */
+} LatShm;
+
+/* latency.c */
+extern int latInit(void);
+extern LatShm *latOpen(void);
+extern void latRecord(LatId id, double secs);
+extern double latNow(void);
+extern int latBucket(unsigned long long us);
+extern double latBucketLow(int b);
+extern double latBucketHigh(int b);
+extern double latPercentile(LatHist *hp, double pct);
+extern void latPrint(FILE *fp, LatShm *lp);
+extern int latExport(char *fn, LatShm *lp);
+
+#endif /* LATSHM_H */
@@ -0,0 +1,712 @@
+/* a log that costs the caller little more than copying its arguments.
+ *
+ * once logRingInit() has been called, logRingV() records the format pointer,
+ * which must be a string that lasts, the raw arguments it needs and the
+ * monotonic time in a ring of fixed size slots, without locks or syscalls.
+ * a writer thread formats waiting messages to stdout a few ms later. if the
+ * ring is full the message is dropped and counted rather than waiting, and
+ * the writer later reports how many were lost.
+ *
+ * the arguments each format needs are found by parsing it once per thread
+ * and remembering the result by format address. a message whose arguments
+ * do not fit in a slot, as with long strings, or with conversions we do not
+ * know, is formatted by the caller instead and its text may run on into up
+ * to MAXCHAIN slots claimed together.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "telenv.h"
+
+#define NSLOTSDEF 4096 /* default slots in the ring */
+#define SLOTDATA 100   /* argument bytes per slot */
+#define MAXCHAIN 8     /* most slots one message may use, a power of 2 */
+#define MAXARGS 16     /* most arguments we encode per message */
+#define NSIGS 64       /* formats remembered per thread */
+#define MAXSPEC 32     /* longest conversion spec we copy */
+#define WRITERUS 2000  /* writer sleep when idle, us */
+#define FLUSHSECS 2    /* longest to wait for the writer to drain at exit */
+
+/* how each argument is passed and stored */
+typedef enum
+{
+    A_INT,  /* int */
+    A_LONG, /* long, stored as long long as are all wider integers */
+    A_LL,   /* long long */
+    A_SIZE, /* size_t */
+    A_IMAX, /* intmax_t */
+    A_PDIF, /* ptrdiff_t */
+    A_DBL,  /* double */
+    A_LDBL, /* long double */
+    A_STR,  /* char *, stored as the string itself */
+    A_PTR,  /* void * */
+    A_SKIP  /* %n, consumed but not stored */
+} ArgType;
+
+/* one parsed conversion spec */
+typedef struct
+{
+    char text[MAXSPEC]; /* spec without length modifier, as "%-*.3d" */
+    int nstar;          /* number of * in width and precision */
+    char len[3];        /* length modifier as found */
+    ArgType type;       /* type of its value */
+} Spec;
+
+/* the arguments a format needs */
+typedef struct
+{
+    const char *fmt;          /* format this is for, or NULL if unused */
+    int nargs;                /* arguments, or -1 if the caller must format */
+    int nstr;                 /* how many are strings */
+    int fixed;                /* bytes for all but the strings */
+    unsigned char type[MAXARGS]; /* ArgType of each */
+} Sig;
+
+/* one message in the ring */
+typedef struct
+{
+    atomic_ulong seq;            /* slot sequence, see logRingV() */
+    const char *fmt;             /* format, or NULL if data is the text */
+    long long ns;                /* CLOCK_MONOTONIC when logged */
+    int ncont;                   /* following slots the text runs on into */
+    unsigned char data[SLOTDATA]; /* arguments or text */
+} Slot;
+
+/* the indices callers and the writer each change are kept on their own
+ * cache lines so neither keeps taking the line from the other.
+ */
+#define CACHELINE 64
+static Slot *slots;        /* the ring, or NULL if not running */
+static unsigned long mask; /* slots - 1 */
+static _Alignas(CACHELINE) atomic_ulong head; /* next slot to fill */
+static _Alignas(CACHELINE) atomic_ulong tail; /* next slot to write */
+static _Alignas(CACHELINE) atomic_ulong lost; /* messages dropped because the ring was full */
+static long long rt0ns;    /* CLOCK_REALTIME at mono0ns */
+static long long mono0ns;  /* CLOCK_MONOTONIC when started */
+static __thread Sig sigs[NSIGS]; /* formats seen by this thread */
+
+static long long clockNs(clockid_t id);
+static Sig *findSig(const char *fmt);
+static int parseSpec(const char **fpp, Spec *sp);
+static int encode(Sig *sgp, unsigned char *dp, va_list ap);
+static int decode(Slot *sp, char *buf, int len);
+static void *writer(void *dummy);
+static int drain(void);
+static void atExit(void);
+
+/* start the ring with nslots, rounded up to a power of 2, or a default if 0.
+ * return 0 if ok, else -1 and logging stays synchronous.
+ */
+int logRingInit(int nslots)
+{
+    pthread_t t;
+    unsigned long i, n;
+
+    if (slots)
+        return (0);
+
+    for (n = MAXCHAIN; n < (nslots > 0 ? nslots : NSLOTSDEF); n <<= 1)
+        continue;
+    slots = (Slot *)calloc(n, sizeof(Slot));
+    if (!slots)
+        return (-1);
+    for (i = 0; i < n; i++)
+        atomic_init(&slots[i].seq, i);
+    mask = n - 1;
+
+    mono0ns = clockNs(CLOCK_MONOTONIC);
+    rt0ns = clockNs(CLOCK_REALTIME);
+
+    if (pthread_create(&t, NULL, writer, NULL) != 0)
+    {
+        free(slots);
+        slots = NULL;
+        return (-1);
+    }
+    pthread_detach(t);
+    atexit(atExit);
+
+    return (0);
+}
+
+/* record a message for the writer.
+ * return 0 if taken, even if lost because the ring is full, or -1 if the
+ * ring is not running and the caller should log it some other way.
+ */
+int logRingV(const char *fmt, va_list ap)
+{
+    unsigned char data[MAXCHAIN * SLOTDATA];
+    const char *f = fmt;
+    unsigned long pos;
+    va_list aq;
+    Sig *sgp;
+    Slot *sp;
+    int n, k, i;
+
+    if (!slots)
+        return (-1);
+
+    /* the arguments if they fit in one slot, else the whole text */
+    sgp = findSig(fmt);
+    va_copy(aq, ap);
+    if (sgp->nargs >= 0 && encode(sgp, data, aq) == 0)
+        n = SLOTDATA;
+    else
+    {
+        f = NULL;
+        n = vsnprintf((char *)data, sizeof(data), fmt, ap) + 1;
+        if (n > sizeof(data))
+            n = sizeof(data);
+    }
+    va_end(aq);
+    k = (n + SLOTDATA - 1) / SLOTDATA;
+
+    /* claim k slots from head: the seq of each equals its pos when it is
+     * free, and is pos + 1 once filled until the writer frees it for the
+     * next lap. the writer frees in order, so if the last is free so are
+     * the others.
+     */
+    pos = atomic_load_explicit(&head, memory_order_relaxed);
+    while (1)
+    {
+        long dif;
+
+        sp = &slots[(pos + k - 1) & mask];
+        dif = (long)(atomic_load_explicit(&sp->seq, memory_order_acquire) - (pos + k - 1));
+        if (dif == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + k, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            atomic_fetch_add_explicit(&lost, 1, memory_order_relaxed);
+            return (0);
+        }
+        else
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+    }
+
+    /* fill them, then publish the first which makes all visible */
+    for (i = 0; i < k; i++)
+    {
+        int m = n - i * SLOTDATA;
+        memcpy(slots[(pos + i) & mask].data, data + i * SLOTDATA, m < SLOTDATA ? m : SLOTDATA);
+    }
+    sp = &slots[pos & mask];
+    sp->ns = clockNs(CLOCK_MONOTONIC);
+    sp->fmt = f;
+    sp->ncont = k - 1;
+
+    atomic_store_explicit(&sp->seq, pos + 1, memory_order_release);
+    return (0);
+}
+
+/* as logRingV() but with the arguments listed */
+int logRing(const char *fmt, ...)
+{
+    va_list ap;
+    int r;
+
+    va_start(ap, fmt);
+    r = logRingV(fmt, ap);
+    va_end(ap);
+
+    return (r);
+}
+
+/* wait up to secs for the writer to write all messages recorded so far.
+ * return 0 if it did, else -1.
+ */
+int logRingFlush(double secs)
+{
+    unsigned long h;
+    double waited;
+
+    if (!slots)
+        return (0);
+
+    h = atomic_load(&head);
+    for (waited = 0; (long)(atomic_load(&tail) - h) < 0; waited += WRITERUS / 1e6)
+    {
+        if (waited >= secs)
+            return (-1);
+        usleep(WRITERUS);
+    }
+
+    return (0);
+}
+
+/* return the given clock in ns */
+static long long clockNs(clockid_t id)
+{
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+    return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+/* return the Sig for fmt, parsing it if not already known to this thread */
+static Sig *findSig(const char *fmt)
+{
+    Sig *sgp = &sigs[((uintptr_t)fmt >> 3) % NSIGS];
+    const char *f = fmt;
+    Spec s;
+    int r;
+
+    if (sgp->fmt == fmt)
+        return (sgp);
+
+    sgp->fmt = fmt;
+    sgp->nargs = sgp->nstr = sgp->fixed = 0;
+    while ((r = parseSpec(&f, &s)) > 0)
+    {
+        int i;
+
+        if (sgp->nargs + s.nstar + 1 > MAXARGS)
+            break;
+        for (i = 0; i < s.nstar; i++)
+        {
+            sgp->type[sgp->nargs++] = A_INT;
+            sgp->fixed += sizeof(int);
+        }
+        sgp->type[sgp->nargs++] = s.type;
+        switch (s.type)
+        {
+        case A_INT:
+            sgp->fixed += sizeof(int);
+            break;
+        case A_LONG:
+        case A_LL:
+        case A_SIZE:
+        case A_IMAX:
+        case A_PDIF:
+            sgp->fixed += sizeof(long long);
+            break;
+        case A_DBL:
+            sgp->fixed += sizeof(double);
+            break;
+        case A_LDBL:
+            sgp->fixed += sizeof(long double);
+            break;
+        case A_STR:
+            sgp->fixed += 1; /* at least its \0 */
+            sgp->nstr++;
+            break;
+        case A_PTR:
+            sgp->fixed += sizeof(void *);
+            break;
+        case A_SKIP:
+            break;
+        }
+    }
+    if (r != 0 || sgp->fixed > SLOTDATA)
+        sgp->nargs = -1;
+
+    return (sgp);
+}
+
+/* parse the next conversion spec at *fpp into *sp and advance *fpp past it.
+ * %% is skipped as plain text.
+ * return 1 if found one, 0 if no more, -1 if one we do not handle.
+ */
+static int parseSpec(const char **fpp, Spec *sp)
+{
+    const char *f = *fpp;
+    char *t = sp->text;
+    int l = 0;
+
+    /* find the next % not part of %% */
+    while (1)
+    {
+        f = strchr(f, '%');
+        if (!f)
+            return (0);
+        if (f[1] != '%')
+            break;
+        f += 2;
+    }
+
+    /* copy flags, width and precision */
+    sp->nstar = 0;
+    *t++ = *f++;
+    while (*f && strchr("-+ #0'123456789.*", *f) && t < &sp->text[MAXSPEC - 3])
+    {
+        if (*f == '*')
+            sp->nstar++;
+        *t++ = *f++;
+    }
+
+    /* length modifier is kept aside */
+    while (*f && strchr("hlLqjzt", *f) && l < 2)
+        sp->len[l++] = *f++;
+    sp->len[l] = '\0';
+
+    /* conversion */
+    switch (*f)
+    {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        if (l == 0 || sp->len[0] == 'h')
+            sp->type = A_INT;
+        else if (sp->len[0] == 'z')
+            sp->type = A_SIZE;
+        else if (sp->len[0] == 'j')
+            sp->type = A_IMAX;
+        else if (sp->len[0] == 't')
+            sp->type = A_PDIF;
+        else if (sp->len[0] == 'l' && sp->len[1] != 'l')
+            sp->type = A_LONG;
+        else
+            sp->type = A_LL;
+        break;
+    case 'c':
+        if (l)
+            return (-1);
+        sp->type = A_INT;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        sp->type = sp->len[0] == 'L' ? A_LDBL : A_DBL;
+        break;
+    case 's':
+        if (l)
+            return (-1);
+        sp->type = A_STR;
+        break;
+    case 'p':
+        sp->type = A_PTR;
+        break;
+    case 'n':
+        sp->type = A_SKIP;
+        break;
+    default:
+        return (-1);
+    }
+    *t++ = *f++;
+    *t = '\0';
+
+    *fpp = f;
+    return (1);
+}
+
+/* copy the arguments described by sgp from ap to dp[SLOTDATA].
+ * return 0 if ok, or -1 if the strings do not fit.
+ */
+static int encode(Sig *sgp, unsigned char *dp, va_list ap)
+{
+    int room = SLOTDATA - sgp->fixed; /* spare bytes for string contents */
+    int i;
+
+    for (i = 0; i < sgp->nargs; i++)
+    {
+        switch (sgp->type[i])
+        {
+        case A_INT:
+        {
+            int v = va_arg(ap, int);
+            memcpy(dp, &v, sizeof(v));
+            dp += sizeof(v);
+            break;
+        }
+        case A_LONG:
+        case A_LL:
+        case A_SIZE:
+        case A_IMAX:
+        case A_PDIF:
+        {
+            long long v;
+
+            switch (sgp->type[i])
+            {
+            case A_LONG:
+                v = (long long)va_arg(ap, long);
+                break;
+            case A_SIZE:
+                v = (long long)va_arg(ap, size_t);
+                break;
+            case A_IMAX:
+                v = (long long)va_arg(ap, intmax_t);
+                break;
+            case A_PDIF:
+                v = (long long)va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                v = va_arg(ap, long long);
+                break;
+            }
+            memcpy(dp, &v, sizeof(v));
+            dp += sizeof(v);
+            break;
+        }
+        case A_DBL:
+        {
+            double v = va_arg(ap, double);
+            memcpy(dp, &v, sizeof(v));
+            dp += sizeof(v);
+            break;
+        }
+        case A_LDBL:
+        {
+            long double v = va_arg(ap, long double);
+            memcpy(dp, &v, sizeof(v));
+            dp += sizeof(v);
+            break;
+        }
+        case A_STR:
+        {
+            const char *v = va_arg(ap, const char *);
+            int n = v ? strlen(v) : 6;
+
+            if (n > room)
+                return (-1);
+            memcpy(dp, v ? v : "(null)", n);
+            dp[n] = '\0';
+            dp += n + 1;
+            room -= n;
+            break;
+        }
+        case A_PTR:
+        {
+            void *v = va_arg(ap, void *);
+            memcpy(dp, &v, sizeof(v));
+            dp += sizeof(v);
+            break;
+        }
+        case A_SKIP:
+            (void)va_arg(ap, void *);
+            break;
+        }
+    }
+
+    return (0);
+}
+
+/* format the message in sp into buf[len].
+ * return its length.
+ */
+static int decode(Slot *sp, char *buf, int len)
+{
+    const unsigned char *dp = sp->data;
+    const char *f = sp->fmt;
+    int l = 0;
+
+    /* text, which may run on into following slots */
+    if (!f)
+    {
+        int i;
+
+        for (i = 0; i <= sp->ncont && l < len - 1; i++)
+        {
+            Slot *cp = &slots[(sp - slots + i) & mask];
+            int n = strnlen((char *)cp->data, SLOTDATA);
+
+            if (n > len - 1 - l)
+                n = len - 1 - l;
+            memcpy(buf + l, cp->data, n);
+            l += n;
+            if (n < SLOTDATA)
+                break;
+        }
+        buf[l] = '\0';
+        return (l);
+    }
+
+    while (*f && l < len - 1)
+    {
+        char spec[MAXSPEC + 40];
+        int star[2];
+        char *t, *st;
+        Spec s;
+        int i;
+
+        /* plain text, with %% as % */
+        if (f[0] != '%')
+        {
+            buf[l++] = *f++;
+            continue;
+        }
+        if (f[1] == '%')
+        {
+            buf[l++] = '%';
+            f += 2;
+            continue;
+        }
+        if (parseSpec(&f, &s) <= 0)
+            break; /* can not happen, findSig() parsed it all */
+
+        /* the * values go into the spec as digits */
+        for (i = 0; i < s.nstar; i++)
+        {
+            memcpy(&star[i], dp, sizeof(int));
+            dp += sizeof(int);
+        }
+        for (t = spec, st = s.text, i = 0; *st; st++)
+        {
+            if (*st != '*')
+                *t++ = *st;
+            else if (st[-1] == '.' && star[i] < 0)
+            {
+                t--; /* negative precision means none */
+                i++;
+            }
+            else
+                t += sprintf(t, "%d", star[i++]);
+        }
+        *t = '\0';
+
+        /* the value, with the length modifier it is now stored as */
+        t = spec + strlen(spec) - 1;
+        switch (s.type)
+        {
+        case A_INT:
+        {
+            char c = *t;
+            int v;
+            memcpy(&v, dp, sizeof(v));
+            dp += sizeof(v);
+            sprintf(t, "%s%c", s.len, c);
+            l += snprintf(buf + l, len - l, spec, v);
+            break;
+        }
+        case A_LONG:
+        case A_LL:
+        case A_SIZE:
+        case A_IMAX:
+        case A_PDIF:
+        {
+            char c = *t;
+            long long v;
+            memcpy(&v, dp, sizeof(v));
+            dp += sizeof(v);
+            sprintf(t, "ll%c", c);
+            l += snprintf(buf + l, len - l, spec, v);
+            break;
+        }
+        case A_DBL:
+        {
+            double v;
+            memcpy(&v, dp, sizeof(v));
+            dp += sizeof(v);
+            l += snprintf(buf + l, len - l, spec, v);
+            break;
+        }
+        case A_LDBL:
+        {
+            char c = *t;
+            long double v;
+            memcpy(&v, dp, sizeof(v));
+            dp += sizeof(v);
+            sprintf(t, "L%c", c);
+            l += snprintf(buf + l, len - l, spec, v);
+            break;
+        }
+        case A_STR:
+            l += snprintf(buf + l, len - l, spec, (char *)dp);
+            dp += strlen((char *)dp) + 1;
+            break;
+        case A_PTR:
+        {
+            void *v;
+            memcpy(&v, dp, sizeof(v));
+            dp += sizeof(v);
+            l += snprintf(buf + l, len - l, spec, v);
+            break;
+        }
+        case A_SKIP:
+            break;
+        }
+        if (l > len - 1)
+            l = len - 1;
+    }
+
+    buf[l] = '\0';
+    return (l);
+}
+
+/* thread to write messages as they arrive */
+static void *writer(void *dummy)
+{
+    while (1)
+        if (drain() == 0)
+            usleep(WRITERUS);
+
+    return (NULL);
+}
+
+/* write all messages waiting, and report any lost.
+ * return how many were written.
+ */
+static int drain()
+{
+    unsigned long t = atomic_load_explicit(&tail, memory_order_relaxed);
+    unsigned long nlost;
+    char ts[15];
+    int n;
+
+    for (n = 0;; n++)
+    {
+        Slot *sp = &slots[t & mask];
+        char buf[1024];
+        long long ns;
+        time_t secs;
+        int l, i, k;
+
+        if (atomic_load_explicit(&sp->seq, memory_order_acquire) != t + 1)
+            break;
+
+        /* same form as daemonLog() plus microseconds */
+        ns = rt0ns + (sp->ns - mono0ns);
+        secs = (time_t)(ns / 1000000000LL);
+        l = sprintf(buf, "%s.%06d: ", timestamp_r(secs, ts), (int)(ns % 1000000000LL / 1000));
+        l += decode(sp, buf + l, sizeof(buf) - l - 1);
+        if (l > 0 && buf[l - 1] != '\n')
+        {
+            buf[l++] = '\n';
+            buf[l] = '\0';
+        }
+        fputs(buf, stdout);
+
+        /* free its slots for the next lap */
+        k = sp->ncont + 1;
+        for (i = 0; i < k; i++)
+            atomic_store_explicit(&slots[(t + i) & mask].seq, t + i + mask + 1, memory_order_release);
+        t += k;
+        atomic_store_explicit(&tail, t, memory_order_release);
+    }
+
+    nlost = atomic_exchange_explicit(&lost, 0, memory_order_relaxed);
+    if (nlost > 0)
+        printf("%s: %lu log messages lost, ring full\n", timestamp_r(time(NULL), ts), nlost);
+    if (n > 0 || nlost > 0)
+        fflush(stdout);
+
+    return (n);
+}
+
+/* give the writer a chance to finish before the process goes */
+static void atExit()
+{
+    (void)logRingFlush(FLUSHSECS);
+}
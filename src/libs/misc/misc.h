@@ -3,3 +3,10 @@ extern void rdRange(double *rap, double *decp);
 extern void haRange(double *hap);
 extern double mjd_now(void);
 extern double utc_now(Now *np);
+
+/* vclock.c */
+extern void vclockInit(double rate, double mjd0);
+extern double vclockRate(void);
+extern double vclockMJD(void);
+extern long vclockWait(long us);
+extern int vclockIsWall(void);
@@ -20,9 +20,11 @@
 #include "telenv.h"
 
 static char lock_fmt[] = "comm/%s.pid"; /* format for file names */
+static int readyfd = -1;                /* from READYFDENV, until used */
 
 static void build_fn(char *name, char fn[]);
 static int read_lockpid(char *fn);
+static void take_readyfd(void);
 
 /* set a lock for program `name', which is really this process.
  * if successful, the lock file also stores our pid.
@@ -34,6 +36,9 @@ int lock_running(char *name)
     char buf[32];
     int fd;
 
+    /* keep the ready pipe from whatever we run before we are ready */
+    take_readyfd();
+
     /* bale if already locked */
     if (testlock_running(name) == 0)
         return (-1);
@@ -93,6 +98,40 @@ int testlock_running(char *name)
     return (-1);
 }
 
+/* tell whoever started us, if they asked, that we are ready for clients.
+ * rund (see rund -w) hands its children the write end of a pipe, named by
+ * READYFDENV; one byte down it is the news. harmless if called again or if
+ * nobody asked.
+ */
+void ready_running()
+{
+    char c = 'R';
+
+    take_readyfd();
+    if (readyfd < 0)
+        return;
+    (void)write(readyfd, &c, 1);
+    (void)close(readyfd);
+    readyfd = -1;
+}
+
+/* claim the ready pipe named by READYFDENV, if any, for ourselves alone.
+ * it is unset and the fd closed on exec so children we system() or fork, such
+ * as telescoped's csimc, neither hold it open nor report ready for us.
+ */
+static void take_readyfd()
+{
+    char *env = getenv(READYFDENV);
+    int fd;
+
+    if (!env)
+        return;
+    fd = atoi(env);
+    unsetenv(READYFDENV);
+    if (fd > 2 && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0)
+        readyfd = fd;
+}
+
 /* build the lock/pid filename in fn */
 static void build_fn(char *name, char fn[])
 {
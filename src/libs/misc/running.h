@@ -1,3 +1,7 @@
 extern int lock_running(char *name);
 extern void unlock_running(char *name, int killtoo);
 extern int testlock_running(char *name);
+extern void ready_running(void);
+
+/* names the fd on which ready_running() reports, see rund */
+#define READYFDENV "TALON_READYFD"
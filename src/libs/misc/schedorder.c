@@ -0,0 +1,453 @@
+/* find an order in which to visit a list of targets that minimises the time
+ * lost to slewing, settling and waiting for visibility windows to open.
+ *
+ * each candidate first target seeds a nearest-neighbour tour which is then
+ * improved with 2-opt (reverse a run) and or-opt (move a run of up to
+ * ORMAX targets elsewhere) until no move helps or time runs out. candidate
+ * seeds are shared out among threads and the best tour found wins.
+ *
+ * slew times use the same trapezoidal model as slewTimeUs(). targets are
+ * assumed to move linearly in both axes, which is plenty for the few hours
+ * a schedule covers on an equatorial mount.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "schedorder.h"
+#include "telstatshm.h"
+
+#define LATECOST 1e6 /* cost of missing a window, in secs of overhead */
+#define ORMAX 3      /* longest run of targets or-opt will move */
+
+/* where the mount is, and what it has cost, after some steps of an order */
+typedef struct
+{
+    double t;    /* time, secs */
+    double x, y; /* axis positions, rads */
+    double ovh;  /* overhead so far, secs */
+    int nlate;   /* windows missed so far */
+} StepState;
+
+/* what each worker thread needs and finds */
+typedef struct
+{
+    SchedMount *mp;
+    SchedTarget *tp;
+    int n;
+    int *seeds;      /* candidate first targets, best first */
+    int first;       /* first seeds[] this worker tries */
+    int stride;      /* then every stride'th one after that */
+    double deadline; /* monotonic secs after which to stop improving */
+    int *order;      /* best order this worker found */
+    double cost;     /* cost of order[] */
+    int bestseed;    /* seeds[] index order[] grew from */
+    int ok;          /* set once order[] holds an order, else it failed */
+    int started;     /* set if running in a thread of its own */
+} Worker;
+
+static void step(SchedMount *mp, StepState *s0, SchedTarget *tp, StepState *s1);
+static double cost(StepState *sp);
+static double suffixCost(Worker *wp, int order[], StepState st[], int from, double limit);
+static void prefixStates(Worker *wp, int order[], StepState st[], int from);
+static void nearest(Worker *wp, int seed, int order[]);
+static void improve(Worker *wp, int order[]);
+static void *worker(void *arg);
+static double monotime(void);
+
+/* evaluate visiting the n targets tp[] in the given order, from mp.
+ * order[] holds indices into tp[].
+ */
+void schedEval(SchedMount *mp, SchedTarget tp[], int order[], int n, SchedResult *rp)
+{
+    StepState s0, s1;
+    int i;
+
+    memset(&s0, 0, sizeof(s0));
+    s0.x = mp->x0;
+    s0.y = mp->y0;
+
+    for (i = 0; i < n; i++)
+    {
+        step(mp, &s0, &tp[order[i]], &s1);
+        s0 = s1;
+    }
+
+    rp->overhead = s0.ovh;
+    rp->finish = s0.t;
+    rp->nlate = s0.nlate;
+}
+
+/* find a good order in which to visit the n targets tp[] starting from mp.
+ * the result is left in order[] as indices into tp[].
+ * use up to nthreads threads and stop refining after about maxsecs.
+ * if rp, also report the outcome of the order found.
+ * return 0 if ok, else -1 if no memory.
+ */
+int schedOrder(SchedMount *mp, SchedTarget tp[], int n, int order[], int nthreads, double maxsecs, SchedResult *rp)
+{
+    pthread_t *tids;
+    Worker *wkrs, *bestwp;
+    double *firstcost;
+    StepState s0, s1;
+    int *seeds;
+    int i, j;
+
+    if (n <= 0)
+        return (0);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > n)
+        nthreads = n;
+
+    seeds = (int *)malloc(n * sizeof(int));
+    firstcost = (double *)malloc(n * sizeof(double));
+    wkrs = (Worker *)calloc(nthreads, sizeof(Worker));
+    tids = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+    if (!seeds || !firstcost || !wkrs || !tids)
+    {
+        free(seeds);
+        free(firstcost);
+        free(wkrs);
+        free(tids);
+        return (-1);
+    }
+
+    /* try seeds in order of how cheap they are to reach first */
+    memset(&s0, 0, sizeof(s0));
+    s0.x = mp->x0;
+    s0.y = mp->y0;
+    for (i = 0; i < n; i++)
+    {
+        step(mp, &s0, &tp[i], &s1);
+        firstcost[i] = cost(&s1);
+        for (j = i; j > 0 && firstcost[seeds[j - 1]] > firstcost[i]; --j)
+            seeds[j] = seeds[j - 1];
+        seeds[j] = i;
+    }
+
+    /* share them out */
+    for (i = 0; i < nthreads; i++)
+    {
+        Worker *wp = &wkrs[i];
+
+        wp->mp = mp;
+        wp->tp = tp;
+        wp->n = n;
+        wp->seeds = seeds;
+        wp->first = i;
+        wp->stride = nthreads;
+        wp->deadline = monotime() + maxsecs;
+        wp->order = (int *)malloc(n * sizeof(int));
+        if (!wp->order)
+        {
+            while (i >= 0)
+                free(wkrs[i--].order);
+            free(seeds);
+            free(firstcost);
+            free(wkrs);
+            free(tids);
+            return (-1);
+        }
+    }
+
+    /* run the first in this thread, the rest alongside */
+    for (i = 1; i < nthreads; i++)
+        wkrs[i].started = pthread_create(&tids[i], NULL, worker, &wkrs[i]) == 0;
+    worker(&wkrs[0]);
+    for (i = 1; i < nthreads; i++)
+    {
+        if (wkrs[i].started)
+            pthread_join(tids[i], NULL);
+        else
+            worker(&wkrs[i]); /* couldn't start it, so do it here */
+    }
+
+    /* pick the best of those that found any, earliest seed wins ties */
+    bestwp = NULL;
+    for (i = 0; i < nthreads; i++)
+        if (wkrs[i].ok && (!bestwp || wkrs[i].cost < bestwp->cost ||
+                           (wkrs[i].cost == bestwp->cost && wkrs[i].bestseed < bestwp->bestseed)))
+            bestwp = &wkrs[i];
+    if (bestwp)
+    {
+        memcpy(order, bestwp->order, n * sizeof(int));
+        if (rp)
+            schedEval(mp, tp, order, n, rp);
+    }
+
+    for (i = 0; i < nthreads; i++)
+        free(wkrs[i].order);
+    free(seeds);
+    free(firstcost);
+    free(wkrs);
+    free(tids);
+
+    return (bestwp ? 0 : -1);
+}
+
+/* move the mount from s0 to and through target tp, leaving the result in s1 */
+static void step(SchedMount *mp, StepState *s0, SchedTarget *tp, StepState *s1)
+{
+    double slew, arrive, begin;
+    int i;
+
+    /* the target moves while we slew so find it where it will be when we
+     * get there. one refinement is plenty at tracking rates.
+     */
+    slew = 0;
+    for (i = 0; i < 2; i++)
+    {
+        double t = s0->t + slew;
+        double h = trapMoveTime(tp->x + tp->dx * t - s0->x, mp->hmaxvel, mp->hmaxacc);
+        double d = trapMoveTime(tp->y + tp->dy * t - s0->y, mp->dmaxvel, mp->dmaxacc);
+
+        slew = h > d ? h : d;
+    }
+
+    /* can not begin until settled and the window opens */
+    arrive = s0->t + slew + mp->settle;
+    begin = arrive < tp->start ? tp->start : arrive;
+
+    s1->ovh = s0->ovh + (begin - s0->t);
+    s1->nlate = s0->nlate + (begin > tp->end);
+    s1->t = begin + tp->dur;
+    s1->x = tp->x + tp->dx * s1->t;
+    s1->y = tp->y + tp->dy * s1->t;
+}
+
+/* what we are trying to minimise */
+static double cost(StepState *sp)
+{
+    return (sp->ovh + LATECOST * sp->nlate);
+}
+
+/* return the cost of order[] given st[] is correct up through st[from].
+ * since cost never decreases along an order, give up as soon as it exceeds
+ * limit and return that.
+ */
+static double suffixCost(Worker *wp, int order[], StepState st[], int from, double limit)
+{
+    StepState s0 = st[from], s1;
+    int i;
+
+    for (i = from; i < wp->n; i++)
+    {
+        step(wp->mp, &s0, &wp->tp[order[i]], &s1);
+        if (cost(&s1) >= limit)
+            return (cost(&s1));
+        s0 = s1;
+    }
+
+    return (cost(&s0));
+}
+
+/* recompute st[from+1 .. n] for order[].
+ * st[i] is the state before visiting order[i]; st[n] is the final state.
+ */
+static void prefixStates(Worker *wp, int order[], StepState st[], int from)
+{
+    int i;
+
+    for (i = from; i < wp->n; i++)
+        step(wp->mp, &st[i], &wp->tp[order[i]], &st[i + 1]);
+}
+
+/* build an order in order[] starting with seed then always moving to the
+ * target that is cheapest to do next.
+ */
+static void nearest(Worker *wp, int seed, int order[])
+{
+    SchedMount *mp = wp->mp;
+    StepState s0, s1, best1;
+    int i, j, bestj;
+
+    memset(&s0, 0, sizeof(s0));
+    s0.x = mp->x0;
+    s0.y = mp->y0;
+
+    /* unvisited targets are kept in order[i..n-1] */
+    for (i = 0; i < wp->n; i++)
+        order[i] = i;
+    order[0] = seed;
+    order[seed] = 0;
+    step(mp, &s0, &wp->tp[seed], &s1);
+    s0 = s1;
+
+    for (i = 1; i < wp->n; i++)
+    {
+        bestj = i;
+        step(mp, &s0, &wp->tp[order[i]], &best1);
+        for (j = i + 1; j < wp->n; j++)
+        {
+            step(mp, &s0, &wp->tp[order[j]], &s1);
+            if (cost(&s1) < cost(&best1))
+            {
+                best1 = s1;
+                bestj = j;
+            }
+        }
+
+        j = order[i];
+        order[i] = order[bestj];
+        order[bestj] = j;
+        s0 = best1;
+    }
+}
+
+/* improve order[] in place with 2-opt and or-opt moves until no move helps
+ * or the deadline passes.
+ */
+static void improve(Worker *wp, int order[])
+{
+    int n = wp->n;
+    StepState *st;
+    int *trial;
+    double best;
+    int improved;
+    int i, j, k, l;
+
+    st = (StepState *)malloc((n + 1) * sizeof(StepState));
+    trial = (int *)malloc(n * sizeof(int));
+    if (!st || !trial)
+    {
+        free(st);
+        free(trial);
+        return;
+    }
+
+    memset(&st[0], 0, sizeof(st[0]));
+    st[0].x = wp->mp->x0;
+    st[0].y = wp->mp->y0;
+    prefixStates(wp, order, st, 0);
+    best = cost(&st[n]);
+
+    do
+    {
+        improved = 0;
+
+        /* 2-opt: reverse order[i..j] */
+        for (i = 0; i < n - 1 && monotime() < wp->deadline; i++)
+        {
+            for (j = i + 1; j < n; j++)
+            {
+                double c;
+
+                memcpy(trial, order, n * sizeof(int));
+                for (k = i, l = j; k < l; k++, --l)
+                {
+                    int tmp = trial[k];
+                    trial[k] = trial[l];
+                    trial[l] = tmp;
+                }
+
+                c = suffixCost(wp, trial, st, i, best);
+                if (c < best)
+                {
+                    memcpy(order, trial, n * sizeof(int));
+                    prefixStates(wp, order, st, i);
+                    best = c;
+                    improved = 1;
+                }
+            }
+        }
+
+        /* or-opt: move the run order[i..i+l-1] to just before order[k] */
+        for (l = 1; l <= ORMAX && l < n; l++)
+        {
+            for (i = 0; i + l <= n && monotime() < wp->deadline; i++)
+            {
+                for (k = 0; k <= n; k++)
+                {
+                    int from, m, o;
+                    double c;
+
+                    if (k >= i && k <= i + l)
+                        continue; /* no change */
+
+                    /* build trial with the run moved */
+                    for (m = o = 0; m <= n; m++)
+                    {
+                        if (m == k)
+                        {
+                            memcpy(&trial[o], &order[i], l * sizeof(int));
+                            o += l;
+                        }
+                        if (m < n && (m < i || m >= i + l))
+                            trial[o++] = order[m];
+                    }
+
+                    from = k < i ? k : i;
+                    c = suffixCost(wp, trial, st, from, best);
+                    if (c < best)
+                    {
+                        memcpy(order, trial, n * sizeof(int));
+                        prefixStates(wp, order, st, from);
+                        best = c;
+                        improved = 1;
+                    }
+                }
+            }
+        }
+    } while (improved && monotime() < wp->deadline);
+
+    free(st);
+    free(trial);
+}
+
+/* try each of our seeds in turn, keeping the best order found.
+ * always finish at least one even if the deadline has passed.
+ */
+static void *worker(void *arg)
+{
+    Worker *wp = (Worker *)arg;
+    SchedResult r;
+    int *order;
+    int i;
+
+    wp->cost = HUGE_VAL;
+    wp->bestseed = wp->n;
+    wp->ok = 0;
+    order = (int *)malloc(wp->n * sizeof(int));
+    if (!order)
+        return (NULL);
+
+    for (i = wp->first; i < wp->n; i += wp->stride)
+    {
+        double c;
+
+        nearest(wp, wp->seeds[i], order);
+        improve(wp, order);
+        schedEval(wp->mp, wp->tp, order, wp->n, &r);
+        c = r.overhead + LATECOST * r.nlate;
+        if (c < wp->cost)
+        {
+            memcpy(wp->order, order, wp->n * sizeof(int));
+            wp->cost = c;
+            wp->bestseed = i;
+            wp->ok = 1;
+        }
+
+        if (monotime() >= wp->deadline)
+            break;
+    }
+
+    free(order);
+    return (NULL);
+}
+
+/* return a monotonic time in secs */
+static double monotime()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
@@ -0,0 +1,40 @@
+/* include file for the slew-overhead minimising target ordering engine */
+
+#ifndef SCHEDORDER_H
+#define SCHEDORDER_H
+
+/* one target to be ordered.
+ * axis positions and rates describe where the mount must be to observe the
+ * target; times are secs from the moment the mount leaves its start position.
+ */
+typedef struct
+{
+    double x, y;   /* H and D canonical axis positions at time 0, rads */
+    double dx, dy; /* rates of change of x and y while tracking, rads/sec */
+    double start;  /* earliest time observing may begin, secs */
+    double end;    /* latest time observing may begin, secs */
+    double dur;    /* time spent observing once there, secs */
+} SchedTarget;
+
+/* the mount doing the observing */
+typedef struct
+{
+    double x0, y0;         /* starting H and D axis positions, rads */
+    double hmaxvel, hmaxacc; /* H axis limits, as MotorInfo */
+    double dmaxvel, dmaxacc; /* D axis limits, as MotorInfo */
+    double settle;         /* time to settle after each slew, secs */
+} SchedMount;
+
+/* the outcome of a given order */
+typedef struct
+{
+    double overhead; /* total slewing, settling and waiting, secs */
+    double finish;   /* time the last target is done, secs */
+    int nlate;       /* number of targets that miss their window */
+} SchedResult;
+
+extern void schedEval(SchedMount *mp, SchedTarget tp[], int order[], int n, SchedResult *rp);
+extern int schedOrder(SchedMount *mp, SchedTarget tp[], int n, int order[], int nthreads, double maxsecs,
+                      SchedResult *rp);
+
+#endif // SCHEDORDER_H
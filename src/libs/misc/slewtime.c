@@ -0,0 +1,183 @@
+/* code to predict how long the mount takes to move between two positions.
+ *
+ * the model follows the trapezoidal profile the CSIMC nodes use for mtpos and
+ * etpos moves: accelerate at maxacc until maxvel is reached, coast, then
+ * decelerate at maxacc to a stop. short moves never reach maxvel and so are
+ * triangular. all positions are canonical rads, velocities rads/sec and
+ * accelerations rads/sec/sec, as in MotorInfo.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "telstatshm.h"
+
+/* return the seconds needed for a rest-to-rest move of dist rads given the
+ * velocity and acceleration limits.
+ * a maxacc <= 0 is taken to mean the axis reaches maxvel instantly.
+ */
+double trapMoveTime(double dist, double maxvel, double maxacc)
+{
+    dist = fabs(dist);
+    if (dist == 0 || maxvel <= 0)
+        return (0.0);
+
+    if (maxacc <= 0)
+        return (dist / maxvel);
+
+    /* triangular if we must start slowing before reaching maxvel */
+    if (dist <= maxvel * maxvel / maxacc)
+        return (2 * sqrt(dist / maxacc));
+
+    /* else ramp up, coast, ramp down */
+    return (dist / maxvel + maxvel / maxacc);
+}
+
+/* return the seconds needed for the given axis to move from one canonical
+ * position to another. axes we do not have take no time.
+ */
+double axisSlewTime(MotorInfo *mip, double from, double to)
+{
+    if (!mip->have)
+        return (0.0);
+    return (trapMoveTime(to - from, mip->maxvel, mip->maxacc));
+}
+
+/* return the microseconds needed for all n axes in mip[] to move from from[]
+ * to to[]. the axes move concurrently so this is the time of the slowest one.
+ */
+long slewTimeUs(MotorInfo *mip[], double from[], double to[], int n)
+{
+    double tmax = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        double t = axisSlewTime(mip[i], from[i], to[i]);
+        if (t > tmax)
+            tmax = t;
+    }
+
+    return ((long)floor(tmax * 1e6 + 0.5));
+}
+
+/* the shape of a jerk-limited rest-to-rest move.
+ * the acceleration phase lasts ta secs and is symmetric about its middle: jerk
+ * for tj secs up to peak acceleration ap, hold ap for ta-2*tj secs, then jerk
+ * back down to zero acceleration at peak velocity vp. the deceleration phase
+ * mirrors it, with a coast at vp between the two if the move is long enough.
+ */
+typedef struct
+{
+    double dist;   /* total distance, >= 0 */
+    double vp, ap; /* peak velocity and acceleration reached */
+    double tj, ta; /* jerk time and whole acceleration phase time */
+    double jerk;   /* jerk used, 0 if instantaneous */
+    double t;      /* total time of the move */
+} SCurve;
+
+/* fill in *sp for a move of dist. maxjerk <= 0 means acceleration changes
+ * instantly, ie, the trapezoidal profile of trapMoveTime().
+ */
+static void scurveShape(SCurve *sp, double dist, double maxvel, double maxacc, double maxjerk)
+{
+    double v;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->dist = dist = fabs(dist);
+    if (dist == 0 || maxvel <= 0)
+        return;
+    if (maxacc <= 0)
+    {
+        sp->vp = maxvel;
+        sp->t = dist / maxvel;
+        return;
+    }
+    if (maxjerk <= 0)
+        maxjerk = 0;
+
+    /* peak velocity: maxvel if there is room to reach it, else the largest
+     * that can be reached and shed again within dist.
+     */
+    v = maxvel;
+    if (maxjerk > 0 && v * maxjerk < maxacc * maxacc)
+    {
+        /* never reaches maxacc even at full speed */
+        if (dist < 2 * v * sqrt(v / maxjerk))
+            v = pow(dist * dist * maxjerk / 4, 1.0 / 3.0);
+    }
+    else if (dist < v * (v / maxacc + (maxjerk > 0 ? maxacc / maxjerk : 0)))
+    {
+        double b = maxjerk > 0 ? maxacc / maxjerk : 0;
+        v = maxacc * (-b + sqrt(b * b + 4 * dist / maxacc)) / 2;
+        if (maxjerk > 0 && v * maxjerk < maxacc * maxacc)
+            v = pow(dist * dist * maxjerk / 4, 1.0 / 3.0);
+    }
+
+    sp->vp = v;
+    sp->jerk = maxjerk;
+    if (maxjerk > 0 && v * maxjerk < maxacc * maxacc)
+    {
+        sp->ap = sqrt(v * maxjerk);
+        sp->tj = sp->ap / maxjerk;
+        sp->ta = 2 * sp->tj;
+    }
+    else
+    {
+        sp->ap = maxacc;
+        sp->tj = maxjerk > 0 ? maxacc / maxjerk : 0;
+        sp->ta = v / maxacc + sp->tj;
+    }
+    sp->t = dist / v + sp->ta;
+}
+
+/* distance covered t secs into the acceleration phase of *sp */
+static double scurveAccPos(SCurve *sp, double t)
+{
+    double t1;
+
+    if (t > sp->ta / 2)
+        return (sp->vp * (t - sp->ta / 2) + scurveAccPos(sp, sp->ta - t));
+    if (t <= sp->tj)
+        return (sp->jerk * t * t * t / 6);
+    t1 = t - sp->tj;
+    return (sp->jerk * sp->tj * sp->tj * sp->tj / 6 + sp->ap * sp->tj / 2 * t1 + sp->ap * t1 * t1 / 2);
+}
+
+/* return the seconds needed for a jerk-limited rest-to-rest move of dist rads.
+ * a maxjerk <= 0 gives the same result as trapMoveTime().
+ */
+double scurveMoveTime(double dist, double maxvel, double maxacc, double maxjerk)
+{
+    SCurve s;
+
+    scurveShape(&s, dist, maxvel, maxacc, maxjerk);
+    return (s.t);
+}
+
+/* return how far along a jerk-limited rest-to-rest move of dist rads the axis
+ * is t secs after starting. the result has the sign of dist and is clamped to
+ * 0 before the move starts and to dist after it ends.
+ */
+double scurveMovePos(double dist, double maxvel, double maxacc, double maxjerk, double t)
+{
+    SCurve s;
+    double x;
+
+    scurveShape(&s, dist, maxvel, maxacc, maxjerk);
+    if (t <= 0 || s.dist == 0)
+        x = 0;
+    else if (t >= s.t)
+        x = s.dist;
+    else if (t > s.t / 2)
+        x = s.dist - (t < s.t - s.ta ? s.vp * (s.t - s.ta - t) + s.vp * s.ta / 2 : scurveAccPos(&s, s.t - t));
+    else
+        x = t < s.ta ? scurveAccPos(&s, t) : s.vp * s.ta / 2 + s.vp * (t - s.ta);
+
+    return (dist < 0 ? -x : x);
+}
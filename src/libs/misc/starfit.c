@@ -0,0 +1,698 @@
+/* fit a 2D gaussian or moffat profile to a star in a cutout of a frame.
+ *
+ * this is meant to take over from gaussfit(), which fits a 1D gaussian to
+ * one line of pixels by simplex through a global. here a circular profile is
+ * fit to the whole cutout by Levenberg-Marquardt, using analytic derivatives,
+ * with all state on the stack so any number of threads may fit at once.
+ *
+ * the gaussian is separable, so each evaluation needs only w+h calls to
+ * exp() and, past one pass over the pixels for their sums against the x
+ * functions, works in sums along a row and a column; see evalGauss(). for a
+ * gaussian star this runs well ahead of gaussfit() while fitting every pixel.
+ *
+ * the moffat is not separable: its residuals and derivatives are formed for
+ * rows packed into float arrays of up to SFMAXDIM pixels, then summed into
+ * the normal equations by dot products. both kinds of loop are plain enough
+ * to vectorise; see the flags given this file in CMakeLists.txt. it costs
+ * several times the gaussian and is not for speed: it is for when the wings
+ * of the profile matter, as for the fwhm of a seeing limited star, which the
+ * gaussian gets badly wrong. a near gaussian star drives beta to its upper
+ * limit, where it is then held.
+ *
+ * starFitBatch() shares many cutouts out among threads, as schedOrder().
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "starfit.h"
+
+#define SFMAXP 6         /* most parameters, moffat */
+#define SFMINDIM 3       /* smallest cutout side, pixels */
+#define SFMAXDIM 256     /* largest cutout side, pixels */
+#define SFMAXITER 50     /* most iterations */
+#define SFTOL 1e-5       /* fractional chisqr improvement deemed converged */
+#define SFLAMBDA0 1e-3   /* initial damping */
+#define SFMAXLAMBDA 1e10 /* give up trying to improve when damping this hard */
+#define SFMINWIDTH 0.3   /* narrowest profile we believe, pixels */
+#define SFBETA0 2.5      /* starting moffat beta */
+#define SFMINBETA 1.01   /* moffat beta limits */
+#define SFMAXBETA 20.0
+#define SFMAXTHREADS 64  /* most threads starFitBatch() will use */
+
+#define FWHMSIG 2.3548200450309493 /* gaussian fwhm / sigma, 2 sqrt(2 ln 2) */
+
+/* parameter indices */
+enum
+{
+    P_BG,
+    P_AMP,
+    P_X,
+    P_Y,
+    P_W,
+    P_BETA
+};
+
+/* the normal equations, summed over the cutout */
+typedef struct
+{
+    double jtj[SFMAXP][SFMAXP]; /* J'J, upper triangle */
+    double jtr[SFMAXP];         /* J'r */
+    double chisqr;              /* r'r */
+} Normal;
+
+/* what each starFitBatch() thread is to do */
+typedef struct
+{
+    StarCutout *cuts; /* all the cutouts */
+    int n;            /* how many */
+    int first;        /* first for this thread */
+    int stride;       /* then every stride'th */
+} Worker;
+
+/* the functions of x or of y that make up the gaussian, see evalGauss() */
+enum
+{
+    GF_1,   /* 1 */
+    GF_G,   /* g */
+    GF_GD,  /* g d */
+    GF_GDD, /* g d^2 */
+    NGF
+};
+
+/* one term of a gaussian derivative: c times an x function times a y one */
+typedef struct
+{
+    double c; /* coefficient */
+    int x, y; /* GF_* */
+} GTerm;
+
+typedef void (*EvalFunc)(const float pix[], int stride, int w, int h, const double p[], Normal *nep);
+
+static int guess(const float pix[], int stride, int w, int h, int model, double p[]);
+static void evalGauss(const float pix[], int stride, int w, int h, const double p[], Normal *nep);
+static void evalMoffat(const float pix[], int stride, int w, int h, const double p[], Normal *nep);
+static void gaussFuncs(int n, double c, double is2, double f[NGF][SFMAXDIM]);
+static double dotd(const double a[], const double b[], int n);
+static void sumRows(float jr[][SFMAXDIM], const float r[], int np, int n, Normal *nep);
+static float sum(const float a[], int n);
+static double sumsqr(const float a[], int n);
+static float dot(const float a[], const float b[], int n);
+static inline float vlogf(float x);
+static inline float vexpf(float x);
+static int solve(double a[SFMAXP][SFMAXP], double b[], int n);
+static int inBounds(const double p[], int model, int w, int h);
+static void *worker(void *arg);
+static int cmpFloat(const void *a, const void *b);
+
+/* fit the given model to the star in the w x h cutout starting at pix[],
+ * whose rows are stride pixels apart. the star is taken to be the brightest
+ * pixel, on a background found from the edges of the cutout.
+ * return 0 with the result in *fp, else -1 if there is no star to fit or the
+ * cutout is too small or large.
+ */
+int starFit(const float pix[], int stride, int w, int h, int model, StarFit *fp)
+{
+    EvalFunc eval = model == SF_MOFFAT ? evalMoffat : evalGauss;
+    int np = model == SF_MOFFAT ? 6 : 5;
+    double p[SFMAXP], pn[SFMAXP], a[SFMAXP][SFMAXP], d[SFMAXP];
+    double lambda = SFLAMBDA0;
+    Normal ne, nen;
+    int iter, k, l;
+
+    if ((model != SF_GAUSS && model != SF_MOFFAT) || w < SFMINDIM || h < SFMINDIM || w > SFMAXDIM || h > SFMAXDIM ||
+        stride < w)
+        return (-1);
+    if (guess(pix, stride, w, h, model, p) < 0)
+        return (-1);
+    (*eval)(pix, stride, w, h, p, &ne);
+
+    for (iter = 0; iter < SFMAXITER; iter++)
+    {
+        int nfree = np;
+        int better = 0;
+
+        /* a moffat beta at a limit that would go beyond it is held there,
+         * as a near gaussian star wants to, else every step is out of bounds
+         */
+        if (model == SF_MOFFAT && ((p[P_BETA] >= SFMAXBETA && ne.jtr[P_BETA] > 0) ||
+                                   (p[P_BETA] <= SFMINBETA && ne.jtr[P_BETA] < 0)))
+            nfree = P_BETA;
+
+        /* try a step, damped by lambda */
+        for (k = 0; k < nfree; k++)
+        {
+            for (l = k; l < nfree; l++)
+                a[k][l] = ne.jtj[k][l];
+            a[k][k] *= 1 + lambda;
+            d[k] = ne.jtr[k];
+        }
+        if (solve(a, d, nfree) == 0)
+        {
+            for (k = 0; k < np; k++)
+                pn[k] = k < nfree ? p[k] + d[k] : p[k];
+            if (model == SF_MOFFAT)
+                pn[P_BETA] = pn[P_BETA] < SFMINBETA ? SFMINBETA : pn[P_BETA] > SFMAXBETA ? SFMAXBETA : pn[P_BETA];
+            if (inBounds(pn, model, w, h))
+            {
+                (*eval)(pix, stride, w, h, pn, &nen);
+                better = nen.chisqr < ne.chisqr;
+            }
+        }
+
+        /* keep it and trust the linear model more, else damp harder */
+        if (better)
+        {
+            int done = ne.chisqr - nen.chisqr <= SFTOL * ne.chisqr;
+
+            memcpy(p, pn, np * sizeof(double));
+            ne = nen;
+            lambda /= 10;
+            if (done)
+                break;
+        }
+        else if ((lambda *= 10) > SFMAXLAMBDA)
+            break;
+    }
+
+    fp->model = model;
+    fp->bg = p[P_BG];
+    fp->amp = p[P_AMP];
+    fp->x = p[P_X];
+    fp->y = p[P_Y];
+    fp->width = p[P_W];
+    if (model == SF_MOFFAT)
+    {
+        fp->beta = p[P_BETA];
+        fp->fwhm = 2 * p[P_W] * sqrt(pow(2.0, 1 / p[P_BETA]) - 1);
+    }
+    else
+    {
+        fp->beta = 0;
+        fp->fwhm = FWHMSIG * p[P_W];
+    }
+    fp->rms = sqrt(ne.chisqr / (w * h));
+    fp->niter = iter;
+
+    return (0);
+}
+
+/* fit each of the n cuts[], using up to nthreads threads */
+void starFitBatch(StarCutout cuts[], int n, int nthreads)
+{
+    pthread_t tids[SFMAXTHREADS];
+    Worker wkrs[SFMAXTHREADS];
+    int i;
+
+    if (n <= 0)
+        return;
+    if (nthreads > SFMAXTHREADS)
+        nthreads = SFMAXTHREADS;
+    if (nthreads > n)
+        nthreads = n;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    for (i = 0; i < nthreads; i++)
+    {
+        wkrs[i].cuts = cuts;
+        wkrs[i].n = n;
+        wkrs[i].first = i;
+        wkrs[i].stride = nthreads;
+    }
+
+    /* run the first in this thread, the rest alongside */
+    for (i = 1; i < nthreads; i++)
+        if (pthread_create(&tids[i], NULL, worker, &wkrs[i]) != 0)
+            tids[i] = 0;
+    worker(&wkrs[0]);
+    for (i = 1; i < nthreads; i++)
+    {
+        if (tids[i])
+            pthread_join(tids[i], NULL);
+        else
+            worker(&wkrs[i]); /* couldn't start it, so do it here */
+    }
+}
+
+/* fit every stride'th cutout from first */
+static void *worker(void *arg)
+{
+    Worker *wp = (Worker *)arg;
+    int i;
+
+    for (i = wp->first; i < wp->n; i += wp->stride)
+    {
+        StarCutout *cp = &wp->cuts[i];
+
+        cp->ok = starFit(cp->pix, cp->stride, cp->w, cp->h, cp->model, &cp->fit);
+    }
+
+    return (NULL);
+}
+
+/* make a first guess at the parameters p[] of model.
+ * return 0 if ok, -1 if nothing rises above the background.
+ */
+static int guess(const float pix[], int stride, int w, int h, int model, double p[])
+{
+    float edge[4 * SFMAXDIM];
+    double s = 0, sx = 0, sy = 0;
+    double fwhm, half;
+    float max;
+    int ne = 0, nhalf = 0;
+    int mx = 0, my = 0;
+    int i, j;
+
+    /* background is the median of the edge pixels */
+    for (i = 0; i < w; i++)
+    {
+        edge[ne++] = pix[i];
+        edge[ne++] = pix[(h - 1) * stride + i];
+    }
+    for (j = 1; j < h - 1; j++)
+    {
+        edge[ne++] = pix[j * stride];
+        edge[ne++] = pix[j * stride + w - 1];
+    }
+    qsort(edge, ne, sizeof(float), cmpFloat);
+    p[P_BG] = edge[ne / 2];
+
+    /* star is the brightest pixel */
+    max = pix[0];
+    for (j = 0; j < h; j++)
+        for (i = 0; i < w; i++)
+            if (pix[j * stride + i] > max)
+            {
+                max = pix[j * stride + i];
+                mx = i;
+                my = j;
+            }
+    p[P_AMP] = max - p[P_BG];
+    if (p[P_AMP] <= 0)
+        return (-1);
+
+    /* centre is the centroid of the 3x3 about it */
+    for (j = my - 1; j <= my + 1; j++)
+        for (i = mx - 1; i <= mx + 1; i++)
+            if (i >= 0 && i < w && j >= 0 && j < h && pix[j * stride + i] > p[P_BG])
+            {
+                double v = pix[j * stride + i] - p[P_BG];
+
+                s += v;
+                sx += v * i;
+                sy += v * j;
+            }
+    p[P_X] = sx / s;
+    p[P_Y] = sy / s;
+
+    /* width is that of a disc of the area above half max */
+    half = p[P_BG] + p[P_AMP] / 2;
+    for (j = 0; j < h; j++)
+        for (i = 0; i < w; i++)
+            if (pix[j * stride + i] > half)
+                nhalf++;
+    fwhm = 2 * sqrt(nhalf / M_PI);
+    if (fwhm < 1)
+        fwhm = 1;
+    if (model == SF_MOFFAT)
+    {
+        p[P_BETA] = SFBETA0;
+        p[P_W] = fwhm / (2 * sqrt(pow(2.0, 1 / SFBETA0) - 1));
+    }
+    else
+        p[P_W] = fwhm / FWHMSIG;
+
+    return (0);
+}
+
+/* form the normal equations of the gaussian with parameters p[].
+ * the profile and each derivative is a sum of products of a function of x
+ * and one of y, each of them 1, g, g d or g d^2 where g is the gaussian and
+ * d the distance from the centre along that axis. so J'J, and the model's
+ * part of J'r and chisqr, follow from sums of those over a row and over a
+ * column. only the pixels' part needs the whole cutout, as the sum of each
+ * row times each x function, and the sum of the squares.
+ */
+static void evalGauss(const float pix[], int stride, int w, int h, const double p[], Normal *nep)
+{
+    double xf[NGF][SFMAXDIM], yf[NGF][SFMAXDIM];
+    double sx[NGF][NGF], sy[NGF][NGF], dm[NGF][NGF];
+    double is2 = 1 / (p[P_W] * p[P_W]), is3 = is2 / p[P_W];
+    double bg = p[P_BG], amp = p[P_AMP];
+    double p2 = 0, m2;
+    GTerm gt[5][2];
+    int nt[5];
+    int a, b, i, j, k, l, t, u;
+
+    /* each derivative as its terms */
+    memset(gt, 0, sizeof(gt));
+    gt[P_BG][0] = (GTerm){1, GF_1, GF_1};
+    gt[P_AMP][0] = (GTerm){1, GF_G, GF_G};
+    gt[P_X][0] = (GTerm){amp * is2, GF_GD, GF_G};
+    gt[P_Y][0] = (GTerm){amp * is2, GF_G, GF_GD};
+    gt[P_W][0] = (GTerm){amp * is3, GF_GDD, GF_G};
+    gt[P_W][1] = (GTerm){amp * is3, GF_G, GF_GDD};
+    nt[P_BG] = nt[P_AMP] = nt[P_X] = nt[P_Y] = 1;
+    nt[P_W] = 2;
+
+    gaussFuncs(w, p[P_X], is2, xf);
+    gaussFuncs(h, p[P_Y], is2, yf);
+    for (a = 0; a < NGF; a++)
+        for (b = a; b < NGF; b++)
+        {
+            sx[a][b] = sx[b][a] = dotd(xf[a], xf[b], w);
+            sy[a][b] = sy[b][a] = dotd(yf[a], yf[b], h);
+        }
+
+    /* dm[a][b] is the sum of each pixel times x function a times y function b */
+    memset(dm, 0, sizeof(dm));
+    for (j = 0; j < h; j++)
+    {
+        const float *row = &pix[j * stride];
+        double r0 = 0, r1 = 0, r2 = 0, r3 = 0, q = 0;
+
+#pragma omp simd reduction(+ : r0, r1, r2, r3, q)
+        for (i = 0; i < w; i++)
+        {
+            double v = row[i];
+
+            r0 += v;
+            r1 += v * xf[GF_G][i];
+            r2 += v * xf[GF_GD][i];
+            r3 += v * xf[GF_GDD][i];
+            q += v * v;
+        }
+        p2 += q;
+        for (b = 0; b < NGF; b++)
+        {
+            dm[GF_1][b] += r0 * yf[b][j];
+            dm[GF_G][b] += r1 * yf[b][j];
+            dm[GF_GD][b] += r2 * yf[b][j];
+            dm[GF_GDD][b] += r3 * yf[b][j];
+        }
+    }
+
+    memset(nep, 0, sizeof(*nep));
+    for (k = 0; k < 5; k++)
+        for (t = 0; t < nt[k]; t++)
+        {
+            GTerm *tk = &gt[k][t];
+
+            /* J'r is the pixels' part less the model's, bg + amp g g */
+            nep->jtr[k] += tk->c * (dm[tk->x][tk->y] - bg * sx[tk->x][GF_1] * sy[tk->y][GF_1] -
+                                    amp * sx[tk->x][GF_G] * sy[tk->y][GF_G]);
+            for (l = k; l < 5; l++)
+                for (u = 0; u < nt[l]; u++)
+                {
+                    GTerm *tl = &gt[l][u];
+
+                    nep->jtj[k][l] += tk->c * tl->c * sx[tk->x][tl->x] * sy[tk->y][tl->y];
+                }
+        }
+
+    /* r'r as pixels^2 - 2 pixels.model + model^2, never less than 0 */
+    m2 = bg * bg * w * h + 2 * bg * amp * sx[GF_1][GF_G] * sy[GF_1][GF_G] +
+         amp * amp * sx[GF_G][GF_G] * sy[GF_G][GF_G];
+    nep->chisqr = p2 - 2 * (bg * dm[GF_1][GF_1] + amp * dm[GF_G][GF_G]) + m2;
+    if (nep->chisqr < 0)
+        nep->chisqr = 0;
+}
+
+/* fill f[][] with the n values of each gaussian function along one axis
+ * whose centre is at c.
+ */
+static void gaussFuncs(int n, double c, double is2, double f[NGF][SFMAXDIM])
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        double d = i - c;
+        double g = exp(-0.5 * d * d * is2);
+
+        f[GF_1][i] = 1;
+        f[GF_G][i] = g;
+        f[GF_GD][i] = g * d;
+        f[GF_GDD][i] = g * d * d;
+    }
+}
+
+/* return the dot product of a[] and b[] */
+static double dotd(const double a[], const double b[], int n)
+{
+    double s = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        s += a[i] * b[i];
+
+    return (s);
+}
+
+/* form the normal equations of the moffat with parameters p[] */
+static void evalMoffat(const float pix[], int stride, int w, int h, const double p[], Normal *nep)
+{
+    float jr[6][SFMAXDIM], r[SFMAXDIM];
+    float dx[SFMAXDIM];
+    float bg = p[P_BG], amp = p[P_AMP], beta = p[P_BETA];
+    float ia = 1 / p[P_W], ia2 = ia * ia;
+    int i, j, n;
+
+    memset(nep, 0, sizeof(*nep));
+
+    for (i = 0; i < w; i++)
+    {
+        dx[i] = i - p[P_X];
+    }
+
+    for (j = 0, n = 0; j < h; j++, n += w)
+    {
+        const float *row = &pix[j * stride];
+        float dy = j - p[P_Y];
+
+        if (n + w > SFMAXDIM)
+        {
+            sumRows(jr, r, 6, n, nep);
+            n = 0;
+        }
+
+#pragma omp simd
+        for (i = 0; i < w; i++)
+        {
+            float r2 = dx[i] * dx[i] + dy * dy;
+            float u = 1 + r2 * ia2;
+            float lu = vlogf(u);
+            float e = vexpf(-beta * lu);
+            float am = amp * e;
+            float t = 2 * am * beta * ia2 / u;
+
+            r[n + i] = row[i] - (bg + am);
+            jr[P_AMP][n + i] = e;
+            jr[P_X][n + i] = t * dx[i];
+            jr[P_Y][n + i] = t * dy;
+            jr[P_W][n + i] = t * r2 * ia;
+            jr[P_BETA][n + i] = -am * lu;
+        }
+    }
+    sumRows(jr, r, 6, n, nep);
+}
+
+/* add the n residuals r[] and derivatives jr[][] of one or more rows to
+ * *nep. the derivative for the background is always 1 so jr[P_BG] is not
+ * used: its products are just sums.
+ */
+static void sumRows(float jr[][SFMAXDIM], const float r[], int np, int n, Normal *nep)
+{
+    int k, l;
+
+    nep->chisqr += sumsqr(r, n);
+    nep->jtr[P_BG] += sum(r, n);
+    nep->jtj[P_BG][P_BG] += n;
+    for (k = P_BG + 1; k < np; k++)
+    {
+        nep->jtr[k] += dot(jr[k], r, n);
+        nep->jtj[P_BG][k] += sum(jr[k], n);
+        for (l = k; l < np; l++)
+            nep->jtj[k][l] += dot(jr[k], jr[l], n);
+    }
+}
+
+/* return the sum of the squares of a[], in double as it decides convergence */
+static double sumsqr(const float a[], int n)
+{
+    double s = 0;
+    int i;
+
+#pragma omp simd reduction(+ : s) simdlen(16)
+    for (i = 0; i < n; i++)
+        s += (double)a[i] * a[i];
+
+    return (s);
+}
+
+/* return the sum of a[] */
+static float sum(const float a[], int n)
+{
+    float s = 0;
+    int i;
+
+#pragma omp simd reduction(+ : s) simdlen(16)
+    for (i = 0; i < n; i++)
+        s += a[i];
+
+    return (s);
+}
+
+/* return the dot product of a[] and b[] */
+static float dot(const float a[], const float b[], int n)
+{
+    float s = 0;
+    int i;
+
+#pragma omp simd reduction(+ : s) simdlen(16)
+    for (i = 0; i < n; i++)
+        s += a[i] * b[i];
+
+    return (s);
+}
+
+/* logf() for x > 0, to within a few ulp, written so it vectorises.
+ * glibc only offers vector logf() and expf() with -ffast-math, which we would
+ * rather not have, so these are after the cephes versions.
+ */
+static inline float vlogf(float x)
+{
+    union {
+        float f;
+        int32_t i;
+    } u = {x};
+    float m, f, z, y;
+    int e, big;
+
+    /* x = m 2^e, m in [sqrt(.5), sqrt(2)) */
+    e = ((u.i >> 23) & 0xff) - 127;
+    u.i = (u.i & 0x007fffff) | 0x3f800000;
+    big = u.f > (float)M_SQRT2;
+    m = big ? u.f * 0.5f : u.f;
+    e += big;
+
+    f = m - 1;
+    z = f * f;
+    y = 7.0376836292e-2f;
+    y = y * f - 1.1514610310e-1f;
+    y = y * f + 1.1676998740e-1f;
+    y = y * f - 1.2420140846e-1f;
+    y = y * f + 1.4249322787e-1f;
+    y = y * f - 1.6668057665e-1f;
+    y = y * f + 2.0000714765e-1f;
+    y = y * f - 2.4999993993e-1f;
+    y = y * f + 3.3333331174e-1f;
+    y = y * f * z - 2.12194440e-4f * e - 0.5f * z;
+
+    return (f + y + 0.693359375f * e);
+}
+
+/* expf() for x <= 0, to within a few ulp, written so it vectorises.
+ * x is held above where the result would be denormal.
+ */
+static inline float vexpf(float x)
+{
+    union {
+        float f;
+        int32_t i;
+    } u;
+    float t, z, y;
+    int n;
+
+    x = x < -87.0f ? -87.0f : x;
+
+    /* x = n ln2 + t, t in [-ln2/2, ln2/2] */
+    t = x * (float)M_LOG2E;
+    n = (int)(t < 0 ? t - 0.5f : t + 0.5f);
+    t = x - 0.693359375f * n + 2.12194440e-4f * n;
+
+    z = t * t;
+    y = 1.9875691500e-4f;
+    y = y * t + 1.3981999507e-3f;
+    y = y * t + 8.3334519073e-3f;
+    y = y * t + 4.1665795894e-2f;
+    y = y * t + 1.6666665459e-1f;
+    y = y * t + 5.0000001201e-1f;
+    y = y * z + t + 1;
+
+    u.i = (n + 127) << 23;
+    return (y * u.f);
+}
+
+/* solve a x = b, leaving x in b, by cholesky decomposition of the upper
+ * triangle of a, which is destroyed.
+ * return 0 if ok, -1 if a is not positive definite.
+ */
+static int solve(double a[SFMAXP][SFMAXP], double b[], int n)
+{
+    int i, j, k;
+
+    /* a = u'u, u upper triangular, in place */
+    for (j = 0; j < n; j++)
+    {
+        double s = a[j][j];
+
+        for (k = 0; k < j; k++)
+            s -= a[k][j] * a[k][j];
+        if (s <= 0)
+            return (-1);
+        a[j][j] = sqrt(s);
+        for (i = j + 1; i < n; i++)
+        {
+            double t = a[j][i];
+
+            for (k = 0; k < j; k++)
+                t -= a[k][j] * a[k][i];
+            a[j][i] = t / a[j][j];
+        }
+    }
+
+    /* u'y = b then ux = y */
+    for (i = 0; i < n; i++)
+    {
+        double s = b[i];
+
+        for (k = 0; k < i; k++)
+            s -= a[k][i] * b[k];
+        b[i] = s / a[i][i];
+    }
+    for (i = n - 1; i >= 0; --i)
+    {
+        double s = b[i];
+
+        for (k = i + 1; k < n; k++)
+            s -= a[i][k] * b[k];
+        b[i] = s / a[i][i];
+    }
+
+    return (0);
+}
+
+/* return 1 if p[] is a believable star in a w x h cutout, else 0 */
+static int inBounds(const double p[], int model, int w, int h)
+{
+    if (!(p[P_AMP] > 0) || !(p[P_W] >= SFMINWIDTH) || p[P_W] > (w > h ? w : h))
+        return (0);
+    if (!(p[P_X] >= -0.5 && p[P_X] <= w - 0.5 && p[P_Y] >= -0.5 && p[P_Y] <= h - 0.5))
+        return (0);
+    if (model == SF_MOFFAT && !(p[P_BETA] >= SFMINBETA && p[P_BETA] <= SFMAXBETA))
+        return (0);
+    return (1);
+}
+
+/* qsort compare for floats */
+static int cmpFloat(const void *a, const void *b)
+{
+    float d = *(float *)a - *(float *)b;
+
+    return (d < 0 ? -1 : d > 0 ? 1 : 0);
+}
@@ -0,0 +1,38 @@
+/* include file for the reentrant 2D star profile fitter */
+
+#ifndef STARFIT_H
+#define STARFIT_H
+
+/* profile models */
+#define SF_GAUSS 0  /* bg + amp * exp(-r^2/(2 width^2)) */
+#define SF_MOFFAT 1 /* bg + amp * (1 + r^2/width^2)^-beta */
+
+/* the best fit to one star */
+typedef struct
+{
+    int model;     /* SF_GAUSS or SF_MOFFAT */
+    double bg;     /* background level */
+    double amp;    /* peak above bg */
+    double x, y;   /* centre, pixels from the first of the cutout */
+    double width;  /* gaussian sigma or moffat alpha, pixels */
+    double beta;   /* moffat beta, 0 for gaussian */
+    double fwhm;   /* full width at half max, pixels */
+    double rms;    /* rms residual per pixel */
+    int niter;     /* iterations used */
+} StarFit;
+
+/* one cutout for starFitBatch() */
+typedef struct
+{
+    const float *pix; /* first pixel of the cutout */
+    int stride;       /* pixels from the start of one row to the next */
+    int w, h;         /* cutout size, pixels */
+    int model;        /* SF_GAUSS or SF_MOFFAT */
+    StarFit fit;      /* result */
+    int ok;           /* 0 if fit is good, else -1 */
+} StarCutout;
+
+extern int starFit(const float pix[], int stride, int w, int h, int model, StarFit *fp);
+extern void starFitBatch(StarCutout cuts[], int n, int nthreads);
+
+#endif // STARFIT_H
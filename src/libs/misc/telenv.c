@@ -10,10 +10,11 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "P_.h"
 #include "strops.h"
 #include "telenv.h"
 
-static char *telhome;
+static THREADLOCAL char *telhome;
 static char telhome_def[] = "/usr/local/telescope";
 
 static void getTELHOME(void);
@@ -128,8 +129,17 @@ int telOELog(char *progname)
  */
 char *timestamp(time_t t)
 {
-    static char str[15];
-    struct tm *tmp = gmtime(&t);
+    static THREADLOCAL char str[15];
+
+    return (timestamp_r(t, str));
+}
+
+/* as timestamp() but into the caller's str[], which must hold at least 15.
+ * for threads that share a static one otherwise, such as the log writer.
+ */
+char *timestamp_r(time_t t, char str[])
+{
+    struct tm tm, *tmp = gmtime_r(&t, &tm);
 
     if (!tmp)
         sprintf(str, "gmtime failed!"); /* N.B. same length */
@@ -142,15 +152,23 @@ char *timestamp(time_t t)
 
 /* rather like printf but prepends timestamp().
  * also appends \n if not in result.
+ * if logRingInit() has been called the message goes by way of the ring, so
+ * fmt must then be a string that lasts, such as a literal.
  */
 void daemonLog(char *fmt, ...)
 {
-    char buf[1024];
+    char buf[1024], ts[15];
     va_list ap;
     int l;
 
+    va_start(ap, fmt);
+    l = logRingV(fmt, ap);
+    va_end(ap);
+    if (l == 0)
+        return;
+
     /* start with time stamp */
-    l = sprintf(buf, "%s: ", timestamp(time(NULL)));
+    l = sprintf(buf, "%s: ", timestamp_r(time(NULL), ts));
 
     /* format the message */
     va_start(ap, fmt);
@@ -169,6 +187,14 @@ void daemonLog(char *fmt, ...)
     fflush(stdout);
 }
 
+/* use dir as TELHOME for this thread, rather than the environment.
+ * this lets each telescope simulated in one process have its own files.
+ */
+void setTELHOME(char *dir)
+{
+    telhome = dir;
+}
+
 static void getTELHOME()
 {
     if (telhome)
@@ -1,6 +1,16 @@
+#include <stdarg.h>
+
 extern FILE *telfopen(char *name, char *how);
 extern int telopen(char *name, int flags, ...);
 extern void telfixpath(char *new, char *old);
+extern void setTELHOME(char *dir);
 extern int telOELog(char *progname);
 extern char *timestamp(time_t t);
+extern char *timestamp_r(time_t t, char str[]);
 extern void daemonLog(char *fmt, ...);
+
+/* logring.c */
+extern int logRingInit(int nslots);
+extern int logRing(const char *fmt, ...);
+extern int logRingV(const char *fmt, va_list ap);
+extern int logRingFlush(double secs);
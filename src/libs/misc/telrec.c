@@ -0,0 +1,571 @@
+/* write and read telemetry recordings, see telrec.h.
+ *
+ * there is one writer per process: trOpen(), trPut() once per poll, trCmd()
+ * for each command, trClose() when done. any number of recordings may be
+ * read at once with trMap(), even one still being written.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telrec.h"
+
+#define TRIDXMAGIC "TRINDEX"
+#define MAXENC (TRCHUNK * 9) /* worst encoded bytes for one column */
+
+static char *colnames[TR_NCOL] = {
+    "mjd",  "state", "hraw",  "hcpos", "hdpos", "hcvel", "draw",  "dcpos", "ddpos", "dcvel", "rraw",
+    "rcpos", "rdpos", "rcvel", "mdha",  "mddec", "jdha",  "jddec", "caha",  "cadec", "daha",  "dadec",
+};
+
+/* writer state */
+static int wfd = -1;                      /* file being written, or -1 */
+static long long woff;                    /* its length so far */
+static double wrows[TRCHUNK][TR_NCOL];    /* records waiting to be written */
+static int wn;                            /* how many */
+static time_t wfirst;                     /* wall time the first was put */
+static TRIndex *widx;                     /* every chunk written */
+static int nwidx, mwidx;                  /* used and malloced */
+static unsigned char wbuf[TR_NCOL * MAXENC]; /* payload being encoded */
+
+static int writeChunk(TRChunkHdr *hp, void *payload);
+static int writeAll(void *p, int n);
+static double predict(int i, double p1, double p2);
+static int chunkOk(TRFile *tfp, long long off, TRChunkHdr *hp);
+static int encode(double *v, int stride, int n, unsigned char *out);
+static int decode(unsigned char *in, unsigned char *end, int n, double *v, int stride);
+
+/* return the name of column col */
+char *trColName(int col)
+{
+    return (col >= 0 && col < TR_NCOL ? colnames[col] : "?");
+}
+
+/* return the column with the given name, or -1 */
+int trColFind(char *name)
+{
+    int i;
+
+    for (i = 0; i < TR_NCOL; i++)
+        if (!strcmp(name, colnames[i]))
+            return (i);
+    return (-1);
+}
+
+/* start a new recording in fn, closing any open one first.
+ * return 0 if ok, else -1 with errno set.
+ */
+int trOpen(char *fn)
+{
+    TRFileHdr fh;
+    int i;
+
+    trClose();
+
+    wfd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (wfd < 0)
+        return (-1);
+    woff = 0;
+    wn = 0;
+    nwidx = 0;
+
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, TRMAGIC, sizeof(fh.magic));
+    fh.version = TRVERSION;
+    fh.ncol = TR_NCOL;
+    for (i = 0; i < TR_NCOL; i++)
+        strncpy(fh.colname[i], colnames[i], sizeof(fh.colname[i]) - 1);
+    if (writeAll(&fh, sizeof(fh)) < 0)
+    {
+        int e = errno;
+        close(wfd);
+        wfd = -1;
+        errno = e;
+        return (-1);
+    }
+    return (0);
+}
+
+/* add one record, writing a chunk when TRCHUNK have built up or the first
+ * has waited TRFLUSH secs.
+ * return 0 if ok, else -1 with errno set.
+ */
+int trPut(double v[TR_NCOL])
+{
+    if (wfd < 0)
+    {
+        errno = EBADF;
+        return (-1);
+    }
+
+    if (wn == 0)
+        wfirst = time(NULL);
+    memcpy(wrows[wn++], v, sizeof(wrows[0]));
+
+    if (wn == TRCHUNK || time(NULL) - wfirst >= TRFLUSH)
+        return (trFlush());
+    return (0);
+}
+
+/* write a command msg received on fifo at mjd t, at once.
+ * return 0 if ok, else -1 with errno set.
+ */
+int trCmd(double t, char *fifo, char *msg)
+{
+    TRChunkHdr ch;
+    int l;
+
+    if (wfd < 0)
+    {
+        errno = EBADF;
+        return (-1);
+    }
+
+    memcpy(wbuf, &t, sizeof(t));
+    l = snprintf((char *)wbuf + sizeof(t), sizeof(wbuf) - sizeof(t), "%s %s", fifo, msg);
+    if (l >= (int)(sizeof(wbuf) - sizeof(t)))
+        l = sizeof(wbuf) - sizeof(t) - 1;
+
+    memset(&ch, 0, sizeof(ch));
+    ch.kind = TRK_CMDS;
+    ch.nrec = 1;
+    ch.nbytes = sizeof(t) + l + 1;
+    ch.t0 = ch.t1 = t;
+    return (writeChunk(&ch, wbuf));
+}
+
+/* write any records waiting as one chunk.
+ * return 0 if ok, else -1 with errno set.
+ */
+int trFlush()
+{
+    TRChunkHdr ch;
+    int c, n = 0;
+
+    if (wfd < 0)
+    {
+        errno = EBADF;
+        return (-1);
+    }
+    if (wn == 0)
+        return (0);
+
+    memset(&ch, 0, sizeof(ch));
+    ch.kind = TRK_POLL;
+    ch.nrec = wn;
+    ch.t0 = wrows[0][TR_MJD];
+    ch.t1 = wrows[wn - 1][TR_MJD];
+    for (c = 0; c < TR_NCOL; c++)
+    {
+        ch.coloff[c] = n;
+        n += encode(&wrows[0][c], TR_NCOL, wn, wbuf + n);
+    }
+    ch.nbytes = n;
+    wn = 0;
+
+    return (writeChunk(&ch, wbuf));
+}
+
+/* finish the recording, if any, with its index */
+void trClose()
+{
+    TRChunkHdr ch;
+    TRTrailer tr;
+
+    if (wfd < 0)
+        return;
+
+    if (trFlush() == 0)
+    {
+        memset(&ch, 0, sizeof(ch));
+        ch.kind = TRK_INDEX;
+        ch.nrec = nwidx;
+        ch.nbytes = nwidx * sizeof(TRIndex);
+        if (nwidx > 0)
+        {
+            ch.t0 = widx[0].t0;
+            ch.t1 = widx[nwidx - 1].t1;
+        }
+
+        memset(&tr, 0, sizeof(tr));
+        memcpy(tr.magic, TRIDXMAGIC, sizeof(TRIDXMAGIC));
+        tr.off = woff;
+        if (writeAll(&ch, sizeof(ch)) == 0 && writeAll(widx, ch.nbytes) == 0)
+            (void)writeAll(&tr, sizeof(tr));
+    }
+
+    close(wfd);
+    wfd = -1;
+}
+
+/* map the recording in fn for reading and index it.
+ * return 0 if ok, else -1 with errno set, EPROTO if not a recording we know.
+ */
+int trMap(char *fn, TRFile *tfp)
+{
+    TRFileHdr fh;
+    TRTrailer tr;
+    TRChunkHdr ch;
+    struct stat st;
+    long long off;
+    int fd, m;
+
+    memset(tfp, 0, sizeof(*tfp));
+
+    fd = open(fn, O_RDONLY);
+    if (fd < 0)
+        return (-1);
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return (-1);
+    }
+    if (st.st_size < (off_t)sizeof(fh))
+    {
+        close(fd);
+        errno = EPROTO;
+        return (-1);
+    }
+    tfp->len = st.st_size;
+    tfp->base = (unsigned char *)mmap(NULL, tfp->len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (tfp->base == (unsigned char *)MAP_FAILED)
+    {
+        tfp->base = NULL;
+        return (-1);
+    }
+
+    memcpy(&fh, tfp->base, sizeof(fh));
+    if (memcmp(fh.magic, TRMAGIC, sizeof(fh.magic)) || fh.version != TRVERSION || fh.ncol != TR_NCOL)
+    {
+        trUnmap(tfp);
+        errno = EPROTO;
+        return (-1);
+    }
+
+    /* use the index if closed cleanly and every entry in it agrees with the
+     * chunk it points to.
+     */
+    memcpy(&tr, tfp->base + tfp->len - sizeof(tr), sizeof(tr));
+    if (!memcmp(tr.magic, TRIDXMAGIC, sizeof(TRIDXMAGIC)) && chunkOk(tfp, tr.off, &ch) && ch.kind == TRK_INDEX)
+    {
+        int i;
+
+        tfp->idx = (TRIndex *)malloc(ch.nbytes + 1);
+        if (!tfp->idx)
+        {
+            trUnmap(tfp);
+            errno = ENOMEM;
+            return (-1);
+        }
+        memcpy(tfp->idx, tfp->base + tr.off + sizeof(ch), ch.nbytes);
+        tfp->nidx = ch.nrec;
+        for (i = 0; i < tfp->nidx; i++)
+        {
+            TRIndex *ip = &tfp->idx[i];
+            TRChunkHdr ich;
+
+            if (!chunkOk(tfp, ip->off, &ich) || ich.kind != ip->kind || ich.nrec != ip->nrec ||
+                ich.kind == TRK_INDEX)
+                break;
+        }
+        if (i == tfp->nidx)
+            return (0);
+        free(tfp->idx);
+        tfp->idx = NULL;
+        tfp->nidx = 0;
+    }
+
+    /* else walk the chunks, stopping at one cut short */
+    m = 0;
+    for (off = sizeof(fh); off + (long long)sizeof(ch) <= tfp->len; off += sizeof(ch) + ch.nbytes)
+    {
+        if (!chunkOk(tfp, off, &ch))
+            break;
+        if (ch.kind == TRK_INDEX)
+            continue;
+        if (tfp->nidx == m)
+        {
+            TRIndex *newidx = (TRIndex *)realloc(tfp->idx, (m = m ? 2 * m : 256) * sizeof(TRIndex));
+            if (!newidx)
+            {
+                trUnmap(tfp);
+                errno = ENOMEM;
+                return (-1);
+            }
+            tfp->idx = newidx;
+        }
+        tfp->idx[tfp->nidx].t0 = ch.t0;
+        tfp->idx[tfp->nidx].t1 = ch.t1;
+        tfp->idx[tfp->nidx].off = off;
+        tfp->idx[tfp->nidx].kind = ch.kind;
+        tfp->idx[tfp->nidx].nrec = ch.nrec;
+        tfp->nidx++;
+    }
+
+    return (0);
+}
+
+/* undo trMap() */
+void trUnmap(TRFile *tfp)
+{
+    if (tfp->base)
+        munmap(tfp->base, tfp->len);
+    if (tfp->idx)
+        free(tfp->idx);
+    memset(tfp, 0, sizeof(*tfp));
+}
+
+/* return the index of the first chunk that ends at or after mjd t, or nidx if
+ * none. chunks are written in time order so their ends never go backwards.
+ */
+int trSeek(TRFile *tfp, double t)
+{
+    int lo = 0, hi = tfp->nidx;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (tfp->idx[mid].t1 < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo);
+}
+
+/* decode chunk i, if it is TRK_POLL, into rows, which must hold TRCHUNK.
+ * return number of rows, 0 if not a poll chunk, or -1 with errno set if bad.
+ */
+int trRows(TRFile *tfp, int i, double rows[][TR_NCOL])
+{
+    TRIndex *ip = &tfp->idx[i];
+    TRChunkHdr ch;
+    unsigned char *payload;
+    int c;
+
+    if (ip->kind != TRK_POLL)
+        return (0);
+
+    memcpy(&ch, tfp->base + ip->off, sizeof(ch));
+    payload = tfp->base + ip->off + sizeof(ch);
+    if (ch.nrec < 0 || ch.nrec > TRCHUNK)
+    {
+        errno = EPROTO;
+        return (-1);
+    }
+
+    for (c = 0; c < TR_NCOL; c++)
+    {
+        int end = c < TR_NCOL - 1 ? ch.coloff[c + 1] : ch.nbytes;
+        if (ch.coloff[c] < 0 || end < ch.coloff[c] || end > ch.nbytes ||
+            decode(payload + ch.coloff[c], payload + end, ch.nrec, &rows[0][c], TR_NCOL) != end - ch.coloff[c])
+        {
+            errno = EPROTO;
+            return (-1);
+        }
+    }
+    return (ch.nrec);
+}
+
+/* walk the commands in chunk i. pass p NULL for the first, then the value
+ * returned for each after. return "fifo msg" and its mjd, or NULL when no
+ * more or if not a command chunk.
+ */
+char *trCmdNext(TRFile *tfp, int i, char *p, double *mjdp)
+{
+    TRIndex *ip = &tfp->idx[i];
+    TRChunkHdr ch;
+    char *payload, *end;
+
+    if (ip->kind != TRK_CMDS)
+        return (NULL);
+
+    memcpy(&ch, tfp->base + ip->off, sizeof(ch));
+    payload = (char *)tfp->base + ip->off + sizeof(ch);
+    end = payload + ch.nbytes;
+
+    p = p ? p + strlen(p) + 1 : payload;
+    if (p + sizeof(double) >= end)
+        return (NULL);
+    memcpy(mjdp, p, sizeof(double));
+    p += sizeof(double);
+    if (!memchr(p, '\0', end - p))
+        return (NULL);
+    return (p);
+}
+
+/* copy the chunk header at off into *hp and check it describes a chunk that
+ * lies wholly within the file, with as many records as its payload can hold.
+ * return 1 if so, else 0.
+ */
+static int chunkOk(TRFile *tfp, long long off, TRChunkHdr *hp)
+{
+    if (off < (long long)sizeof(TRFileHdr) || off + (long long)sizeof(*hp) > tfp->len)
+        return (0);
+    memcpy(hp, tfp->base + off, sizeof(*hp));
+    if (hp->nbytes < 0 || hp->nrec < 0 || off + (long long)sizeof(*hp) + hp->nbytes > tfp->len)
+        return (0);
+
+    switch (hp->kind)
+    {
+    case TRK_POLL:
+        /* at least the one byte each value takes, in every column */
+        return (hp->nrec <= TRCHUNK && (long long)hp->nrec * TR_NCOL <= hp->nbytes);
+    case TRK_CMDS:
+        /* at least a time and a NUL each */
+        return ((long long)hp->nrec * (sizeof(double) + 1) <= hp->nbytes);
+    case TRK_INDEX:
+        return ((long long)hp->nrec * sizeof(TRIndex) == hp->nbytes);
+    default:
+        return (0);
+    }
+}
+
+/* write a chunk and note it in the index.
+ * return 0 if ok, else -1 with errno set.
+ */
+static int writeChunk(TRChunkHdr *hp, void *payload)
+{
+    TRIndex *ip;
+
+    if (nwidx == mwidx)
+    {
+        TRIndex *newidx = (TRIndex *)realloc(widx, (mwidx ? 2 * mwidx : 256) * sizeof(TRIndex));
+        if (!newidx)
+            return (-1);
+        widx = newidx;
+        mwidx = mwidx ? 2 * mwidx : 256;
+    }
+    ip = &widx[nwidx];
+    ip->t0 = hp->t0;
+    ip->t1 = hp->t1;
+    ip->off = woff;
+    ip->kind = hp->kind;
+    ip->nrec = hp->nrec;
+
+    if (writeAll(hp, sizeof(*hp)) < 0 || writeAll(payload, hp->nbytes) < 0)
+        return (-1);
+    nwidx++;
+    return (0);
+}
+
+/* write n bytes at p to wfd and count them in woff.
+ * return 0 if ok, else -1 with errno set.
+ */
+static int writeAll(void *p, int n)
+{
+    char *cp = (char *)p;
+
+    while (n > 0)
+    {
+        int w = write(wfd, cp, n);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        cp += w;
+        n -= w;
+        woff += w;
+    }
+    return (0);
+}
+
+/* guess value i of a column from the two before it */
+static double predict(int i, double p1, double p2)
+{
+    if (i == 0)
+        return (0.0);
+    if (i == 1)
+        return (p1);
+    return (2 * p1 - p2);
+}
+
+/* encode n values, each stride apart starting at v, into out.
+ * each value is xor'd with its prediction and stored as one byte giving the
+ * count of leading zero bytes << 4 | count of bytes kept, then those bytes,
+ * most significant first. the zero bytes trailing them are implied.
+ * return number of bytes used.
+ */
+static int encode(double *v, int stride, int n, unsigned char *out)
+{
+    unsigned char *op = out;
+    double p1 = 0, p2 = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        double pred = predict(i, p1, p2);
+        unsigned long long a, b, x;
+        int lz, tz, nb;
+
+        memcpy(&a, &v[i * stride], sizeof(a));
+        memcpy(&b, &pred, sizeof(b));
+        x = a ^ b;
+        if (x == 0)
+            *op++ = 0;
+        else
+        {
+            lz = __builtin_clzll(x) / 8;
+            tz = __builtin_ctzll(x) / 8;
+            nb = 8 - lz - tz;
+            *op++ = (unsigned char)(lz << 4 | nb);
+            for (x >>= 8 * tz; nb > 0; nb--)
+                *op++ = (unsigned char)(x >> 8 * (nb - 1));
+        }
+
+        p2 = p1;
+        p1 = v[i * stride];
+    }
+
+    return (op - out);
+}
+
+/* undo encode(): decode n values from in into v, each stride apart, reading
+ * no further than end.
+ * return number of bytes used, or -1 if they are not a valid encoding.
+ */
+static int decode(unsigned char *in, unsigned char *end, int n, double *v, int stride)
+{
+    unsigned char *ip = in;
+    double p1 = 0, p2 = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        double pred = predict(i, p1, p2);
+        unsigned long long b, x = 0;
+        int h, lz, nb;
+
+        if (ip >= end)
+            return (-1);
+        h = *ip++;
+        lz = h >> 4;
+        nb = h & 0xf;
+        if (lz + nb > 8 || ip + nb > end)
+            return (-1);
+        for (; nb > 0; nb--)
+            x = x << 8 | *ip++;
+        if (h)
+            x <<= 8 * (8 - lz - (h & 0xf));
+
+        memcpy(&b, &pred, sizeof(b));
+        b ^= x;
+        memcpy(&v[i * stride], &b, sizeof(b));
+
+        p2 = p1;
+        p1 = v[i * stride];
+    }
+
+    return (ip - in);
+}
@@ -0,0 +1,101 @@
+/* include file for telemetry recordings: telescoped state at every poll.
+ *
+ * a recording is a file header followed by chunks. each poll chunk holds up
+ * to TRCHUNK records stored column by column, so a reader decodes only what
+ * it needs. each value is xor'd with a linear prediction from the two before
+ * it in the same column and only its nonzero bytes kept, which is lossless
+ * and small for smoothly changing positions and constant state. commands
+ * received are kept in their own chunks, written as they arrive. a file
+ * closed cleanly ends with an index of all chunks by time; one cut short is
+ * indexed by walking the chunk headers, losing at most the last chunk.
+ */
+
+#ifndef TELREC_H
+#define TELREC_H
+
+#define TRMAGIC "TALONREC" /* first 8 bytes of a recording */
+#define TRVERSION 1        /* bump when layout changes */
+#define TRCHUNK 1024       /* most records in one chunk */
+#define TRFLUSH 5          /* most wall secs a record waits in memory */
+
+/* columns of each record */
+typedef enum
+{
+    TR_MJD,   /* telstatshm now.n_mjd */
+    TR_STATE, /* telstate */
+    TR_HRAW, TR_HCPOS, TR_HDPOS, TR_HCVEL, /* TEL_HM raw, cpos, dpos, cvel */
+    TR_DRAW, TR_DCPOS, TR_DDPOS, TR_DCVEL, /* TEL_DM */
+    TR_RRAW, TR_RCPOS, TR_RDPOS, TR_RCVEL, /* TEL_RM */
+    TR_MDHA, TR_MDDEC, /* mesh corrections */
+    TR_JDHA, TR_JDDEC, /* jogging offsets */
+    TR_CAHA, TR_CADEC, /* current apparent HA/Dec */
+    TR_DAHA, TR_DADEC, /* desired apparent HA/Dec */
+    TR_NCOL
+} TRCol;
+
+/* kinds of chunk */
+typedef enum
+{
+    TRK_POLL = 1, /* TR_NCOL columns of nrec values */
+    TRK_CMDS,     /* nrec of: double mjd, then "fifo msg" with a NUL */
+    TRK_INDEX     /* nrec TRIndex, one per chunk before it */
+} TRKind;
+
+/* file header */
+typedef struct
+{
+    char magic[8];              /* TRMAGIC */
+    int version;                /* TRVERSION */
+    int ncol;                   /* TR_NCOL */
+    char colname[TR_NCOL][12];  /* see trColName() */
+} TRFileHdr;
+
+/* chunk header, payload follows directly */
+typedef struct
+{
+    int kind;            /* TRKind */
+    int nrec;            /* records in it */
+    int nbytes;          /* bytes of payload */
+    int coloff[TR_NCOL]; /* iff TRK_POLL: column starts within payload */
+    double t0, t1;       /* first and last mjd in it */
+} TRChunkHdr;
+
+/* one index entry */
+typedef struct
+{
+    double t0, t1;  /* as in its TRChunkHdr */
+    long long off;  /* file offset of its TRChunkHdr */
+    int kind, nrec; /* as in its TRChunkHdr */
+} TRIndex;
+
+/* last bytes of a file closed cleanly */
+typedef struct
+{
+    char magic[8];  /* "TRINDEX" */
+    long long off;  /* file offset of the TRK_INDEX chunk */
+} TRTrailer;
+
+/* a recording opened for reading */
+typedef struct
+{
+    unsigned char *base; /* whole file, mmap'd */
+    long long len;       /* its length */
+    TRIndex *idx;        /* every complete chunk, in file order */
+    int nidx;
+} TRFile;
+
+/* telrec.c */
+extern char *trColName(int col);
+extern int trColFind(char *name);
+extern int trOpen(char *fn);
+extern int trPut(double v[TR_NCOL]);
+extern int trCmd(double t, char *fifo, char *msg);
+extern int trFlush(void);
+extern void trClose(void);
+extern int trMap(char *fn, TRFile *tfp);
+extern void trUnmap(TRFile *tfp);
+extern int trSeek(TRFile *tfp, double t);
+extern int trRows(TRFile *tfp, int i, double rows[][TR_NCOL]);
+extern char *trCmdNext(TRFile *tfp, int i, char *p, double *mjdp);
+
+#endif /* TELREC_H */
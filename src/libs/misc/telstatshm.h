@@ -148,6 +148,17 @@ typedef struct
      * SuperWASP specific state is below
      */
 
+    /* look-ahead for the current target, iff TS_HUNTING/TRACKING */
+    double tlimit; /* secs it may be tracked before reaching a limit, or at
+                    * least so long while limaxis is -1 and the look-ahead
+                    * is still running; 0 when not tracking */
+    int limaxis;   /* TEL_HM etc to reach it first, or -1 if none in 12 hrs */
+
+    /* bumped by telescoped whenever anything above changes other than what
+     * follows from the clock alone, so clients can skip work when it has not
+     */
+    unsigned int gen;
+
 } TelStatShm;
 
 /* handy shortcuts that check things for being ready for normal observing */
@@ -176,4 +187,11 @@ extern void tel_ideal2realxy(TelAxes *tap, double *Xp, double *Yp);
 extern int tel_solve_axes(double H[], double D[], double X[], double Y[], int nstars, double ftol, TelAxes *tap,
                           double fitp[]);
 
+/* slewtime.c */
+extern double trapMoveTime(double dist, double maxvel, double maxacc);
+extern double axisSlewTime(MotorInfo *mip, double from, double to);
+extern long slewTimeUs(MotorInfo *mip[], double from[], double to[], int n);
+extern double scurveMoveTime(double dist, double maxvel, double maxacc, double maxjerk);
+extern double scurveMovePos(double dist, double maxvel, double maxacc, double maxjerk, double t);
+
 #endif // TELSTATSHM_H
@@ -0,0 +1,234 @@
+/* record spans of time spent in named regions of code, per thread, and write
+ * them as Chrome trace JSON.
+ *
+ * each thread that records gets its own buffer the first time, holding the
+ * most recent NSPANS spans, so recording takes no locks and a dump shows
+ * what led up to it. a span is kept when it ends, with its start and
+ * duration, so spans cut off by the buffer wrapping are never half shown.
+ *
+ * a dump may be asked for at any time, including from a signal handler, by
+ * traceRequestDump(), or automatically when an outermost span takes longer
+ * than set by traceStall(). the dump itself is done by the next call to
+ * traceCheck() from the daemon's main loop.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "telenv.h"
+#include "trace.h"
+
+#define NSPANS 65536    /* spans kept per thread */
+#define MAXDEPTH 32     /* deepest nesting recorded */
+#define STALLHOLD 60.0  /* secs after a stall dump before another */
+
+/* one finished span */
+typedef struct
+{
+    const char *name; /* as given to TRACE_BEGIN */
+    long long t0;     /* CLOCK_MONOTONIC at start, ns */
+    long long dur;    /* duration, ns */
+} Span;
+
+/* all spans recorded by one thread */
+typedef struct TraceBuf
+{
+    struct TraceBuf *next;          /* list of all buffers */
+    int tid;                        /* kernel thread id */
+    int gen;                        /* tracegen when depth was last valid */
+    int depth;                      /* spans now open */
+    const char *open[MAXDEPTH];     /* names of open spans */
+    long long start[MAXDEPTH];      /* when they started */
+    atomic_ulong n;                 /* spans ever finished */
+    Span spans[NSPANS];             /* last NSPANS of them */
+} TraceBuf;
+
+volatile int traceOn;
+
+static TraceBuf *bufs;                  /* all buffers */
+static pthread_mutex_t buflock = PTHREAD_MUTEX_INITIALIZER; /* guards bufs */
+static __thread TraceBuf *mybuf;     /* this thread's */
+static atomic_int tracegen;             /* bumped each time enabled */
+static long long stallns;               /* outermost spans longer dump, 0 never */
+static long long lastdump;              /* when last stall dump was asked for */
+static atomic_int dumpwanted;           /* set when a dump is wanted */
+
+static long long nowNs(void);
+static TraceBuf *newBuf(void);
+
+/* start or stop recording.
+ * spans open when recording starts are not recorded.
+ */
+void traceEnable(int on)
+{
+    if (on && !traceOn)
+        atomic_fetch_add(&tracegen, 1);
+    traceOn = on;
+}
+
+/* ask for a dump when an outermost span lasts more than ms, or never if 0 */
+void traceStall(double ms)
+{
+    stallns = (long long)(ms * 1e6);
+}
+
+/* note the start of the named span */
+void traceBegin(const char *name)
+{
+    TraceBuf *tp = mybuf;
+    int gen = atomic_load_explicit(&tracegen, memory_order_relaxed);
+
+    if (!tp && !(tp = mybuf = newBuf()))
+        return;
+    if (tp->gen != gen)
+    {
+        /* forget spans left open when recording last stopped */
+        tp->gen = gen;
+        tp->depth = 0;
+    }
+
+    if (tp->depth < MAXDEPTH)
+    {
+        tp->open[tp->depth] = name;
+        tp->start[tp->depth] = nowNs();
+    }
+    tp->depth++;
+}
+
+/* note the end of the named span and record it */
+void traceEnd(const char *name)
+{
+    TraceBuf *tp = mybuf;
+    unsigned long n;
+    long long t1;
+    Span *sp;
+
+    if (!tp || tp->depth == 0 || tp->gen != atomic_load_explicit(&tracegen, memory_order_relaxed))
+        return;
+    if (--tp->depth >= MAXDEPTH)
+        return;
+    if (tp->open[tp->depth] != name && strcmp(tp->open[tp->depth], name))
+    {
+        /* unbalanced, perhaps by a return between; start again */
+        tp->depth = 0;
+        return;
+    }
+
+    t1 = nowNs();
+    n = atomic_load_explicit(&tp->n, memory_order_relaxed);
+    sp = &tp->spans[n % NSPANS];
+    sp->name = name;
+    sp->t0 = tp->start[tp->depth];
+    sp->dur = t1 - sp->t0;
+    atomic_store_explicit(&tp->n, n + 1, memory_order_release);
+
+    if (tp->depth == 0 && stallns > 0 && sp->dur > stallns && t1 - lastdump > (long long)(STALLHOLD * 1e9))
+    {
+        lastdump = t1;
+        atomic_store(&dumpwanted, 1);
+    }
+}
+
+/* ask for a dump at the next traceCheck(). safe from a signal handler. */
+void traceRequestDump()
+{
+    atomic_store(&dumpwanted, 1);
+}
+
+/* if a dump is wanted write one to archive/logs/<progname>-<time>.json.
+ * call this regularly from the main loop.
+ * return 1 if wrote one, 0 if none wanted, -1 if trouble.
+ */
+int traceCheck(char *progname)
+{
+    char fn[1024], path[1024];
+
+    if (!atomic_exchange(&dumpwanted, 0))
+        return (0);
+
+    sprintf(fn, "archive/logs/%s-%s.json", progname, timestamp(time(NULL)));
+    telfixpath(path, fn);
+    if (traceDump(path) < 0)
+    {
+        daemonLog("%s: %s", path, strerror(errno));
+        return (-1);
+    }
+    daemonLog("Trace written to %s", path);
+    return (1);
+}
+
+/* write all recorded spans to fn as Chrome trace JSON.
+ * spans being recorded by other threads meanwhile may be missed.
+ * return 0 if ok, else -1 with errno set.
+ */
+int traceDump(char *fn)
+{
+    int pid = getpid();
+    char *sep = "";
+    TraceBuf *tp;
+    FILE *fp;
+
+    fp = fopen(fn, "w");
+    if (!fp)
+        return (-1);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    pthread_mutex_lock(&buflock);
+    for (tp = bufs; tp; tp = tp->next)
+    {
+        unsigned long n = atomic_load_explicit(&tp->n, memory_order_acquire);
+        unsigned long i = n > NSPANS ? n - NSPANS : 0;
+
+        for (; i < n; i++)
+        {
+            Span *sp = &tp->spans[i % NSPANS];
+
+            fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", sep,
+                    sp->name, pid, tp->tid, sp->t0 / 1e3, sp->dur / 1e3);
+            sep = ",";
+        }
+    }
+    pthread_mutex_unlock(&buflock);
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp) == EOF)
+        return (-1);
+    return (0);
+}
+
+/* return CLOCK_MONOTONIC in ns */
+static long long nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+/* make a buffer for this thread and add it to bufs.
+ * return it, or NULL if no memory.
+ */
+static TraceBuf *newBuf()
+{
+    TraceBuf *tp = (TraceBuf *)calloc(1, sizeof(TraceBuf));
+
+    if (!tp)
+        return (NULL);
+    tp->tid = (int)syscall(SYS_gettid);
+    tp->gen = atomic_load(&tracegen);
+
+    pthread_mutex_lock(&buflock);
+    tp->next = bufs;
+    bufs = tp;
+    pthread_mutex_unlock(&buflock);
+
+    return (tp);
+}
@@ -0,0 +1,40 @@
+/* include file for span tracing of daemon hot paths.
+ *
+ * bracket a region with TRACE_BEGIN("name") and TRACE_END("name"), using
+ * the same literal for both. nothing is recorded until traceEnable(1); the
+ * spans may then be written as Chrome trace JSON, which chrome://tracing and
+ * ui.perfetto.dev both read. build with -DTRACE_SPANS to compile the macros in.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef TRACE_SPANS
+#define TRACE_BEGIN(name)                                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (traceOn)                                                                                                   \
+            traceBegin(name);                                                                                          \
+    } while (0)
+#define TRACE_END(name)                                                                                                \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (traceOn)                                                                                                   \
+            traceEnd(name);                                                                                            \
+    } while (0)
+#else
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#endif
+
+extern volatile int traceOn; /* set while recording, see traceEnable() */
+
+extern void traceEnable(int on);
+extern void traceStall(double ms);
+extern void traceBegin(const char *name);
+extern void traceEnd(const char *name);
+extern void traceRequestDump(void);
+extern int traceCheck(char *progname);
+extern int traceDump(char *fn);
+
+#endif /* TRACE_H */
@@ -0,0 +1,75 @@
+/* a clock that may run faster than real time, for simulations.
+ *
+ * until vclockInit() is called, or after vclockInit(1, 0), the clock is just
+ * the wall clock. with rate > 0 it runs that many times faster than real time;
+ * with rate 0 it only advances when the caller says it has waited, so a poll
+ * loop runs as fast as the cpu allows while still seeing regular time steps.
+ * the clock may also start at any mjd, such as the beginning of a past night.
+ * each thread has its own clock.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "misc.h"
+
+static THREADLOCAL double vrate = 1; /* sim secs per real sec, 0 for stepped */
+static THREADLOCAL double wmjd0;     /* wall clock when started */
+static THREADLOCAL double smjd0;     /* sim clock when started */
+static THREADLOCAL double smjd;      /* sim clock now, when stepped */
+static THREADLOCAL int vset;         /* set when anything but the wall clock */
+
+/* start the clock at mjd0, or now if 0, running rate times real time.
+ * rate 0 means advance only by vclockWait().
+ */
+void vclockInit(double rate, double mjd0)
+{
+    wmjd0 = mjd_now();
+    smjd0 = mjd0 > 0 ? mjd0 : wmjd0;
+    smjd = smjd0;
+    vrate = rate < 0 ? 1 : rate;
+    vset = vrate != 1 || smjd0 != wmjd0;
+}
+
+/* return rate the clock is running, 0 if stepped */
+double vclockRate()
+{
+    return (vrate);
+}
+
+/* return the current mjd according to the clock */
+double vclockMJD()
+{
+    if (!vset)
+        return (mjd_now());
+    if (vrate == 0)
+        return (smjd);
+    return (smjd0 + (mjd_now() - wmjd0) * vrate);
+}
+
+/* the caller wants to wait us simulated microseconds.
+ * return the real microseconds it should wait for that.
+ * if stepped, the clock advances by us now and the caller need not wait.
+ */
+long vclockWait(long us)
+{
+    if (!vset)
+        return (us);
+    if (vrate == 0)
+    {
+        smjd += us / 1e6 / SPD;
+        return (0);
+    }
+    return ((long)(us / vrate));
+}
+
+/* return 1 if the clock is just the wall clock, else 0 */
+int vclockIsWall()
+{
+    return (!vset);
+}
@@ -0,0 +1,441 @@
+/* time the main entry points of the astro library.
+ *
+ * each benchmark is a loop of one kind of call, each at a slightly later
+ * time so results cached by the library for a given mjd are not reused. it
+ * is run until it has warmed up, then sized so one sample takes about -t ms,
+ * then timed for -n samples. for each one line is printed with the mean
+ * nanosecs per call and its 95% confidence interval, the median and the
+ * fastest sample.
+ *
+ * the process is pinned to one cpu so samples are not spread across cores
+ * with different caches and clocks.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "satlib.h"
+
+#define STARTMJD 46311.4167 /* when the sky is computed, 2026 Oct 17 22h UTC */
+#define STEP (1.0 / SPD)    /* days between successive calls */
+#define MAXSAMPLES 1000     /* most -n */
+
+/* one benchmark */
+typedef struct
+{
+    char *name;                /* as printed */
+    void (*fn)(int arg, long); /* run the call n times */
+    int arg;                   /* passed to fn */
+} Bench;
+
+static void usage(void);
+static int pinCpu(int cpu);
+static double nowSecs(void);
+static double runFor(Bench *bp, long n);
+static void runBench(Bench *bp);
+static int cmpDouble(const void *a, const void *b);
+static double tValue(int df);
+static void b_obj_cir(int i, long n);
+static void b_vsop87(int prec, long n);
+static void b_moon(int i, long n);
+static void b_nutation(int i, long n);
+static void b_precess(int i, long n);
+static void b_riset_cir(int i, long n);
+static void b_sgp4(int i, long n);
+static void b_db_crack_line(int i, long n);
+
+/* objects used, as database lines */
+static char *dblines[] = {
+#define DB_FIXED 0
+    "Altair,f|S|A7,19:50:47,8:52:06,0.8,2000",
+#define DB_ELLIPTICAL 1
+    "Ceres,e,10.5935,80.3099,73.1153,2.767046,0.2141,0.07553,113.4104,10/27/2007,2000,H3.34,0.12",
+#define DB_HYPERBOLIC 2
+    "C/1980 E1 Bowell,h,3/12.4/1982,1.6617,114.5576,1.057305,135.0761,3.363976,2000,g4.5,4.0",
+#define DB_PARABOLIC 3
+    "C/2007 E2 Lovejoy,p,3/27.5/2007,95.8836,1.09286,306.3934,8.8089,2000,g9.0,4.0",
+#define DB_LEO 4
+    "LEO,E,10/17.9/2026,51.64,100.0,0.0005,90.0,0.0,15.5,0,1000",
+#define DB_GEO 5
+    "GEO,E,10/17.9/2026,0.05,80.0,0.0002,270.0,0.0,1.0027,0,1000",
+#define DB_SUN 6
+    "Sun,P",
+#define DB_MOON 7
+    "Moon,P",
+#define DB_MARS 8
+    "Mars,P",
+#define DB_JUPITER 9
+    "Jupiter,P",
+};
+#define NDBLINES (sizeof(dblines) / sizeof(dblines[0]))
+
+static Bench benches[] = {
+    {"obj_cir fixed", b_obj_cir, DB_FIXED},
+    {"obj_cir elliptical", b_obj_cir, DB_ELLIPTICAL},
+    {"obj_cir hyperbolic", b_obj_cir, DB_HYPERBOLIC},
+    {"obj_cir parabolic", b_obj_cir, DB_PARABOLIC},
+    {"obj_cir earthsat leo", b_obj_cir, DB_LEO},
+    {"obj_cir earthsat geo", b_obj_cir, DB_GEO},
+    {"obj_cir sun", b_obj_cir, DB_SUN},
+    {"obj_cir moon", b_obj_cir, DB_MOON},
+    {"obj_cir mars", b_obj_cir, DB_MARS},
+    {"obj_cir jupiter", b_obj_cir, DB_JUPITER},
+    {"vsop87 mars full", b_vsop87, 0},
+    {"vsop87 mars 1e-6", b_vsop87, 6},
+    {"vsop87 mars 1e-4", b_vsop87, 4},
+    {"vsop87 mars 1e-3", b_vsop87, 3},
+    {"moon", b_moon, 0},
+    {"nutation", b_nutation, 0},
+    {"precess", b_precess, 0},
+    {"riset_cir fixed", b_riset_cir, DB_FIXED},
+    {"riset_cir sun", b_riset_cir, DB_SUN},
+    {"riset_cir moon", b_riset_cir, DB_MOON},
+    {"sgp4", b_sgp4, DB_LEO},
+    {"sdp4", b_sgp4, DB_GEO},
+    {"db_crack_line", b_db_crack_line, 0},
+};
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static char *me;
+static int nsamples = 20;       /* timed samples per benchmark */
+static double samplesecs = .05; /* target secs per sample */
+static double warmsecs = .2;    /* secs to run before timing */
+static Now now;                 /* site and time for obj_cir et al */
+static Obj objs[NDBLINES];      /* cracked dblines[] */
+static volatile double sink;    /* results go here so they are not optimised away */
+
+int main(int ac, char *av[])
+{
+    char *match = NULL;
+    int cpu = -1;
+    int i;
+
+    /* N.B. strops.h basenm() clashes with the _GNU_SOURCE string.h */
+    me = strrchr(av[0], '/') ? strrchr(av[0], '/') + 1 : av[0];
+
+    while ((--ac > 0) && ((*++av)[0] == '-'))
+    {
+        char *s;
+        for (s = av[0] + 1; *s != '\0'; s++)
+            switch (*s)
+            {
+            case 'c':
+                if (ac < 2)
+                    usage();
+                cpu = atoi(*++av);
+                ac--;
+                break;
+            case 'n':
+                if (ac < 2)
+                    usage();
+                nsamples = atoi(*++av);
+                ac--;
+                break;
+            case 't':
+                if (ac < 2)
+                    usage();
+                samplesecs = atof(*++av) / 1000;
+                ac--;
+                break;
+            case 'w':
+                if (ac < 2)
+                    usage();
+                warmsecs = atof(*++av) / 1000;
+                ac--;
+                break;
+            default:
+                usage();
+            }
+    }
+    if (ac > 1 || nsamples < 2 || nsamples > MAXSAMPLES || samplesecs <= 0)
+        usage();
+    if (ac == 1)
+        match = av[0];
+
+    if (pinCpu(cpu) < 0)
+    {
+        fprintf(stderr, "%s: can not pin to cpu %d: %s\n", me, cpu, strerror(errno));
+        exit(1);
+    }
+
+    /* a site at mid northern latitude */
+    now.n_mjd = STARTMJD;
+    now.n_lat = degrad(28.76);
+    now.n_lng = degrad(-17.88);
+    now.n_temp = 10;
+    now.n_pressure = 780;
+    now.n_elev = 2400 / ERAD;
+    now.n_epoch = EOD;
+    for (i = 0; i < NDBLINES; i++)
+    {
+        char whynot[256];
+
+        if (db_crack_line(dblines[i], &objs[i], whynot) < 0)
+        {
+            fprintf(stderr, "%s: %s: %s\n", me, dblines[i], whynot);
+            exit(1);
+        }
+    }
+
+    printf("# %-22s %10s %10s %10s %10s %10s\n", "benchmark", "ns/op", "+-95%", "median", "min", "ops/sample");
+    for (i = 0; i < NBENCHES; i++)
+        if (!match || strstr(benches[i].name, match))
+            runBench(&benches[i]);
+
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s [options] [name]\n", me);
+    fprintf(stderr, "Purpose: time astro library calls, optionally only those whose names contain name.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -c cpu   pin to this cpu; default the one we start on\n");
+    fprintf(stderr, "  -n n     samples per benchmark, 2..%d; default 20\n", MAXSAMPLES);
+    fprintf(stderr, "  -t ms    target time per sample; default 50\n");
+    fprintf(stderr, "  -w ms    time to run each before sampling; default 200\n");
+    exit(1);
+}
+
+/* pin this process to the given cpu, or the one it is on now if < 0.
+ * return 0 if ok, else -1.
+ */
+static int pinCpu(int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu < 0 && (cpu = sched_getcpu()) < 0)
+        return (-1);
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return (sched_setaffinity(0, sizeof(set), &set));
+}
+
+/* return a monotonic time in secs */
+static double nowSecs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* run bp for n calls and return the secs it took */
+static double runFor(Bench *bp, long n)
+{
+    double t0 = nowSecs();
+
+    (*bp->fn)(bp->arg, n);
+    return (nowSecs() - t0);
+}
+
+/* warm up, size, sample and report one benchmark */
+static void runBench(Bench *bp)
+{
+    double ns[MAXSAMPLES];
+    double t, mean, sd;
+    long n;
+    int i;
+
+    /* warm up, growing n until a run is long enough to time */
+    t = nowSecs() + warmsecs;
+    for (n = 1; runFor(bp, n) < samplesecs / 10 || nowSecs() < t;)
+        if (runFor(bp, n) < samplesecs / 10)
+            n *= 2;
+
+    /* size a sample */
+    n = (long)ceil(n * samplesecs / runFor(bp, n));
+    if (n < 1)
+        n = 1;
+
+    /* sample */
+    for (i = 0, mean = 0; i < nsamples; i++)
+    {
+        ns[i] = runFor(bp, n) * 1e9 / n;
+        mean += ns[i];
+    }
+    mean /= nsamples;
+    for (i = 0, sd = 0; i < nsamples; i++)
+        sd += (ns[i] - mean) * (ns[i] - mean);
+    sd = sqrt(sd / (nsamples - 1));
+    qsort(ns, nsamples, sizeof(double), cmpDouble);
+
+    printf("%-24s %10.1f %10.1f %10.1f %10.1f %10ld\n", bp->name, mean, tValue(nsamples - 1) * sd / sqrt(nsamples),
+           ns[nsamples / 2], ns[0], n);
+    fflush(stdout);
+}
+
+/* qsort compare for doubles */
+static int cmpDouble(const void *a, const void *b)
+{
+    double d = *(double *)a - *(double *)b;
+
+    return (d < 0 ? -1 : d > 0 ? 1 : 0);
+}
+
+/* return the two-sided 95% Student t value for df degrees of freedom */
+static double tValue(int df)
+{
+    static double t[] = {0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                         2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                         2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+    if (df < sizeof(t) / sizeof(t[0]))
+        return (t[df]);
+    if (df < 60)
+        return (2.00);
+    return (1.96);
+}
+
+/* obj_cir() of objs[i] */
+static void b_obj_cir(int i, long n)
+{
+    Now nw = now;
+    Obj o = objs[i];
+
+    while (n-- > 0)
+    {
+        nw.n_mjd += STEP;
+        obj_cir(&nw, &o);
+        sink = o.s_alt;
+    }
+}
+
+/* vsop87() of mars to a precision of 10^-prec, or full if 0.
+ * N.B. vsop87() refuses precisions coarser than 1e-3.
+ */
+static void b_vsop87(int prec, long n)
+{
+    double p = prec ? pow(10.0, -prec) : 0.0;
+    double m = now.n_mjd;
+    double ret[6];
+
+    while (n-- > 0)
+    {
+        m += STEP;
+        vsop87(m, MARS, p, ret);
+        sink = ret[0];
+    }
+}
+
+/* moon() */
+static void b_moon(int i, long n)
+{
+    double m = now.n_mjd;
+    double lam, bet, rho, msp, mdp;
+
+    while (n-- > 0)
+    {
+        m += STEP;
+        moon(m, &lam, &bet, &rho, &msp, &mdp);
+        sink = lam;
+    }
+}
+
+/* nutation() */
+static void b_nutation(int i, long n)
+{
+    double m = now.n_mjd;
+    double deps, dpsi;
+
+    while (n-- > 0)
+    {
+        m += STEP;
+        nutation(m, &deps, &dpsi);
+        sink = deps;
+    }
+}
+
+/* precess() from J2000 */
+static void b_precess(int i, long n)
+{
+    double m = now.n_mjd;
+
+    while (n-- > 0)
+    {
+        double ra = 1.0, dec = 0.5;
+
+        m += STEP;
+        precess(J2000, m, &ra, &dec);
+        sink = ra;
+    }
+}
+
+/* riset_cir() of objs[i], a new day each call */
+static void b_riset_cir(int i, long n)
+{
+    Now nw = now;
+    Obj o = objs[i];
+    RiseSet rs;
+
+    while (n-- > 0)
+    {
+        nw.n_mjd += 1 + STEP;
+        riset_cir(&nw, &o, 0.0, &rs);
+        sink = rs.rs_risetm;
+    }
+}
+
+/* propagate objs[i] with sgp4() or sdp4() as earthsat.c would choose,
+ * a minute later each call. the set up is done on the first call only.
+ */
+static void b_sgp4(int i, long n)
+{
+    Obj *op = &objs[i];
+    SatElem se;
+    SatData sd;
+    Vec3 pos, vel;
+    double dy, t = 0;
+    int yr;
+
+    memset((void *)&se, 0, sizeof(se));
+    memset((void *)&sd, 0, sizeof(sd));
+    sd.elem = &se;
+    mjd_dayno(op->es_epoch, &yr, &dy);
+    se.se_EPOCH = (yr - 1900) * 1000 + dy + 1;
+    se.se_XNO = op->es_n * (2 * PI / 1440.0);
+    se.se_XINCL = (float)degrad(op->es_inc);
+    se.se_XNODEO = (float)degrad(op->es_raan);
+    se.se_EO = op->es_e;
+    se.se_OMEGAO = (float)degrad(op->es_ap);
+    se.se_XMO = (float)degrad(op->es_M);
+    se.se_BSTAR = op->es_drag;
+    se.se_XNDT20 = op->es_decay * (2 * PI / 1440.0 / 1440.0);
+
+    while (n-- > 0)
+    {
+        t += 1.0;
+        if (se.se_XNO >= (1.0 / 225.0))
+            sgp4(&sd, &pos, &vel, t);
+        else
+            sdp4(&sd, &pos, &vel, t);
+        sink = pos.x;
+    }
+
+    if (sd.prop.sgp4)
+        free(sd.prop.sgp4);
+    if (sd.deep)
+        free(sd.deep);
+}
+
+/* db_crack_line() of each of dblines[] in turn */
+static void b_db_crack_line(int i, long n)
+{
+    Obj o;
+
+    while (n-- > 0)
+    {
+        db_crack_line(dblines[n % NDBLINES], &o, NULL);
+        sink = o.o_type;
+    }
+}
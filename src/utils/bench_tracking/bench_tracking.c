@@ -0,0 +1,523 @@
+/* benchmark the telescoped tracking path against the virtual axes.
+ *
+ * each case acquires one standard target from home with the same core as
+ * telescoped -v, then tracks it for a while on a stepped clock, so the
+ * simulated results are the same on every run:
+ *   pole:      near the celestial pole
+ *   zenith:    straight up
+ *   meridian:  crossing the meridian part way through the track
+ *   satellite: a low earth orbit satellite near culmination
+ * for each case one line is printed with the simulated secs to acquire, the
+ * mean thread cpu per poll while tracking, the mean cpu to build a track
+ * profile, and the rms and largest tracking error in arcsecs. the cpu times
+ * are in units of one obj_cir() timed in the same run, so they compare
+ * across machines and loads; that reference is printed as a comment in usecs.
+ *
+ * with -b the results are compared with a baseline in the same format, such
+ * as an earlier run saved to a file, and the exit status is 1 if any case got
+ * worse by more than the allowed margin. cases not in the baseline are not
+ * compared. the simulated results should repeat exactly; the cpu ratios
+ * should be close from one machine to another.
+ *
+ * TELHOME must have the telescoped config files.
+ * N.B. do not run from a directory containing archive/config.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "configfile.h"
+#include "csimc.h"
+#include "misc.h"
+#include "strops.h"
+#include "telenv.h"
+#include "telstatshm.h"
+
+#include "teled.h"
+
+#define POLLUS (2 * 1000000 / HZ) /* poll period, as telescoped */
+#define STARTMJD 46311.4167       /* default start, 2026 Oct 17 22h UTC */
+#define CMDTO 600.0               /* secs to wait for a command to complete */
+#define PASSDAYS 2.0              /* days to search for a satellite pass */
+#define PASSSTEP 20.0             /* secs between pass search samples */
+#define PASSLEAD 90.0             /* secs before culmination to start */
+#define SIMTOL 1.05               /* allowed simulated result growth */
+#define SIMABS 0.05               /* .. plus this much absolute */
+#define CPUTOL 2.0                /* default allowed cpu ratio growth */
+#define REFLOOPS 2000             /* obj_cir()s in the reference */
+#define REFTRIES 5                /* best of so many reference timings */
+#define NMETRIC 5                 /* metrics per case */
+
+/* the standard targets */
+typedef enum
+{
+    POLE,
+    ZENITH,
+    MERIDIAN,
+    SATELLITE
+} CaseId;
+
+/* one benchmark case */
+typedef struct
+{
+    char *name;              /* as printed */
+    CaseId id;               /* which target */
+    double secs;             /* secs to track after acquiring */
+    int failed;              /* set if it could not run */
+    char why[300];           /* reason, if failed, with room for a reply */
+    double m[NMETRIC];       /* results, in the order of mnames[] */
+    TelStatShm shm;          /* the core's status */
+} Case;
+
+static char *mnames[NMETRIC] = {"acqsecs", "pollref", "buildref", "rmsarcsec", "maxarcsec"};
+static int mcpu[NMETRIC] = {0, 1, 1, 0, 0}; /* which are cpu ratios */
+
+static Case cases[] = {
+    {.name = "pole", .id = POLE, .secs = 300, .failed = 0},
+    {.name = "zenith", .id = ZENITH, .secs = 300, .failed = 0},
+    {.name = "meridian", .id = MERIDIAN, .secs = 600, .failed = 0},
+    {.name = "satellite", .id = SATELLITE, .secs = 120, .failed = 0},
+};
+#define NCASES (sizeof(cases) / sizeof(cases[0]))
+
+static void usage(void);
+static void *runCase(void *arg);
+static int sendCmd(char *cmd, double *secsp);
+static double pollCore(void);
+static double threadCpu(void);
+static double refCpu(void);
+static double findPass(Now *np, Obj *op);
+static void satLine(double mjd0, char buf[]);
+static int compare(char *fn, double cputol);
+
+static char *me;
+static FILE *resfp; /* where results go; stdout gets the core's logs */
+static double startmjd = STARTMJD;
+static double refus; /* cpu usecs per obj_cir(), the unit of cpu ratios */
+static THREADLOCAL Case *cur; /* case this thread is running */
+static THREADLOCAL int code;  /* latest reply code to current command */
+static THREADLOCAL char reply[256];
+
+int main(int ac, char *av[])
+{
+    char *basefn = NULL;
+    double cputol = CPUTOL;
+    int i;
+
+    me = basenm(av[0]);
+
+    while ((--ac > 0) && ((*++av)[0] == '-'))
+    {
+        char *s;
+        for (s = av[0] + 1; *s != '\0'; s++)
+            switch (*s)
+            {
+            case 'b':
+                if (ac < 2)
+                    usage();
+                basefn = *++av;
+                ac--;
+                break;
+            case 'j':
+                if (ac < 2)
+                    usage();
+                startmjd = atof(*++av);
+                ac--;
+                break;
+            case 'x':
+                if (ac < 2)
+                    usage();
+                cputol = atof(*++av);
+                ac--;
+                break;
+            default:
+                usage();
+            }
+    }
+    if (ac > 0)
+        usage();
+
+    /* results to stdout, any logging of the core elsewhere */
+    resfp = fdopen(dup(1), "w");
+    if (!resfp || !freopen("/dev/null", "a", stdout))
+    {
+        fprintf(stderr, "%s: can not redirect logging: %s\n", me, strerror(errno));
+        exit(1);
+    }
+
+    /* the unit of cpu, timed just before the cases it measures */
+    refus = refCpu();
+    if (refus <= 0)
+    {
+        fprintf(stderr, "%s: can not time the reference\n", me);
+        exit(1);
+    }
+    fprintf(resfp, "# reference %.3f usecs\n", refus);
+
+    /* each case runs on a fresh thread so it starts with a fresh core */
+    fprintf(resfp, "# %-10s", "case");
+    for (i = 0; i < NMETRIC; i++)
+        fprintf(resfp, " %10s", mnames[i]);
+    fprintf(resfp, "\n");
+    for (i = 0; i < NCASES; i++)
+    {
+        Case *cp = &cases[i];
+        pthread_t t;
+        int j;
+
+        if (pthread_create(&t, NULL, runCase, cp) != 0)
+        {
+            fprintf(stderr, "%s: can not start a thread\n", me);
+            exit(1);
+        }
+        pthread_join(t, NULL);
+
+        if (cp->failed)
+        {
+            fprintf(resfp, "# %s failed: %s\n", cp->name, cp->why);
+            continue;
+        }
+        fprintf(resfp, "%-12s", cp->name);
+        for (j = 0; j < NMETRIC; j++)
+            fprintf(resfp, " %10.3f", cp->m[j]);
+        fprintf(resfp, "\n");
+    }
+    fflush(resfp);
+
+    for (i = 0; i < NCASES; i++)
+        if (cases[i].failed)
+            return (1);
+    if (basefn && compare(basefn, cputol) < 0)
+        return (1);
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s [options]\n", me);
+    fprintf(stderr, "Purpose: benchmark tracking against the virtual axes.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -b file  compare with baseline results in file; exit 1 if any regress\n");
+    fprintf(stderr, "  -j mjd   when to start, as in telstatshm; default %g\n", (double)STARTMJD);
+    fprintf(stderr, "  -x f     allowed growth factor in cpu ratios; default %g\n", (double)CPUTOL);
+    exit(1);
+}
+
+/* thread to run one case */
+static void *runCase(void *arg)
+{
+    Case *cp = (Case *)arg;
+    Now *np = &cp->shm.now;
+    double secs, end, sum2 = 0, max = 0, polls = 0;
+    double cpu = 0, buildsecs;
+    int nsum = 0, nbuilds;
+    char cmd[256];
+    double lst, ra;
+    Obj o;
+
+    /* fresh core on a stepped clock */
+    cur = cp;
+    vclockInit(0, startmjd);
+    telstatshmp = &cp->shm;
+    np->n_mjd = vclockMJD();
+    np->n_epoch = EOD;
+    virtual_mode = 1;
+    tel_msg("Reset");
+
+    /* the satellite sets its own start so it is well up */
+    if (cp->id == SATELLITE)
+    {
+        double mjd0;
+
+        satLine(startmjd, cmd);
+        if (db_crack_line(cmd, &o, NULL) < 0 || (mjd0 = findPass(np, &o)) == 0)
+        {
+            strcpy(cp->why, "no satellite pass found");
+            cp->failed = 1;
+            return (NULL);
+        }
+        vclockInit(0, mjd0 - PASSLEAD / SPD);
+        np->n_mjd = vclockMJD();
+    }
+
+    if (sendCmd("home", &secs) < 0)
+    {
+        snprintf(cp->why, sizeof(cp->why), "home: %s", reply);
+        cp->failed = 1;
+        return (NULL);
+    }
+
+    /* the target, from where the sky is now */
+    np->n_mjd = vclockMJD();
+    now_lst(np, &lst);
+    lst = hrrad(lst);
+    switch (cp->id)
+    {
+    case POLE:
+        sprintf(cmd, "RA:%.6f Dec:%.6f", lst + PI / 4, degrad(89.5));
+        break;
+    case ZENITH:
+        sprintf(cmd, "RA:%.6f Dec:%.6f", lst, np->n_lat);
+        break;
+    case MERIDIAN:
+        ra = lst + cp->secs / 2 / SPD * 2 * PI / SIDRATE; /* crosses half way */
+        sprintf(cmd, "RA:%.6f Dec:%.6f", ra, np->n_lat - degrad(30));
+        break;
+    case SATELLITE:
+        satLine(startmjd, cmd);
+        break;
+    }
+    if (sendCmd(cmd, &cp->m[0]) < 0)
+    {
+        snprintf(cp->why, sizeof(cp->why), "acquire: %s", reply);
+        cp->failed = 1;
+        return (NULL);
+    }
+
+    /* track, noting cpu each poll and error whenever locked on */
+    tel_trackstats(&nbuilds, &buildsecs);
+    end = vclockMJD() + cp->secs / SPD;
+    while (vclockMJD() < end)
+    {
+        MotorInfo *mip;
+        double e2 = 0;
+
+        cpu += pollCore();
+        polls++;
+        if (telstatshmp->telstate != TS_TRACKING)
+            continue;
+        for (mip = &telstatshmp->minfo[TEL_HM]; mip <= &telstatshmp->minfo[TEL_DM]; mip++)
+            if (mip->have)
+                e2 += delra(mip->cpos - mip->dpos) * delra(mip->cpos - mip->dpos);
+        sum2 += e2;
+        nsum++;
+        if (e2 > max)
+            max = e2;
+    }
+    if (nsum == 0)
+    {
+        strcpy(cp->why, "never tracked");
+        cp->failed = 1;
+        return (NULL);
+    }
+
+    cp->m[1] = 1e6 * cpu / polls / refus;
+    tel_msg("Stop");
+    tel_trackstats(&nbuilds, &buildsecs);
+    cp->m[2] = nbuilds > 0 ? 1e6 * buildsecs / nbuilds / refus : 0;
+    cp->m[3] = 3600 * raddeg(sqrt(sum2 / nsum));
+    cp->m[4] = 3600 * raddeg(sqrt(max));
+
+    return (NULL);
+}
+
+/* send cmd to the core and poll until it completes.
+ * return 0 and the simulated secs it took if ok, else -1.
+ */
+static int sendCmd(char *cmd, double *secsp)
+{
+    double mjd0 = vclockMJD();
+
+    code = 1;
+    strcpy(reply, "No response");
+    telstatshmp->now.n_mjd = mjd0;
+    tel_msg(cmd);
+    while (code > 0 && vclockMJD() < mjd0 + CMDTO / SPD)
+        (void)pollCore();
+
+    *secsp = (vclockMJD() - mjd0) * SPD;
+    return (code == 0 ? 0 : -1);
+}
+
+/* give the core one poll, as chk_fifos() does when no commands arrive.
+ * return the thread cpu secs it used.
+ */
+static double pollCore()
+{
+    double cpu0;
+
+    telstatshmp->now.n_mjd = vclockMJD();
+    cpu0 = threadCpu();
+    tel_msg(NULL);
+    cpu0 = threadCpu() - cpu0;
+    (void)vclockWait(POLLUS);
+
+    return (cpu0);
+}
+
+/* return cpu secs used so far by the calling thread */
+static double threadCpu()
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        return (0.0);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* time obj_cir(), much of what the core does while tracking.
+ * return its cpu usecs per call, the least of REFTRIES, or 0 if it can not
+ * be timed.
+ */
+static double refCpu()
+{
+    double best = 0;
+    Now n;
+    Obj o;
+    int i, j;
+
+    memset(&n, 0, sizeof(n));
+    n.n_mjd = startmjd;
+    n.n_lat = degrad(30);
+    n.n_epoch = EOD;
+    for (i = 0; i < REFTRIES; i++)
+    {
+        double cpu0 = threadCpu();
+
+        for (j = 0; j < REFLOOPS; j++)
+        {
+            memset(&o, 0, sizeof(o));
+            o.o_type = FIXED;
+            o.f_RA = j * 2 * PI / REFLOOPS;
+            o.f_dec = degrad(45);
+            o.f_epoch = J2000;
+            n.n_mjd = startmjd + j / SPD;
+            (void)obj_cir(&n, &o);
+        }
+        cpu0 = threadCpu() - cpu0;
+        if (i == 0 || cpu0 < best)
+            best = cpu0;
+    }
+
+    return (1e6 * best / REFLOOPS);
+}
+
+/* find when op next culminates highest as seen from np within PASSDAYS.
+ * return its mjd, or 0 if it never rises.
+ */
+static double findPass(Now *np, Obj *op)
+{
+    Now n = *np;
+    double best = 0, bestalt = 0;
+    double t;
+
+    for (t = 0; t < PASSDAYS * SPD; t += PASSSTEP)
+    {
+        n.n_mjd = np->n_mjd + t / SPD;
+        if (obj_cir(&n, op) < 0)
+            continue;
+        if (op->s_alt > bestalt)
+        {
+            bestalt = op->s_alt;
+            best = n.n_mjd;
+        }
+    }
+
+    return (best);
+}
+
+/* fill buf with the satellite as a database line with epoch mjd0 */
+static void satLine(double mjd0, char buf[])
+{
+    double dy;
+    int mn, yr;
+
+    mjd_cal(mjd0, &mn, &dy, &yr);
+    sprintf(buf, "LEO,E,%d/%.6f/%d,51.64,100.0,0.0005,90.0,0.0,15.5,0,1000", mn, dy, yr);
+}
+
+/* compare cases[] with the baseline in fn.
+ * return 0 if none got worse, else -1.
+ */
+static int compare(char *fn, double cputol)
+{
+    char line[1024];
+    int bad = 0, nbase = 0;
+    FILE *fp;
+    int i, j;
+
+    fp = fopen(fn, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        return (-1);
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        char name[64];
+        double b[NMETRIC];
+
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%63s %lf %lf %lf %lf %lf", name, &b[0], &b[1], &b[2], &b[3], &b[4]) != NMETRIC + 1)
+            continue;
+        nbase++;
+
+        for (i = 0; i < NCASES; i++)
+            if (!strcmp(cases[i].name, name))
+                break;
+        if (i == NCASES)
+        {
+            fprintf(stderr, "%s: no such case: %s\n", fn, name);
+            bad++;
+            continue;
+        }
+
+        for (j = 0; j < NMETRIC; j++)
+        {
+            double limit = mcpu[j] ? b[j] * cputol : b[j] * SIMTOL + SIMABS;
+
+            if (cases[i].m[j] > limit)
+            {
+                fprintf(stderr, "Regression: %s %s %g, baseline %g\n", name, mnames[j], cases[i].m[j], b[j]);
+                bad++;
+            }
+        }
+    }
+    fclose(fp);
+
+    if (nbase == 0)
+    {
+        fprintf(stderr, "%s: no baseline results\n", fn);
+        return (-1);
+    }
+    return (bad ? -1 : 0);
+}
+
+/* the core's replies come here rather than to a fifo */
+void fifoWrite(FifoId f, int c, char *fmt, ...)
+{
+    va_list ap;
+
+    if (f != Tel_Id)
+        return;
+    code = c;
+    va_start(ap, fmt);
+    vsnprintf(reply, sizeof(reply), fmt, ap);
+    va_end(ap);
+}
+
+/* the core's log is not wanted */
+void tdlog(char *fmt, ...)
+{
+}
+
+/* the core can not continue: end just this case */
+void die()
+{
+    strcpy(cur->why, "core died, check config files");
+    cur->failed = 1;
+    pthread_exit(NULL);
+}
@@ -1,10 +1,12 @@
 /* handle loading scripts and cracking the config file */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/select.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -15,8 +17,76 @@
 
 #include "mc.h"
 
+#define LOADTO 30 /* secs loadAllCfg() waits for any node to make progress */
+#define FWTO 30   /* secs loadFirmware() waits for any node to make progress */
+#define FWWIN 4   /* boot packets per node csimcd may hold before their ACK */
+
+/* bytes b takes in a packet, see escData() */
+#define ESCLEN(b) ((b) == PSYNC || (b) == PESC ? 2 : 1)
+
+/* one node being loaded by loadAllCfg() */
+typedef enum
+{
+    NL_OPENING, /* waiting for csimcd to confirm the connection */
+    NL_SENDING, /* sending scripts */
+    NL_SYNCING, /* sending, then waiting for the answer to, =version; */
+    NL_DONE     /* answered and closed */
+} NLState;
+
+typedef struct
+{
+    int addr;            /* node address */
+    int fd;              /* connection to it */
+    NLState state;
+    char *scripts;       /* its INITn list, cut up by strtok_r() */
+    char *save;          /* strtok_r() state */
+    char *fn;            /* script being sent, if any */
+    FILE *fp;            /* open on fn */
+    char out[512];       /* bytes waiting to be sent */
+    int nout, off;       /* how many, and how many of those sent */
+    char in[1024];       /* partial line back from node */
+    int nin;             /* bytes in it */
+    struct timeval tdone; /* when it became NL_DONE */
+} NodeLoad;
+
+/* one node being sent firmware by loadFirmware() */
+typedef struct
+{
+    int addr;             /* node address */
+    char *fn;             /* firmware file name */
+    FILE *fp;             /* open on fn, at the next BootIm */
+    long fstart, fsize;   /* offset of first BootIm, and file size */
+    int fd;               /* boot connection, or -1 */
+    int opening;          /* waiting for csimcd to confirm fd */
+    int framed;           /* fd is FOR_WBOOT, so FWWIN packets may be queued */
+    Byte rtype;           /* type of the run of records being sent */
+    unsigned raddr;       /* address of rdata[0] */
+    Byte rdata[1024];     /* the run's data */
+    int rlen, rpos;       /* bytes in rdata, and put in packets so far */
+    int rsent;            /* set once any of the run is in a packet */
+    int eof;              /* no more runs */
+    Byte pkt[PMXDAT + 1]; /* packet being written, after its length if framed */
+    int npkt, off;        /* bytes in pkt, and written so far */
+    int fly[FWWIN];       /* data bytes in each packet awaiting ACK, oldest first */
+    int nfly;             /* packets awaiting ACK */
+    long nacked;          /* data bytes ACKed */
+    int npkts;            /* packets ACKed */
+    int done, failed;     /* all ACKed and closed, or given up */
+    struct timeval tdone; /* when it became done */
+} FwLoad;
+
 static FILE *openACFile(char *fn);
-static int download(char *fn, FILE *fp, int fd);
+static int nlFill(NodeLoad *np);
+static int nlWrite(NodeLoad *np);
+static int nlRead(NodeLoad *np);
+static int isNumber(char *str);
+static void fwOpened(FwLoad *lp);
+static void fwFail(FwLoad *lp);
+static int fwPacket(FwLoad *lp);
+static int fwHdrLen(FwLoad *lp, int cnt);
+static int fwRun(FwLoad *lp);
+static int fwWrite(FwLoad *lp);
+static int fwRead(FwLoad *lp);
 static void escData(Byte b, Byte *bp, int *ip);
 static int chkVersion(int vn, int addr);
 
@@ -58,52 +128,260 @@ int loadOneCfg(int fd, char *fn)
 }
 
 /* open the config file cfn and load all scripts to all nodes.
+ * the file is read once, every node is opened at once and scripts are
+ * streamed to all of them together, so csimcd interleaves their packets and
+ * each node compiles while the others are being sent to. we never block on
+ * one node: writes go as fast as csimcd takes them and whatever comes back
+ * is printed as it arrives, so neither side can stall the other.
  * exit(3) if trouble.
  */
 void loadAllCfg(char *cfn)
 {
-    int addr;
+    static char names[NNODES][8];
+    static char values[NNODES][256];
+    static NodeLoad nl[NNODES];
+    CfgEntry ce[NNODES];
+    struct timeval tv0, tv1;
+    int addr, n, nleft, i;
+
+    /* scan cfn once for all INITn entries */
+    for (addr = 0; addr <= MAXNA; addr++)
+    {
+        sprintf(names[addr], "INIT%d", addr);
+        ce[addr].name = names[addr];
+        ce[addr].type = CFG_STR;
+        ce[addr].valp = values[addr];
+        ce[addr].slen = sizeof(values[addr]) - 1;
+    }
+    if (readCfgFile(0, cfn, ce, NNODES) < 0)
+    {
+        printf("%s: %s\n", cfn, strerror(errno));
+        exit(3);
+    }
 
-    /* scan through cfn for INITn entries */
+    /* ask for a connection to each node, all at once */
+    gettimeofday(&tv0, NULL);
+    n = 0;
     for (addr = 0; addr <= MAXNA; addr++)
     {
-        char name[32], value[256];
-        sprintf(name, "INIT%d", addr);
-        if (!read1CfgEntry(0, cfn, name, CFG_STR, value, sizeof(value)))
+        NodeLoad *np;
+
+        if (!ce[addr].found)
+            continue;
+
+        np = &nl[n++];
+        memset(np, 0, sizeof(*np));
+        np->addr = addr;
+        np->scripts = values[addr];
+        np->fd = csi_openStart(host, port, addr);
+        if (np->fd < 0)
         {
-            /* scan for and load each .cmc file */
-            char *fn, *vp;
-            char buf[32];
-            int fd;
-
-            /* open node */
-            fd = csi_open(host, port, addr);
-            if (fd < 0)
-            {
-                printf("Can not open Host %s Port %d address %d\n", host, port, addr);
+            printf("Can not open Host %s Port %d address %d\n", host, port, addr);
+            exit(3);
+        }
+        np->state = NL_OPENING;
+    }
+
+    /* feed them all until each has confirmed it is done */
+    for (nleft = n; nleft > 0;)
+    {
+        struct timeval tv;
+        fd_set rfs, wfs;
+        int maxfd = -1;
+        int s;
+
+        FD_ZERO(&rfs);
+        FD_ZERO(&wfs);
+        for (i = 0; i < n; i++)
+        {
+            NodeLoad *np = &nl[i];
+
+            if (np->state == NL_DONE)
+                continue;
+            if (np->state == NL_SENDING && nlFill(np) < 0)
                 exit(3);
-            }
+            FD_SET(np->fd, &rfs);
+            if (np->off < np->nout)
+                FD_SET(np->fd, &wfs);
+            if (np->fd > maxfd)
+                maxfd = np->fd;
+        }
 
-            /* load each script */
-            vp = value;
-            while ((fn = strtok(vp, " \t")) != NULL)
-            {
-                if (loadOneCfg(fd, fn) < 0)
-                    exit(3);
-                vp = NULL;
-            }
+        tv.tv_sec = LOADTO;
+        tv.tv_usec = 0;
+        s = selectI(maxfd + 1, &rfs, &wfs, NULL, &tv);
+        if (s < 0)
+        {
+            printf("select: %s\n", strerror(errno));
+            exit(3);
+        }
+        if (s == 0)
+        {
+            for (i = 0; i < n; i++)
+                if (nl[i].state != NL_DONE)
+                    printf("Node %d: no progress for %d secs\n", nl[i].addr, LOADTO);
+            exit(3);
+        }
 
-            /* sync */
-            if (csi_wr(fd, buf, sizeof(buf), "=version;") < 0)
+        for (i = 0; i < n; i++)
+        {
+            NodeLoad *np = &nl[i];
+
+            if (np->state == NL_DONE)
+                continue;
+            if (np->state == NL_OPENING)
             {
-                printf("Addr %d error: %s\n", csi_f2n(fd), strerror(errno));
+                /* csimcd has found the node and confirmed the connection */
+                if (FD_ISSET(np->fd, &rfs))
+                {
+                    if (csi_openDone(np->fd, np->addr) < 0)
+                    {
+                        printf("Can not open Host %s Port %d address %d\n", host, port, np->addr);
+                        exit(3);
+                    }
+                    fcntl(np->fd, F_SETFL, fcntl(np->fd, F_GETFL) | O_NONBLOCK);
+                    np->state = NL_SENDING;
+                }
+                continue;
+            }
+            if (FD_ISSET(np->fd, &wfs) && nlWrite(np) < 0)
                 exit(3);
+            if (FD_ISSET(np->fd, &rfs))
+            {
+                if (nlRead(np) < 0)
+                    exit(3);
+                if (np->state == NL_DONE)
+                {
+                    gettimeofday(&np->tdone, NULL);
+                    csi_close(np->fd);
+                    nleft--;
+                }
             }
+        }
+    }
+
+    /* report how long the slowest took, which is how long it all took */
+    gettimeofday(&tv1, NULL);
+    if (verbose)
+        for (i = 0; i < n; i++)
+            printf("Node %d ready after %.1f secs\n", nl[i].addr,
+                   (nl[i].tdone.tv_sec - tv0.tv_sec) + (nl[i].tdone.tv_usec - tv0.tv_usec) / 1e6);
+    printf("%d nodes loaded in %.1f secs\n", n, (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6);
+}
+
+/* make sure np has something waiting to be sent, moving on to its next
+ * script at the end of each and to syncing after the last.
+ * return 0 if ok, else -1.
+ */
+static int nlFill(NodeLoad *np)
+{
+    while (np->off == np->nout && np->state == NL_SENDING)
+    {
+        np->off = np->nout = 0;
+
+        /* more of the current script */
+        if (np->fp)
+        {
+            np->nout = fread(np->out, sizeof(char), sizeof(np->out), np->fp);
+            if (np->nout > 0)
+                return (0);
+            fclose(np->fp);
+            np->fp = NULL;
+            printf("Node %d loaded with %s\n", np->addr, np->fn);
+        }
+
+        /* next script, if any */
+        np->fn = strtok_r(np->fn ? NULL : np->scripts, " \t", &np->save);
+        if (np->fn)
+        {
+            np->fp = openACFile(np->fn);
+            if (!np->fp)
+                return (-1);
+            continue;
+        }
+
+        /* all sent, ask for something back to know they have been taken */
+        np->nout = sprintf(np->out, "=version;");
+        np->state = NL_SYNCING;
+    }
+
+    return (0);
+}
+
+/* send what we can of what np has waiting.
+ * return 0 if ok, else -1.
+ */
+static int nlWrite(NodeLoad *np)
+{
+    int w = write(np->fd, np->out + np->off, np->nout - np->off);
+
+    if (w < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return (0);
+        printf("Node %d: %s\n", np->addr, strerror(errno));
+        return (-1);
+    }
+    np->off += w;
+    return (0);
+}
+
+/* read what np has sent back. print each line, except that once syncing the
+ * first that is just a number is the answer and the node is done.
+ * return 0 if ok, else -1.
+ */
+static int nlRead(NodeLoad *np)
+{
+    int r = read(np->fd, np->in + np->nin, sizeof(np->in) - 1 - np->nin);
+    char *lp, *eol;
 
-            /* done */
-            csi_close(fd);
+    if (r < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return (0);
+        printf("Node %d: %s\n", np->addr, strerror(errno));
+        return (-1);
+    }
+    if (r == 0)
+    {
+        printf("Node %d: connection closed\n", np->addr);
+        return (-1);
+    }
+
+    np->nin += r;
+    np->in[np->nin] = '\0';
+    for (lp = np->in; (eol = strchr(lp, '\n')) != NULL; lp = eol + 1)
+    {
+        *eol = '\0';
+        if (eol > lp && eol[-1] == '\r')
+            eol[-1] = '\0';
+        if (np->state == NL_SYNCING && np->off == np->nout && isNumber(lp))
+        {
+            np->state = NL_DONE;
+            return (0);
         }
+        printf("Node %d: %s\n", np->addr, lp);
     }
+
+    /* keep any partial line, or flush if it fills the buffer */
+    np->nin = strlen(lp);
+    if (np->nin == sizeof(np->in) - 1)
+    {
+        printf("Node %d: %s\n", np->addr, lp);
+        np->nin = 0;
+    }
+    else
+        memmove(np->in, lp, np->nin);
+    return (0);
+}
+
+/* return whether str is nothing but a decimal integer */
+static int isNumber(char *str)
+{
+    char *end;
+
+    (void)strtol(str, &end, 10);
+    return (*str != '\0' && *end == '\0');
 }
 
 /* open the given file.
@@ -131,198 +409,442 @@ static void guardFirmware(int signo)
     printf("\nNever interrupt a firmware download while in progress.\n");
 }
 
-/* attempt to download firmware in fn to the node with addr.
- * return 0 if ok else -1.
+/* download the firmware in fn to each of the naddr nodes in addr[], all at
+ * once, and report how long each took.
+ * return 0 if all ok else -1.
  */
-int loadFirmware(int addr, char *fn)
+int loadFirmware(int addr[], int naddr, char *fn)
 {
+    static FwLoad fl[NNODES];
     void (*oldint)();
-    FILE *ffp;
+    struct timeval tv0, tv1, tvp;
     char buf[128];
-    int bfd;
-    int vn;
-
-    /* open firmware file */
-    ffp = openACFile(fn);
-    if (!ffp)
-        return (-1); /* already explained */
+    int vn = 0;
+    int nleft, nbad, i;
 
-    /* open a boot connection */
-    bfd = csi_bopen(host, port, addr);
-    if (bfd < 0)
+    /* open the firmware for each node, and a boot connection to it */
+    nbad = 0;
+    for (i = 0; i < naddr; i++)
     {
-        printf("Boot open(%d): %s\n", addr, strerror(errno));
-        fclose(ffp);
-        return (-1);
-    }
+        FwLoad *lp = &fl[i];
+
+        memset(lp, 0, sizeof(*lp));
+        lp->addr = addr[i];
+        lp->fn = fn;
+        lp->fd = -1;
+        lp->rsent = 1; /* no run yet */
+        lp->fp = openACFile(fn);
+        if (!lp->fp)
+        {
+            lp->failed = 1;
+            nbad++;
+            continue;
+        }
 
-    /* get version from first line */
-    if (fgets(buf, sizeof(buf), ffp) == NULL)
-    {
-        printf("%s: %s\n", fn, strerror(errno));
-        fclose(ffp);
-        csi_close(bfd);
-        return (-1);
+        /* get version from first line, then size for progress */
+        if (fgets(buf, sizeof(buf), lp->fp) == NULL)
+        {
+            printf("%s: %s\n", fn, strerror(errno));
+            lp->failed = 1;
+            nbad++;
+            continue;
+        }
+        vn = atoi(buf);
+        lp->fstart = ftell(lp->fp);
+        fseek(lp->fp, 0L, SEEK_END);
+        lp->fsize = ftell(lp->fp);
+        fseek(lp->fp, lp->fstart, SEEK_SET);
+
+        if (!fwfast)
+            lp->fd = csi_bopen(host, port, lp->addr);
+        else
+        {
+            lp->fd = csi_bopenStart(host, port, lp->addr);
+            lp->opening = lp->framed = 1;
+        }
+        if (lp->fd < 0)
+        {
+            printf("Boot open(%d): %s\n", lp->addr, strerror(errno));
+            lp->failed = 1;
+            nbad++;
+        }
     }
-    vn = atoi(buf);
 
     /* do not allow casual interruptions */
     oldint = signal(SIGINT, guardFirmware);
 
-    /* load firmware */
+    /* feed each its packets as fast as csimcd will take them */
     if (verbose)
-        printf("Loading Node %d with version %d from %s.. ", addr, vn, fn);
-    if (download(fn, ffp, bfd) < 0)
+        printf("Loading %d node%s with version %d from %s.. ", naddr - nbad, naddr - nbad == 1 ? "" : "s", vn, fn);
+    gettimeofday(&tv0, NULL);
+    tvp = tv0;
+    for (nleft = naddr - nbad; nleft > 0;)
     {
-        fclose(ffp);
-        csi_close(bfd);
-        signal(SIGINT, oldint);
-        return (-1);
+        struct timeval tv;
+        fd_set rfs, wfs;
+        int maxfd = -1;
+        int s;
+
+        FD_ZERO(&rfs);
+        FD_ZERO(&wfs);
+        for (i = 0; i < naddr; i++)
+        {
+            FwLoad *lp = &fl[i];
+
+            if (lp->failed || lp->done)
+                continue;
+
+            /* have the next packet ready while there is room for it */
+            if (!lp->opening && lp->off == lp->npkt && lp->nfly < (lp->framed ? FWWIN : 1) &&
+                (s = fwPacket(lp)) <= 0)
+            {
+                if (s < 0)
+                {
+                    fwFail(lp);
+                    nleft--;
+                    continue;
+                }
+                if (lp->nfly == 0)
+                {
+                    /* all sent and ACKed */
+                    gettimeofday(&lp->tdone, NULL);
+                    csi_close(lp->fd);
+                    lp->done = 1;
+                    nleft--;
+                    continue;
+                }
+            }
+
+            FD_SET(lp->fd, &rfs);
+            if (lp->off < lp->npkt)
+                FD_SET(lp->fd, &wfs);
+            if (lp->fd > maxfd)
+                maxfd = lp->fd;
+        }
+        if (nleft == 0)
+            break;
+
+        tv.tv_sec = FWTO;
+        tv.tv_usec = 0;
+        s = selectI(maxfd + 1, &rfs, &wfs, NULL, &tv);
+        if (s < 0)
+        {
+            printf("select: %s\n", strerror(errno));
+            break;
+        }
+        if (s == 0)
+        {
+            for (i = 0; i < naddr; i++)
+            {
+                if (!fl[i].failed && !fl[i].done)
+                {
+                    printf("Node %d: no progress for %d secs\n", fl[i].addr, FWTO);
+                    fwFail(&fl[i]);
+                }
+            }
+            break;
+        }
+
+        for (i = 0; i < naddr; i++)
+        {
+            FwLoad *lp = &fl[i];
+
+            if (lp->failed || lp->done)
+                continue;
+            if (lp->opening)
+            {
+                if (FD_ISSET(lp->fd, &rfs))
+                    fwOpened(lp);
+                if (lp->failed)
+                    nleft--;
+                continue;
+            }
+            if ((FD_ISSET(lp->fd, &wfs) && fwWrite(lp) < 0) || (FD_ISSET(lp->fd, &rfs) && fwRead(lp) < 0))
+            {
+                fwFail(lp);
+                nleft--;
+            }
+        }
+
+        /* show progress */
+        gettimeofday(&tv1, NULL);
+        if ((tv1.tv_sec - tvp.tv_sec) * 1000 + (tv1.tv_usec - tvp.tv_usec) / 1000 >= 500)
+        {
+            char back[256];
+            int n = 0;
+
+            for (i = 0; i < naddr && n < sizeof(back) - 16; i++)
+                if (!fl[i].failed)
+                    n += printf(" %d:%3ld%%", fl[i].addr,
+                                100 * (ftell(fl[i].fp) - fl[i].fstart) / (fl[i].fsize - fl[i].fstart + 1));
+            back[n] = 0;
+            while (--n >= 0)
+                back[n] = '\b';
+            printf("%s", back);
+            fflush(stdout);
+            tvp = tv1;
+        }
     }
     printf("done.                  \n");
 
-    /* finished with firmware file and boot connection */
-    fclose(ffp);
-    csi_close(bfd);
-
-    /* confirm version */
-    if (chkVersion(vn, addr) < 0)
+    /* time-to-flash for each */
+    for (i = 0; i < naddr; i++)
     {
-        signal(SIGINT, oldint);
-        return (-1);
+        FwLoad *lp = &fl[i];
+        double dt;
+
+        if (lp->fp)
+            fclose(lp->fp);
+        if (!lp->done)
+        {
+            if (!lp->failed)
+                fwFail(lp);
+            continue;
+        }
+        dt = (lp->tdone.tv_sec - tv0.tv_sec) + (lp->tdone.tv_usec - tv0.tv_usec) / 1e6;
+        printf("Node %d: %ld bytes in %d packets flashed in %.1f secs, %.0f B/s\n", lp->addr, lp->nacked, lp->npkts,
+               dt, dt > 0 ? lp->nacked / dt : 0.0);
     }
 
+    /* confirm version of each that took it all */
+    for (i = 0; i < naddr; i++)
+        if (fl[i].done && chkVersion(vn, fl[i].addr) < 0)
+            fl[i].failed = 1;
+
     /* reinstate old handler */
     signal(SIGINT, oldint);
 
+    for (i = 0; i < naddr; i++)
+        if (fl[i].failed || !fl[i].done)
+            return (-1);
+
     /* ok! */
     if (verbose)
         printf("\a"); /* beep! */
     return (0);
 }
 
-/* load firmware in boot file fp named fn to socket fd.
- * return 0 if all ok, else -1.
- * N.B. we assume fp starts positioned at start of boot records.
- * N.B. if a BT_EXEC BootIm is found, it must be placed at the end of a packet
- *   because it will be immediately jumped to, anything after will be lost.
+/* csimcd has answered lp's connection request: finish opening it. a csimcd
+ * that does not know framed boot connections just closes, so then try again
+ * the old way, one packet at a time.
  */
-static int download(char *fn, FILE *fp, int fd)
+static void fwOpened(FwLoad *lp)
 {
-    int bimsz = sizeof(BootIm);
-    struct timeval tv0;
-    int last_was_exec;
-    char buf[PMXLEN * 2];
-    Byte data[PMXLEN * 2];
-    BootIm bim;
-    long fsize, fcount;
-    int ndata;
-    int totd;
-
-    /* get size for progress.. return to same fp position */
-    fcount = ftell(fp);
-    fseek(fp, 0L, SEEK_END);
-    fsize = ftell(fp);
-    fseek(fp, fcount, SEEK_SET);
-
-    /* send, in BOOTREC packets */
-    last_was_exec = 0;
-    totd = 0;
-    ndata = 0;
-    gettimeofday(&tv0, NULL);
-    while (1)
+    lp->opening = 0;
+    if (csi_bopenDone(lp->fd, lp->addr) >= 0)
     {
-        int more = fread(&bim, bimsz, 1, fp) == 1;
-        int nmore = 0;
-        struct timeval tv1;
-        int ms;
+        fcntl(lp->fd, F_SETFL, fcntl(lp->fd, F_GETFL) | O_NONBLOCK);
+        return;
+    }
 
-        /* show progress */
-        gettimeofday(&tv1, NULL);
-        ms = (tv1.tv_sec - tv0.tv_sec) * 1000 + (tv1.tv_usec - tv0.tv_usec) / 1000;
-        if (ms >= 500)
-        {
-            char back[128];
-            long fnow = ftell(fp);
-            int left = (fsize - fnow) * ms / (1000 * totd);
-            int min = left / 60;
-            int sec = left % 60;
-            int n = printf("%3ld%% @ %5dB/s %3d:%02d", 100 * fnow / fsize, 1000 * totd / ms, min, sec);
-            back[n] = 0;
-            while (--n >= 0)
-                back[n] = '\b';
-            printf("%s", back);
-            tv0 = tv1;
-            totd = 0;
-        }
+    lp->framed = 0;
+    lp->fd = csi_bopen(host, port, lp->addr);
+    if (lp->fd < 0)
+    {
+        printf("Boot open(%d): %s\n", lp->addr, strerror(errno));
+        lp->failed = 1;
+    }
+    else if (verbose)
+        printf("Node %d: csimcd takes one boot packet at a time\n", lp->addr);
+}
 
-        if (more)
-        {
-            /* read in BootIm */
-            escData(bim.type, buf, &nmore);
-            escData(bim.len, buf, &nmore);
-            escData(bim.addrh, buf, &nmore);
-            escData(bim.addrl, buf, &nmore);
-
-            /* then the data, unless 0-length BT_EXEC record */
-            if (bim.len > 0)
-            {
-                Byte rbuf[PMXLEN * 2];
-                int i;
+/* give up on lp */
+static void fwFail(FwLoad *lp)
+{
+    if (lp->opening)
+        (void)close(lp->fd);
+    else if (lp->fd >= 0)
+        csi_close(lp->fd);
+    lp->fd = -1;
+    lp->failed = 1;
+}
 
-                if (fread(rbuf, bim.len, 1, fp) != 1)
-                {
-                    printf("%s is short\n", fn);
-                    return (-1);
-                }
+/* build lp's next BOOTREC packet in lp->pkt.
+ * if fwfast, runs of contiguous records are sent as one and split across
+ * packets so each is as full as it may be, else each record is a packet.
+ * N.B. a BT_EXEC BootIm is always placed at the end of a packet because it
+ *   will be immediately jumped to, anything after would be lost.
+ * N.B. FLASH is programmed a word at a time so those runs are only split at
+ *   an even number of bytes.
+ * return bytes of data in the packet, 0 if no more, else -1.
+ */
+static int fwPacket(FwLoad *lp)
+{
+    Byte *dp = &lp->pkt[lp->framed];
+    int ndata = 0;
 
-                for (i = 0; i < bim.len; i++)
-                    escData(rbuf[i], buf, &nmore);
-            }
-        }
+    while (1)
+    {
+        int whole = !fwfast || (lp->rtype & BT_EXEC);
+        int nleft, cnt, ne, i;
+        unsigned a;
 
-        /* send packet if: eof, more would overflow, or last with BT_EXEC */
-        if ((!more && ndata) || ndata + nmore > PMXDAT || last_was_exec)
+        /* next run once all of this one is in packets */
+        if (lp->rsent && lp->rpos == lp->rlen)
         {
-            Byte nsync;
-
-            /* send 1 packet */
-            if (writeI(fd, data, ndata) < 0)
-            {
-                printf("Boot write: %s\n", strerror(errno));
-                return (-1);
-            }
+            int s;
 
-            /* this lets daemon read our exact write size each time
-             * and let us give synced progress messages.
-             */
-            if (readI(fd, &nsync, 1) != 1)
-            {
-                printf("Boot read: %s\n", strerror(errno));
+            if (lp->eof)
+                break;
+            if ((s = fwRun(lp)) < 0)
                 return (-1);
-            }
-            if (nsync != ndata)
+            if (s == 0)
             {
-                printf("Bad boot size: wrote %d read %d\n", ndata, nsync);
-                return (-1);
+                lp->eof = 1;
+                break;
             }
+            whole = !fwfast || (lp->rtype & BT_EXEC);
+        }
 
-            /* start accumulating another packet's worth */
-            totd += ndata;
-            ndata = 0;
+        /* as much of the rest of the run as fits, as one record */
+        nleft = lp->rlen - lp->rpos;
+        if (nleft > 255)
+            nleft = 255;
+        for (cnt = ne = 0; cnt < nleft; cnt++)
+        {
+            int e = ESCLEN(lp->rdata[lp->rpos + cnt]);
+            if (ndata + fwHdrLen(lp, cnt + 1) + ne + e > PMXDAT)
+                break;
+            ne += e;
+        }
+        if ((lp->rtype & BT_FLASH) && cnt < nleft && (cnt & 1))
+            cnt--;
+        if (cnt < nleft && (whole || cnt == 0) && ndata > 0)
+            break; /* in the next packet */
+        if (cnt == 0 && nleft > 0)
+        {
+            printf("Node %d: %d-byte record at 0x%x does not fit in a packet\n", lp->addr, nleft,
+                   lp->raddr + lp->rpos);
+            return (-1);
         }
+        if (cnt == 0 && ndata + fwHdrLen(lp, 0) > PMXDAT)
+            break;
 
-        if (!more)
+        a = (lp->raddr + lp->rpos) & 0xffff;
+        escData(lp->rtype, dp, &ndata);
+        escData(cnt, dp, &ndata);
+        escData(a >> 8, dp, &ndata);
+        escData(a & 0xff, dp, &ndata);
+        for (i = 0; i < cnt; i++)
+            escData(lp->rdata[lp->rpos + i], dp, &ndata);
+        lp->rpos += cnt;
+        lp->rsent = 1;
+
+        if (lp->rtype & BT_EXEC)
             break;
+    }
+
+    if (lp->framed)
+        lp->pkt[0] = ndata;
+    lp->npkt = ndata ? ndata + lp->framed : 0;
+    lp->off = 0;
+    return (ndata);
+}
+
+/* bytes the record header for cnt more bytes of lp's run takes in a packet */
+static int fwHdrLen(FwLoad *lp, int cnt)
+{
+    unsigned a = (lp->raddr + lp->rpos) & 0xffff;
+
+    return (ESCLEN(lp->rtype) + ESCLEN(cnt) + ESCLEN(a >> 8) + ESCLEN(a & 0xff));
+}
+
+/* read lp's next BootIm into its run, then, if fwfast, any more of the
+ * same type that carry on where it ends.
+ * return 1 if ok, 0 if no more, else -1.
+ */
+static int fwRun(FwLoad *lp)
+{
+    BootIm bim;
+
+    if (fread(&bim, sizeof(bim), 1, lp->fp) != 1)
+        return (0);
+    lp->rtype = bim.type;
+    lp->raddr = (bim.addrh << 8) | bim.addrl;
+    lp->rlen = bim.len;
+    lp->rpos = 0;
+    lp->rsent = 0;
+    if (bim.len > 0 && fread(lp->rdata, bim.len, 1, lp->fp) != 1)
+    {
+        printf("%s is short\n", lp->fn);
+        return (-1);
+    }
+
+    while (fwfast && !(lp->rtype & BT_EXEC))
+    {
+        long pos = ftell(lp->fp);
 
-        if (nmore)
+        if (fread(&bim, sizeof(bim), 1, lp->fp) != 1 || bim.type != lp->rtype ||
+            ((bim.addrh << 8) | bim.addrl) != ((lp->raddr + lp->rlen) & 0xffff) ||
+            lp->rlen + bim.len > sizeof(lp->rdata))
         {
-            last_was_exec = (bim.type & BT_EXEC);
-            memcpy(data + ndata, buf, nmore);
-            ndata += nmore;
+            fseek(lp->fp, pos, SEEK_SET);
+            break;
+        }
+        if (bim.len > 0 && fread(lp->rdata + lp->rlen, bim.len, 1, lp->fp) != 1)
+        {
+            printf("%s is short\n", lp->fn);
+            return (-1);
         }
+        lp->rlen += bim.len;
+    }
+
+    return (1);
+}
+
+/* send more of lp's packet. once all written it awaits its ACK.
+ * return 0 if ok, else -1.
+ */
+static int fwWrite(FwLoad *lp)
+{
+    int n = write(lp->fd, lp->pkt + lp->off, lp->npkt - lp->off);
+
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return (0);
+        printf("Node %d: boot write: %s\n", lp->addr, strerror(errno));
+        return (-1);
+    }
+    lp->off += n;
+    if (lp->off == lp->npkt)
+        lp->fly[lp->nfly++] = lp->npkt - lp->framed;
+    return (0);
+}
+
+/* read the sizes csimcd reports as each of lp's packets is ACKed by the node.
+ * return 0 if ok, else -1.
+ */
+static int fwRead(FwLoad *lp)
+{
+    Byte nsync[FWWIN];
+    int n, i;
+
+    n = read(lp->fd, nsync, lp->nfly > 0 ? lp->nfly : 1);
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return (0);
+        printf("Node %d: boot read: %s\n", lp->addr, strerror(errno));
+        return (-1);
+    }
+    if (n == 0)
+    {
+        printf("Node %d: boot connection lost\n", lp->addr);
+        return (-1);
     }
 
+    for (i = 0; i < n; i++)
+    {
+        if (lp->nfly == 0 || nsync[i] != lp->fly[0])
+        {
+            printf("Node %d: bad boot size: wrote %d read %d\n", lp->addr, lp->nfly ? lp->fly[0] : 0, nsync[i]);
+            return (-1);
+        }
+        lp->nacked += lp->fly[0];
+        lp->npkts++;
+        memmove(lp->fly, lp->fly + 1, --lp->nfly * sizeof(lp->fly[0]));
+    }
     return (0);
 }
 
@@ -65,6 +65,7 @@ static char *cfg_fn = cfg_def;                      /* actual config file */
 static char ipme[] = "127.0.0.1";                   /* local host IP */
 char *host = ipme;                                  /* actual server host */
 int port = CSIMCPORT;                               /* server port */
+int fwfast;                                         /* firmware windowed and coalesced, see boot.c */
 static char dname[] = "csimcd";                     /* name of network daemon */
 
 static fd_set fdset;      /* set of all conn fds, + stdin */
@@ -109,6 +110,9 @@ int main(int ac, char *av[])
             case 'r':
                 rflag++;
                 break;
+            case 'w':
+                fwfast++;
+                break;
             case 't':
                 if (ac < 3)
                     usage();
@@ -211,6 +215,8 @@ static void usage()
     fprintf(stderr, " -r      reboot all nodes on network\n");
     fprintf(stderr, " -t n b  make initial connection to serial port on node <n> at baud rate <b>.\n");
     fprintf(stderr, " -v      verbose\n");
+    fprintf(stderr, " -w      send firmware in full packets, several queued per node; not yet\n");
+    fprintf(stderr, "         proven on hardware, default is a record per packet as in the file\n");
 
     exit(4);
 }
@@ -251,22 +257,15 @@ static void daemonCheck()
     if (fd < 0 && (!host || !strcmp(host, "localhost") || !strcmp(host, ipme)))
     {
         char buf[256];
-        int i;
 
-        sprintf(buf, "rund %s -i %d", dname, port);
+        /* rund returns once csimcd is ready to accept us */
+        sprintf(buf, "rund -w %d %s -i %d", DWT, dname, port);
         if (system(buf) != 0)
         {
             fprintf(stderr, "Can not start %s\n", dname);
             exit(1);
         }
-
-        for (i = 0; i < DWT; i++)
-        {
-            sleep(1);
-            fd = csimcd_clconn(host, port);
-            if (fd >= 0)
-                break;
-        }
+        fd = csimcd_clconn(host, port);
     }
 
     if (fd < 0)
@@ -486,7 +485,7 @@ static void cmdHelp()
     printf(" !history [n]\t\tshow command history, or repeat item [n]\n");
     printf(" !trace [<f>]\t\tappend output to file <f>, or turn off if no <f>\n");
     printf(" !interrupt\t\tsame as Ctrl-C\n");
-    printf(" !Firm <a> <f>\t\tload firmware in .cmf file <f> onto node <a>\n");
+    printf(" !Firm <a>[,<a>..] <f>\tload firmware in .cmf file <f> onto each node <a>\n");
     printf(" !Reboot\t\treboot *all* nodes\n");
     printf(" Ctrl-C\t\t\tstop any loops and go back to reading input\n");
     printf(" Ctrl-D or EOF\t\tclose all connections and exit\n");
@@ -569,20 +568,20 @@ static void cmdConnect(int addr)
 /* firmware command. cmd is the entire original command line, sans CMCHAR. */
 static void cmdFirmware(char cmd[])
 {
-    char *fn;
-    int addr;
-    int fd;
+    int addrs[NNODES];
+    int naddrs;
+    char *fn, *ap;
+    int fd, i;
 
-    /* get args: <addr> <filename> */
+    /* get args: <addr>[,<addr>...] <filename> */
     cmd = strtok(cmd, " \t\n");  /* skip "firmware" */
-    cmd = strtok(NULL, " \t\n"); /* this is the address */
+    cmd = strtok(NULL, " \t\n"); /* these are the addresses */
     if (!cmd || !isdigit(*cmd))
     {
         printf("Please specify a node address to download.\n");
         kickPrompt();
         return;
     }
-    addr = strtol(cmd, NULL, 0);
     fn = strtok(NULL, " \t\n"); /* this is the filename */
     if (!fn)
     {
@@ -590,17 +589,24 @@ static void cmdFirmware(char cmd[])
         kickPrompt();
         return;
     }
+    for (naddrs = 0, ap = cmd; naddrs < NNODES && isdigit(*ap); naddrs++)
+    {
+        addrs[naddrs] = strtol(ap, &ap, 0);
+        if (*ap == ',')
+            ap++;
+    }
 
-    /* break any connections to addr */
+    /* break any connections to them */
     for (fd = 1; fd <= maxfdset; fd++)
-        if (FD_ISSET(fd, &fdset) && csi_f2n(fd) == addr)
-            closeFD(fd);
+        for (i = 0; i < naddrs; i++)
+            if (FD_ISSET(fd, &fdset) && csi_f2n(fd) == addrs[i])
+                closeFD(fd);
 
-    /* download to addr */
-    if (loadFirmware(addr, fn) < 0)
-        printf("Could not download %s to %d\n", fn, addr);
+    /* download to all at once */
+    if (loadFirmware(addrs, naddrs, fn) < 0)
+        printf("Could not download %s to %s\n", fn, cmd);
     else if (verbose)
-        printf("Successfully downloaded %s to %d.\n", fn, addr);
+        printf("Successfully downloaded %s to %s.\n", fn, cmd);
 
     /* fresh prompt */
     kickPrompt();
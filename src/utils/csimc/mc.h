@@ -2,12 +2,13 @@
 extern int verbose;
 extern char *host;
 extern int port;
+extern int fwfast;
 extern void pollBack(int fd);
 
 /* boot.c */
 extern void loadAllCfg(char *cfn);
 extern int loadOneCfg(int addr, char *fn);
-extern int loadFirmware(int addr, char *fn);
+extern int loadFirmware(int addr[], int naddr, char *fn);
 
 /* eintrio.c */
 extern int selectI(int n, fd_set *rp, fd_set *wp, fd_set *xp, struct timeval *tp);
@@ -0,0 +1,869 @@
+/* measure how each mount axis really moves and recommend MAXVEL, MAXACC and
+ * POLL_PERIOD for telescoped.cfg.
+ *
+ * each axis is driven through three kinds of profile:
+ *   step:  etpos/mtpos moves of one size at several acceleration limits,
+ *          to find the acceleration it achieves, overshoot and settling time.
+ *   ramp:  mtvel at increasing speeds to find where velocity saturates.
+ *   sine:  etrack/mtrack sinusoids at increasing frequencies to find the
+ *          tracking bandwidth.
+ *   acquire: etrack/mtrack onto a sidereal track span away, once as the
+ *          plain track the node must jump to and hunt, once beginning with
+ *          the S-curve telescoped now uses, to compare overshoot and settling.
+ * the position is sampled by a loop running on the node itself so the
+ * response is seen at the node clock rate rather than our round trip rate.
+ *
+ * with -v the axes are the virtual ones telescoped uses in virtual mode.
+ *
+ * N.B. telescoped must not be running; the axes must be homed and free to
+ * move the travel span either side of where they are now.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "configfile.h"
+#include "csimc.h"
+#include "strops.h"
+#include "telenv.h"
+#include "telstatshm.h"
+#include "virmc.h"
+
+#define NACC 4        /* acceleration levels for step tests */
+#define NRAMP 8       /* speeds for ramp test */
+#define NSINE 6       /* frequencies for sine test */
+#define SETTLEWIN 3.0 /* secs to watch after a move should be done */
+#define SPC 20        /* track points per sine cycle */
+#define MAXSAMP 100000 /* most samples in one test */
+#define ACQPTS 60     /* track points in an acquisition, as PPTRACK */
+#define ACQRATE 7.29e-5 /* acquisition track rate, rads/sec, sidereal */
+#define ACQDERATE 0.9 /* as telescoped's buildTrack() */
+#define ACQTAIL 10.0  /* as telescoped's buildTrack() */
+#define JERKRAMP 0.25 /* as telescoped's default xMAXJERK */
+
+/* one axis under test */
+typedef struct
+{
+    char name;      /* H, D or R */
+    int have;       /* whether axis exists */
+    int addr;       /* csimc address */
+    int haveenc;    /* whether positions come from an encoder */
+    int step, sign; /* motor steps/rev and sign */
+    int estep, esign; /* encoder counts/rev and sign */
+    double maxvel;  /* configured max velocity, rads/sec */
+    double maxacc;  /* configured max acceleration, rads/sec/sec */
+    double maxjerk; /* configured or default max jerk, rads/sec^3 */
+    int cfd, sfd;   /* sampling and commanding connections */
+    double home;    /* position when we started, rads */
+} Axis;
+
+/* one position sample */
+typedef struct
+{
+    double t; /* secs since test began */
+    double x; /* canonical position, rads */
+} Sample;
+
+/* what we learn about an axis */
+typedef struct
+{
+    double acc[NACC];    /* acceleration limits tried, rads/sec/sec */
+    double gotacc[NACC]; /* achieved acceleration */
+    double overs[NACC];  /* overshoot, rads */
+    double settle[NACC]; /* time from command to settled, secs */
+    double vsat;         /* highest sustained velocity, rads/sec */
+    double fband;        /* tracking bandwidth, Hz, 0 if beyond tests */
+    double tsettle;      /* settling time after gentlest step, secs */
+    double acqover[2];   /* acquisition overshoot, plain then S-curve, rads */
+    double acqsettle[2]; /* acquisition time to settle on track, secs */
+} Result;
+
+static void usage(void);
+static void readCfg(void);
+static void openAxis(Axis *ap);
+static void closeAxis(Axis *ap);
+static void setLimits(Axis *ap, double maxvel, double maxacc);
+static void moveTo(Axis *ap, double x);
+static void setVel(Axis *ap, double v);
+static void trackPath(Axis *ap, int n, int ivalms, double x[]);
+static double where(Axis *ap);
+static int record(Axis *ap, double secs, Sample s[]);
+static void stepTest(Axis *ap, Result *rp);
+static void rampTest(Axis *ap, Result *rp);
+static void sineTest(Axis *ap, Result *rp);
+static void acqTest(Axis *ap, Result *rp);
+static void recommend(Axis *ap, Result *rp);
+static void logSamples(Axis *ap, char *test, double param, Sample s[], int n);
+static double fitSlope(Sample s[], int n, double t0, double t1);
+static void velocities(Sample s[], int n, double v[]);
+
+static char *me;
+static int virtual_mode;            /* use virmc.c instead of csimcd */
+static char tdcfn[] = "archive/config/telescoped.cfg";
+static char hcfn[] = "archive/config/home.cfg";
+static char csicfn[] = "archive/config/csimc.cfg";
+static char ipme[] = "127.0.0.1";
+static char *host = ipme;
+static int port = CSIMCPORT;
+static double span = 0.2;           /* travel either side of start, rads */
+static double factor = 1.5;         /* test limits up to this times config */
+static double margin = 0.8;         /* fraction of measured limits to use */
+static double tol;                  /* settled within this, rads */
+static int period = 10;             /* sample period, ms */
+static FILE *logfp;                 /* raw samples, if wanted */
+static Axis axes[3] = {{.name = 'H', .have = 0}, {.name = 'D', .have = 0}, {.name = 'R', .have = 0}};
+static Sample samples[MAXSAMP];
+
+int main(int ac, char *av[])
+{
+    char *which = "HD";
+    char *logfn = NULL;
+    int i;
+
+    me = basenm(av[0]);
+
+    while ((--ac > 0) && ((*++av)[0] == '-'))
+    {
+        char *s;
+        for (s = av[0] + 1; *s != '\0'; s++)
+            switch (*s)
+            {
+            case 'a':
+                if (ac < 2)
+                    usage();
+                which = *++av;
+                --ac;
+                break;
+            case 'f':
+                if (ac < 2)
+                    usage();
+                factor = atof(*++av);
+                --ac;
+                break;
+            case 'l':
+                if (ac < 2)
+                    usage();
+                logfn = *++av;
+                --ac;
+                break;
+            case 'm':
+                if (ac < 2)
+                    usage();
+                margin = atof(*++av);
+                --ac;
+                break;
+            case 'p':
+                if (ac < 2)
+                    usage();
+                period = atoi(*++av);
+                --ac;
+                break;
+            case 's':
+                if (ac < 2)
+                    usage();
+                span = atof(*++av);
+                --ac;
+                break;
+            case 'v':
+                virtual_mode++;
+                break;
+            default:
+                usage();
+            }
+    }
+    if (ac > 0 || span <= 0 || factor < 1 || margin <= 0 || margin > 1 || period < 1)
+        usage();
+
+    if (logfn)
+    {
+        logfp = fopen(logfn, "w");
+        if (!logfp)
+        {
+            fprintf(stderr, "%s: %s\n", logfn, strerror(errno));
+            exit(1);
+        }
+        fprintf(logfp, "# axis test param secs rads\n");
+    }
+
+    readCfg();
+
+    for (i = 0; i < 3; i++)
+    {
+        Axis *ap = &axes[i];
+        Result r;
+
+        if (!strchr(which, ap->name))
+            continue;
+        if (!ap->have)
+        {
+            printf("%c: not in %s, skipped\n", ap->name, tdcfn);
+            continue;
+        }
+
+        openAxis(ap);
+        memset(&r, 0, sizeof(r));
+        stepTest(ap, &r);
+        rampTest(ap, &r);
+        sineTest(ap, &r);
+        acqTest(ap, &r);
+        recommend(ap, &r);
+        closeAxis(ap);
+    }
+
+    if (logfp)
+        fclose(logfp);
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s [options]\n", me);
+    fprintf(stderr, "Purpose: measure axis dynamics and recommend MAXVEL/MAXACC/POLL_PERIOD.\n");
+    fprintf(stderr, "N.B. stop telescoped first; axes must be homed and free to move +-span.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, " -a HDR  axes to test; default is HD\n");
+    fprintf(stderr, " -f x    test limits up to x times config values; default %g\n", factor);
+    fprintf(stderr, " -l file log every sample to file\n");
+    fprintf(stderr, " -m x    recommend x times the measured limits; default %g\n", margin);
+    fprintf(stderr, " -p ms   sample period; default %d\n", period);
+    fprintf(stderr, " -s r    travel either side of start, rads; default %g\n", span);
+    fprintf(stderr, " -v      use virtual axes, as telescoped -v\n");
+    exit(1);
+}
+
+/* read what we need from the same config files as telescoped */
+static void readCfg()
+{
+    char name[32];
+    int i;
+
+    if (!read1CfgEntry(0, csicfn, "HOST", CFG_STR, name, sizeof(name)))
+        host = strcpy(malloc(strlen(name) + 1), name);
+    (void)read1CfgEntry(0, csicfn, "PORT", CFG_INT, &port, 0);
+
+    if (read1CfgEntry(0, tdcfn, "ACQUIREACC", CFG_DBL, &tol, 0) < 0 || tol <= 0)
+        tol = 0.0003;
+
+    for (i = 0; i < 3; i++)
+    {
+        Axis *ap = &axes[i];
+        int n = 0;
+
+#define RD(f, k, t, v) (sprintf(name, "%c%s", ap->name, k), n += read1CfgEntry(0, f, name, t, v, 0) < 0)
+        RD(tdcfn, "HAVE", CFG_INT, &ap->have);
+        RD(tdcfn, "AXIS", CFG_INT, &ap->addr);
+        RD(tdcfn, "MAXVEL", CFG_DBL, &ap->maxvel);
+        RD(tdcfn, "MAXACC", CFG_DBL, &ap->maxacc);
+        sprintf(name, "%cMAXJERK", ap->name);
+        if (read1CfgEntry(0, tdcfn, name, CFG_DBL, &ap->maxjerk, 0) < 0 || ap->maxjerk <= 0)
+            ap->maxjerk = ap->maxacc / JERKRAMP;
+        if (ap->name == 'R')
+        {
+            RD(tdcfn, "STEP", CFG_INT, &ap->step);
+            RD(tdcfn, "SIGN", CFG_INT, &ap->sign);
+            ap->haveenc = 0;
+        }
+        else
+        {
+            RD(hcfn, "STEP", CFG_INT, &ap->step);
+            RD(hcfn, "SIGN", CFG_INT, &ap->sign);
+            RD(tdcfn, "ESTEP", CFG_INT, &ap->estep);
+            RD(tdcfn, "ESIGN", CFG_INT, &ap->esign);
+            ap->haveenc = 1;
+        }
+#undef RD
+        if (n > 0 && ap->have)
+        {
+            fprintf(stderr, "%c: %d entries missing from config files\n", ap->name, n);
+            exit(1);
+        }
+    }
+}
+
+/* open connections to ap and note where it is */
+static void openAxis(Axis *ap)
+{
+    if (virtual_mode)
+    {
+        (void)vmcSetup(ap->addr, factor * ap->maxvel, factor * ap->maxacc, ap->step, ap->esign);
+        vmcReset(ap->addr);
+        vmcSetHome(ap->addr);
+    }
+    else
+    {
+        ap->cfd = csi_open(host, port, ap->addr);
+        ap->sfd = csi_open(host, port, ap->addr);
+        if (ap->cfd < 0 || ap->sfd < 0)
+        {
+            fprintf(stderr, "%c: can not open csimc addr %d: %s\n", ap->name, ap->addr, strerror(errno));
+            exit(1);
+        }
+        if (!csi_rix(ap->sfd, "=h;"))
+        {
+            fprintf(stderr, "%c: axis is not homed\n", ap->name);
+            exit(1);
+        }
+    }
+
+    ap->home = where(ap);
+    printf("%c: addr %d starting at %.6f rads, config MAXVEL %g MAXACC %g\n", ap->name, ap->addr, ap->home,
+           ap->maxvel, ap->maxacc);
+}
+
+/* put ap back where it was and restore its config limits */
+static void closeAxis(Axis *ap)
+{
+    setLimits(ap, ap->maxvel, ap->maxacc);
+    moveTo(ap, ap->home);
+    (void)record(ap, trapMoveTime(where(ap) - ap->home, ap->maxvel, ap->maxacc) + SETTLEWIN, samples);
+
+    if (!virtual_mode)
+    {
+        csi_close(ap->cfd);
+        csi_close(ap->sfd);
+    }
+}
+
+/* set the node's motion limits.
+ * N.B. the virtual axes have no acceleration limit.
+ */
+static void setLimits(Axis *ap, double maxvel, double maxacc)
+{
+    if (virtual_mode)
+    {
+        (void)vmcSetup(ap->addr, maxvel, maxacc, ap->step, ap->esign);
+    }
+    else
+    {
+        double scale = ap->step / (2 * PI);
+
+        csi_w(ap->sfd, "maxvel=%.0f;", maxvel * scale);
+        csi_w(ap->sfd, "maxacc=%.0f;", maxacc * scale);
+    }
+}
+
+/* start ap moving to canonical position x */
+static void moveTo(Axis *ap, double x)
+{
+    if (virtual_mode)
+    {
+        vmcSetTargetPosition(ap->addr, ap->sign * ap->step * x / (2 * PI));
+    }
+    else if (ap->haveenc)
+    {
+        csi_w(ap->sfd, "etpos=%.0f;", ap->esign * ap->estep * x / (2 * PI));
+    }
+    else
+    {
+        csi_w(ap->sfd, "mtpos=%.0f;", ap->sign * ap->step * x / (2 * PI));
+    }
+}
+
+/* start ap moving at canonical velocity v, 0 to stop */
+static void setVel(Axis *ap, double v)
+{
+    int stp = ap->sign * (int)floor(ap->step * v / (2 * PI) + .5);
+
+    if (virtual_mode)
+    {
+        /* virmc moves raw positions by its own sign, which is esign */
+        if (v == 0)
+            vmcStop(ap->addr);
+        else
+            vmcJog(ap->addr, ap->esign * stp);
+    }
+    else
+    {
+        csi_w(ap->sfd, "clock=0;");
+        csi_w(ap->sfd, "timeout=300000;");
+        csi_w(ap->sfd, "mtvel=%d;", stp);
+    }
+}
+
+/* start ap following the n canonical positions in x[], ivalms apart */
+static void trackPath(Axis *ap, int n, int ivalms, double x[])
+{
+    int i;
+
+    if (virtual_mode)
+    {
+        double *raw = (double *)malloc(n * sizeof(double));
+
+        for (i = 0; i < n; i++)
+            raw[i] = ap->sign * x[i];
+        vmcResetClock(ap->addr);
+        vmcSetTimeout(ap->addr, n * ivalms);
+        (void)vmcSetTrackPath(ap->addr, n, 0, ivalms, raw);
+        free((void *)raw);
+    }
+    else
+    {
+        double scale = ap->haveenc ? ap->esign * ap->estep / (2 * PI) : ap->sign * ap->step / (2 * PI);
+
+        csi_w(ap->sfd, "clock=0;");
+        csi_w(ap->sfd, "timeout=%d;", n * ivalms);
+        csi_w(ap->sfd, ap->haveenc ? "etrack" : "mtrack");
+        csi_w(ap->sfd, "(0,%d", ivalms);
+        for (i = 0; i < n; i++)
+            csi_w(ap->sfd, ",%.0f", scale * x[i] + .5);
+        csi_w(ap->sfd, ");");
+    }
+}
+
+/* return the current canonical position of ap */
+static double where(Axis *ap)
+{
+    if (virtual_mode)
+        return ((2 * PI) * ap->sign * vmcGetPosition(ap->addr) / ap->step);
+    if (ap->haveenc)
+        return ((2 * PI) * ap->esign * csi_rix(ap->sfd, "=epos;") / ap->estep);
+    return ((2 * PI) * ap->sign * csi_rix(ap->sfd, "=mpos;") / ap->step);
+}
+
+/* sample the position of ap every period ms for secs into s[].
+ * return the number of samples.
+ */
+static int record(Axis *ap, double secs, Sample s[])
+{
+    int n = 0;
+
+    if (virtual_mode)
+    {
+        long t0 = vmcGetClock(ap->addr);
+        long t;
+
+        /* the virtual node only moves when serviced, as by tel_poll() */
+        do
+        {
+            vmcService(ap->addr);
+            t = vmcGetClock(ap->addr) - t0;
+            s[n].t = t / 1000.0;
+            s[n].x = where(ap);
+            usleep(period * 1000);
+        } while (++n < MAXSAMP && t < secs * 1000);
+    }
+    else
+    {
+        char buf[128];
+        long t0 = -1;
+
+        /* let the node time and report its own position */
+        csi_w(ap->cfd, "for ($1 = clock + %d; clock < $1; pause(%d)) printf(\"%%d %%d\\n\", clock, %s);",
+              (int)(secs * 1000), period, ap->haveenc ? "epos" : "mpos");
+        csi_w(ap->cfd, "printf(\"end\\n\");");
+        while (csi_r(ap->cfd, buf, sizeof(buf)) > 0 && strncmp(buf, "end", 3))
+        {
+            long t, raw;
+
+            if (sscanf(buf, "%ld %ld", &t, &raw) != 2 || n >= MAXSAMP)
+                continue;
+            if (t0 < 0)
+                t0 = t;
+            s[n].t = (t - t0) / 1000.0;
+            if (ap->haveenc)
+                s[n].x = (2 * PI) * ap->esign * raw / ap->estep;
+            else
+                s[n].x = (2 * PI) * ap->sign * raw / ap->step;
+            n++;
+        }
+    }
+
+    return (n);
+}
+
+/* step back and forth across span at each of NACC acceleration limits */
+static void stepTest(Axis *ap, Result *rp)
+{
+    double vcap = factor * ap->maxvel;
+    double *v = (double *)malloc(MAXSAMP * sizeof(double));
+    int k;
+
+    printf("%c: step %g rads at up to %g rads/sec\n", ap->name, 2 * span, vcap);
+    printf("%c: %10s %10s %10s %10s\n", ap->name, "MaxAcc", "GotAcc", "Overshoot", "Settled");
+
+    /* start from one end */
+    setLimits(ap, ap->maxvel, ap->maxacc);
+    moveTo(ap, ap->home - span);
+    (void)record(ap, trapMoveTime(span, ap->maxvel, ap->maxacc) + SETTLEWIN, samples);
+
+    for (k = 0; k < NACC; k++)
+    {
+        double acc = factor * ap->maxacc * (k + 1) / NACC;
+        double dir = k % 2 ? -1 : 1;
+        double target = ap->home + dir * span;
+        double x0 = where(ap);
+        double over = 0, settle = 0, vpk = 0, tpk = 0;
+        int i, n;
+
+        setLimits(ap, vcap, acc);
+        moveTo(ap, target);
+        n = record(ap, trapMoveTime(target - x0, vcap, acc) + SETTLEWIN, samples);
+        logSamples(ap, "step", acc, samples, n);
+        if (n < 3)
+            continue;
+
+        /* overshoot and last time outside tol */
+        for (i = 0; i < n; i++)
+        {
+            double err = dir * (samples[i].x - target);
+
+            if (err > over)
+                over = err;
+            if (fabs(err) > tol)
+                settle = samples[i].t;
+        }
+
+        /* achieved acceleration is the slope of the velocity as it climbs
+         * from 10% to 90% of its peak.
+         */
+        velocities(samples, n, v);
+        for (i = 0; i < n; i++)
+        {
+            if (fabs(v[i]) > vpk)
+            {
+                vpk = fabs(v[i]);
+                tpk = samples[i].t;
+            }
+        }
+        {
+            double t10 = -1, t90 = -1;
+
+            for (i = 0; i < n && samples[i].t <= tpk; i++)
+            {
+                if (t10 < 0 && fabs(v[i]) >= 0.1 * vpk)
+                    t10 = samples[i].t;
+                if (t90 < 0 && fabs(v[i]) >= 0.9 * vpk)
+                    t90 = samples[i].t;
+            }
+            if (t10 >= 0 && t90 > t10)
+            {
+                /* slope of |v| over the climb */
+                double sv = 0, st = 0, svt = 0, stt = 0;
+                int m = 0;
+
+                for (i = 0; i < n; i++)
+                {
+                    if (samples[i].t < t10 || samples[i].t > t90)
+                        continue;
+                    sv += fabs(v[i]);
+                    st += samples[i].t;
+                    svt += fabs(v[i]) * samples[i].t;
+                    stt += samples[i].t * samples[i].t;
+                    m++;
+                }
+                if (m > 1 && m * stt - st * st > 0)
+                    rp->gotacc[k] = (m * svt - st * sv) / (m * stt - st * st);
+            }
+            else
+            {
+                /* reached speed within one sample */
+                rp->gotacc[k] = vpk / (period / 1000.0);
+            }
+        }
+
+        rp->acc[k] = acc;
+        rp->overs[k] = over;
+        rp->settle[k] = settle;
+        printf("%c: %10.4f %10.4f %10.6f %10.2f\n", ap->name, acc, rp->gotacc[k], over, settle);
+    }
+
+    /* settling time: how long after the ideal profile ends the gentlest step
+     * took to come within tol.
+     */
+    rp->tsettle = rp->settle[0] - trapMoveTime(2 * span, vcap, rp->acc[0]);
+    if (rp->tsettle < period / 1000.0)
+        rp->tsettle = period / 1000.0;
+
+    free((void *)v);
+}
+
+/* run at increasing speeds, alternating direction to stay within span, and
+ * find the highest speed actually sustained.
+ */
+static void rampTest(Axis *ap, Result *rp)
+{
+    double vcap = factor * ap->maxvel;
+    int k;
+
+    printf("%c: ramp up to %g rads/sec\n", ap->name, vcap);
+    printf("%c: %10s %10s\n", ap->name, "Commanded", "Got");
+
+    setLimits(ap, vcap, ap->maxacc);
+    for (k = 1; k <= NRAMP; k++)
+    {
+        double vel = vcap * k / NRAMP;
+        double dir = k % 2 ? 1 : -1;
+        double tacc = vel / ap->maxacc;
+        double thold, got;
+        int n;
+
+        /* start from the far side so the whole run fits in 2*span */
+        moveTo(ap, ap->home - dir * span);
+        (void)record(ap, trapMoveTime(2 * span, vcap, ap->maxacc) + 1, samples);
+
+        /* time at speed left once we have accelerated */
+        thold = 2 * span / vel - tacc;
+        if (thold < 4 * period / 1000.0)
+        {
+            printf("%c: %10.4f %10s\n", ap->name, vel, "span too short");
+            break;
+        }
+
+        setVel(ap, dir * vel);
+        n = record(ap, tacc + thold, samples);
+        setVel(ap, 0);
+        logSamples(ap, "ramp", vel, samples, n);
+
+        got = fabs(fitSlope(samples, n, tacc + thold / 4, tacc + thold));
+        printf("%c: %10.4f %10.4f\n", ap->name, vel, got);
+        if (got > rp->vsat)
+            rp->vsat = got;
+        if (got < 0.95 * vel)
+            break; /* saturated */
+    }
+
+    /* wait to stop */
+    (void)record(ap, vcap / ap->maxacc + 1, samples);
+}
+
+/* follow sinusoids of increasing frequency about home and find where the
+ * response falls to 70% or lags by 45 degrees.
+ */
+static void sineTest(Axis *ap, Result *rp)
+{
+    static double freqs[NSINE] = {0.05, 0.1, 0.2, 0.5, 1.0, 2.0};
+    double x[4 * SPC + 1];
+    int k;
+
+    printf("%c: sine\n", ap->name);
+    printf("%c: %10s %10s %10s %10s\n", ap->name, "Hz", "Amp", "Gain", "Lag,deg");
+
+    setLimits(ap, ap->maxvel, ap->maxacc);
+    moveTo(ap, ap->home);
+    (void)record(ap, trapMoveTime(span, ap->maxvel, ap->maxacc) + SETTLEWIN, samples);
+
+    rp->fband = 0;
+    for (k = 0; k < NSINE; k++)
+    {
+        double f = freqs[k];
+        double w = 2 * PI * f;
+        double amp = span / 2;
+        double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0, xm = 0;
+        double a, b, det, gain, lag;
+        int ivalms = (int)floor(1000.0 / (f * SPC) + .5);
+        int i, n, m = 0;
+
+        /* stay within half the configured limits */
+        if (amp * w > ap->maxvel / 2)
+            amp = ap->maxvel / 2 / w;
+        if (amp * w * w > ap->maxacc / 2)
+            amp = ap->maxacc / 2 / (w * w);
+        if (ivalms < period)
+            break;
+
+        for (i = 0; i <= 4 * SPC; i++)
+            x[i] = ap->home + amp * sin(w * i * ivalms / 1000.0);
+        trackPath(ap, 4 * SPC + 1, ivalms, x);
+        n = record(ap, 4 * SPC * ivalms / 1000.0, samples);
+        logSamples(ap, "sine", f, samples, n);
+
+        /* fit x - home = a sin + b cos + c over the last 3 cycles */
+        for (i = 0; i < n; i++)
+            if (samples[i].t >= 1 / f)
+            {
+                xm += samples[i].x - ap->home;
+                m++;
+            }
+        if (m < SPC)
+            continue;
+        xm /= m;
+        for (i = 0; i < n; i++)
+        {
+            double s, c, d;
+
+            if (samples[i].t < 1 / f)
+                continue;
+            s = sin(w * samples[i].t);
+            c = cos(w * samples[i].t);
+            d = samples[i].x - ap->home - xm;
+            ss += s * s;
+            sc += s * c;
+            cc += c * c;
+            xs += d * s;
+            xc += d * c;
+        }
+        det = ss * cc - sc * sc;
+        if (det == 0)
+            continue;
+        a = (xs * cc - xc * sc) / det;
+        b = (xc * ss - xs * sc) / det;
+        gain = sqrt(a * a + b * b) / amp;
+        lag = -raddeg(atan2(b, a));
+
+        printf("%c: %10.2f %10.6f %10.3f %10.1f\n", ap->name, f, amp, gain, lag);
+        if (!rp->fband && (gain < 0.707 || gain > 1.414 || lag > 45))
+            rp->fband = f;
+    }
+
+    moveTo(ap, ap->home);
+}
+
+/* acquire a sidereal track starting at home from span below it, first as
+ * the plain track, which the node must catch with its own trapezoid and then
+ * hunt, then with the S-curve telescoped's buildTrack() puts in front of it.
+ * for each report the greatest excursion past the track in the direction of
+ * approach and the last time the axis was more than tol from it.
+ */
+static void acqTest(Axis *ap, Result *rp)
+{
+    static char *names[2] = {"plain", "S-curve"};
+    double x[ACQPTS];
+    int k;
+
+    printf("%c: acquire %g rads onto %g rads/sec\n", ap->name, span, ACQRATE);
+    printf("%c: %10s %10s %10s %10s\n", ap->name, "Profile", "Curve", "Overshoot", "Settled");
+
+    setLimits(ap, ap->maxvel, ap->maxacc);
+    for (k = 0; k < 2; k++)
+    {
+        double vel = ACQDERATE * ap->maxvel, acc = ACQDERATE * ap->maxacc;
+        double off, dir, tacq, dur, over = 0, settle = 0;
+        int ivalms;
+        int i, n;
+
+        moveTo(ap, ap->home - span);
+        (void)record(ap, trapMoveTime(2 * span, ap->maxvel, ap->maxacc) + SETTLEWIN, samples);
+
+        /* same spacing for both so only the start differs */
+        off = where(ap) - ap->home;
+        dir = off < 0 ? 1 : -1;
+        tacq = scurveMoveTime(off, vel, acc, ap->maxjerk);
+        dur = tacq + ACQTAIL;
+        ivalms = (int)ceil(1000.0 * dur / (ACQPTS - 1));
+        for (i = 0; i < ACQPTS; i++)
+        {
+            double t = i * ivalms / 1000.0;
+
+            x[i] = ap->home + ACQRATE * t;
+            if (k == 1)
+                x[i] += off + scurveMovePos(-off, vel, acc, ap->maxjerk, t);
+        }
+
+        trackPath(ap, ACQPTS, ivalms, x);
+        n = record(ap, dur, samples);
+        logSamples(ap, "acquire", k, samples, n);
+
+        for (i = 0; i < n; i++)
+        {
+            double err = samples[i].x - (ap->home + ACQRATE * samples[i].t);
+
+            if (dir * err > over)
+                over = dir * err;
+            if (fabs(err) > tol)
+                settle = samples[i].t;
+        }
+
+        rp->acqover[k] = over;
+        rp->acqsettle[k] = settle;
+        printf("%c: %10s %10.2f %10.6f %10.2f\n", ap->name, names[k], k ? tacq : 0.0, over, settle);
+    }
+
+    moveTo(ap, ap->home);
+    (void)record(ap, trapMoveTime(span, ap->maxvel, ap->maxacc) + SETTLEWIN, samples);
+}
+
+/* print the values to put in telescoped.cfg.
+ * MAXVEL is margin of the highest sustained speed. MAXACC is the step level
+ * which got to the far side and settled soonest, provided the axis really
+ * achieved it and its overshoot stayed within 10*tol, times margin of what
+ * it achieved. POLL_PERIOD is short enough to see settling and tracking
+ * errors well within their time scales.
+ */
+static void recommend(Axis *ap, Result *rp)
+{
+    double vel, acc = 0, best = HUGE_VAL, poll;
+    int k;
+
+    vel = rp->vsat > 0 ? margin * rp->vsat : ap->maxvel;
+
+    for (k = 0; k < NACC; k++)
+    {
+        if (rp->acc[k] == 0 || rp->gotacc[k] < 0.9 * rp->acc[k] || rp->overs[k] > 10 * tol)
+            continue;
+        if (rp->settle[k] < best)
+        {
+            best = rp->settle[k];
+            acc = rp->acc[k];
+        }
+    }
+    if (acc == 0)
+        acc = ap->maxacc;
+    else
+        acc = margin * acc;
+
+    poll = rp->tsettle / 5;
+    if (rp->fband > 0 && 1 / (10 * rp->fband) < poll)
+        poll = 1 / (10 * rp->fband);
+    if (poll < period / 1000.0)
+        poll = period / 1000.0;
+
+    printf("%c: recommend\n", ap->name);
+    printf("%cMAXVEL\t\t%.3f\t\t! %.0f%% of %.3f sustained\n", ap->name, vel, 100 * margin, rp->vsat);
+    printf("%cMAXACC\t\t%.3f\t\t! settled %.2f secs after %.2f rad step\n", ap->name, acc, best, 2 * span);
+    printf("POLL_PERIOD\t%.0f\t\t! ms; bandwidth %s%.2f Hz, settling %.2f secs\n", 1000 * poll,
+           rp->fband > 0 ? "" : ">", rp->fband > 0 ? rp->fband : 2.0, rp->tsettle);
+}
+
+/* write samples to logfp, if open */
+static void logSamples(Axis *ap, char *test, double param, Sample s[], int n)
+{
+    int i;
+
+    if (!logfp)
+        return;
+    for (i = 0; i < n; i++)
+        fprintf(logfp, "%c %s %g %.3f %.7f\n", ap->name, test, param, s[i].t, s[i].x);
+}
+
+/* return the least-squares slope of position vs time between t0 and t1 */
+static double fitSlope(Sample s[], int n, double t0, double t1)
+{
+    double sx = 0, st = 0, sxt = 0, stt = 0;
+    int i, m = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        if (s[i].t < t0 || s[i].t > t1)
+            continue;
+        sx += s[i].x;
+        st += s[i].t;
+        sxt += s[i].x * s[i].t;
+        stt += s[i].t * s[i].t;
+        m++;
+    }
+    if (m < 2 || m * stt - st * st <= 0)
+        return (0.0);
+    return ((m * sxt - st * sx) / (m * stt - st * st));
+}
+
+/* fill v[] with velocities at each sample, by central differences */
+static void velocities(Sample s[], int n, double v[])
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        int i0 = i > 0 ? i - 1 : 0;
+        int i1 = i < n - 1 ? i + 1 : n - 1;
+        double dt = s[i1].t - s[i0].t;
+
+        v[i] = dt > 0 ? (s[i1].x - s[i0].x) / dt : 0;
+    }
+}
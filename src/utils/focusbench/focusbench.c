@@ -0,0 +1,280 @@
+/* count the moves autofocus strategies take on synthetic V curves.
+ *
+ * each trial is a hyperbolic V curve with a random best focus within a few
+ * steps of the start, random least fwhm and slope, gaussian noise of -r of
+ * the fwhm and, with probability -o, a spoilt sample up to 2.5 times too
+ * big. each is focused by:
+ *
+ *   afNext   the autofocus engine, as focus_auto() in telescoped uses it
+ *   scan     a fixed scan of 11 samples a step apart about the start, then
+ *            one afFit(), as a script would do by hand
+ *   funcmax  the misc library funcmax() on -fwhm, as a reference
+ *
+ * for each one line is printed with the mean, median and most moves taken
+ * by those that succeed, the rms error of the best focus found, in units of
+ * the step, and how many failed or ended more than -t off. moves are samples
+ * plus the one to best.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "autofocus.h"
+#include "lstsqr.h"
+
+#define MAXTRIALS 100000 /* most -n */
+#define STEP 50.0        /* initial sample spacing, microns */
+#define RANGE 6.0        /* true best within this many steps of start */
+#define LIMIT 50.0       /* focuser travel either side of start, steps */
+#define NSCAN 11         /* samples in a scan */
+
+/* one synthetic V curve */
+typedef struct
+{
+    double best;  /* true best focus, microns */
+    double fmin;  /* fwhm there, pixels */
+    double slope; /* fwhm per micron far from best */
+} VCurve;
+
+static void usage(void);
+static void makeCurve(VCurve *vp);
+static double measure(VCurve *vp, double x);
+static double gaussNoise(void);
+static int runEngine(VCurve *vp, double *bestp);
+static int runScan(VCurve *vp, double *bestp);
+static int runFuncmax(VCurve *vp, double *bestp);
+static double fmFunc(double u);
+static void runTrials(char *name, int (*fn)(VCurve *vp, double *bestp));
+static int cmpInt(const void *a, const void *b);
+
+static char *me;
+static int ntrials = 2000; /* trials per strategy */
+static double noise = .03; /* fwhm noise, fraction */
+static double outlier = .05; /* chance a sample is spoilt */
+static double tol = .2;    /* best focus wanted to within this, steps */
+static unsigned seed = 1;  /* for rand_r() noise */
+static unsigned cseed;     /* for rand_r() curves, the same for each strategy */
+static VCurve *fmcurve;    /* curve funcmax() is working on */
+static int fmcount;        /* samples funcmax() has taken */
+
+int main(int ac, char *av[])
+{
+    me = strrchr(av[0], '/') ? strrchr(av[0], '/') + 1 : av[0];
+
+    while ((--ac > 0) && ((*++av)[0] == '-'))
+    {
+        char *s;
+        for (s = av[0] + 1; *s != '\0'; s++)
+            switch (*s)
+            {
+            case 'n':
+                if (ac < 2)
+                    usage();
+                ntrials = atoi(*++av);
+                ac--;
+                break;
+            case 'o':
+                if (ac < 2)
+                    usage();
+                outlier = atof(*++av);
+                ac--;
+                break;
+            case 'r':
+                if (ac < 2)
+                    usage();
+                noise = atof(*++av);
+                ac--;
+                break;
+            case 's':
+                if (ac < 2)
+                    usage();
+                seed = atoi(*++av);
+                ac--;
+                break;
+            case 't':
+                if (ac < 2)
+                    usage();
+                tol = atof(*++av);
+                ac--;
+                break;
+            default:
+                usage();
+            }
+    }
+    if (ac > 0 || ntrials < 1 || ntrials > MAXTRIALS || noise < 0 || outlier < 0 || outlier > 1 || tol <= 0)
+        usage();
+    cseed = seed;
+
+    printf("# %-8s %8s %8s %8s %10s %8s %8s\n", "strategy", "mean", "median", "max", "rms err", "failed", "off");
+    runTrials("afNext", runEngine);
+    runTrials("scan", runScan);
+    runTrials("funcmax", runFuncmax);
+
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s [options]\n", me);
+    fprintf(stderr, "Purpose: count autofocus moves on synthetic V curves.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -n n     trials per strategy, 1..%d; default 2000\n", MAXTRIALS);
+    fprintf(stderr, "  -o p     chance a sample is spoilt; default .05\n");
+    fprintf(stderr, "  -r f     fwhm noise, fraction; default .03\n");
+    fprintf(stderr, "  -s seed  for the curves and noise; default 1\n");
+    fprintf(stderr, "  -t tol   best focus wanted to within this, steps; default .2\n");
+    exit(1);
+}
+
+/* run ntrials of fn, each on the same curves and noise as the others */
+static void runTrials(char *name, int (*fn)(VCurve *vp, double *bestp))
+{
+    int *moves = malloc(ntrials * sizeof(int));
+    unsigned s0 = cseed;
+    double err = 0, sum = 0;
+    int nfail = 0, noff = 0, nok = 0;
+    int i;
+
+    if (!moves)
+    {
+        fprintf(stderr, "%s: no memory for %d trials\n", me, ntrials);
+        exit(1);
+    }
+
+    for (i = 0; i < ntrials; i++)
+    {
+        double best, e;
+        VCurve v;
+        int n;
+
+        makeCurve(&v);
+        n = (*fn)(&v, &best);
+        if (n < 0)
+        {
+            nfail++;
+            moves[i] = 0;
+            continue;
+        }
+        moves[i] = n + 1;
+        sum += moves[i];
+        e = (best - v.best) / STEP;
+        if (fabs(e) > tol)
+            noff++;
+        err += e * e;
+        nok++;
+    }
+    cseed = s0;
+
+    /* failures sort first as 0 */
+    qsort(moves, ntrials, sizeof(int), cmpInt);
+    printf("%-10s %8.2f %8d %8d %10.4f %8d %8d\n", name, nok ? sum / nok : 0, moves[nfail + nok / 2], moves[ntrials - 1],
+           nok ? sqrt(err / nok) : 0, nfail, noff);
+    fflush(stdout);
+    free(moves);
+}
+
+/* make a random curve near 0 */
+static void makeCurve(VCurve *vp)
+{
+    vp->best = STEP * RANGE * (2.0 * rand_r(&cseed) / RAND_MAX - 1);
+    vp->fmin = 1.5 + 1.5 * rand_r(&cseed) / RAND_MAX;
+    vp->slope = (0.3 + 0.7 * rand_r(&cseed) / RAND_MAX) / STEP;
+}
+
+/* return a noisy fwhm of vp at x */
+static double measure(VCurve *vp, double x)
+{
+    double d = vp->slope * (x - vp->best);
+    double f = sqrt(vp->fmin * vp->fmin + d * d);
+
+    f *= 1 + noise * gaussNoise();
+    if ((double)rand_r(&seed) / RAND_MAX < outlier)
+        f *= 1 + 1.5 * rand_r(&seed) / RAND_MAX;
+    return (f > .1 ? f : .1);
+}
+
+/* return a normally distributed random number with unit variance */
+static double gaussNoise()
+{
+    double u1 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+
+    return (sqrt(-2 * log(u1)) * cos(2 * M_PI * u2));
+}
+
+/* focus vp with afNext().
+ * return samples taken with best in *bestp, or -1 if it fails.
+ */
+static int runEngine(VCurve *vp, double *bestp)
+{
+    AutoFocus af;
+    double x;
+    int r;
+
+    afInit(&af, 0.0, STEP, tol * STEP, -LIMIT * STEP, LIMIT * STEP, AF_MAXSAMP);
+    while ((r = afNext(&af, &x)) == AF_MORE)
+        afAddSample(&af, x, measure(vp, x));
+    if (r == AF_FAIL)
+        return (-1);
+
+    *bestp = x;
+    return (af.nsamp);
+}
+
+/* focus vp with a scan about 0 then one fit.
+ * return samples taken with best in *bestp, or -1 if it fails.
+ */
+static int runScan(VCurve *vp, double *bestp)
+{
+    AutoFocus af;
+    int i;
+
+    afInit(&af, 0.0, STEP, tol * STEP, -LIMIT * STEP, LIMIT * STEP, AF_MAXSAMP);
+    for (i = 0; i < NSCAN; i++)
+    {
+        double x = (i - NSCAN / 2) * STEP;
+
+        afAddSample(&af, x, measure(vp, x));
+    }
+    if (afFit(&af) < 0)
+        return (-1);
+
+    *bestp = af.best;
+    return (NSCAN);
+}
+
+/* focus vp with funcmax().
+ * funcmax() starts 5% either side of its x0 so it works in units of 20 steps
+ * from 1, which gives it a first spacing of one step about 0.
+ * return samples taken with best in *bestp, or -1 if it fails.
+ */
+static int runFuncmax(VCurve *vp, double *bestp)
+{
+    double u;
+
+    fmcurve = vp;
+    fmcount = 0;
+    if (funcmax(fmFunc, 1.0, noise * vp->fmin, &u) < 0)
+        return (-1);
+    if (fmcount > 100)
+        return (-1);
+
+    *bestp = (u - 1) * 20 * STEP;
+    return (fmcount);
+}
+
+/* funcmax() wants a maximum */
+static double fmFunc(double u)
+{
+    if (++fmcount > 100)
+        return (0); /* stuck, so flatten it to end it */
+    return (-measure(fmcurve, (u - 1) * 20 * STEP));
+}
+
+/* qsort compare for ints */
+static int cmpInt(const void *a, const void *b)
+{
+    return (*(int *)a - *(int *)b);
+}
@@ -1,18 +1,27 @@
 /*
     Main program to read the Talon shared memory and print all the requested
-    information as formatted strings, suitable for FITS headers
+    information as formatted strings, suitable for FITS headers.
+
+    with -l print the telescoped latency histograms instead, or with -e write
+    them to a file for a metrics collector, every -i secs if given.
 */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/shm.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "P_.h"
 #include "astro.h"
+#include "latshm.h"
 #include "telstatshm.h"
 
 TelStatShm *init_shm(void);
+static void usage(char *me);
+static int latency(int print, char *expfn, int interval);
 
 TelStatShm *init_shm()
 {
@@ -36,22 +45,85 @@ TelStatShm *init_shm()
     return (TelStatShm *)addr;
 }
 
+static void usage(char *me)
+{
+    printf("Syntax: %s [max_time_for_meteo]\n", me);
+    printf("        %s -l            print latency histograms\n", me);
+    printf("        %s -e file [-i secs]  export latency histograms to file, every secs\n", me);
+    exit(EXIT_FAILURE);
+}
+
+/* print and/or export the latency histograms, repeating every interval secs
+ * if > 0. return only if trouble.
+ */
+static int latency(int print, char *expfn, int interval)
+{
+    LatShm *lp = latOpen();
+
+    if (!lp)
+    {
+        fprintf(stderr, "latency shm: %s\n", errno == ENOENT ? "telescoped not running" : strerror(errno));
+        return (EXIT_FAILURE);
+    }
+
+    for (;;)
+    {
+        if (print)
+            latPrint(stdout, lp);
+        if (expfn && latExport(expfn, lp) < 0)
+        {
+            fprintf(stderr, "%s: %s\n", expfn, strerror(errno));
+            return (EXIT_FAILURE);
+        }
+        if (interval <= 0)
+            return (EXIT_SUCCESS);
+        fflush(stdout);
+        sleep(interval);
+    }
+}
+
 int main(int argc, char **argv)
 {
     char buf[128];
     double lst, fupos;
     long maxtime = 90;
     TelStatShm *telstatshmp;
+    char *expfn = NULL;
+    int lflag = 0, interval = 0;
+    int c;
 
-    if (argc == 2)
+    while ((c = getopt(argc, argv, "le:i:")) != -1)
     {
-        maxtime = atol(argv[1]);
+        switch (c)
+        {
+        case 'l':
+            lflag = 1;
+            break;
+        case 'e':
+            expfn = optarg;
+            break;
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
     }
-    if ((argc > 2) || (maxtime == 0L))
+    if (lflag || expfn)
     {
-        printf("Syntax: %s [max_time_for_meteo]\n", argv[0]);
-        exit(EXIT_FAILURE);
+        if (optind < argc || interval < 0)
+            usage(argv[0]);
+        exit(latency(lflag, expfn, interval));
+    }
+    if (interval)
+        usage(argv[0]);
+
+    if (argc - optind == 1)
+    {
+        maxtime = atol(argv[optind]);
     }
+    if ((argc - optind > 1) || (maxtime == 0L))
+        usage(argv[0]);
 
     telstatshmp = init_shm();
 
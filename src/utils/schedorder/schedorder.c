@@ -0,0 +1,250 @@
+/* read a list of targets and print the order in which to observe them that
+ * loses the least time to slewing, settling and waiting.
+ *
+ * the mount geometry, axis limits and current position come from the
+ * telstatshm segment so telescoped must be running (virtual mode is fine).
+ *
+ * each target line is:
+ *   name RA Dec [start end dur]
+ * RA is apparent in hours, Dec in degrees, both may be sexagesimal.
+ * start and end bound when observing may begin and dur is how long it lasts,
+ * all in seconds from now. a missing window means any time; missing dur is 0.
+ * lines beginning with # are ignored.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "cliserv.h"
+#include "configfile.h"
+#include "misc.h"
+#include "schedorder.h"
+#include "strops.h"
+#include "telstatshm.h"
+
+#define RATEDT 60.0 /* secs over which to find axis rates */
+
+typedef struct
+{
+    char name[64];
+    double ra, dec; /* apparent, rads */
+} Named;
+
+static void usage(char *me);
+static int readTargets(FILE *fp, Named **npp, SchedTarget **tpp);
+static void findAxes(TelStatShm *tsp, double ra, double dec, double dt, double *xp, double *yp);
+static void wrapAxis(MotorInfo *mip, double *vp);
+
+static Now now; /* when the schedule begins */
+
+int main(int ac, char *av[])
+{
+    char *me = basenm(av[0]);
+    int nthreads = 4;
+    double maxsecs = 5;
+    double settle = -1;
+    TelStatShm *tsp;
+    SchedMount m;
+    SchedResult r;
+    SchedTarget *tp;
+    Named *names;
+    FILE *fp = stdin;
+    double t;
+    int *order;
+    int n, i;
+
+    /* crack arguments */
+    for (av++; --ac > 0 && **av == '-'; av++)
+    {
+        char *arg = *av;
+        if (!strcmp(arg, "-t") && ac > 1)
+        {
+            nthreads = atoi(*++av);
+            --ac;
+        }
+        else if (!strcmp(arg, "-s") && ac > 1)
+        {
+            maxsecs = atof(*++av);
+            --ac;
+        }
+        else if (!strcmp(arg, "-e") && ac > 1)
+        {
+            settle = atof(*++av);
+            --ac;
+        }
+        else
+            usage(me);
+    }
+    if (ac > 1)
+        usage(me);
+    if (ac == 1)
+    {
+        fp = fopen(*av, "r");
+        if (!fp)
+        {
+            fprintf(stderr, "%s: %s\n", *av, strerror(errno));
+            exit(1);
+        }
+    }
+
+    if (open_telshm(&tsp) < 0)
+    {
+        fprintf(stderr, "%s: can not connect to telstatshm: %s\n", me, strerror(errno));
+        exit(1);
+    }
+
+    /* schedule starts now from where the mount is now */
+    now = tsp->now;
+    now.n_mjd = mjd_now();
+    memset(&m, 0, sizeof(m));
+    m.x0 = tsp->minfo[TEL_HM].cpos;
+    m.y0 = tsp->minfo[TEL_DM].cpos;
+    m.hmaxvel = tsp->minfo[TEL_HM].maxvel;
+    m.hmaxacc = tsp->minfo[TEL_HM].maxacc;
+    m.dmaxvel = tsp->minfo[TEL_DM].maxvel;
+    m.dmaxacc = tsp->minfo[TEL_DM].maxacc;
+    m.settle = settle >= 0 ? settle : 1.0 + tsp->dt / 1000.0;
+
+    n = readTargets(fp, &names, &tp);
+    if (n <= 0)
+    {
+        fprintf(stderr, "%s: no targets\n", me);
+        exit(1);
+    }
+
+    /* find where each target is on the axes and how fast it moves */
+    for (i = 0; i < n; i++)
+    {
+        double x1, y1;
+
+        findAxes(tsp, names[i].ra, names[i].dec, 0.0, &tp[i].x, &tp[i].y);
+        findAxes(tsp, names[i].ra, names[i].dec, RATEDT, &x1, &y1);
+        x1 -= 2 * PI * floor((x1 - tp[i].x) / (2 * PI) + 0.5); /* same wrap */
+        y1 -= 2 * PI * floor((y1 - tp[i].y) / (2 * PI) + 0.5);
+        tp[i].dx = (x1 - tp[i].x) / RATEDT;
+        tp[i].dy = (y1 - tp[i].y) / RATEDT;
+    }
+
+    order = (int *)malloc(n * sizeof(int));
+    if (!order || schedOrder(&m, tp, n, order, nthreads, maxsecs, &r) < 0)
+    {
+        fprintf(stderr, "%s: no memory for %d targets\n", me, n);
+        exit(1);
+    }
+
+    /* report, retracing to show when each begins */
+    printf("# %-20s %10s %10s\n", "Name", "Start", "Overhead");
+    for (i = 0, t = 0; i < n; i++)
+    {
+        SchedResult ri;
+
+        schedEval(&m, tp, order, i + 1, &ri);
+        t = ri.finish - tp[order[i]].dur;
+        printf("%-22s %10.1f %10.1f%s\n", names[order[i]].name, t, ri.overhead,
+               t > tp[order[i]].end ? " LATE" : "");
+    }
+    printf("# %d targets, %.1f secs overhead, %d late, done after %.1f secs\n", n, r.overhead, r.nlate, r.finish);
+
+    return (0);
+}
+
+static void usage(char *me)
+{
+    fprintf(stderr, "Usage: %s [options] [file]\n", me);
+    fprintf(stderr, "Purpose: order targets to minimise slew and wait overhead.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -t n   number of threads to use; default 4\n");
+    fprintf(stderr, "  -s s   seconds to spend refining the order; default 5\n");
+    fprintf(stderr, "  -e s   settling time after each slew, seconds; default 1 + poll period\n");
+    fprintf(stderr, "Reads lines of: name RA(hours) Dec(degrees) [start end dur(secs from now)]\n");
+    exit(1);
+}
+
+/* read target lines from fp into malloced arrays.
+ * return number found.
+ */
+static int readTargets(FILE *fp, Named **npp, SchedTarget **tpp)
+{
+    Named *names = NULL;
+    SchedTarget *tp = NULL;
+    char line[1024];
+    int n = 0;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        char name[64], rastr[32], decstr[32];
+        double ra, dec, start, end, dur;
+        int nf;
+
+        if (line[0] == '#')
+            continue;
+        nf = sscanf(line, "%63s %31s %31s %lf %lf %lf", name, rastr, decstr, &start, &end, &dur);
+        if (nf < 3)
+            continue;
+        if (nf < 5)
+        {
+            start = 0;
+            end = HUGE_VAL;
+        }
+        if (nf < 6)
+            dur = 0;
+
+        f_scansex(0.0, rastr, &ra);
+        f_scansex(0.0, decstr, &dec);
+
+        names = (Named *)realloc(names, (n + 1) * sizeof(Named));
+        tp = (SchedTarget *)realloc(tp, (n + 1) * sizeof(SchedTarget));
+        if (!names || !tp)
+        {
+            fprintf(stderr, "No memory for more targets\n");
+            exit(1);
+        }
+
+        strcpy(names[n].name, name);
+        names[n].ra = hrrad(ra);
+        names[n].dec = degrad(dec);
+        memset(&tp[n], 0, sizeof(tp[n]));
+        tp[n].start = start;
+        tp[n].end = end;
+        tp[n].dur = dur;
+        n++;
+    }
+
+    *npp = names;
+    *tpp = tp;
+    return (n);
+}
+
+/* find the canonical axis positions for ra/dec dt secs after the schedule
+ * begins, wrapped within the axis limits as telescoped would.
+ */
+static void findAxes(TelStatShm *tsp, double ra, double dec, double dt, double *xp, double *yp)
+{
+    Now n = now;
+    double lst, ha;
+
+    n.n_mjd += dt / SPD;
+    now_lst(&n, &lst);
+    ha = hrrad(lst) - ra;
+    haRange(&ha);
+
+    tel_hadec2xy(ha, dec, &tsp->tax, xp, yp);
+    tel_ideal2realxy(&tsp->tax, xp, yp);
+    wrapAxis(&tsp->minfo[TEL_HM], xp);
+    wrapAxis(&tsp->minfo[TEL_DM], yp);
+}
+
+/* wrap *vp whole revolutions to be within the limits of mip, if possible */
+static void wrapAxis(MotorInfo *mip, double *vp)
+{
+    while (*vp <= mip->neglim && *vp + 2 * PI < mip->poslim)
+        *vp += 2 * PI;
+    while (*vp >= mip->poslim && *vp - 2 * PI > mip->neglim)
+        *vp -= 2 * PI;
+}
@@ -0,0 +1,313 @@
+/* time and check starFit() against the gaussfit() it is to replace.
+ *
+ * sets of synthetic stars are made, gaussian and moffat, in small and large
+ * cutouts, each at a random subpixel centre on a flat background with
+ * poisson-like noise. each set is fit by gaussfit() along the row through
+ * the brightest pixel, as starStats() does, then by starFit() with each
+ * model, then by starFitBatch() on one thread and on -t threads. for each
+ * one line is printed with the microsecs per star, the rms error of the
+ * centre and fwhm found, and how many fits failed.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "starfit.h"
+
+#define MAXSTARS 100000 /* most -n */
+#define BG 100.0        /* background level */
+
+/* one set of synthetic stars */
+typedef struct
+{
+    char *name; /* as printed */
+    int model;  /* SF_GAUSS or SF_MOFFAT */
+    double beta; /* moffat beta */
+    double fwhm; /* pixels */
+    int size;    /* cutout side, pixels */
+} StarSet;
+
+static StarSet sets[] = {
+    {"gauss 3px in 15", SF_GAUSS, 0, 3.0, 15},
+    {"gauss 6px in 31", SF_GAUSS, 0, 6.0, 31},
+    {"moffat 3px in 15", SF_MOFFAT, 3.0, 3.0, 15},
+    {"moffat 6px in 31", SF_MOFFAT, 3.0, 6.0, 31},
+};
+#define NSETS (sizeof(sets) / sizeof(sets[0]))
+
+/* gaussfit.c has no header of its own */
+extern void gaussfit(int pix[], int n, double *gmaxp, double *cenp, double *fwhmp);
+
+static void usage(void);
+static void makeStars(StarSet *sp);
+static double gaussNoise(void);
+static double nowSecs(void);
+static void runGaussfit(StarSet *sp);
+static void runStarFit(StarSet *sp, int model);
+static void runBatch(StarSet *sp, int nthreads);
+static void report(char *set, char *how, double secs, StarFit fits[], int ok[]);
+
+static char *me;
+static int nstars = 2000;   /* stars per set */
+static double peak = 1000;  /* star peak above BG */
+static float *pix;          /* nstars cutouts, one after another */
+static double *truex, *truey; /* true centres */
+static double truefwhm;     /* true fwhm of this set */
+static StarFit *fits;       /* results */
+static int *oks;            /* starFit() returns */
+static unsigned seed = 1;   /* for rand_r() */
+
+int main(int ac, char *av[])
+{
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+
+    me = strrchr(av[0], '/') ? strrchr(av[0], '/') + 1 : av[0];
+
+    while ((--ac > 0) && ((*++av)[0] == '-'))
+    {
+        char *s;
+        for (s = av[0] + 1; *s != '\0'; s++)
+            switch (*s)
+            {
+            case 'n':
+                if (ac < 2)
+                    usage();
+                nstars = atoi(*++av);
+                ac--;
+                break;
+            case 'p':
+                if (ac < 2)
+                    usage();
+                peak = atof(*++av);
+                ac--;
+                break;
+            case 's':
+                if (ac < 2)
+                    usage();
+                seed = atoi(*++av);
+                ac--;
+                break;
+            case 't':
+                if (ac < 2)
+                    usage();
+                nthreads = atoi(*++av);
+                ac--;
+                break;
+            default:
+                usage();
+            }
+    }
+    if (ac > 0 || nstars < 1 || nstars > MAXSTARS || peak <= 0 || nthreads < 1)
+        usage();
+
+    pix = malloc(nstars * 31 * 31 * sizeof(float));
+    truex = malloc(nstars * sizeof(double));
+    truey = malloc(nstars * sizeof(double));
+    fits = malloc(nstars * sizeof(StarFit));
+    oks = malloc(nstars * sizeof(int));
+    if (!pix || !truex || !truey || !fits || !oks)
+    {
+        fprintf(stderr, "%s: no memory for %d stars\n", me, nstars);
+        exit(1);
+    }
+
+    printf("# %-18s %-14s %10s %10s %10s %8s\n", "stars", "fit", "us/star", "rms pos", "rms fwhm", "failed");
+    for (i = 0; i < NSETS; i++)
+    {
+        makeStars(&sets[i]);
+        runGaussfit(&sets[i]);
+        runStarFit(&sets[i], SF_GAUSS);
+        runStarFit(&sets[i], SF_MOFFAT);
+        runBatch(&sets[i], 1);
+        if (nthreads > 1)
+            runBatch(&sets[i], nthreads);
+    }
+
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s [options]\n", me);
+    fprintf(stderr, "Purpose: time and check starFit() against gaussfit() on synthetic stars.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -n n     stars per set, 1..%d; default 2000\n", MAXSTARS);
+    fprintf(stderr, "  -p peak  star peak above background; default 1000\n");
+    fprintf(stderr, "  -s seed  for the random centres and noise; default 1\n");
+    fprintf(stderr, "  -t n     threads for the batch fit; default one per cpu\n");
+    exit(1);
+}
+
+/* fill pix[] with nstars of sp, noting their true centres */
+static void makeStars(StarSet *sp)
+{
+    int sz = sp->size;
+    double w;
+    int n, i, j;
+
+    if (sp->model == SF_MOFFAT)
+        w = sp->fwhm / (2 * sqrt(pow(2.0, 1 / sp->beta) - 1));
+    else
+        w = sp->fwhm / (2 * sqrt(2 * log(2.0)));
+    truefwhm = sp->fwhm;
+
+    for (n = 0; n < nstars; n++)
+    {
+        float *p = &pix[n * sz * sz];
+
+        truex[n] = (sz - 1) / 2.0 + (double)rand_r(&seed) / RAND_MAX - 0.5;
+        truey[n] = (sz - 1) / 2.0 + (double)rand_r(&seed) / RAND_MAX - 0.5;
+        for (j = 0; j < sz; j++)
+            for (i = 0; i < sz; i++)
+            {
+                double dx = i - truex[n], dy = j - truey[n];
+                double r2 = dx * dx + dy * dy;
+                double v;
+
+                if (sp->model == SF_MOFFAT)
+                    v = BG + peak * pow(1 + r2 / (w * w), -sp->beta);
+                else
+                    v = BG + peak * exp(-r2 / (2 * w * w));
+                p[j * sz + i] = v + sqrt(v) * gaussNoise();
+            }
+    }
+}
+
+/* return a normally distributed random number with unit variance */
+static double gaussNoise()
+{
+    double u1 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+
+    return (sqrt(-2 * log(u1)) * cos(2 * M_PI * u2));
+}
+
+/* return a monotonic time in secs */
+static double nowSecs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* fit each star with gaussfit() along the row through its brightest pixel.
+ * gaussfit() knows nothing of background so it is taken off first, as
+ * starStats() does. only x is found so y is taken as the true y.
+ */
+static void runGaussfit(StarSet *sp)
+{
+    int sz = sp->size;
+    int row[31];
+    double t0, t;
+    int n, i;
+
+    t0 = nowSecs();
+    for (n = 0; n < nstars; n++)
+    {
+        float *p = &pix[n * sz * sz];
+        double gmax, cen, fwhm;
+        int maxi = 0;
+
+        for (i = 1; i < sz * sz; i++)
+            if (p[i] > p[maxi])
+                maxi = i;
+        for (i = 0; i < sz; i++)
+            row[i] = (int)(p[(maxi / sz) * sz + i] - BG);
+        gaussfit(row, sz, &gmax, &cen, &fwhm);
+
+        fits[n].x = cen;
+        fits[n].y = truey[n];
+        fits[n].fwhm = fwhm;
+        oks[n] = 0;
+    }
+    t = nowSecs() - t0;
+
+    report(sp->name, "gaussfit row", t, fits, oks);
+}
+
+/* fit each star with starFit() with the given model */
+static void runStarFit(StarSet *sp, int model)
+{
+    int sz = sp->size;
+    double t0, t;
+    int n;
+
+    t0 = nowSecs();
+    for (n = 0; n < nstars; n++)
+        oks[n] = starFit(&pix[n * sz * sz], sz, sz, sz, model, &fits[n]);
+    t = nowSecs() - t0;
+
+    report(sp->name, model == SF_MOFFAT ? "starFit moffat" : "starFit gauss", t, fits, oks);
+}
+
+/* fit all stars with starFitBatch() using the set's model and nthreads */
+static void runBatch(StarSet *sp, int nthreads)
+{
+    StarCutout *cuts = malloc(nstars * sizeof(StarCutout));
+    int sz = sp->size;
+    char how[32];
+    double t0, t;
+    int n;
+
+    if (!cuts)
+    {
+        fprintf(stderr, "%s: no memory for %d cutouts\n", me, nstars);
+        exit(1);
+    }
+    for (n = 0; n < nstars; n++)
+    {
+        cuts[n].pix = &pix[n * sz * sz];
+        cuts[n].stride = sz;
+        cuts[n].w = cuts[n].h = sz;
+        cuts[n].model = sp->model;
+    }
+
+    t0 = nowSecs();
+    starFitBatch(cuts, nstars, nthreads);
+    t = nowSecs() - t0;
+
+    for (n = 0; n < nstars; n++)
+    {
+        fits[n] = cuts[n].fit;
+        oks[n] = cuts[n].ok;
+    }
+    sprintf(how, "batch %d thread%s", nthreads, nthreads > 1 ? "s" : "");
+    report(sp->name, how, t, fits, oks);
+    free(cuts);
+}
+
+/* print one line of results */
+static void report(char *set, char *how, double secs, StarFit fits[], int ok[])
+{
+    double pos = 0, fwhm = 0;
+    int nok = 0;
+    int n;
+
+    for (n = 0; n < nstars; n++)
+    {
+        double dx, dy, df;
+
+        if (ok[n] < 0)
+            continue;
+        dx = fits[n].x - truex[n];
+        dy = fits[n].y - truey[n];
+        df = fits[n].fwhm - truefwhm;
+        pos += dx * dx + dy * dy;
+        fwhm += df * df;
+        nok++;
+    }
+    if (nok > 0)
+    {
+        pos = sqrt(pos / nok);
+        fwhm = sqrt(fwhm / nok);
+    }
+
+    printf("%-20s %-14s %10.2f %10.4f %10.4f %8d\n", set, how, secs * 1e6 / nstars, pos, fwhm, nstars - nok);
+    fflush(stdout);
+}
@@ -0,0 +1,629 @@
+/* look at, cut up and replay telescoped recordings made with telescoped -R.
+ *
+ * telrec info file
+ *	chunks, records, span and how well each column compressed.
+ * telrec dump [-s mjd] [-e mjd] [-c col,...] [-o out] file
+ *	print records and commands within the window as text, or copy them to
+ *	a new recording out.
+ * telrec stats [-s mjd] [-e mjd] file
+ *	time in each state, acquisition times and tracking error per axis.
+ * telrec replay [-s mjd] [-e mjd] file
+ *	send the commands within the window to a running telescoped, each when
+ *	its clock reaches the time it was first received, and print what comes
+ *	back. meant for telescoped -v -j <window start> -R 0 so the replay is
+ *	itself recorded, then compared with diff.
+ * telrec diff [-s mjd] [-e mjd] [-x arcsec] a b
+ *	compare positions in b with those in a at the same times. exit 1 if
+ *	any axis differs by more than arcsec rms.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "cliserv.h"
+#include "telrec.h"
+#include "telstatshm.h"
+
+#define ASPR (180 * 3600 / PI) /* arcsec per rad */
+#define NSTATES (TS_LIMITING + 1)
+#define MAXFIFOS 8
+#define STALLSECS 10 /* wall secs telescoped's clock may stand still in replay */
+
+static char *me;
+static double tstart = -1e30, tend = 1e30; /* window, mjd */
+
+static char *statenames[NSTATES] = {"Absent", "Stopped", "Hunting", "Tracking", "Slewing", "Homing", "Limiting"};
+
+/* fifos replay() has connected to */
+static struct
+{
+    char name[32];
+    int fd[2];
+} fifos[MAXFIFOS];
+static int nfifos;
+
+static void usage(void);
+static void mapOrDie(char *fn, TRFile *tfp);
+static void drain(TelStatShm *tsp);
+static int waitFor(TelStatShm *tsp, double t);
+static double (*loadRows(TRFile *tfp, int *np))[TR_NCOL];
+static int info(char *fn);
+static int dump(char *fn, char *cols, char *out);
+static int stats(char *fn);
+static int replay(char *fn);
+static int diff(char *afn, char *bfn, double tol);
+
+int main(int ac, char *av[])
+{
+    char *cols = NULL, *out = NULL;
+    double tol = 1;
+    char *cmd;
+    int c;
+
+    me = av[0];
+    if (ac < 2)
+        usage();
+    cmd = av[1];
+    optind = 2;
+
+    while ((c = getopt(ac, av, "s:e:c:o:x:")) != -1)
+    {
+        switch (c)
+        {
+        case 's':
+            tstart = atof(optarg);
+            break;
+        case 'e':
+            tend = atof(optarg);
+            break;
+        case 'c':
+            cols = optarg;
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'x':
+            tol = atof(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    ac -= optind;
+    av += optind;
+
+    if (!strcmp(cmd, "info") && ac == 1)
+        return (info(av[0]));
+    if (!strcmp(cmd, "dump") && ac == 1)
+        return (dump(av[0], cols, out));
+    if (!strcmp(cmd, "stats") && ac == 1)
+        return (stats(av[0]));
+    if (!strcmp(cmd, "replay") && ac == 1)
+        return (replay(av[0]));
+    if (!strcmp(cmd, "diff") && ac == 2)
+        return (diff(av[0], av[1], tol));
+    usage();
+    return (2);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s info file\n", me);
+    fprintf(stderr, "       %s dump [-s mjd] [-e mjd] [-c col,...] [-o out] file\n", me);
+    fprintf(stderr, "       %s stats [-s mjd] [-e mjd] file\n", me);
+    fprintf(stderr, "       %s replay [-s mjd] [-e mjd] file\n", me);
+    fprintf(stderr, "       %s diff [-s mjd] [-e mjd] [-x arcsec] a b\n", me);
+    fprintf(stderr, "mjd is as in telstatshm, see %s dump -c mjd\n", me);
+    exit(2);
+}
+
+/* map fn or exit */
+static void mapOrDie(char *fn, TRFile *tfp)
+{
+    if (trMap(fn, tfp) < 0)
+    {
+        fprintf(stderr, "%s: %s\n", fn, errno == EPROTO ? "not a telescoped recording" : strerror(errno));
+        exit(2);
+    }
+}
+
+/* return a malloced array of all records within the window, and how many.
+ * exits if trouble.
+ */
+static double (*loadRows(TRFile *tfp, int *np))[TR_NCOL]
+{
+    static double rows[TRCHUNK][TR_NCOL];
+    double(*all)[TR_NCOL] = NULL;
+    int n = 0, m = 0;
+    int i, j, nr;
+
+    for (i = trSeek(tfp, tstart); i < tfp->nidx && tfp->idx[i].t0 <= tend; i++)
+    {
+        nr = trRows(tfp, i, rows);
+        if (nr < 0)
+        {
+            fprintf(stderr, "Chunk %d: %s\n", i, strerror(errno));
+            exit(2);
+        }
+        for (j = 0; j < nr; j++)
+        {
+            if (rows[j][TR_MJD] < tstart || rows[j][TR_MJD] > tend)
+                continue;
+            if (n == m)
+            {
+                m = m ? 2 * m : 4096;
+                all = realloc(all, m * sizeof(all[0]));
+                if (!all)
+                {
+                    fprintf(stderr, "No memory for %d records\n", m);
+                    exit(2);
+                }
+            }
+            memcpy(all[n++], rows[j], sizeof(rows[j]));
+        }
+    }
+
+    *np = n;
+    return (all);
+}
+
+static int info(char *fn)
+{
+    long long colbytes[TR_NCOL];
+    long long nrec = 0, ncmd = 0, npoll = 0;
+    TRChunkHdr ch;
+    TRFile tf;
+    int i, c;
+
+    mapOrDie(fn, &tf);
+    memset(colbytes, 0, sizeof(colbytes));
+
+    for (i = 0; i < tf.nidx; i++)
+    {
+        TRIndex *ip = &tf.idx[i];
+
+        if (ip->kind == TRK_CMDS)
+        {
+            ncmd += ip->nrec;
+            continue;
+        }
+        memcpy(&ch, tf.base + ip->off, sizeof(ch));
+        for (c = 0; c < TR_NCOL; c++)
+            colbytes[c] += (c < TR_NCOL - 1 ? ch.coloff[c + 1] : ch.nbytes) - ch.coloff[c];
+        nrec += ip->nrec;
+        npoll++;
+    }
+
+    printf("%s: %lld bytes, %d chunks, %lld records in %lld, %lld commands\n", fn, tf.len, tf.nidx, nrec, npoll,
+           ncmd);
+    if (tf.nidx > 0)
+    {
+        double t0 = tf.idx[0].t0, t1 = tf.idx[tf.nidx - 1].t1;
+        time_t u;
+        char buf[64];
+
+        /* a command may be written before the poll chunk holding its time */
+        for (i = 1; i < tf.nidx; i++)
+            if (tf.idx[i].t0 < t0)
+                t0 = tf.idx[i].t0;
+        u = (time_t)((t0 - 25567.5) * SPD);
+
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", gmtime(&u));
+        printf("MJD %.6f .. %.6f, %.1f secs from %s UTC\n", t0, t1, (t1 - t0) * SPD, buf);
+    }
+    if (nrec > 0)
+    {
+        printf("%-6s %12s %10s\n", "column", "bytes", "bytes/rec");
+        for (c = 0; c < TR_NCOL; c++)
+            printf("%-6s %12lld %10.2f\n", trColName(c), colbytes[c], (double)colbytes[c] / nrec);
+    }
+
+    trUnmap(&tf);
+    return (0);
+}
+
+static int dump(char *fn, char *cols, char *out)
+{
+    static double rows[TRCHUNK][TR_NCOL];
+    int want[TR_NCOL], nwant = 0;
+    TRFile tf;
+    int i, j, k, nr;
+
+    mapOrDie(fn, &tf);
+
+    if (cols)
+    {
+        char *c, *save = NULL;
+        for (c = strtok_r(cols, ",", &save); c; c = strtok_r(NULL, ",", &save))
+            if ((want[nwant++] = trColFind(c)) < 0)
+            {
+                fprintf(stderr, "%s: no such column\n", c);
+                return (2);
+            }
+    }
+    else
+        for (nwant = 0; nwant < TR_NCOL; nwant++)
+            want[nwant] = nwant;
+
+    if (out && trOpen(out) < 0)
+    {
+        fprintf(stderr, "%s: %s\n", out, strerror(errno));
+        return (2);
+    }
+
+    if (!out)
+    {
+        for (k = 0; k < nwant; k++)
+            printf("%s%s", k ? " " : "", trColName(want[k]));
+        printf("\n");
+    }
+
+    for (i = trSeek(&tf, tstart); i < tf.nidx && tf.idx[i].t0 <= tend; i++)
+    {
+        if (tf.idx[i].kind == TRK_CMDS)
+        {
+            double t;
+            char *p;
+
+            for (p = trCmdNext(&tf, i, NULL, &t); p; p = trCmdNext(&tf, i, p, &t))
+            {
+                if (t < tstart || t > tend)
+                    continue;
+                if (out)
+                {
+                    char fifo[32];
+                    int l = strcspn(p, " ");
+                    sprintf(fifo, "%.*s", l < 31 ? l : 31, p);
+                    if (trCmd(t, fifo, p[l] ? p + l + 1 : p + l) < 0)
+                        goto werr;
+                }
+                else
+                    printf("# %.9f %s\n", t, p);
+            }
+            continue;
+        }
+
+        nr = trRows(&tf, i, rows);
+        if (nr < 0)
+        {
+            fprintf(stderr, "Chunk %d: %s\n", i, strerror(errno));
+            return (2);
+        }
+        for (j = 0; j < nr; j++)
+        {
+            double *rp = rows[j];
+
+            if (rp[TR_MJD] < tstart || rp[TR_MJD] > tend)
+                continue;
+            if (out)
+            {
+                if (trPut(rp) < 0)
+                    goto werr;
+                continue;
+            }
+            for (k = 0; k < nwant; k++)
+            {
+                int c = want[k];
+                if (c == TR_MJD)
+                    printf("%s%.9f", k ? " " : "", rp[c]);
+                else if (c == TR_STATE || c == TR_HRAW || c == TR_DRAW || c == TR_RRAW)
+                    printf("%s%.0f", k ? " " : "", rp[c]);
+                else
+                    printf("%s%.9g", k ? " " : "", rp[c]);
+            }
+            printf("\n");
+        }
+    }
+
+    if (out)
+        trClose();
+    trUnmap(&tf);
+    return (0);
+
+werr:
+    fprintf(stderr, "%s: %s\n", out, strerror(errno));
+    return (2);
+}
+
+static int stats(char *fn)
+{
+    double statesecs[NSTATES];
+    double (*rows)[TR_NCOL];
+    double sum2[3], max[3];
+    double huntt = 0, acqsum = 0, acqmax = 0;
+    int nacq = 0, ntrack = 0, prevstate = -1;
+    TRFile tf;
+    int n, i, a;
+
+    mapOrDie(fn, &tf);
+    rows = loadRows(&tf, &n);
+    if (n < 2)
+    {
+        fprintf(stderr, "%s: fewer than 2 records in window\n", fn);
+        return (1);
+    }
+
+    memset(statesecs, 0, sizeof(statesecs));
+    memset(sum2, 0, sizeof(sum2));
+    memset(max, 0, sizeof(max));
+
+    for (i = 0; i < n; i++)
+    {
+        double *rp = rows[i];
+        int s = (int)rp[TR_STATE];
+
+        if (s < 0 || s >= NSTATES)
+            continue;
+        if (i + 1 < n)
+            statesecs[s] += (rows[i + 1][TR_MJD] - rp[TR_MJD]) * SPD;
+
+        if (s == TS_HUNTING && prevstate != TS_HUNTING)
+            huntt = rp[TR_MJD];
+        if (s == TS_TRACKING && prevstate == TS_HUNTING)
+        {
+            double secs = (rp[TR_MJD] - huntt) * SPD;
+            acqsum += secs;
+            if (secs > acqmax)
+                acqmax = secs;
+            nacq++;
+        }
+        prevstate = s;
+
+        if (s == TS_TRACKING)
+        {
+            for (a = 0; a < 3; a++)
+            {
+                double e = fabs(rp[TR_HCPOS + 4 * a] - rp[TR_HDPOS + 4 * a]) * ASPR;
+                sum2[a] += e * e;
+                if (e > max[a])
+                    max[a] = e;
+            }
+            ntrack++;
+        }
+    }
+
+    printf("%d records over %.1f secs, %.1f ms apart on average\n", n, (rows[n - 1][TR_MJD] - rows[0][TR_MJD]) * SPD,
+           (rows[n - 1][TR_MJD] - rows[0][TR_MJD]) * SPD * 1e3 / (n - 1));
+    for (i = 0; i < NSTATES; i++)
+        if (statesecs[i] > 0)
+            printf("%-9s %10.1f secs\n", statenames[i], statesecs[i]);
+    if (nacq > 0)
+        printf("%d acquisitions, mean %.1f max %.1f secs\n", nacq, acqsum / nacq, acqmax);
+    if (ntrack > 0)
+    {
+        static char axes[3] = {'H', 'D', 'R'};
+        printf("Tracking error over %d records, arcsec:\n", ntrack);
+        printf("%-4s %10s %10s\n", "axis", "rms", "max");
+        for (a = 0; a < 3; a++)
+            printf("%-4c %10.2f %10.2f\n", axes[a], sqrt(sum2[a] / ntrack), max[a]);
+    }
+
+    free(rows);
+    trUnmap(&tf);
+    return (0);
+}
+
+/* wait up to 10 ms for replies on any fifo and print them */
+static void drain(TelStatShm *tsp)
+{
+    struct timeval tv;
+    fd_set rfd;
+    int maxfd = 0, f;
+
+    FD_ZERO(&rfd);
+    for (f = 0; f < nfifos; f++)
+    {
+        FD_SET(fifos[f].fd[0], &rfd);
+        if (fifos[f].fd[0] > maxfd)
+            maxfd = fifos[f].fd[0];
+    }
+    tv.tv_sec = 0;
+    tv.tv_usec = 10000;
+    if (select(maxfd + 1, &rfd, NULL, NULL, &tv) <= 0)
+        return;
+
+    for (f = 0; f < nfifos; f++)
+    {
+        if (FD_ISSET(fifos[f].fd[0], &rfd))
+        {
+            char buf[1024];
+            int code;
+            if (cli_read(fifos[f].fd, &code, buf, sizeof(buf)) == 0)
+                printf("%.9f %s %d %s\n", tsp->now.n_mjd, fifos[f].name, code, buf);
+        }
+    }
+    fflush(stdout);
+}
+
+/* drain until telescoped's clock reaches t.
+ * return 0 if it did, else -1 if telescoped has gone or its clock stopped.
+ */
+static int waitFor(TelStatShm *tsp, double t)
+{
+    double last = tsp->now.n_mjd;
+    time_t moved = time(NULL);
+
+    while (tsp->now.n_mjd < t)
+    {
+        drain(tsp);
+        if (tsp->now.n_mjd != last)
+        {
+            last = tsp->now.n_mjd;
+            moved = time(NULL);
+        }
+        else if (time(NULL) - moved > STALLSECS || (kill(tsp->telescoped_pid, 0) < 0 && errno == ESRCH))
+        {
+            fprintf(stderr, "telescoped stopped at %.9f, waiting for %.9f\n", last, t);
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+static int replay(char *fn)
+{
+    TelStatShm *tsp;
+    TRFile tf;
+    double t0, tlast;
+    int i;
+
+    mapOrDie(fn, &tf);
+    if (tf.nidx == 0)
+    {
+        fprintf(stderr, "%s: empty\n", fn);
+        return (1);
+    }
+    i = trSeek(&tf, tstart);
+    if (i == tf.nidx)
+    {
+        fprintf(stderr, "%s: nothing after %.6f\n", fn, tstart);
+        return (1);
+    }
+    t0 = tf.idx[i].t0 > tstart ? tf.idx[i].t0 : tstart;
+    tlast = tf.idx[tf.nidx - 1].t1 < tend ? tf.idx[tf.nidx - 1].t1 : tend;
+
+    if (open_telshm(&tsp) < 0)
+    {
+        fprintf(stderr, "telescoped not running: start it with -v -j %.6f -R 0\n", t0);
+        return (2);
+    }
+    if (tsp->now.n_mjd > t0 + 1 / SPD)
+        fprintf(stderr, "Warning: telescoped is already past the start, start it with -v -j %.6f -R 0\n", t0);
+
+    for (; i < tf.nidx && tf.idx[i].t0 <= tend; i++)
+    {
+        double t;
+        char *p;
+
+        for (p = trCmdNext(&tf, i, NULL, &t); p; p = trCmdNext(&tf, i, p, &t))
+        {
+            char err[1024], name[32];
+            int l = strcspn(p, " ");
+            char *msg = p[l] ? p + l + 1 : p + l;
+            int f;
+
+            if (t < tstart || t > tend)
+                continue;
+            sprintf(name, "%.*s", l < 31 ? l : 31, p);
+
+            /* wait for telescoped to catch up, showing replies meanwhile */
+            if (waitFor(tsp, t) < 0)
+                return (2);
+
+            /* send on its fifo, connecting the first time */
+            for (f = 0; f < nfifos; f++)
+                if (!strcmp(fifos[f].name, name))
+                    break;
+            if (f == nfifos)
+            {
+                if (nfifos == MAXFIFOS)
+                {
+                    fprintf(stderr, "%s: too many fifos\n", name);
+                    return (2);
+                }
+                if (cli_conn(name, fifos[f].fd, err) < 0)
+                {
+                    fprintf(stderr, "%s: %s\n", name, err);
+                    return (2);
+                }
+                strcpy(fifos[f].name, name);
+                nfifos++;
+            }
+            printf("%.9f %s > %s\n", tsp->now.n_mjd, name, msg);
+            fflush(stdout);
+            if (cli_write(fifos[f].fd, msg, err) < 0)
+            {
+                fprintf(stderr, "%s: %s\n", name, err);
+                return (2);
+            }
+        }
+    }
+
+    /* let it run on to the end of the window so both recordings cover it */
+    if (waitFor(tsp, tlast) < 0)
+        return (2);
+
+    trUnmap(&tf);
+    return (0);
+}
+
+static int diff(char *afn, char *bfn, double tol)
+{
+    static int poscols[] = {TR_HCPOS, TR_HDPOS, TR_DCPOS, TR_DDPOS, TR_RCPOS, TR_RDPOS};
+#define NPOSCOLS (int)(sizeof(poscols) / sizeof(poscols[0]))
+    double sum2[NPOSCOLS], max[NPOSCOLS];
+    double (*a)[TR_NCOL], (*b)[TR_NCOL];
+    int na, nb, i, j, c, n = 0, nstate = 0, bad = 0;
+    TRFile atf, btf;
+
+    mapOrDie(afn, &atf);
+    mapOrDie(bfn, &btf);
+    a = loadRows(&atf, &na);
+    b = loadRows(&btf, &nb);
+    if (na < 2 || nb < 2)
+    {
+        fprintf(stderr, "Fewer than 2 records in window\n");
+        return (2);
+    }
+
+    memset(sum2, 0, sizeof(sum2));
+    memset(max, 0, sizeof(max));
+
+    /* compare each of a within b's span with b interpolated to its time */
+    for (i = 0, j = 0; i < na; i++)
+    {
+        double t = a[i][TR_MJD], f;
+
+        if (t < b[0][TR_MJD] || t > b[nb - 1][TR_MJD])
+            continue;
+        while (j < nb - 2 && b[j + 1][TR_MJD] < t)
+            j++;
+        f = b[j + 1][TR_MJD] > b[j][TR_MJD] ? (t - b[j][TR_MJD]) / (b[j + 1][TR_MJD] - b[j][TR_MJD]) : 0;
+
+        for (c = 0; c < NPOSCOLS; c++)
+        {
+            int k = poscols[c];
+            double bv = b[j][k] + f * (b[j + 1][k] - b[j][k]);
+            double e = fabs(a[i][k] - bv) * ASPR;
+
+            sum2[c] += e * e;
+            if (e > max[c])
+                max[c] = e;
+        }
+        if (a[i][TR_STATE] != b[f < 0.5 ? j : j + 1][TR_STATE])
+            nstate++;
+        n++;
+    }
+
+    if (n == 0)
+    {
+        fprintf(stderr, "Recordings do not overlap in time\n");
+        return (2);
+    }
+
+    printf("%d records compared, state differs in %d\n", n, nstate);
+    printf("%-6s %10s %10s  arcsec\n", "column", "rms", "max");
+    for (c = 0; c < NPOSCOLS; c++)
+    {
+        double rms = sqrt(sum2[c] / n);
+        printf("%-6s %10.2f %10.2f%s\n", trColName(poscols[c]), rms, max[c], rms > tol ? "  FAIL" : "");
+        if (rms > tol)
+            bad = 1;
+    }
+
+    free(a);
+    free(b);
+    trUnmap(&atf);
+    trUnmap(&btf);
+    return (bad);
+}
@@ -0,0 +1,384 @@
+/* run several simulated telescopes in one process, each on its own thread
+ * with the same core as telescoped -v, and drive each through a script of
+ * commands as fast as the cpu allows.
+ *
+ * each script line is:
+ *   secs command
+ * meaning wait secs of simulated time after the previous command completed
+ * then send command, just as it would arrive on the Tel fifo. prefix the
+ * command with "Focus " to send it to the focuser instead. lines beginning
+ * with # are ignored.
+ *
+ * for each mount and command one line is printed:
+ *   mount step start secs code reply
+ * where start is the MJD the command was sent, secs how long it took in
+ * simulated time, and code and reply are the final response.
+ *
+ * each mount may read its own config files by giving it its own TELHOME
+ * with -c, so tracking parameters may be compared side by side. mounts may
+ * also start at random times spread over -s secs for Monte-Carlo runs.
+ * N.B. do not run from a directory containing archive/config, else all
+ * mounts will find those files first.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "configfile.h"
+#include "csimc.h"
+#include "misc.h"
+#include "strops.h"
+#include "telenv.h"
+#include "telstatshm.h"
+
+#include "teled.h"
+
+#define POLLUS (2 * 1000000 / HZ) /* poll period, as telescoped */
+#define MAXHOMES 32               /* most -c options */
+
+/* one line of the script */
+typedef struct
+{
+    double wait;   /* secs after previous completes */
+    int focus;     /* set if for Focus rather than Tel */
+    char cmd[256]; /* command */
+} Step;
+
+/* one simulated mount */
+typedef struct
+{
+    int id;           /* 0.. */
+    char *home;       /* TELHOME, or NULL to use the environment */
+    double mjd0;      /* when its clock starts */
+    FifoId fid;       /* channel of the command in progress */
+    int code;         /* latest response code to that command */
+    char reply[256];  /* latest response to that command */
+    int failed;       /* set if the core died */
+    TelStatShm shm;   /* its status, as telescoped keeps in shm */
+    pthread_t thread; /* thread running it */
+} Mount;
+
+static void usage(void);
+static int readScript(FILE *fp);
+static void *runMount(void *arg);
+static void pollMount(void);
+
+static char *me;
+static Step *script;           /* malloced list of steps */
+static int nscript;            /* steps in script */
+static double rate;            /* clock rate, 0 for as fast as possible */
+static double cmdto = 3600;    /* secs to wait for a command to complete */
+static FILE *resfp;            /* where results go; stdout gets the logs */
+static THREADLOCAL Mount *mnt; /* the mount this thread is running */
+
+int main(int ac, char *av[])
+{
+    char *homes[MAXHOMES];
+    int nhomes = 0;
+    char *logfn = NULL;
+    double mjd0 = 0, spread = 0;
+    unsigned seed = 1;
+    struct timeval tv0, tv1;
+    Mount *mounts;
+    FILE *fp;
+    int n = 1;
+    int i;
+
+    me = basenm(av[0]);
+
+    while ((--ac > 0) && ((*++av)[0] == '-'))
+    {
+        char *s;
+        for (s = av[0] + 1; *s != '\0'; s++)
+            switch (*s)
+            {
+            case 'c':
+                if (ac < 2 || nhomes == MAXHOMES)
+                    usage();
+                homes[nhomes++] = *++av;
+                ac--;
+                break;
+            case 'j':
+                if (ac < 2)
+                    usage();
+                mjd0 = atof(*++av);
+                ac--;
+                break;
+            case 'l':
+                if (ac < 2)
+                    usage();
+                logfn = *++av;
+                ac--;
+                break;
+            case 'n':
+                if (ac < 2)
+                    usage();
+                n = atoi(*++av);
+                ac--;
+                break;
+            case 'r':
+                if (ac < 2)
+                    usage();
+                seed = atoi(*++av);
+                ac--;
+                break;
+            case 's':
+                if (ac < 2)
+                    usage();
+                spread = atof(*++av);
+                ac--;
+                break;
+            case 't':
+                if (ac < 2)
+                    usage();
+                rate = atof(*++av);
+                ac--;
+                break;
+            case 'w':
+                if (ac < 2)
+                    usage();
+                cmdto = atof(*++av);
+                ac--;
+                break;
+            default:
+                usage();
+            }
+    }
+    if (ac != 1 || n < 1 || rate < 0)
+        usage();
+
+    fp = fopen(av[0], "r");
+    if (!fp)
+    {
+        fprintf(stderr, "%s: %s\n", av[0], strerror(errno));
+        exit(1);
+    }
+    if (readScript(fp) <= 0)
+    {
+        fprintf(stderr, "%s: no commands\n", av[0]);
+        exit(1);
+    }
+    fclose(fp);
+
+    /* results to stdout, the cores' logging elsewhere */
+    resfp = fdopen(dup(1), "w");
+    if (!resfp || !freopen(logfn ? logfn : "/dev/null", "a", stdout))
+    {
+        fprintf(stderr, "%s: %s\n", logfn ? logfn : "/dev/null", strerror(errno));
+        exit(1);
+    }
+    setvbuf(resfp, NULL, _IOLBF, 0);
+
+    mounts = (Mount *)calloc(n, sizeof(Mount));
+    if (!mounts)
+    {
+        fprintf(stderr, "%s: no memory for %d mounts\n", me, n);
+        exit(1);
+    }
+    if (mjd0 == 0)
+        mjd0 = mjd_now();
+    srand(seed);
+
+    fprintf(resfp, "# %-4s %4s %14s %10s %4s %s\n", "Mount", "Step", "Start", "Secs", "Code", "Reply");
+    gettimeofday(&tv0, NULL);
+    for (i = 0; i < n; i++)
+    {
+        Mount *mp = &mounts[i];
+
+        mp->id = i;
+        mp->home = nhomes > 0 ? homes[i % nhomes] : NULL;
+        mp->mjd0 = mjd0 + spread * rand() / RAND_MAX / SPD;
+        if (pthread_create(&mp->thread, NULL, runMount, mp) != 0)
+        {
+            fprintf(stderr, "%s: can not start mount %d\n", me, i);
+            exit(1);
+        }
+    }
+    for (i = 0; i < n; i++)
+        pthread_join(mounts[i].thread, NULL);
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < n; i++)
+        if (mounts[i].failed)
+            fprintf(resfp, "# mount %d failed: %s\n", i, mounts[i].reply);
+    fprintf(resfp, "# %d mounts, %d steps, %.3f secs\n", n, nscript,
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6);
+
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: %s [options] script\n", me);
+    fprintf(stderr, "Purpose: run simulated telescopes in parallel through a script of commands.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -n n     number of mounts; default 1\n");
+    fprintf(stderr, "  -t rate  clock rate vs real time, 0 for as fast as possible; default 0\n");
+    fprintf(stderr, "  -j mjd   when the clocks start, as in telstatshm; default now\n");
+    fprintf(stderr, "  -s secs  start each mount at a random time up to this much later\n");
+    fprintf(stderr, "  -r seed  random seed for -s; default 1\n");
+    fprintf(stderr, "  -c dir   TELHOME for the next mount; repeat for more, used in turn\n");
+    fprintf(stderr, "  -w secs  longest to wait for a command to complete; default 3600\n");
+    fprintf(stderr, "  -l file  append the mounts' logs to file; default discard\n");
+    fprintf(stderr, "Script lines: secs command; secs to wait after the previous one completes\n");
+    exit(1);
+}
+
+/* read script lines from fp into script[].
+ * return number found.
+ */
+static int readScript(FILE *fp)
+{
+    char line[1024];
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        Step *sp;
+        char *cmd;
+        double wait;
+
+        if (line[0] == '#')
+            continue;
+        wait = strtod(line, &cmd);
+        if (cmd == line)
+            continue;
+        while (*cmd == ' ' || *cmd == '\t')
+            cmd++;
+        cmd[strcspn(cmd, "\r\n")] = '\0';
+        if (*cmd == '\0')
+            continue;
+
+        script = (Step *)realloc(script, (nscript + 1) * sizeof(Step));
+        if (!script)
+        {
+            fprintf(stderr, "No memory for more steps\n");
+            exit(1);
+        }
+        sp = &script[nscript++];
+        sp->wait = wait;
+        sp->focus = strncasecmp(cmd, "Focus ", 6) == 0;
+        if (sp->focus)
+            cmd += 6;
+        strncpy(sp->cmd, cmd, sizeof(sp->cmd) - 1);
+        sp->cmd[sizeof(sp->cmd) - 1] = '\0';
+    }
+
+    return (nscript);
+}
+
+/* thread to run one mount through the script */
+static void *runMount(void *arg)
+{
+    Mount *mp = (Mount *)arg;
+    double start;
+    int i;
+
+    /* set up a fresh core */
+    mnt = mp;
+    if (mp->home)
+        setTELHOME(mp->home);
+    vclockInit(rate, mp->mjd0);
+    telstatshmp = &mp->shm;
+    telstatshmp->now.n_mjd = vclockMJD();
+    telstatshmp->now.n_epoch = EOD;
+    virtual_mode = 1;
+    tel_msg("Reset");
+    focus_msg("Reset");
+
+    start = vclockMJD();
+    for (i = 0; i < nscript; i++)
+    {
+        Step *sp = &script[i];
+
+        while (vclockMJD() < start + sp->wait / SPD)
+            pollMount();
+
+        /* send, then poll until it completes */
+        mp->fid = sp->focus ? Focus_Id : Tel_Id;
+        mp->code = 1;
+        strcpy(mp->reply, "No response");
+        start = vclockMJD();
+        telstatshmp->now.n_mjd = start;
+        if (sp->focus)
+            focus_msg(sp->cmd);
+        else
+            tel_msg(sp->cmd);
+        while (mp->code > 0 && vclockMJD() < start + cmdto / SPD)
+            pollMount();
+
+        fprintf(resfp, "%6d %4d %14.6f %10.3f %4d %s\n", mp->id, i, start, (vclockMJD() - start) * SPD, mp->code,
+                mp->reply);
+        start = vclockMJD();
+    }
+
+    allstop();
+    return (NULL);
+}
+
+/* give the core one poll, as chk_fifos() does when no commands arrive */
+static void pollMount()
+{
+    long us;
+
+    telstatshmp->now.n_mjd = vclockMJD();
+    tel_msg(NULL);
+    focus_msg(NULL);
+
+    us = vclockWait(POLLUS);
+    if (us > 0)
+        usleep(us);
+}
+
+/* the core's replies come here rather than to a fifo */
+void fifoWrite(FifoId f, int code, char *fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (code < 0)
+        tdlog("%s: %d %s", f == Tel_Id ? "Tel" : "Focus", code, buf);
+    if (f == mnt->fid)
+    {
+        mnt->code = code;
+        strncpy(mnt->reply, buf, sizeof(mnt->reply) - 1);
+    }
+}
+
+/* log with the mount and its own time */
+void tdlog(char *fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    buf[strcspn(buf, "\n")] = '\0';
+
+    printf("%d %s: %s\n", mnt->id, timestamp((time_t)floor((vclockMJD() - 25567.5) * SPD)), buf);
+}
+
+/* the core can not continue: end just this mount */
+void die()
+{
+    tdlog("die()!");
+    mnt->failed = 1;
+    strcpy(mnt->reply, "died, see log");
+    pthread_exit(NULL);
+}
@@ -45,6 +45,11 @@
 #include "xobs.h"
 
 static void skyExpCB(Widget w, XtPointer client, XtPointer call);
+static void skyInit(void);
+static void drawSkyBg(void);
+static void findSyms(XRectangle syms[]);
+static void drawSyms(void);
+static void addDamage(XRectangle *rp);
 static void aa2xy(double alt, double az, int *xp, int *yp);
 
 #define SKYSZ 100    /* size of sky map, pixels */
@@ -53,8 +58,27 @@ static void aa2xy(double alt, double az, int *xp, int *yp);
 #define SUNSZ 8      /* size of sun */
 #define MOONSZ SUNSZ /* size of moon */
 
+/* the symbols that move, each kept as the rectangle it last covered.
+ * an empty rectangle means the symbol is not shown.
+ */
+typedef enum
+{
+    SYM_MOON,
+    SYM_SUN,
+    SYM_TARG,
+    SYM_TEL,
+    SYM_N
+} SkySym;
+
+#define MAXDAMAGE (2 * SYM_N) /* old and new place of each */
+
 static Widget skyda_w; /* sky symbol DA */
 static Pixmap sky_pm;  /* pixmap to make it update cleanly */
+static Pixmap bg_pm;   /* the parts that never change: sky and grid */
+
+static XRectangle drawn[SYM_N];        /* where each symbol is in sky_pm */
+static XRectangle damage[MAXDAMAGE];   /* areas of sky_pm to bring up to date */
+static int ndamage;
 
 static GC skyGC;        /* GC for skyda_w */
 static Pixel skybg_p;   /* color for overall background */
@@ -78,102 +102,215 @@ Widget mkSky(Widget main_w)
     return (fr_w);
 }
 
-/* draw the sky map.
+/* bring the sky map up to date.
+ * only the symbols that have moved are redrawn, and only the areas they left
+ * and now cover are copied to the screen, so this costs nothing when none has.
  * N.B. do nothing gracefully if called before window is known
  */
 void showSkyMap()
 {
     Display *dsp = XtDisplay(skyda_w);
     Window win = XtWindow(skyda_w);
-    int x, y;
+    XRectangle syms[SYM_N];
+    int i;
 
     if (!win || !sky_pm)
         return;
 
-    if (!skyGC)
+    /* note where anything has moved from and to */
+    findSyms(syms);
+    for (i = 0; i < SYM_N; i++)
     {
-        skyGC = XCreateGC(dsp, win, 0L, NULL);
-        sky_p = getColor(toplevel_w, "#334");
-        skygrid_p = getColor(toplevel_w, "#777");
-        skytel_p = getColor(toplevel_w, "#ccf");
-        skytarg_p = getColor(toplevel_w, "green");
-        skysun_p = getColor(toplevel_w, "yellow");
-        skymoon_p = getColor(toplevel_w, "#ccc");
-        XtVaGetValues(skyda_w, XmNbackground, &skybg_p, NULL);
+        if (memcmp(&syms[i], &drawn[i], sizeof(XRectangle)) == 0)
+            continue;
+        addDamage(&drawn[i]);
+        addDamage(&syms[i]);
+        drawn[i] = syms[i];
     }
+    if (ndamage == 0)
+        return;
+
+    /* restore the background under the damage then draw all symbols over it.
+     * symbols always draw in the same order, so redrawing those that have not
+     * moved leaves them just as they were.
+     */
+    for (i = 0; i < ndamage; i++)
+    {
+        XRectangle *rp = &damage[i];
+        XCopyArea(dsp, bg_pm, sky_pm, skyGC, rp->x, rp->y, rp->width, rp->height, rp->x, rp->y);
+    }
+    drawSyms();
+
+    /* copy just the damage to screen */
+    for (i = 0; i < ndamage; i++)
+    {
+        XRectangle *rp = &damage[i];
+        XCopyArea(dsp, sky_pm, win, skyGC, rp->x, rp->y, rp->width, rp->height, rp->x, rp->y);
+    }
+    ndamage = 0;
+}
+
+/* callback for the sky drawing area expose.
+ * the first builds the pixmaps, the rest just copy from sky_pm.
+ */
+static void skyExpCB(Widget w, XtPointer client, XtPointer call)
+{
+    Display *dsp = XtDisplay(w);
+    Window win = XtWindow(w);
+
+    if (!sky_pm)
+    {
+        skyInit();
+        showSkyMap();
+    }
+
+    XCopyArea(dsp, sky_pm, win, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 0);
+}
+
+/* create the GC, colors and pixmaps, and draw the background once */
+static void skyInit()
+{
+    Display *dsp = XtDisplay(skyda_w);
+    Window win = XtWindow(skyda_w);
+    Window root;
+    unsigned int bw, d;
+    unsigned int wid, hei;
+    int x, y;
+
+    skyGC = XCreateGC(dsp, win, 0L, NULL);
+    sky_p = getColor(toplevel_w, "#334");
+    skygrid_p = getColor(toplevel_w, "#777");
+    skytel_p = getColor(toplevel_w, "#ccf");
+    skytarg_p = getColor(toplevel_w, "green");
+    skysun_p = getColor(toplevel_w, "yellow");
+    skymoon_p = getColor(toplevel_w, "#ccc");
+    XtVaGetValues(skyda_w, XmNbackground, &skybg_p, NULL);
+
+    XGetGeometry(dsp, win, &root, &x, &y, &wid, &hei, &bw, &d);
+    sky_pm = XCreatePixmap(dsp, win, wid, hei, d);
+    bg_pm = XCreatePixmap(dsp, win, wid, hei, d);
+
+    /* nothing is drawn yet */
+    drawSkyBg();
+    XCopyArea(dsp, bg_pm, sky_pm, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 0);
+    memset(drawn, 0, sizeof(drawn));
+    ndamage = 0;
+}
+
+/* draw the sky disc, horizon labels and grid into bg_pm */
+static void drawSkyBg()
+{
+    Display *dsp = XtDisplay(skyda_w);
 
     /* background */
     XSetForeground(dsp, skyGC, skybg_p);
-    XFillRectangle(dsp, sky_pm, skyGC, 0, 0, SKYSZ, SKYSZ);
+    XFillRectangle(dsp, bg_pm, skyGC, 0, 0, SKYSZ, SKYSZ);
     XSetForeground(dsp, skyGC, sky_p);
-    XFillArc(dsp, sky_pm, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 360 * 64);
-    XDrawString(dsp, sky_pm, skyGC, 0, 10, "NW", 2);
+    XFillArc(dsp, bg_pm, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 360 * 64);
+    XDrawString(dsp, bg_pm, skyGC, 0, 10, "NW", 2);
 
     /* 30-degree grid */
     XSetForeground(dsp, skyGC, skygrid_p);
-    XDrawArc(dsp, sky_pm, skyGC, SKYSZ / 6, SKYSZ / 6, 2 * SKYSZ / 3, 2 * SKYSZ / 3, 0, 360 * 64);
-    XDrawArc(dsp, sky_pm, skyGC, SKYSZ / 3, SKYSZ / 3, SKYSZ / 3, SKYSZ / 3, 0, 360 * 64);
-    XDrawPoint(dsp, sky_pm, skyGC, SKYSZ / 2, SKYSZ / 2);
+    XDrawArc(dsp, bg_pm, skyGC, SKYSZ / 6, SKYSZ / 6, 2 * SKYSZ / 3, 2 * SKYSZ / 3, 0, 360 * 64);
+    XDrawArc(dsp, bg_pm, skyGC, SKYSZ / 3, SKYSZ / 3, SKYSZ / 3, SKYSZ / 3, 0, 360 * 64);
+    XDrawPoint(dsp, bg_pm, skyGC, SKYSZ / 2, SKYSZ / 2);
+}
 
-    /* crescent moon */
+/* fill syms[] with the rectangle each symbol would cover now.
+ * each includes all drawSyms() touches for it, with a pixel to spare for
+ * the outlines X draws one wider than asked.
+ */
+static void findSyms(XRectangle syms[])
+{
+    int x, y;
+
+    memset(syms, 0, SYM_N * sizeof(XRectangle));
+
+    /* moon, including the sky drawn over it to make the crescent */
     if (moonobj.s_alt >= 0)
     {
         aa2xy(moonobj.s_alt, moonobj.s_az, &x, &y);
-        XSetForeground(dsp, skyGC, skymoon_p);
-        XFillArc(dsp, sky_pm, skyGC, x - MOONSZ / 2, y - MOONSZ / 2, MOONSZ, MOONSZ, 0, 360 * 64);
-        XSetForeground(dsp, skyGC, sky_p);
-        XFillArc(dsp, sky_pm, skyGC, x - MOONSZ, y - MOONSZ / 2, MOONSZ, MOONSZ, 0, 360 * 64);
+        syms[SYM_MOON].x = x - MOONSZ;
+        syms[SYM_MOON].y = y - MOONSZ / 2;
+        syms[SYM_MOON].width = MOONSZ + MOONSZ / 2 + 1;
+        syms[SYM_MOON].height = MOONSZ + 1;
     }
 
-    /* sun */
     if (sunobj.s_alt >= 0)
     {
         aa2xy(sunobj.s_alt, sunobj.s_az, &x, &y);
-        XSetForeground(dsp, skyGC, skysun_p);
-        XFillArc(dsp, sky_pm, skyGC, x - SUNSZ / 2, y - SUNSZ / 2, SUNSZ, SUNSZ, 0, 360 * 64);
+        syms[SYM_SUN].x = x - SUNSZ / 2;
+        syms[SYM_SUN].y = y - SUNSZ / 2;
+        syms[SYM_SUN].width = syms[SYM_SUN].height = SUNSZ + 1;
     }
 
-    /* target */
     switch (telstatshmp->telstate)
     {
     case TS_SLEWING: /* FALLTHRU */
     case TS_HUNTING: /* FALLTHRU */
     case TS_TRACKING:
         aa2xy(telstatshmp->Dalt, telstatshmp->Daz, &x, &y);
-        XSetForeground(dsp, skyGC, skytarg_p);
-        XDrawLine(dsp, sky_pm, skyGC, x - TGSZ / 2, y - TGSZ / 2, x + TGSZ / 2, y + TGSZ / 2);
-        XDrawLine(dsp, sky_pm, skyGC, x + TGSZ / 2, y - TGSZ / 2, x - TGSZ / 2, y + TGSZ / 2);
+        syms[SYM_TARG].x = x - TGSZ / 2;
+        syms[SYM_TARG].y = y - TGSZ / 2;
+        syms[SYM_TARG].width = syms[SYM_TARG].height = TGSZ + 1;
         break;
     default:
         break;
     }
 
-    /* telescope */
     aa2xy(telstatshmp->Calt, telstatshmp->Caz, &x, &y);
-    XSetForeground(dsp, skyGC, skytel_p);
-    XDrawArc(dsp, sky_pm, skyGC, x - TLSZ / 2, y - TLSZ / 2, TLSZ, TLSZ, 0, 360 * 64);
-
-    /* copy pixmap to screen */
-    XCopyArea(dsp, sky_pm, win, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 0);
+    syms[SYM_TEL].x = x - TLSZ / 2;
+    syms[SYM_TEL].y = y - TLSZ / 2;
+    syms[SYM_TEL].width = syms[SYM_TEL].height = TLSZ + 1;
 }
 
-/* callback for the sky drawing area expose */
-static void skyExpCB(Widget w, XtPointer client, XtPointer call)
+/* draw each symbol shown into sky_pm where drawn[] says it is */
+static void drawSyms()
 {
-    if (!sky_pm)
+    Display *dsp = XtDisplay(skyda_w);
+    XRectangle *rp;
+
+    /* crescent moon */
+    rp = &drawn[SYM_MOON];
+    if (rp->width)
     {
-        Display *dsp = XtDisplay(w);
-        Window win = XtWindow(w);
-        Window root;
-        unsigned int bw, d;
-        unsigned int wid, hei;
-        int x, y;
-
-        XGetGeometry(dsp, win, &root, &x, &y, &wid, &hei, &bw, &d);
-        sky_pm = XCreatePixmap(dsp, win, wid, hei, d);
+        int x = rp->x + MOONSZ, y = rp->y + MOONSZ / 2;
+
+        XSetForeground(dsp, skyGC, skymoon_p);
+        XFillArc(dsp, sky_pm, skyGC, x - MOONSZ / 2, y - MOONSZ / 2, MOONSZ, MOONSZ, 0, 360 * 64);
+        XSetForeground(dsp, skyGC, sky_p);
+        XFillArc(dsp, sky_pm, skyGC, x - MOONSZ, y - MOONSZ / 2, MOONSZ, MOONSZ, 0, 360 * 64);
+    }
+
+    /* sun */
+    rp = &drawn[SYM_SUN];
+    if (rp->width)
+    {
+        XSetForeground(dsp, skyGC, skysun_p);
+        XFillArc(dsp, sky_pm, skyGC, rp->x, rp->y, SUNSZ, SUNSZ, 0, 360 * 64);
+    }
+
+    /* target */
+    rp = &drawn[SYM_TARG];
+    if (rp->width)
+    {
+        XSetForeground(dsp, skyGC, skytarg_p);
+        XDrawLine(dsp, sky_pm, skyGC, rp->x, rp->y, rp->x + TGSZ, rp->y + TGSZ);
+        XDrawLine(dsp, sky_pm, skyGC, rp->x + TGSZ, rp->y, rp->x, rp->y + TGSZ);
     }
 
-    showSkyMap();
+    /* telescope */
+    rp = &drawn[SYM_TEL];
+    XSetForeground(dsp, skyGC, skytel_p);
+    XDrawArc(dsp, sky_pm, skyGC, rp->x, rp->y, TLSZ, TLSZ, 0, 360 * 64);
+}
+
+/* add *rp to the damage list, unless it is empty */
+static void addDamage(XRectangle *rp)
+{
+    if (rp->width == 0 || ndamage >= MAXDAMAGE)
+        return;
+    damage[ndamage++] = *rp;
 }
 
 static void aa2xy(double alt, double az, int *xp, int *yp)
@@ -45,18 +45,27 @@ static char blank[] = " ";
 /* update the display.
  * called periodically and on specific impulses.
  * if force, redraw everything, else just what seems timely.
+ * N.B. nothing at all is done if neither the clock nor the shm generation
+ *   says anything could have changed since last time.
  */
 void updateStatus(int force)
 {
 
     static double last_slow, last_fast;
     static double last_tbusy, last_dbusy, last_obusy, last_wbusy;
+    static unsigned int last_gen;
     Now *np = &telstatshmp->now;
     int doslow = force || mjd > last_slow + SLOW_DT;
     int dofast = force || mjd > last_fast + FAST_DT;
+    int newgen = telstatshmp->gen != last_gen;
     TelState ts = telstatshmp->telstate;
     int busy;
 
+    /* idle */
+    if (!doslow && !dofast && !newgen)
+        return;
+    last_gen = telstatshmp->gen;
+
     /* always do these at least occasionally */
     if (doslow)
     {
@@ -72,18 +81,23 @@ void updateStatus(int force)
         last_fast = mjd;
     }
 
-    /* do these at least occasionally or especially often when busy */
+    /* do these at least occasionally or whenever something may have moved.
+     * showSkyMap() only draws what has, so this is cheap when nothing has.
+     */
     busy = ts == TS_SLEWING || ts == TS_HUNTING || ts == TS_LIMITING;
-    if (doslow || busy || mjd < last_tbusy + COAST_DT)
+    if (doslow || newgen || busy || mjd < last_tbusy + COAST_DT)
     {
         showSkyMap();
         if (busy)
             last_tbusy = mjd;
     }
 
-    /* always be very responsive to the scope */
+    /* always be very responsive to the scope.
+     * RA follows the clock even when nothing moves so keep up with that too.
+     */
     showScope();
-    showHL();
+    if (force || newgen)
+        showHL();
 }
 
 static void curPos()
@@ -173,7 +173,7 @@ static void initShm()
 }
 
 /* start the given daemon on the given channel if not already running.
- * wait for connect to work up to 'to' secs.
+ * rund returns as soon as the daemon says it is ready, up to 'to' secs.
  * die if required, else ignore.
  * N.B. this is *not* where we build the permanent fifo connection.
  */
@@ -181,14 +181,13 @@ static void chkDaemon(char *dname, char *fifo, int required, int to)
 {
     char buf[1024];
     int fd[2];
-    int i;
 
     /* ok if responding to lock */
     if (testlock_running(dname) == 0)
         return;
 
-    /* nope. execute it, via rund */
-    sprintf(buf, "rund %s", dname);
+    /* nope. execute it, via rund, and wait for it to be ready */
+    sprintf(buf, "rund -w %d %s", to, dname);
     if (system(buf) != 0)
     {
         if (required)
@@ -200,17 +199,13 @@ static void chkDaemon(char *dname, char *fifo, int required, int to)
             return;
     }
 
-    /* give it a few seconds to build the fifo */
-    for (i = 0; i < to; i++)
+    /* ready means the fifo is built, but make sure */
+    if (cli_conn(fifo, fd, buf) == 0)
     {
-        sleep(1);
-        if (cli_conn(fifo, fd, buf) == 0)
-        {
-            /* ok, it's running, that's all we need to know */
-            (void)close(fd[0]);
-            (void)close(fd[1]);
-            return;
-        }
+        /* ok, it's running, that's all we need to know */
+        (void)close(fd[0]);
+        (void)close(fd[1]);
+        return;
     }
 
     /* no can do if get here */